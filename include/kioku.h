@@ -27,6 +27,9 @@
 #include "kioku/filesystem.h"
 #include "kioku/git.h"
 #include "kioku/schedule.h"
+#include "kioku/clock.h"
+#include "kioku/scheduler.h"
+#include "kioku/optimizer.h"
 #include "kioku/string.h"
 #include "kioku/model.h"
 #include "kioku/card.h"
@@ -37,6 +40,10 @@
 #include "kioku/error.h"
 #include "kioku/enum.h"
 #include "kioku/datastructure.h"
+#include "kioku/thread.h"
+#include "kioku/io.h"
+#include "kioku/watch.h"
+#include "kioku/snapshot.h"
 
 #endif /* _KIOKU_H */
 
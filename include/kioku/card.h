@@ -3,6 +3,8 @@
 
 #include "kioku/schedule.h"
 #include "kioku/result.h"
+#include "kioku/filesystem.h"
+#include "kioku/datastructure.h"
 
 typedef struct _srsCARD_s
 {
@@ -12,23 +14,131 @@ typedef struct _srsCARD_s
   srsTIME     when_next_scheduled;
 } srsCARD;
 
+/**
+ * Number of cards a @ref srsCARD_CURSOR reads from disk at once. This bounds its memory use regardless of how many cards a deck has.
+ */
+#ifndef srsCARD_CURSOR_BATCH
+#define srsCARD_CURSOR_BATCH 64
+#endif
+
+/**
+ * Number of idle IO engines @ref srsCard_LoadTimes and card cursors keep for reuse. Each thread loading cards and each open cursor needs one of its own, and any beyond this are released once it is done.
+ */
+#ifndef srsCARD_ENGINES_MAX
+#define srsCARD_ENGINES_MAX 8
+#endif
+
+/**
+ * Restricts which cards a @ref srsCARD_CURSOR yields. Zeroed fields do not restrict anything, so a zeroed filter yields every card.
+ */
+typedef struct _srsCARD_FILTER_s
+{
+  srsTIME due_before;  /**< Only cards scheduled strictly before this time */
+  srsTIME added_after; /**< Only cards added strictly after this time */
+  size_t  limit;       /**< Stop after yielding this many cards */
+} srsCARD_FILTER;
+
+/**
+ * Opaque handle for reading the cards of a deck one at a time.
+ */
+typedef struct _srsCARD_CURSOR_s srsCARD_CURSOR;
+
+/**
+ * Opens a cursor over the cards of a deck.
+ * Cards are read from disk in batches of @ref srsCARD_CURSOR_BATCH as the cursor advances, and the filter is applied as each batch is read, so memory use is the same for a deck of any size.
+ * Cards come out in the order the cards directory lists them. That order does not depend on the filter and is the same for every cursor over an unchanged deck. Cards that are neither added nor removed while the cursor is open are yielded exactly once.
+ * Like @ref srsCard_GetAll, missing or malformed times are replaced with the current time and written back.
+ * @param[in] deck_name Name of the deck to get the cards from.
+ * @param[in] filter Restricts which cards are yielded. May be NULL to yield every card.
+ * @return The cursor, or NULL if the deck could not be opened. Must be released with @ref srsCardCursor_Close.
+ */
+kiokuAPI srsCARD_CURSOR *srsCardCursor_Open(const char *deck_name, const srsCARD_FILTER *filter);
+
+/**
+ * Behaves like @ref srsCardCursor_Open, for a deck of a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI srsCARD_CURSOR *srsCardCursor_OpenAt(srsMODEL *model, const char *deck_name, const srsCARD_FILTER *filter);
+
+/**
+ * Advances a cursor to the next card that passes its filter.
+ * @param[in] cursor The cursor.
+ * @param[out] card_out Receives the card. Its id and path are owned by the cursor and only valid until the next call.
+ * @return Whether a card was stored. False once every card has been yielded, the limit has been reached, or reading failed. See @ref srsCardCursor_HasFailed.
+ */
+kiokuAPI bool srsCardCursor_Next(srsCARD_CURSOR *cursor, srsCARD *card_out);
+
+/**
+ * Whether a cursor stopped early because cards could not be read.
+ * @param[in] cursor The cursor.
+ * @return True if reading failed. The error is set when it happens.
+ */
+kiokuAPI bool srsCardCursor_HasFailed(const srsCARD_CURSOR *cursor);
+
+/**
+ * Closes a cursor opened with @ref srsCardCursor_Open.
+ * @param[in] cursor The cursor. NULL is ignored.
+ */
+kiokuAPI void srsCardCursor_Close(srsCARD_CURSOR *cursor);
+
 /**
  * Returns a list of all cards for a deck.
- * TODO Some day we need to support decks with thousands of cards. We cannot allocate that much memory, and we have no real reason to. We will need a new function to replace this one that allows us to filter them.
+ * For large decks prefer @ref srsCardCursor_Open, which does not need to hold every card in memory at once.
  * @param[in] deck_name Name of the deck to get the cards from.
  * @param[out] count_out Place to store the number of elements in the returned array.
  * @return Unmanaged dynamically allocated card array, or NULL if no cards are found.
  */
 kiokuAPI srsCARD *srsCard_GetAll(const char *deck_name, size_t *count_out);
 
+/**
+ * Behaves like @ref srsCard_GetAll, for a deck of a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI srsCARD *srsCard_GetAllAt(srsMODEL *model, const char *deck_name, size_t *count_out);
+
+/**
+ * Returns a list of all cards for a deck, allocating the array and every string in it from an arena.
+ * This costs a handful of chunk allocations however many cards there are, and the whole listing is released with the arena rather than @ref srsCard_FreeArray.
+ * @param[in] deck_name Name of the deck to get the cards from.
+ * @param[in] arena The arena to allocate from. Nothing is left allocated in it on failure.
+ * @param[out] count_out Place to store the number of elements in the returned array.
+ * @return Card array owned by the arena, or NULL if no cards are found.
+ */
+kiokuAPI srsCARD *srsCard_GetAllInArena(const char *deck_name, srsARENA *arena, size_t *count_out);
+
+/**
+ * Behaves like @ref srsCard_GetAllInArena, for a deck of a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI srsCARD *srsCard_GetAllInArenaAt(srsMODEL *model, const char *deck_name, srsARENA *arena, size_t *count_out);
+
+/**
+ * Loads the added and scheduled times of a batch of cards in as few round trips as possible.
+ * Like @ref srsCard_GetAll, missing or malformed times are replaced with the current time and written back.
+ * @param[in] cards_dir Handle to the cards directory of the deck.
+ * @param[in,out] cards The cards. Their ids must be set, and their times are filled in.
+ * @param[in] count Number of cards.
+ * @return Whether the times could be read.
+ */
+kiokuAPI bool srsCard_LoadTimes(srsDIR *cards_dir, srsCARD *cards, size_t count);
+
 /**
  * Returns the content of a file associated with the specified card.
  * @param[in] card The card.
  * @param[in] file The filename to find relative to the card's directory.
- * @return Unmanaged dynamically allocated text of a file for the specified card. Returns NULL if the file doesn't exist relative to the card directory.
+ * @return Unmanaged dynamically allocated text of the whole file for the specified card. Returns NULL if the file doesn't exist relative to the card directory.
  */
 kiokuAPI char *srsCard_GetContent(srsCARD card, const char *file);
 
+/**
+ * Maps a file associated with the specified card without copying it.
+ * @param[in] card The card.
+ * @param[in] file The filename to find relative to the card's directory.
+ * @param[out] view_out Receives the view of the file. It must be released with @ref srsFile_Unmap when this succeeds.
+ * @return Whether the file could be mapped. Fails if the file doesn't exist relative to the card directory.
+ */
+kiokuAPI bool srsCard_MapContent(srsCARD card, const char *file, srsFILE_VIEW *view_out);
+
 /**
  * Frees a card array returned by @ref srsCard_GetAll
  * @param[in] cards Array of cards
@@ -0,0 +1,70 @@
+/**
+ * @addtogroup Clock
+ *
+ * Clock module
+ * Tells the local time without asking the C runtime for it every time.
+ * The offset of local time from UTC is looked up with the reentrant localtime_r and cached. Every time zone changes its offset on a quarter hour, so the cache is looked up again at most once per @ref srsCLOCK_REFRESH_SECONDS, and the current time is then only a call to time() and some arithmetic.
+ * Work that needs one consistent "now" for all it touches, such as a request or a batch of cards, should take a @ref srsCLOCK_SNAPSHOT once and reuse it.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_CLOCK_H
+#define _KIOKU_CLOCK_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+#include "kioku/schedule.h"
+
+/**
+ * Longest a cached UTC offset is used before it is looked up again. Caches expire on multiples of it counted from the Unix epoch, so it should divide the 15 minutes between possible changes of offset.
+ */
+#ifndef srsCLOCK_REFRESH_SECONDS
+#define srsCLOCK_REFRESH_SECONDS 900
+#endif
+
+/**
+ * The time at one moment, in each of the forms it is used in.
+ */
+typedef struct _srsCLOCK_SNAPSHOT_s
+{
+  int64_t utc;            /**< Seconds since the Unix epoch */
+  int32_t utc_offset;     /**< Minutes the local time is ahead of UTC */
+  srsTIME_PACKED packed;  /**< The local time, packed */
+  srsTIME time;           /**< The local time */
+} srsCLOCK_SNAPSHOT;
+
+/**
+ * Get the offset of local time from UTC, as of now. Looked up again at most once per @ref srsCLOCK_REFRESH_SECONDS. Thread-safe.
+ * @return Minutes the local time is ahead of UTC.
+ */
+kiokuAPI int32_t srsClock_GetUTCOffset();
+
+/**
+ * Get the current local time, to the minute. This is cheap enough to call per card, but a batch should still take it once with @ref srsClock_Capture so that all of it sees the same time.
+ * @return The current time, packed.
+ */
+kiokuAPI srsTIME_PACKED srsClock_Now();
+
+/**
+ * Takes the current time in each of its forms at once.
+ * @return The snapshot.
+ */
+kiokuAPI srsCLOCK_SNAPSHOT srsClock_Capture();
+
+/**
+ * Packs a Unix time as the local time of a given offset from UTC.
+ * @param[in] utc Seconds since the Unix epoch.
+ * @param[in] utc_offset Minutes the local time is ahead of UTC.
+ * @return The packed time, or @ref srsTIME_PACKED_NONE if it is before @ref srsTIME_PACKED_EPOCH_YEAR or after @ref srsTIME_PACKED_MAX_YEAR.
+ */
+kiokuAPI srsTIME_PACKED srsClock_Pack(int64_t utc, int32_t utc_offset);
+
+/**
+ * Drops the cached UTC offset so that it is looked up on next use, such as after the time zone of the process was changed.
+ */
+kiokuAPI void srsClock_Refresh();
+
+#endif /* _KIOKU_CLOCK_H */
+
+/** @} */
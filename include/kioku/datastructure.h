@@ -12,6 +12,9 @@
 
 #include "kioku/decl.h"
 #include "kioku/types.h"
+#include "kioku/thread.h"
+#include <stdlib.h>
+#include <string.h>
 
 #ifndef srsMEMSTACK_MINIMUM_CAPACITY
 #define srsMEMSTACK_MINIMUM_CAPACITY 2
@@ -79,6 +82,544 @@ kiokuAPI bool srsMemStack_Push(srsMEMSTACK *stack, const void *data);
  */
 kiokuAPI bool srsMemStack_Pop(srsMEMSTACK *stack, void *data_out);
 
+#ifndef srsVECTOR_MINIMUM_CAPACITY
+#define srsVECTOR_MINIMUM_CAPACITY 8
+#endif
+
+/**
+ * A vector gives memory back once its count drops below its capacity divided by this, halving the capacity.
+ * Shrinking only well below where it grew keeps a vector whose count goes up and down from reallocating every time.
+ */
+#ifndef srsVECTOR_SHRINK_DIVISOR
+#define srsVECTOR_SHRINK_DIVISOR 8
+#endif
+
+/**
+ * Changes where the elements of a vector live. Used by the functions @ref srsVECTOR_DEFINE generates whenever the capacity changes, and not meant to be called otherwise.
+ * Capacities up to inline_capacity use the inline storage, and anything larger is allocated.
+ * @param[in,out] data Pointer to the vector's elements.
+ * @param[in,out] capacity The vector's capacity.
+ * @param[in] inline_data The vector's inline storage.
+ * @param[in] inline_capacity Number of elements the inline storage holds.
+ * @param[in] count Number of elements to keep. Must not exceed new_capacity.
+ * @param[in] element_size Size of an element.
+ * @param[in] new_capacity The capacity to change to.
+ * @return Whether the capacity could be changed. If not, the vector is unchanged.
+ */
+kiokuAPI bool srsVector_SetCapacity(void **data, size_t *capacity, void *inline_data, size_t inline_capacity, size_t count, size_t element_size, size_t new_capacity);
+
+/**
+ * Defines a growable array of element_type, and inline functions to work with it, all named after the type and prefix given.
+ * The first inline_capacity elements are stored in the vector itself, so small vectors never allocate. It may be 0.
+ * Pushing and popping only call out of line when the capacity changes: it doubles when full, and halves per @ref srsVECTOR_SHRINK_DIVISOR.
+ * The definition is complete without a semicolon after it. A zeroed vector is empty and ready to use. Read the elements through data and count, but do not change them directly.
+ * While elements are stored inline, data points into the vector, so it must not be copied or moved.
+ * Not thread-safe.
+ *
+ * For example, srsVECTOR_DEFINE(srsINT_STACK, srsIntStack, int, 16) defines srsINT_STACK along with srsIntStack_Push and the rest:
+ * - void Free(vector): Releases the elements and leaves the vector empty.
+ * - bool Reserve(vector, capacity): Makes room for at least capacity elements in all.
+ * - bool Push(vector, element): Adds a copy of element to the end.
+ * - bool PushN(vector, elements, count): Adds copies of count elements to the end. They must not be in the vector.
+ * - element_type *Extend(vector, count): Adds count uninitialized elements to the end and returns the first of them, or NULL.
+ * - bool Pop(vector, element_out): Removes the last element, copying it to element_out unless that is NULL. False if empty.
+ * - element_type *Top(vector): The last element, or NULL if empty.
+ * - void Clear(vector): Removes every element, keeping the capacity.
+ * - element_type *Detach(vector, count_out): Hands the elements over as an array to be released with free(), leaving the vector empty. NULL if empty or if it could not be allocated.
+ */
+#define srsVECTOR_DEFINE(type_name, prefix, element_type, inline_capacity)                  \
+  typedef struct                                                                            \
+  {                                                                                         \
+    element_type *data;                                                                     \
+    size_t count;                                                                           \
+    size_t capacity;                                                                        \
+    element_type inline_data[((inline_capacity) > 0) ? (inline_capacity) : 1];              \
+  } type_name;                                                                              \
+                                                                                            \
+  static inline bool prefix##_SetCapacity(type_name *vector, size_t capacity)               \
+  {                                                                                         \
+    return srsVector_SetCapacity((void **)&vector->data, &vector->capacity, vector->inline_data, (inline_capacity), vector->count, sizeof(element_type), capacity); \
+  }                                                                                         \
+  static inline bool prefix##_Grow(type_name *vector, size_t count)                         \
+  {                                                                                         \
+    size_t needed = vector->count + count;                                                  \
+    size_t capacity = vector->capacity * 2;                                                 \
+    if (needed < vector->count)                                                             \
+    {                                                                                       \
+      return false;                                                                         \
+    }                                                                                       \
+    if (needed <= (inline_capacity))                                                        \
+    {                                                                                       \
+      return prefix##_SetCapacity(vector, (inline_capacity));                               \
+    }                                                                                       \
+    capacity = (capacity < srsVECTOR_MINIMUM_CAPACITY) ? srsVECTOR_MINIMUM_CAPACITY : capacity; \
+    return prefix##_SetCapacity(vector, (capacity < needed) ? needed : capacity);           \
+  }                                                                                         \
+  static inline void prefix##_Free(type_name *vector)                                       \
+  {                                                                                         \
+    vector->count = 0;                                                                      \
+    if ((vector->data != NULL) && (vector->data != vector->inline_data))                    \
+    {                                                                                       \
+      free(vector->data);                                                                   \
+    }                                                                                       \
+    vector->data = NULL;                                                                    \
+    vector->capacity = 0;                                                                   \
+  }                                                                                         \
+  static inline bool prefix##_Reserve(type_name *vector, size_t capacity)                   \
+  {                                                                                         \
+    return (capacity <= vector->capacity) || prefix##_SetCapacity(vector, capacity);        \
+  }                                                                                         \
+  static inline bool prefix##_Push(type_name *vector, element_type element)                 \
+  {                                                                                         \
+    if ((vector->count == vector->capacity) && !prefix##_Grow(vector, 1))                   \
+    {                                                                                       \
+      return false;                                                                         \
+    }                                                                                       \
+    vector->data[vector->count++] = element;                                                \
+    return true;                                                                            \
+  }                                                                                         \
+  static inline element_type *prefix##_Extend(type_name *vector, size_t count)              \
+  {                                                                                         \
+    if ((count > vector->capacity - vector->count) && !prefix##_Grow(vector, count))        \
+    {                                                                                       \
+      return NULL;                                                                          \
+    }                                                                                       \
+    vector->count += count;                                                                 \
+    return vector->data + (vector->count - count);                                          \
+  }                                                                                         \
+  static inline bool prefix##_PushN(type_name *vector, const element_type *elements, size_t count) \
+  {                                                                                         \
+    element_type *extended = (count == 0) ? NULL : prefix##_Extend(vector, count);          \
+    if (extended != NULL)                                                                   \
+    {                                                                                       \
+      memcpy(extended, elements, count * sizeof(element_type));                             \
+    }                                                                                       \
+    return (count == 0) || (extended != NULL);                                              \
+  }                                                                                         \
+  static inline bool prefix##_Pop(type_name *vector, element_type *element_out)             \
+  {                                                                                         \
+    if (vector->count == 0)                                                                 \
+    {                                                                                       \
+      return false;                                                                         \
+    }                                                                                       \
+    vector->count--;                                                                        \
+    if (element_out != NULL)                                                                \
+    {                                                                                       \
+      *element_out = vector->data[vector->count];                                           \
+    }                                                                                       \
+    if ((vector->count < vector->capacity / srsVECTOR_SHRINK_DIVISOR) && (vector->capacity > srsVECTOR_MINIMUM_CAPACITY) && (vector->data != vector->inline_data)) \
+    {                                                                                       \
+      /* Keeping the larger capacity is fine if this fails */                               \
+      prefix##_SetCapacity(vector, vector->capacity / 2);                                   \
+    }                                                                                       \
+    return true;                                                                            \
+  }                                                                                         \
+  static inline element_type *prefix##_Top(type_name *vector)                               \
+  {                                                                                         \
+    return (vector->count == 0) ? NULL : &vector->data[vector->count - 1];                  \
+  }                                                                                         \
+  static inline void prefix##_Clear(type_name *vector)                                      \
+  {                                                                                         \
+    vector->count = 0;                                                                      \
+  }                                                                                         \
+  static inline element_type *prefix##_Detach(type_name *vector, size_t *count_out)         \
+  {                                                                                         \
+    element_type *elements = NULL;                                                          \
+    size_t count = vector->count;                                                           \
+    if ((count > 0) && (vector->data == vector->inline_data))                               \
+    {                                                                                       \
+      elements = malloc(count * sizeof(element_type));                                      \
+      if (elements != NULL)                                                                 \
+      {                                                                                     \
+        memcpy(elements, vector->data, count * sizeof(element_type));                       \
+      }                                                                                     \
+    }                                                                                       \
+    else if (count > 0)                                                                     \
+    {                                                                                       \
+      elements = vector->data;                                                              \
+      vector->data = NULL;                                                                  \
+    }                                                                                       \
+    prefix##_Free(vector);                                                                  \
+    if (count_out != NULL)                                                                  \
+    {                                                                                       \
+      *count_out = (elements == NULL) ? 0 : count;                                          \
+    }                                                                                       \
+    return elements;                                                                        \
+  }
+
+#ifndef srsARENA_DEFAULT_CHUNK_SIZE
+#define srsARENA_DEFAULT_CHUNK_SIZE (16 * 1024)
+#endif
+
+/**
+ * Every allocation from an @ref srsARENA is aligned to this many bytes. Must be a power of two.
+ */
+#ifndef srsARENA_ALIGNMENT
+#define srsARENA_ALIGNMENT (2 * sizeof(void *))
+#endif
+
+typedef struct _srsARENA_CHUNK_s srsARENA_CHUNK;
+
+/**
+ * srsARENA
+ * A region allocator for many small allocations that share a lifetime.
+ * Allocations are bumped out of chunks obtained from malloc. Each new chunk is twice the size of the last, so an arena holding N bytes costs O(log N) mallocs.
+ * Nothing is freed individually. Memory is reclaimed all at once with @ref srsArena_Reset or @ref srsArena_Free.
+ * Not thread-safe. Directly altering any of these values will result in undefined behaviour.
+ */
+typedef struct _srsARENA_s
+{
+  size_t chunk_size;
+  srsARENA_CHUNK *chunk; /* Current chunk, linked to the ones before it */
+  srsARENA_CHUNK *spare; /* A released chunk kept for reuse so reset/allocate cycles do not hit malloc */
+  size_t used;           /* Bytes used in the current chunk */
+  void *last;            /* Most recent allocation, which can be resized in place */
+} srsARENA;
+
+/**
+ * A position in an arena recorded by @ref srsArena_GetMark.
+ */
+typedef struct _srsARENA_MARK_s
+{
+  srsARENA_CHUNK *chunk;
+  size_t used;
+} srsARENA_MARK;
+
+/**
+ * Initializes an arena. No memory is allocated until the first allocation.
+ * @param[in] arena The arena to initialize.
+ * @param[in] chunk_size Size of the first chunk. If 0, it will be set to @ref srsARENA_DEFAULT_CHUNK_SIZE.
+ * @return Whether the arena could be initialized. Fails on NULL input.
+ */
+kiokuAPI bool srsArena_Init(srsARENA *arena, size_t chunk_size);
+
+/**
+ * Releases every chunk of an arena and zeroes it. Any memory allocated from it becomes invalid.
+ * @param[in] arena The arena. NULL is ignored.
+ */
+kiokuAPI void srsArena_Free(srsARENA *arena);
+
+/**
+ * Allocates memory from an arena.
+ * @param[in] arena The arena.
+ * @param[in] size Number of bytes. 0 is treated as 1 so every allocation is distinct.
+ * @return Memory aligned to @ref srsARENA_ALIGNMENT, or NULL on bad input or allocation failure. Valid until the arena is reset past it or freed.
+ */
+kiokuAPI void *srsArena_Alloc(srsARENA *arena, size_t size);
+
+/**
+ * Allocates zeroed memory for an array from an arena.
+ * @param[in] arena The arena.
+ * @param[in] count Number of elements.
+ * @param[in] size Size of an element.
+ * @return The zeroed memory, or NULL on bad input, overflow or allocation failure.
+ */
+kiokuAPI void *srsArena_Calloc(srsARENA *arena, size_t count, size_t size);
+
+/**
+ * Resizes an allocation made from an arena. The most recent allocation grows or shrinks in place when its chunk has room. Anything else is copied to a new allocation, and the old one is only reclaimed with the rest of the arena.
+ * @param[in] arena The arena.
+ * @param[in] memory The allocation, or NULL to allocate.
+ * @param[in] old_size Size the allocation was made with.
+ * @param[in] new_size Size to resize to.
+ * @return The resized memory, or NULL on failure, in which case memory is left untouched.
+ */
+kiokuAPI void *srsArena_Realloc(srsARENA *arena, void *memory, size_t old_size, size_t new_size);
+
+/**
+ * Copies a string into an arena.
+ * @param[in] arena The arena.
+ * @param[in] string The string.
+ * @return The copy, or NULL on bad input or allocation failure.
+ */
+kiokuAPI char *srsArena_StrDup(srsARENA *arena, const char *string);
+
+/**
+ * Whether memory lies inside an arena's chunks.
+ * @param[in] arena The arena.
+ * @param[in] memory Any pointer.
+ * @return True if memory was allocated from the arena. This walks the chunk list, which is short thanks to chunk growth.
+ */
+kiokuAPI bool srsArena_Owns(const srsARENA *arena, const void *memory);
+
+/**
+ * Records the current position of an arena, so everything allocated after it can be released with @ref srsArena_Reset.
+ * @param[in] arena The arena.
+ * @return The mark. Marking an arena with nothing allocated yet gives a mark that resets it to empty.
+ */
+kiokuAPI srsARENA_MARK srsArena_GetMark(const srsARENA *arena);
+
+/**
+ * Releases everything allocated from an arena since a mark was taken. Marks taken after it become invalid.
+ * @param[in] arena The arena.
+ * @param[in] mark A mark from @ref srsArena_GetMark on the same arena.
+ */
+kiokuAPI void srsArena_Reset(srsARENA *arena, srsARENA_MARK mark);
+
+/**
+ * Smallest number of slots a hash map has. Must be a power of two.
+ */
+#ifndef srsHASHMAP_MINIMUM_CAPACITY
+#define srsHASHMAP_MINIMUM_CAPACITY 16
+#endif
+
+/**
+ * Percentage of a hash map's slots that may be used before it grows.
+ */
+#ifndef srsHASHMAP_MAX_LOAD_PERCENT
+#define srsHASHMAP_MAX_LOAD_PERCENT 85
+#endif
+
+/**
+ * Slots of the old table moved to the new one by each change while a hash map grows.
+ */
+#ifndef srsHASHMAP_MIGRATE_STEP
+#define srsHASHMAP_MIGRATE_STEP 32
+#endif
+
+typedef struct _srsHASHMAP_SLOT_s srsHASHMAP_SLOT;
+
+/**
+ * srsHASHMAP
+ * Maps strings to pointers with open addressing. Robin Hood probing keeps every entry close to its home slot, so a lookup reads one or two neighbouring slots and compares hashes before comparing any strings.
+ * Keys are interned: the map copies each key into an arena once, and the copy stays valid and unique until the map is freed, even after its entry is removed. Maps whose keys keep changing should be rebuilt now and then.
+ * Growing is incremental. A table twice the size is allocated, and every later change moves a few entries over from the old one, so no single change pays for rehashing them all. Lookups check both tables meanwhile.
+ * Lookups do not change the map, so any number of threads may look up at once as long as none changes it. Directly altering any of these values will result in undefined behaviour.
+ */
+typedef struct _srsHASHMAP_s
+{
+  srsHASHMAP_SLOT *slots;
+  size_t capacity;
+  size_t used;                 /* Entries in slots */
+  size_t count;                /* Entries in both tables */
+  srsHASHMAP_SLOT *old_slots;  /* The table being moved out of while growing */
+  size_t old_capacity;
+  size_t migrated;             /* Slots of the old table moved so far */
+  srsARENA keys;
+} srsHASHMAP;
+
+/**
+ * Initializes an empty hash map.
+ * @param[in] map The map to initialize.
+ * @param[in] capacity Number of entries to make room for up front. May be 0.
+ * @return Whether the map could be initialized. Fails on NULL input or allocation failure.
+ */
+kiokuAPI bool srsHashMap_Init(srsHASHMAP *map, size_t capacity);
+
+/**
+ * Releases everything a hash map holds, including its keys, and zeroes it.
+ * @param[in] map The map. NULL is ignored.
+ */
+kiokuAPI void srsHashMap_Free(srsHASHMAP *map);
+
+/**
+ * Adds an entry, or changes the value of the entry already there.
+ * @param[in] map The map.
+ * @param[in] key The key, which is copied.
+ * @param[in] value The value. May be NULL.
+ * @return False on bad input or allocation failure, in which case the map is unchanged.
+ */
+kiokuAPI bool srsHashMap_Set(srsHASHMAP *map, const char *key, void *value);
+
+/**
+ * Looks up an entry.
+ * @param[in] map The map.
+ * @param[in] key The key.
+ * @param[out] value_out Receives the value if found. May be NULL.
+ * @return Whether there is an entry for key.
+ */
+kiokuAPI bool srsHashMap_Get(const srsHASHMAP *map, const char *key, void **value_out);
+
+/**
+ * Removes an entry. Its interned key stays valid.
+ * @param[in] map The map.
+ * @param[in] key The key.
+ * @return Whether there was an entry to remove.
+ */
+kiokuAPI bool srsHashMap_Remove(srsHASHMAP *map, const char *key);
+
+/**
+ * Gets the map's own copy of a key, adding an entry with a NULL value if there is none. Equal strings interned in the same map give the same pointer, so they can be compared by address.
+ * @param[in] map The map.
+ * @param[in] key The key.
+ * @return The interned key, or NULL on bad input or allocation failure.
+ */
+kiokuAPI const char *srsHashMap_Intern(srsHASHMAP *map, const char *key);
+
+/**
+ * Get the number of entries in a hash map.
+ * @param[in] map The map.
+ * @return The number of entries, or 0 if map is NULL.
+ */
+kiokuAPI size_t srsHashMap_GetCount(const srsHASHMAP *map);
+
+/**
+ * Bytes the positions of an srsMPMC_QUEUE are kept apart by, so that producers and consumers do not contend for one cache line.
+ */
+#ifndef srsMPMC_QUEUE_CACHE_LINE
+#define srsMPMC_QUEUE_CACHE_LINE 64
+#endif
+
+typedef struct _srsMPMC_QUEUE_CELL_s srsMPMC_QUEUE_CELL;
+
+/**
+ * srsMPMC_QUEUE
+ * Bounded queue of pointers that any number of threads may push to and pop from at once without locking.
+ * Every cell carries a sequence number telling whether it is ready for the next push or the next pop, so a push or pop claims its cell with one compare-exchange and then publishes it with one store. It never blocks: pushing to a full queue and popping from an empty one fail straight away, and callers decide whether to wait.
+ * Directly altering any of these values will result in undefined behaviour.
+ */
+typedef struct _srsMPMC_QUEUE_s
+{
+  srsMPMC_QUEUE_CELL *cells;
+  uint32_t mask;               /* Capacity - 1, the capacity being a power of two */
+  uint8_t pad0[srsMPMC_QUEUE_CACHE_LINE];
+  srsATOMIC32 push_position;
+  uint8_t pad1[srsMPMC_QUEUE_CACHE_LINE];
+  srsATOMIC32 pop_position;
+  uint8_t pad2[srsMPMC_QUEUE_CACHE_LINE];
+} srsMPMC_QUEUE;
+
+/**
+ * Initializes an empty queue. Not thread-safe.
+ * @param[in] queue The queue to initialize.
+ * @param[in] capacity Number of pointers it holds at most, rounded up to a power of two. Must be between 2 and 2^30.
+ * @return Whether the queue could be initialized. Fails on bad input or allocation failure.
+ */
+kiokuAPI bool srsMPMCQueue_Init(srsMPMC_QUEUE *queue, uint32_t capacity);
+
+/**
+ * Releases a queue's cells and zeroes it. Pointers still in it are not touched. Not thread-safe.
+ * @param[in] queue The queue. NULL is ignored.
+ */
+kiokuAPI void srsMPMCQueue_Free(srsMPMC_QUEUE *queue);
+
+/**
+ * Adds a pointer to the back of a queue. Thread-safe.
+ * @param[in] queue The queue.
+ * @param[in] value The pointer. May be NULL.
+ * @return False if the queue is full.
+ */
+kiokuAPI bool srsMPMCQueue_Push(srsMPMC_QUEUE *queue, void *value);
+
+/**
+ * Takes the pointer at the front of a queue. Thread-safe.
+ * @param[in] queue The queue.
+ * @param[out] value_out Receives the pointer.
+ * @return False if the queue is empty.
+ */
+kiokuAPI bool srsMPMCQueue_Pop(srsMPMC_QUEUE *queue, void **value_out);
+
+/**
+ * Get the number of pointers a queue holds at most.
+ * @param[in] queue The queue.
+ * @return The capacity, or 0 if queue is NULL.
+ */
+kiokuAPI uint32_t srsMPMCQueue_GetCapacity(const srsMPMC_QUEUE *queue);
+
+/**
+ * Most pools whose objects threads cache at once. Pools beyond this still work, but share their objects through the pool's lock only.
+ */
+#ifndef srsPOOL_CACHES_MAX
+#define srsPOOL_CACHES_MAX 32
+#endif
+
+/**
+ * Objects a thread keeps cached per pool. Releasing more than this gives half of them back to the pool.
+ */
+#ifndef srsPOOL_CACHE_SIZE
+#define srsPOOL_CACHE_SIZE 64
+#endif
+
+/**
+ * Bytes of objects allocated together whenever a pool runs out. Objects larger than this get a slab each.
+ */
+#ifndef srsPOOL_SLAB_SIZE
+#define srsPOOL_SLAB_SIZE (64 * 1024)
+#endif
+
+typedef struct _srsPOOL_SLAB_s srsPOOL_SLAB;
+
+/**
+ * srsPOOL
+ * Allocates objects of one size from slabs of @ref srsPOOL_SLAB_SIZE bytes at a time, and keeps released objects for reuse instead of freeing them, so an object allocated and released over and over only reaches malloc once.
+ * Each thread caches up to @ref srsPOOL_CACHE_SIZE released objects per pool, and allocating and releasing only take the pool's lock when that cache is empty or full, moving half a cache at a time. Objects may be released on a different thread than they were allocated on, and a thread's cached objects go back to the pool when it exits.
+ * Slabs are only freed with the pool, so a pool holds on to as many objects as were ever allocated from it at once. Objects are aligned like @ref srsARENA allocations.
+ * Thread-safe, except for @ref srsPool_Free. Static pools are initialized with @ref srsPOOL_INIT and need no other set-up. Directly altering any of these values will result in undefined behaviour.
+ */
+typedef struct _srsPOOL_s
+{
+  size_t object_size;
+  srsATOMIC32 serial;      /* Tells this pool's thread caches from those of pools that used them before. 0 until first used. */
+  int32_t cache;           /* Which of each thread's caches this pool uses, or -1 for none */
+  srsSPINLOCK lock;        /* Guards everything below */
+  void *free_list;
+  srsPOOL_SLAB *slabs;
+} srsPOOL;
+
+#define srsPOOL_INIT(object_size) {(object_size), 0, -1, srsSPINLOCK_INIT, NULL, NULL}
+
+/**
+ * Initializes an empty pool. Nothing is allocated until the first object is.
+ * @param[in] pool The pool to initialize.
+ * @param[in] object_size Size of every object. Objects smaller than a pointer take the size of one.
+ */
+kiokuAPI void srsPool_Init(srsPOOL *pool, size_t object_size);
+
+/**
+ * Releases every slab of a pool, which invalidates every object allocated from it, whether released or not. The pool may be used again afterwards.
+ * Not thread-safe: no other thread may be using the pool.
+ * @param[in] pool The pool. NULL is ignored.
+ */
+kiokuAPI void srsPool_Free(srsPOOL *pool);
+
+/**
+ * Allocates an object. Its contents are unspecified.
+ * @param[in] pool The pool.
+ * @return The object, or NULL on bad input or allocation failure.
+ */
+kiokuAPI void *srsPool_Alloc(srsPOOL *pool);
+
+/**
+ * Gives an object back to the pool it was allocated from.
+ * @param[in] pool The pool.
+ * @param[in] object The object. NULL is ignored.
+ */
+kiokuAPI void srsPool_Release(srsPOOL *pool, void *object);
+
+/**
+ * Defines a pool of element_type, and inline functions to work with it, all named after the type and prefix given.
+ * The definition is complete without a semicolon after it. Static pools are initialized with srsPOOL_DEFINE_INIT(element_type).
+ *
+ * For example, srsPOOL_DEFINE(srsNODE_POOL, srsNodePool, srsNODE) defines srsNODE_POOL along with:
+ * - void Init(pool): See @ref srsPool_Init.
+ * - void Free(pool): See @ref srsPool_Free.
+ * - element_type *Alloc(pool): Allocates an element with unspecified contents, or returns NULL.
+ * - void Release(pool, element): Gives an element back.
+ */
+#define srsPOOL_DEFINE(type_name, prefix, element_type)                                     \
+  typedef struct                                                                            \
+  {                                                                                         \
+    srsPOOL pool;                                                                           \
+  } type_name;                                                                              \
+  static inline void prefix##_Init(type_name *pool)                                         \
+  {                                                                                         \
+    srsPool_Init(&pool->pool, sizeof(element_type));                                        \
+  }                                                                                         \
+  static inline void prefix##_Free(type_name *pool)                                         \
+  {                                                                                         \
+    srsPool_Free(&pool->pool);                                                              \
+  }                                                                                         \
+  static inline element_type *prefix##_Alloc(type_name *pool)                               \
+  {                                                                                         \
+    return (element_type *)srsPool_Alloc(&pool->pool);                                      \
+  }                                                                                         \
+  static inline void prefix##_Release(type_name *pool, element_type *element)               \
+  {                                                                                         \
+    srsPool_Release(&pool->pool, element);                                                  \
+  }
+
+#define srsPOOL_DEFINE_INIT(element_type) {srsPOOL_INIT(sizeof(element_type))}
+
 #endif /* _KIOKU_DATASTRUCTURE_H */
 
 /** @} */
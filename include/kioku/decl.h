@@ -103,6 +103,13 @@
 # error Cannot define srsTHREADLOCAL
 #endif
 
+/* Promises the compiler that a pointer is the only way its memory is reached, so loops over several arrays can be vectorized */
+#if defined(_MSC_VER) || defined(__cplusplus)
+# define srsRESTRICT __restrict
+#else
+# define srsRESTRICT restrict
+#endif
+
 #endif /* _KIOKU_DECL_H */
 
 /** @} */
@@ -111,6 +111,13 @@ kiokuAPI bool srsFileSystem_Exit();
  */
 kiokuAPI size_t srsPath_GetFull(const char *relative, char *path_out, size_t nbytes);
 
+/**
+ * Replace DOS style '\\' separators with '/' in place.
+ * @param[in,out] path Path to modify.
+ * @param[in] nbytes Maximum number of characters to look at.
+ */
+kiokuAPI void kioku_path_replace_separators(char *path, size_t nbytes);
+
 /**
  * Find the first and last chars to use in path for trimming redundant chars on each end.
  * Up to one leading slash may remain.
@@ -186,6 +193,16 @@ kiokuAPI bool srsFile_Create(const char *path);
  */
 kiokuAPI bool srsPath_Move(const char *path, const char *newpath);
 
+/**
+ * Get a name for a temporary file next to a path, to write a new version of it before moving it into place.
+ * The name is unique to the calling process and call, so concurrent writers of one path never write the same temporary file.
+ * @param[in] path Path the temporary file will be moved to.
+ * @param[out] temp_out Buffer to receive the name.
+ * @param[in] temp_size Size of the buffer, including null-terminator.
+ * @return Whether the name fit in the buffer.
+ */
+kiokuAPI bool srsFile_GetTempPath(const char *path, char *temp_out, size_t temp_size);
+
 /**
  * Delete a file or directory. @todo Directories will be deleted recursively.
  * @param[in] path Path to the file/dir to delete.
@@ -200,6 +217,13 @@ kiokuAPI bool srsPath_Remove(const char *path);
  */
 kiokuAPI bool srsPath_Exists(const char *path);
 
+/**
+ * Check if a path is absolute.
+ * @param[in] path Path to check.
+ * @return Whether the path starts at a filesystem root (including a drive letter on Windows).
+ */
+kiokuAPI bool srsPath_IsAbsolute(const char *path);
+
 /**
  * Check if a file exists.
  * @param[in] path Path to the file/dir to check.
@@ -223,12 +247,41 @@ kiokuAPI int32_t srsFile_GetLength(const char *filepath);
 
 /**
  * Set the content of a file (overwriting what may have been there)
+ * In durable mode the new content replaces the old atomically and is on stable storage once this returns. See @ref srsFileSystem_SetDurable.
  * @param[in] filepath Path to the file
  * @param[in] content The null-terminated content string to write.
  * @return Whether successful
  */
 kiokuAPI bool srsFile_SetContent(const char *filepath, const char *content);
 
+/**
+ * Upper bound on the number of files flushed together by one group commit in durable mode.
+ */
+#ifndef srsFILE_SYNC_BATCH_MAX
+#define srsFILE_SYNC_BATCH_MAX 64
+#endif
+
+/**
+ * How many times a group commit yields to let writers that are still preparing their files join it before it flushes without them.
+ */
+#ifndef srsFILE_SYNC_WINDOW_SPINS
+#define srsFILE_SYNC_WINDOW_SPINS 32
+#endif
+
+/**
+ * Turn durable writes on or off for @ref srsFile_SetContent and @ref srsFile_SetContentAt. They are off by default.
+ * When on, content is written to a temporary file that is flushed to disk and renamed over the original, so a crash can never leave a file half-written.
+ * Flushes from concurrent writers are batched into a group commit, so many writers together pay roughly the cost of one flush rather than one each.
+ * @param[in] durable Whether writes should be durable.
+ */
+kiokuAPI void srsFileSystem_SetDurable(bool durable);
+
+/**
+ * Whether durable writes are on. See @ref srsFileSystem_SetDurable.
+ * @return True if they are on.
+ */
+kiokuAPI bool srsFileSystem_IsDurable();
+
 /**
  * Get the content of a file.
  * @param[in] filepath Path to the file
@@ -309,6 +362,330 @@ kiokuAPI bool srsDir_PopCWD(char **popped);
  */
 kiokuAPI int32_t srsFile_ReadLineByNumber(const char *path, uint32_t linenum, char *linebuf, size_t linebuf_size);
 
+/**
+ * Opaque handle to an open directory.
+ * Paths passed alongside a directory handle are resolved relative to it rather than the Current Working Directory (CWD), so handle-based functions never touch the CWD or the Directory Stack and are safe to use from multiple threads.
+ * Wherever a function accepts a NULL handle, relative paths fall back to being resolved against the CWD.
+ */
+typedef struct _srsDIR_s srsDIR;
+
+/**
+ * This is used by @ref srsFileSystem_IterateAt to determine what to iterate over.
+ * @param dir Handle to the directory that contains the item being visited. It is only valid for the duration of the call.
+ * @param name The name of the item being visited, relative to dir.
+ * @param is_dir Whether the item is a directory. This comes from the directory listing where possible, so the visitor rarely needs to stat anything itself.
+ * @param userdata User-specified data via @ref srsFileSystem_IterateAt.
+ * @return Visiting action to perform. See @ref srsFILESYSTEM_VISIT_ACTION for more information.
+ */
+typedef srsFILESYSTEM_VISIT_ACTION (*srsFILESYSTEM_VISIT_AT_FUNC)(srsDIR *dir, const char *name, bool is_dir, void *userdata);
+
+/**
+ * Open a handle to a directory.
+ * @param[in] path Path to the directory. Relative paths are relative to the CWD at the time of the call only.
+ * @return A handle that must be released with @ref srsDir_Close, or NULL if path is not an accessible directory.
+ */
+kiokuAPI srsDIR *srsDir_Open(const char *path);
+
+/**
+ * Open a handle to a directory relative to another one.
+ * @param[in] dir The directory to resolve path against. If NULL, this behaves like @ref srsDir_Open.
+ * @param[in] path Path to the directory. Absolute paths ignore dir.
+ * @return A handle that must be released with @ref srsDir_Close, or NULL if path is not an accessible directory.
+ */
+kiokuAPI srsDIR *srsDir_OpenAt(srsDIR *dir, const char *path);
+
+/**
+ * Close a directory handle opened with @ref srsDir_Open or @ref srsDir_OpenAt.
+ * @param[in] dir The handle to close. NULL is ignored.
+ */
+kiokuAPI void srsDir_Close(srsDIR *dir);
+
+/**
+ * Get the path a directory handle was opened with.
+ * @param[in] dir The directory handle.
+ * @return The absolute path of the directory. Memory is owned by the handle. NULL if dir is NULL.
+ */
+kiokuAPI const char *srsDir_GetPath(const srsDIR *dir);
+
+#ifndef kiokuOS_WINDOWS
+/**
+ * Get the descriptor backing a directory handle, for use with the *at family of system calls.
+ * The descriptor remains owned by the handle.
+ * @param[in] dir The directory handle, or NULL for the CWD.
+ * @return The descriptor, or AT_FDCWD if dir is NULL.
+ */
+kiokuAPI int srsDir_GetDescriptor(const srsDIR *dir);
+#endif
+
+/**
+ * Check if a file/dir exists relative to a directory handle.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to the file/dir to check.
+ * @return Whether the file/dir exists.
+ */
+kiokuAPI bool srsPath_ExistsAt(srsDIR *dir, const char *path);
+
+/**
+ * Check if a file exists relative to a directory handle.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to the file to check.
+ * @return Whether the path exists and is not a directory.
+ */
+kiokuAPI bool srsFile_ExistsAt(srsDIR *dir, const char *path);
+
+/**
+ * Check if a directory exists relative to a directory handle.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to the dir to check.
+ * @return Whether the path exists and is a directory.
+ */
+kiokuAPI bool srsDir_ExistsAt(srsDIR *dir, const char *path);
+
+/**
+ * Open a file relative to a directory handle.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to the file.
+ * @param[in] mode File mode. Accepts anything that fopen would.
+ * @return The opened stream, or NULL on failure.
+ */
+kiokuAPI FILE *srsFile_OpenAt(srsDIR *dir, const char *path, const char *mode);
+
+/**
+ * Gets the length of a file relative to a directory handle.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] filepath Path to the file.
+ * @return The length of the file, or -1 if it isn't an accessible file.
+ */
+kiokuAPI int32_t srsFile_GetLengthAt(srsDIR *dir, const char *filepath);
+
+/**
+ * Set the content of an existing file relative to a directory handle. Behaves like @ref srsFile_SetContent.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] filepath Path to the file.
+ * @param[in] content The null-terminated content string to write.
+ * @return Whether successful.
+ */
+kiokuAPI bool srsFile_SetContentAt(srsDIR *dir, const char *filepath, const char *content);
+
+/**
+ * Get the content of a file relative to a directory handle. Behaves like @ref srsFile_GetContent.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] filepath Path to the file.
+ * @param[out] content_out Where to read the string into.
+ * @param[in] count Size of the content buffer, including null-terminator.
+ * @return Whether successful.
+ */
+kiokuAPI bool srsFile_GetContentAt(srsDIR *dir, const char *filepath, char *content_out, size_t count);
+
+/**
+ * Iterate the filesystem starting from a directory according to an iterator, without changing the CWD.
+ * Unlike @ref srsFileSystem_Iterate, this is safe to run from several threads at once.
+ * @param[in] dir The directory to resolve dirpath against, or NULL for the CWD.
+ * @param[in] dirpath The path to iterate from. Must be a valid directory.
+ * @param[in] userdata Passed to the iterator for the user to do with as they please.
+ * @param[in] iterator A callback function to determine how iteration takes place. See @ref srsFILESYSTEM_VISIT_AT_FUNC for more information.
+ * @return Whether any problems occured.
+ */
+kiokuAPI bool srsFileSystem_IterateAt(srsDIR *dir, const char *dirpath, void *userdata, srsFILESYSTEM_VISIT_AT_FUNC iterator);
+
+/**
+ * Opaque handle for reading the entries of a single directory one at a time.
+ * Unlike @ref srsFileSystem_IterateAt, the caller decides when to read the next entry, so reading can be paused and resumed without holding the whole listing in memory.
+ * Entries are returned in the order the directory lists them. That order is the same for every stream over an unchanged directory, and entries that are neither added nor removed while a stream is open are returned exactly once.
+ */
+typedef struct _srsDIR_STREAM_s srsDIR_STREAM;
+
+/**
+ * Open a stream over the entries of a directory.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to the directory.
+ * @return The stream, or NULL if path is not a readable directory. Must be released with @ref srsDirStream_Close.
+ */
+kiokuAPI srsDIR_STREAM *srsDirStream_Open(srsDIR *dir, const char *path);
+
+/**
+ * Read the next entry of a stream. The current and parent directory entries are skipped.
+ * @param[in] stream The stream.
+ * @param[out] name_out Receives the name of the entry. It is owned by the stream and only valid until the next call.
+ * @param[out] is_dir_out Receives whether the entry is a directory. May be NULL.
+ * @return Whether an entry was read. False once every entry has been read.
+ */
+kiokuAPI bool srsDirStream_Next(srsDIR_STREAM *stream, const char **name_out, bool *is_dir_out);
+
+/**
+ * Get the handle of the directory a stream reads, for resolving the names it returns.
+ * @param[in] stream The stream.
+ * @return The handle, owned by the stream. NULL if stream is NULL.
+ */
+kiokuAPI srsDIR *srsDirStream_GetDir(const srsDIR_STREAM *stream);
+
+/**
+ * Close a stream opened with @ref srsDirStream_Open.
+ * @param[in] stream The stream. NULL is ignored.
+ */
+kiokuAPI void srsDirStream_Close(srsDIR_STREAM *stream);
+
+/**
+ * Walks a directory tree like @ref srsFileSystem_IterateAt, but splits subtrees across a pool of work-stealing threads.
+ * Entries are read in large batches and their types come from the directory listing where the platform provides them, so most entries are never stat'd.
+ * Entries of one directory are visited in order by a single thread, but different directories are visited concurrently, so the iterator and userdata must be thread-safe.
+ * The directory handle passed to the iterator is only valid for the duration of the call.
+ * RECURSE queues the subdirectory rather than descending into it immediately, STOP skips the remaining entries of the current directory, and EXIT ends the walk as soon as every thread notices, though calls already in progress on other threads still complete.
+ * @param[in] dir Handle to resolve dirpath against, or NULL to resolve it against the CWD.
+ * @param[in] dirpath The directory to walk.
+ * @param[in] thread_count Number of threads to walk with, including the calling thread. 0 uses one per hardware thread.
+ * @param[in] userdata User-specified data passed to the iterator function.
+ * @param[in] iterator A callback function to determine how iteration takes place. See @ref srsFILESYSTEM_VISIT_AT_FUNC for more information.
+ * @return Whether the walk completed without failing to read a directory. An early STOP or EXIT still counts as success.
+ */
+kiokuAPI bool srsFileSystem_IterateParallel(srsDIR *dir, const char *dirpath, uint32_t thread_count, void *userdata, srsFILESYSTEM_VISIT_AT_FUNC iterator);
+
+/** Files larger than this many bytes are memory mapped by @ref srsFile_Map. Smaller ones are read into a pooled buffer. */
+#ifndef srsFILE_MAP_THRESHOLD
+#define srsFILE_MAP_THRESHOLD (16 * 1024)
+#endif
+
+/**
+ * srsFILE_VIEW
+ * Read-only view of a whole file obtained via @ref srsFile_Map.
+ * The data is not guaranteed to be NUL-terminated, so always bound reads by size.
+ * Only data and size may be read. Directly altering any of these values will result in undefined behaviour.
+ */
+typedef struct _srsFILE_VIEW_s
+{
+  const char *data;
+  size_t size;
+  int32_t kind;
+  int32_t slot;
+} srsFILE_VIEW;
+
+/**
+ * Maps the content of a file into memory without copying it into a caller buffer.
+ * @param[in] path Path to the file.
+ * @param[out] view_out Receives the view. It must be released with @ref srsFile_Unmap when it succeeds.
+ * @return Whether the file could be mapped. Fails if it does not exist, is a directory, or cannot be read.
+ */
+kiokuAPI bool srsFile_Map(const char *path, srsFILE_VIEW *view_out);
+
+/**
+ * Maps the content of a file relative to a directory handle. Behaves like @ref srsFile_Map.
+ * @param[in] dir Handle to resolve path against, or NULL to resolve it against the CWD.
+ * @param[in] path Path to the file.
+ * @param[out] view_out Receives the view. It must be released with @ref srsFile_Unmap when it succeeds.
+ * @return Whether the file could be mapped.
+ */
+kiokuAPI bool srsFile_MapAt(srsDIR *dir, const char *path, srsFILE_VIEW *view_out);
+
+/**
+ * Releases a view obtained via @ref srsFile_Map. Its data must not be used afterwards.
+ * Views may be released from any thread.
+ * @param[in] view The view to release.
+ */
+kiokuAPI void srsFile_Unmap(srsFILE_VIEW *view);
+
+/** Appended to a file's name to name its persistent line index */
+#ifndef srsLINE_INDEX_SUFFIX
+#define srsLINE_INDEX_SUFFIX ".lidx"
+#endif
+
+/** Directory next to a file that holds its persistent line index. It is created with a .gitignore, so indexes are never committed. */
+#ifndef srsLINE_INDEX_DIRNAME
+#define srsLINE_INDEX_DIRNAME ".kioku-cache"
+#endif
+
+/**
+ * srsLINE_INDEX
+ * Byte offsets of every line in a file so any line can be read with a single positioned read.
+ * Every access checks the file's size, modification time and inode, and rebuilds the index if the file changed.
+ * An index must not be used by several threads at once.
+ */
+typedef struct _srsLINE_INDEX_s srsLINE_INDEX;
+
+/**
+ * Indexes the lines of a file.
+ * Lines follow the rules of @ref srsFile_ReadLineByNumber.
+ * @param[in] path Path to the file. Relative paths are resolved against the CWD on every access.
+ * @param[in] persist Whether to load the index from, and save it to, a sidecar file in @ref srsLINE_INDEX_DIRNAME next to the file, named by appending @ref srsLINE_INDEX_SUFFIX to its name. A sidecar that does not match the file is ignored and replaced.
+ * @return The index, or NULL if the file could not be read or is larger than 4GiB. Must be released with @ref srsLineIndex_Close.
+ */
+kiokuAPI srsLINE_INDEX *srsLineIndex_Open(const char *path, bool persist);
+
+/**
+ * Releases an index obtained via @ref srsLineIndex_Open. Any sidecar is left in place.
+ * @param[in] index The index to release.
+ */
+kiokuAPI void srsLineIndex_Close(srsLINE_INDEX *index);
+
+/**
+ * Gets the number of lines in the indexed file.
+ * @param[in] index The index.
+ * @return The number of lines, or -1 if the file can no longer be read.
+ */
+kiokuAPI int32_t srsLineIndex_GetCount(srsLINE_INDEX *index);
+
+/**
+ * Reads a line from the indexed file. Behaves like @ref srsFile_ReadLineByNumber.
+ * @param[in] index The index.
+ * @param[in] linenum The line number, starting at 1.
+ * @param[out] linebuf Buffer to receive the line, without its line ending.
+ * @param[in] linebuf_size Size of linebuf. Longer lines are truncated.
+ * @return The length of the line read into linebuf, or -1 if there is no such line.
+ */
+kiokuAPI int32_t srsLineIndex_ReadLine(srsLINE_INDEX *index, uint32_t linenum, char *linebuf, size_t linebuf_size);
+
+/**
+ * Reads a line like @ref srsFile_ReadLineByNumber, using a persistent line index kept in a small process-wide cache.
+ * This is safe to call from several threads.
+ * @param[in] path Path to the file.
+ * @param[in] linenum The line number, starting at 1.
+ * @param[out] linebuf Buffer to receive the line, without its line ending.
+ * @param[in] linebuf_size Size of linebuf. Longer lines are truncated.
+ * @return The length of the line read into linebuf, or -1 if there is no such line.
+ */
+kiokuAPI int32_t srsFile_ReadLineIndexed(const char *path, uint32_t linenum, char *linebuf, size_t linebuf_size);
+
+/**
+ * Reads a line of a file relative to a directory handle. Behaves like @ref srsFile_ReadLineIndexed.
+ * @param[in] dir Handle to resolve path against, or NULL to resolve it against the CWD.
+ * @param[in] path Path to the file.
+ * @param[in] linenum The line number, starting at 1.
+ * @param[out] linebuf Buffer to receive the line, without its line ending.
+ * @param[in] linebuf_size Size of linebuf. Longer lines are truncated.
+ * @return The length of the line read into linebuf, or -1 if there is no such line.
+ */
+kiokuAPI int32_t srsFile_ReadLineIndexedAt(srsDIR *dir, const char *path, uint32_t linenum, char *linebuf, size_t linebuf_size);
+
+/**
+ * Drops anything cached in memory about a file, or about everything beneath a directory, such as existence checks and the indexes kept by @ref srsFile_ReadLineIndexed.
+ * Changes made through this module invalidate what they touch on their own. Watchers call this for changes made by anything else.
+ * @param[in] path Path to a file or directory. It does not need to exist anymore.
+ */
+kiokuAPI void srsFileSystem_Invalidate(const char *path);
+
+/**
+ * Drops anything cached in memory about a path relative to a directory handle. Behaves like @ref srsFileSystem_Invalidate.
+ * @param[in] dir The directory to resolve path against, or NULL for the CWD.
+ * @param[in] path Path to a file or directory.
+ */
+kiokuAPI void srsFileSystem_InvalidateAt(srsDIR *dir, const char *path);
+
+/**
+ * How long in milliseconds the existence checks of paths nobody is watching may be answered from memory.
+ * Off by default, since changes made outside this module would go unnoticed for that long.
+ */
+#ifndef srsSTAT_CACHE_TTL_MS
+#define srsSTAT_CACHE_TTL_MS 0
+#endif
+
+/**
+ * Declare that a watcher reports every change beneath a directory via @ref srsFileSystem_Invalidate.
+ * Until that stops, existence checks beneath it (@ref srsPath_Exists, @ref srsFile_Exists, @ref srsDir_Exists and their At variants) are answered from a bounded in-memory cache, including for paths that do not exist.
+ * @param[in] path Path to the watched directory.
+ * @param[in] watched Whether it is now watched. Each watcher of a directory declares it separately, and when the last one stops, everything cached beneath it is dropped.
+ * @return Whether the directory was added or removed. Fails if it was not being watched, or on allocation failure.
+ */
+kiokuAPI bool srsFileSystem_SetWatched(const char *path, bool watched);
+
 #endif /* _KIOKU_FILESYSTEM_H */
 
 /**
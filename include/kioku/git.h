@@ -14,6 +14,18 @@ typedef struct srsGIT_CREATE_OPTS_s {
 
 #define srsGIT_CREATE_OPTS_INIT (srsGIT_CREATE_OPTS){".gitignore", "", "Initial Commit"}
 
+/**
+ * Size of a buffer that can hold an object ID as a hex string, including the terminator.
+ */
+#define srsGIT_OID_STRING_SIZE 41
+
+/**
+ * srsGIT_REPO
+ * An open repository, for working with several repositories at once. The srsGit_Repo_* functions work with the current repository, which is one of these too.
+ * Each repository serializes the operations on it, so it may be used from any thread.
+ */
+typedef struct _srsGIT_REPO_s srsGIT_REPO;
+
 /**
  * Create a repository with a first file and initial commit.
  * This will update all git functions to operate on the new repository.
@@ -23,6 +35,59 @@ typedef struct srsGIT_CREATE_OPTS_s {
  */
 kiokuAPI bool srsGit_Repo_Create(const char *path, const srsGIT_CREATE_OPTS opts);
 
+/**
+ * Create a repository with a first file and initial commit, like @ref srsGit_Repo_Create, without changing the current repository.
+ * @param[in] path The path at which to create it.
+ * @param[in] opts The options that specify how the repository is initialized.
+ * @return The new repository, to be closed with @ref srsGitRepo_Close, or NULL if it could not be created.
+ */
+kiokuAPI srsGIT_REPO *srsGitRepo_Create(const char *path, const srsGIT_CREATE_OPTS opts);
+
+/**
+ * Open a repository without changing the current repository.
+ * @param[in] path The path to the repository.
+ * @return The repository, to be closed with @ref srsGitRepo_Close, or NULL if it could not be opened.
+ */
+kiokuAPI srsGIT_REPO *srsGitRepo_Open(const char *path);
+
+/**
+ * Close a repository opened with @ref srsGitRepo_Open or @ref srsGitRepo_Create.
+ * @param[in] repo The repository. May be NULL.
+ */
+kiokuAPI void srsGitRepo_Close(srsGIT_REPO *repo);
+
+/**
+ * Get the path of a repository's workdir.
+ * @param[in] repo The repository.
+ * @return The path, ending in a separator. Memory is owned by the repository.
+ */
+kiokuAPI const char *srsGitRepo_GetPath(const srsGIT_REPO *repo);
+
+/**
+ * Commit whatever has been added to a repository. Behaves like @ref srsGit_Commit.
+ * @param[in] repo The repository.
+ * @param[in] message The commit message
+ * @return Whether it was successful.
+ */
+kiokuAPI bool srsGitRepo_Commit(srsGIT_REPO *repo, const char *message);
+
+/**
+ * Add a path of a repository to be committed. Behaves like @ref srsGit_Add.
+ * @param[in] repo The repository.
+ * @param[in] path The path(s) to be added, relative to the root of the repository.
+ * @return Whether it was successful.
+ */
+kiokuAPI bool srsGitRepo_Add(srsGIT_REPO *repo, const char *path);
+
+/**
+ * Get the commit a repository's HEAD points to. Behaves like @ref srsGit_Repo_GetHead.
+ * @param[in] repo The repository.
+ * @param[out] oid_out Receives the object ID as a hex string.
+ * @param[in] oid_out_size Size of oid_out. Must be at least @ref srsGIT_OID_STRING_SIZE.
+ * @return Whether it was stored.
+ */
+kiokuAPI bool srsGitRepo_GetHead(srsGIT_REPO *repo, char *oid_out, size_t oid_out_size);
+
 /**
  * Return the number of times the git library has been initialized.
  * If it's greater than 1, a git shutdown is needed.
@@ -75,4 +140,49 @@ kiokuAPI srsRESULT srsGit_Repo_Open(const char *path);
  */
 kiokuAPI const char *srsGit_Repo_GetCurrent();
 
+/**
+ * Get the current repository itself, for the srsGitRepo_* functions.
+ * @return The current repository, or NULL if none is open. It is owned by the implementation and is closed when the current repository changes.
+ */
+kiokuAPI srsGIT_REPO *srsGit_Repo_GetCurrentRepo();
+
+/**
+ * Get the commit the current repo's HEAD points to.
+ * @param[out] oid_out Receives the object ID as a hex string.
+ * @param[in] oid_out_size Size of oid_out. Must be at least @ref srsGIT_OID_STRING_SIZE.
+ * @return Whether it was stored. Fails when no repo is open or HEAD does not point to a commit yet.
+ */
+kiokuAPI bool srsGit_Repo_GetHead(char *oid_out, size_t oid_out_size);
+
+/**
+ * Called by @ref srsGit_Repo_WalkHistory for each version of a file.
+ * @param[in] path Path of the file, relative to the repo.
+ * @param[in] content Content of the file as committed. It is not null-terminated.
+ * @param[in] size Size of content in bytes.
+ * @param[in] time When it was committed, as seconds since 1970 in the committer's local time.
+ * @param[in] userdata User-specified data via @ref srsGit_Repo_WalkHistory.
+ * @return Whether to keep walking.
+ */
+typedef bool (*srsGIT_HISTORY_FUNC)(const char *path, const char *content, size_t size, int64_t time, void *userdata);
+
+/**
+ * Walks the first-parent history of the current repo's HEAD from the oldest commit on, visiting every file each commit added or changed.
+ * @param[in] pathspec Only files matching this pattern are visited, with the same rules as git's pathspecs. NULL visits every file.
+ * @param[in] func Called for each version of a file.
+ * @param[in] userdata Passed through to func.
+ * @return Whether the whole history could be read, or func stopped the walk.
+ */
+kiokuAPI bool srsGit_Repo_WalkHistory(const char *pathspec, srsGIT_HISTORY_FUNC func, void *userdata);
+
+/**
+ * Walks the history of a repository's HEAD. Behaves like @ref srsGit_Repo_WalkHistory.
+ * The repository stays locked during the walk, so func must not use it.
+ * @param[in] repo The repository.
+ * @param[in] pathspec Only files matching this pattern are visited. NULL visits every file.
+ * @param[in] func Called for each version of a file.
+ * @param[in] userdata Passed through to func.
+ * @return Whether the whole history could be read, or func stopped the walk.
+ */
+kiokuAPI bool srsGitRepo_WalkHistory(srsGIT_REPO *repo, const char *pathspec, srsGIT_HISTORY_FUNC func, void *userdata);
+
 #endif /* _KIOKU_SIMPLEGIT_H */
@@ -0,0 +1,100 @@
+/**
+ * @addtogroup IO
+ *
+ * IO module
+ * Executes batches of small file operations with as few round trips to the kernel as possible.
+ * On Linux batches are submitted through io_uring. Elsewhere, or when io_uring is unavailable, a small pool of threads performs them with blocking calls.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_IO_H
+#define _KIOKU_IO_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+#include "kioku/filesystem.h"
+
+/**
+ * Default number of operations kept in flight at once.
+ */
+#define srsIO_DEFAULT_DEPTH 64
+
+/**
+ * Engine flag to always use the blocking thread pool, even where io_uring is available.
+ */
+#define srsIO_FLAG_BLOCKING (1 << 0)
+
+/**
+ * Request flag for @ref srsIO_WRITE to create the file if it does not exist. Without it, writing to a missing file fails.
+ */
+#define srsIO_FLAG_CREATE (1 << 0)
+
+/**
+ * Kinds of requests.
+ */
+typedef enum _srsIO_OP_e
+{
+  srsIO_READ,  /**< Open a file and read up to size bytes from its start into buffer */
+  srsIO_WRITE, /**< Open a file, truncate it, and write size bytes from buffer */
+  srsIO_STAT,  /**< Get the size, modification time and type of a path */
+  srsIO_SYNC   /**< Open a file or directory and flush it to stable storage. Submitting many together lets the filesystem commit them at once. */
+} srsIO_OP;
+
+/**
+ * A single file operation. Fill in the inputs and submit an array of them with @ref srsIO_Submit.
+ */
+typedef struct _srsIO_REQUEST_s
+{
+  /* Inputs */
+  srsIO_OP op;
+  srsDIR *dir;      /**< Handle to resolve path against, or NULL for the CWD */
+  const char *path;
+  char *buffer;     /**< Destination for @ref srsIO_READ, source for @ref srsIO_WRITE */
+  size_t size;      /**< Capacity of buffer for @ref srsIO_READ, bytes to write for @ref srsIO_WRITE */
+  uint32_t flags;
+  void *userdata;
+  /* Outputs */
+  int64_t result;   /**< Bytes read or written, 0 for a successful @ref srsIO_STAT or @ref srsIO_SYNC, or a negated errno value */
+  uint64_t file_size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  bool is_dir;
+} srsIO_REQUEST;
+
+typedef struct _srsIO_ENGINE_s srsIO_ENGINE;
+
+/**
+ * Creates an engine. An engine may only be used by one thread at a time.
+ * @param[in] depth Number of operations to keep in flight at once. 0 uses @ref srsIO_DEFAULT_DEPTH.
+ * @param[in] flags Combination of srsIO_FLAG engine flags.
+ * @return The engine, or NULL if it could not be created. Must be released with @ref srsIO_Destroy.
+ */
+kiokuAPI srsIO_ENGINE *srsIO_Create(uint32_t depth, uint32_t flags);
+
+/**
+ * Releases an engine created with @ref srsIO_Create.
+ * @param[in] engine The engine.
+ */
+kiokuAPI void srsIO_Destroy(srsIO_ENGINE *engine);
+
+/**
+ * Whether the engine submits requests asynchronously to the kernel rather than through its thread pool.
+ * @param[in] engine The engine.
+ * @return True for io_uring.
+ */
+kiokuAPI bool srsIO_IsAsync(const srsIO_ENGINE *engine);
+
+/**
+ * Executes a batch of requests, returning once all of them have completed.
+ * Requests are independent of each other and may complete in any order.
+ * @param[in] engine The engine.
+ * @param[in,out] requests The requests. Their outputs are filled in on return.
+ * @param[in] count Number of requests.
+ * @return Whether the batch was executed. Each request reports its own failure through its result.
+ */
+kiokuAPI bool srsIO_Submit(srsIO_ENGINE *engine, srsIO_REQUEST *requests, size_t count);
+
+#endif /* _KIOKU_IO_H */
+
+/** @} */
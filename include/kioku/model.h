@@ -12,6 +12,11 @@
 #include "kioku/decl.h"
 #include "kioku/types.h"
 #include "kioku/result.h"
+#include "kioku/filesystem.h"
+#include "kioku/watch.h"
+#include "kioku/schedule.h"
+#include "kioku/card.h"
+#include "kioku/git.h"
 
 #ifndef KIOKU_MODEL_USERLIST_NAME
 #define KIOKU_MODEL_USERLIST_NAME "users.json"
@@ -20,6 +25,90 @@
 #define srsMODEL_CARD_ID_MAX 256
 #define srsMODEL_DECK_ID_MAX 256
 
+/**
+ * Maximum number of listeners that can be registered via @ref srsModel_AddListener at once.
+ */
+#ifndef srsMODEL_LISTENER_MAX
+#define srsMODEL_LISTENER_MAX 8
+#endif
+
+/**
+ * Maximum number of rescheduled cards remembered between calls to @ref srsModel_Card_GetNextID. Beyond this the deck's due queue is rebuilt instead.
+ */
+#ifndef srsMODEL_DUE_PENDING_MAX
+#define srsMODEL_DUE_PENDING_MAX 64
+#endif
+
+/**
+ * Number of cards counted at a time by each thread of @ref srsModel_GetForecast.
+ */
+#ifndef srsMODEL_FORECAST_CHUNK
+#define srsMODEL_FORECAST_CHUNK 65536
+#endif
+
+/**
+ * Maximum number of threads @ref srsModel_GetForecast counts cards on.
+ */
+#ifndef srsMODEL_FORECAST_THREADS_MAX
+#define srsMODEL_FORECAST_THREADS_MAX 16
+#endif
+
+/**
+ * Maximum number of threads decks are loaded on when the model is made resident by @ref srsModel_SetResident.
+ */
+#ifndef srsMODEL_RESIDENT_THREADS_MAX
+#define srsMODEL_RESIDENT_THREADS_MAX 16
+#endif
+
+/**
+ * Maximum number of paths @ref srsModel_ExistsInRoot remembers having found inside the model root. They are forgotten all at once when it fills up.
+ */
+#ifndef srsMODEL_PATH_CACHE_MAX
+#define srsMODEL_PATH_CACHE_MAX 4096
+#endif
+
+/**
+ * Called for each card by @ref srsModel_Deck_ForEachCard.
+ * @param[in] card The card. It and its strings are only valid during the call.
+ * @param[in] userdata Passed through from @ref srsModel_Deck_ForEachCard.
+ * @return Whether to go on to the next card.
+ */
+typedef bool (*srsMODEL_CARD_FUNC)(const srsCARD *card, void *userdata);
+
+/**
+ * Open a model context for a root. Behaves like @ref srsModel_SetRoot on a new context.
+ * @param[in] path Path to the model root.
+ * @return The context, to be closed with @ref srsModel_Close, or NULL if the root could not be set.
+ */
+kiokuAPI srsMODEL *srsModel_Open(const char *path);
+
+/**
+ * Close a model context opened with @ref srsModel_Open, releasing its root and everything kept about it.
+ * @param[in] model The context. May be NULL.
+ */
+kiokuAPI void srsModel_Close(srsMODEL *model);
+
+/**
+ * Get the default model context, which the functions without a model argument work with.
+ * @return The default context. It is never closed.
+ */
+kiokuAPI srsMODEL *srsModel_GetDefault();
+
+/**
+ * Get the repository of a context's root.
+ * @param[in] model The context.
+ * @return The repository, or NULL if no root is set. It is owned by the context and remains valid until its root changes.
+ */
+kiokuAPI srsGIT_REPO *srsModel_GetRepoAt(srsMODEL *model);
+
+/**
+ * Get a counter that changes whenever the watcher of a context sees cards change, not counting snapshots being written.
+ * Caches of card state can compare it to the value they were built at, like @ref srsModel_GetVersion but without being invalidated by their own writes.
+ * @param[in] model The context.
+ * @return The current count. Only meaningful while @ref srsModel_IsWatchedAt is true.
+ */
+kiokuAPI int32_t srsModel_GetCardChangesAt(srsMODEL *model);
+
 /**
  * Set the root path for all model operations. All non-absolute paths passed to the model API are assumed to be relative to it.
  * @param[in] path Path to use as model root. If NULL, it will attempt to close out any resources associated with it. Otherwise, it must be an existing directory that is also a git repository. The string is duplicated - no reference to the actual pointer is kept.
@@ -27,6 +116,12 @@
  */
 kiokuAPI srsRESULT srsModel_SetRoot(const char *path);
 
+/**
+ * Behaves like @ref srsModel_SetRoot, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI srsRESULT srsModel_SetRootAt(srsMODEL *model, const char *path);
+
 /**
  * Get the root path for all model operations. It will be an absolute path.
  * @param[in] path Path to use as model root. Must be an existing directory that is also a git repository. The string is duplicated - no reference to the actual pointer is kept.
@@ -34,6 +129,132 @@ kiokuAPI srsRESULT srsModel_SetRoot(const char *path);
  */
 kiokuAPI const char *srsModel_GetRoot();
 
+/**
+ * Behaves like @ref srsModel_GetRoot, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI const char *srsModel_GetRootAt(srsMODEL *model);
+
+/**
+ * Get a handle to the root directory for all model operations.
+ * Model functions resolve their paths against this rather than the current working directory.
+ * @return The handle for the current model root, or NULL if one is not set. It is owned by the model and remains valid until the root changes.
+ */
+kiokuAPI srsDIR *srsModel_GetRootDir();
+
+/**
+ * Behaves like @ref srsModel_GetRootDir, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI srsDIR *srsModel_GetRootDirAt(srsMODEL *model);
+
+/**
+ * Whether the decks of the current model root are being watched for changes made outside of the model API, such as manual edits.
+ * The watcher is started by @ref srsModel_SetRoot where the platform supports it. Without one, changes are only seen when files are read again.
+ * @return True if changes are being watched.
+ */
+kiokuAPI bool srsModel_IsWatched();
+
+/**
+ * Behaves like @ref srsModel_IsWatched, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_IsWatchedAt(srsMODEL *model);
+
+/**
+ * Get a counter that changes whenever a change to the decks of the model root is observed, and whenever the root changes.
+ * State derived from the model can be kept in memory and refreshed only when this differs from the value it was built at.
+ * @return The current version. Only meaningful while @ref srsModel_IsWatched is true.
+ */
+kiokuAPI uint32_t srsModel_GetVersion();
+
+/**
+ * Behaves like @ref srsModel_GetVersion, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI uint32_t srsModel_GetVersionAt(srsMODEL *model);
+
+/**
+ * Register a callback for changes to the decks of the model root, such as cards being added, edited or rescheduled.
+ * Callbacks run on the watcher thread after cached file state for the path has been invalidated. They are only called while @ref srsModel_IsWatched is true.
+ * Paths passed to the callback are relative to the model root, e.g. "decks/Japanese/cards/0001/front.md". A @ref srsWATCH_RESCAN event passes the decks directory itself.
+ * @param[in] func The callback. It must not change the model root.
+ * @param[in] userdata Passed through to func.
+ * @return Whether it was registered. Fails when @ref srsMODEL_LISTENER_MAX listeners are already registered.
+ */
+kiokuAPI bool srsModel_AddListener(srsWATCH_FUNC func, void *userdata);
+
+/**
+ * Behaves like @ref srsModel_AddListener, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_AddListenerAt(srsMODEL *model, srsWATCH_FUNC func, void *userdata);
+
+/**
+ * Unregister a callback registered via @ref srsModel_AddListener. It may still be running on the watcher thread when this returns.
+ * @param[in] func The callback.
+ * @param[in] userdata The userdata it was registered with.
+ */
+kiokuAPI void srsModel_RemoveListener(srsWATCH_FUNC func, void *userdata);
+
+/**
+ * Behaves like @ref srsModel_RemoveListener, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI void srsModel_RemoveListenerAt(srsMODEL *model, srsWATCH_FUNC func, void *userdata);
+
+/**
+ * Canonicalize the model root again and forget the paths @ref srsModel_ExistsInRoot found inside it, such as after the root or a directory above it was moved or relinked.
+ */
+kiokuAPI void srsModel_RefreshPaths();
+
+/**
+ * Behaves like @ref srsModel_RefreshPaths, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI void srsModel_RefreshPathsAt(srsMODEL *model);
+
+/**
+ * Keep the decks of the model root in memory, so requests about them are answered without reading cards from disk.
+ * Every deck is loaded up front, by this and by each @ref srsModel_SetRoot after it, and decks created later are loaded when first asked for.
+ * Cards rescheduled through @ref srsModel_Card_SetDue are updated in memory as they are written. Changes made outside of the model API are only seen while @ref srsModel_IsWatched is true: rescheduled cards are updated in place, and a deck whose cards come or go is loaded again when it is next asked for.
+ * @param[in] resident Whether to keep decks in memory. Turning it off frees them.
+ */
+kiokuAPI void srsModel_SetResident(bool resident);
+
+/**
+ * Behaves like @ref srsModel_SetResident, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI void srsModel_SetResidentAt(srsMODEL *model, bool resident);
+
+/**
+ * Whether decks are kept in memory, as set by @ref srsModel_SetResident.
+ * @return True if decks are kept in memory.
+ */
+kiokuAPI bool srsModel_IsResident();
+
+/**
+ * Behaves like @ref srsModel_IsResident, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_IsResidentAt(srsMODEL *model);
+
+/**
+ * Call a function for each card of a deck kept in memory, in the order of the deck's snapshot. The deck stays locked during the calls, so they should not call into the model.
+ * @param[in] deck_path Path to the deck, relative to the model root.
+ * @param[in] func Called for each card until it returns false.
+ * @param[in] userdata Passed through to func.
+ * @return False if the model is not resident, the deck could not be loaded, or func returned false. Cards may have been passed to func even so.
+ */
+kiokuAPI bool srsModel_Deck_ForEachCard(const char *deck_path, srsMODEL_CARD_FUNC func, void *userdata);
+
+/**
+ * Behaves like @ref srsModel_Deck_ForEachCard, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_Deck_ForEachCardAt(srsMODEL *model, const char *deck_path, srsMODEL_CARD_FUNC func, void *userdata);
+
 /**
  * Check to see if the path is to a valid model root directory.
  * This is only true if it's a workdir of a git repository and contains known metadata files that are characteristic of the model.
@@ -46,11 +267,20 @@ kiokuAPI bool srsModel_IsValidRoot(const char *path);
  * See if a valid filesystem entity is inside the model root. Values that resolve to the model root do not count as "in" it. Used primarily for input validation.
  * Once the model root is set, the model API ignores current working directory, doing everything from the model root.
  * That includes relative path input to this function.
+ * The root is canonicalized once when it is set, so this only canonicalizes the path and compares prefixes. Repositories nested in the root count as inside it.
+ * Symlinks are followed before any ".." after them, so a link out of the root cannot be walked back into it.
+ * While @ref srsModel_IsWatched is true, paths found inside the decks are remembered until the watcher sees entries come or go, so checking them again does not touch the disk.
  * @param[in] path An absolute or relative path. Relative paths are counted as relative to the root, NOT the current working directory.
  * @return True if it's within the root path, false if it's not. If root path is not set, it will return false with error data set.
  */
 kiokuAPI bool srsModel_ExistsInRoot(const char *path);
 
+/**
+ * Behaves like @ref srsModel_ExistsInRoot, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_ExistsInRootAt(srsMODEL *model, const char *path);
+
 /**
  * Attempt to create an empty model root.
  * @param[in] path An absolute or relative path. This is relative to the CWD.
@@ -67,6 +297,8 @@ kiokuAPI srsRESULT srsModel_CreateAndSetRoot(const char *path);
 
 /**
  * Get the next card ID for a deck.
+ * The deck's .schedule file lists cards in order and its .at file holds the current position in it. Decks without an .at file give the card due soonest instead.
+ * The soonest card comes from a queue of the deck's cards ordered by due time. While the model is watched the queue is kept in memory, so this takes constant time at any deck size, and cards rescheduled on disk are moved within it rather than rebuilding it.
  * @param[in] deck_path Path to the deck to get the next card ID of.
  * @param[out] card_id_out Place to store the ID string. Must be large enough to include a null-terminator.
  * @param[in] card_id_out_size Size of the buffer, including the null terminator.
@@ -74,6 +306,45 @@ kiokuAPI srsRESULT srsModel_CreateAndSetRoot(const char *path);
  */
 kiokuAPI bool srsModel_Card_GetNextID(const char *deck_path, char *card_id_out, size_t card_id_out_size);
 
+/**
+ * Behaves like @ref srsModel_Card_GetNextID, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_Card_GetNextIDAt(srsMODEL *model, const char *deck_path, char *card_id_out, size_t card_id_out_size);
+
+/**
+ * Reschedule a card, such as after it has been graded.
+ * The card's scheduled time is written to disk and the card is moved within the deck's due queue, if it is in memory.
+ * @param[in] deck_path Path to the deck, relative to the model root.
+ * @param[in] card_id The ID of the card.
+ * @param[in] due When the card is next due.
+ * @return Whether the card exists and its schedule could be written.
+ */
+kiokuAPI bool srsModel_Card_SetDue(const char *deck_path, const char *card_id, srsTIME due);
+
+/**
+ * Behaves like @ref srsModel_Card_SetDue, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_Card_SetDueAt(srsMODEL *model, const char *deck_path, const char *card_id, srsTIME due);
+
+/**
+ * Forecast how many reviews fall due on each of the coming days, across every deck of the model.
+ * Decks are read from their snapshots, so only decks that changed since their snapshot was written touch card files.
+ * The cards are split into chunks of @ref srsMODEL_FORECAST_CHUNK that threads count into their own counters, which are added up at the end.
+ * @param[in] from The first day starts at midnight of this time. Cards that are already due count towards it.
+ * @param[in] days Number of days to forecast.
+ * @param[out] counts_out Receives the number of cards due on each of the days.
+ * @return Whether every deck could be read. counts_out is still filled in from the decks that could be.
+ */
+kiokuAPI bool srsModel_GetForecast(srsTIME from, uint32_t days, uint32_t *counts_out);
+
+/**
+ * Behaves like @ref srsModel_GetForecast, for a model context.
+ * @param[in] model The context.
+ */
+kiokuAPI bool srsModel_GetForecastAt(srsMODEL *model, srsTIME from, uint32_t days, uint32_t *counts_out);
+
 /**
  * Outputs the card path to the specified card ID within the specified deck. Returns false if it fails to find it for whatever reason.
  * @param[in] deck_path Path to the deck to look in.
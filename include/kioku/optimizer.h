@@ -0,0 +1,112 @@
+/**
+ * @addtogroup Optimizer
+ *
+ * Optimizer module
+ * Fits the weights of the FSRS scheduler to a user's review history.
+ * Reviews are collected in a @ref srsREVIEW_LOG, either one at a time or from the git history of the model, where every commit that rescheduled a card counts as a review of it.
+ * Fitting replays each card's reviews with candidate weights and scores how well the predicted probability of recall matched whether the card was recalled.
+ * Cards are split into shards that are replayed on separate threads, a step at a time across all of a shard's cards through @ref srsScheduler_GradeMany.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_OPTIMIZER_H
+#define _KIOKU_OPTIMIZER_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+#include "kioku/schedule.h"
+#include "kioku/scheduler.h"
+
+/**
+ * Number of cards replayed together as one shard.
+ */
+#ifndef srsOPTIMIZER_SHARD_CARDS
+#define srsOPTIMIZER_SHARD_CARDS 256
+#endif
+
+/**
+ * Maximum number of threads reviews are replayed on.
+ */
+#ifndef srsOPTIMIZER_THREADS_MAX
+#define srsOPTIMIZER_THREADS_MAX 16
+#endif
+
+typedef struct _srsREVIEW_LOG_s srsREVIEW_LOG;
+
+typedef struct _srsOPTIMIZER_OPTS_s
+{
+  uint32_t epochs;        /**< Passes over the whole history */
+  uint32_t batch_size;    /**< Reviews scored per step of gradient descent, rounded up to whole shards */
+  float learning_rate;    /**< Step size of the Adam optimizer */
+  uint32_t thread_count;  /**< Threads to replay reviews on, or 0 for one per hardware thread */
+} srsOPTIMIZER_OPTS;
+
+#define srsOPTIMIZER_OPTS_INIT (srsOPTIMIZER_OPTS){2, 8192, 0.04f, 0}
+
+/**
+ * Creates an empty review log.
+ * @return The log, or NULL if it could not be allocated. Must be released with @ref srsReviewLog_Free.
+ */
+kiokuAPI srsREVIEW_LOG *srsReviewLog_Create();
+
+/**
+ * Releases a review log.
+ * @param[in] log The log. NULL is ignored.
+ */
+kiokuAPI void srsReviewLog_Free(srsREVIEW_LOG *log);
+
+/**
+ * Adds a review. A card's reviews may be added in any order, and its earliest one is taken as when it was first learned.
+ * @param[in] log The log.
+ * @param[in] card Any number that identifies the card.
+ * @param[in] time When it was reviewed.
+ * @param[in] grade The grade it was given.
+ * @return False on bad input or if the log could not grow.
+ */
+kiokuAPI bool srsReviewLog_Add(srsREVIEW_LOG *log, uint32_t card, srsTIME_PACKED time, srsGRADE grade);
+
+/**
+ * Get the number of reviews in a log.
+ * @param[in] log The log.
+ * @return The number of reviews, or 0 if log is NULL.
+ */
+kiokuAPI size_t srsReviewLog_GetCount(const srsREVIEW_LOG *log);
+
+/**
+ * Adds the reviews found in the git history of the model root.
+ * Each commit that changed a card's scheduled.txt is a review at the time of the commit. The history does not record grades, so they are inferred from how the card's interval changed: shrinking to a day or less is Again, and growing by larger factors is Hard, Good or Easy.
+ * @param[in] log The log.
+ * @return Whether the whole history could be read.
+ */
+kiokuAPI bool srsReviewLog_LoadHistory(srsREVIEW_LOG *log);
+
+/**
+ * Behaves like @ref srsReviewLog_LoadHistory, for the root of a model context.
+ * @param[in] model The context.
+ * @param[in] log The log.
+ */
+kiokuAPI bool srsReviewLog_LoadHistoryAt(srsMODEL *model, srsREVIEW_LOG *log);
+
+/**
+ * Scores how well a scheduler predicts the reviews of a log.
+ * @param[in] scheduler The settings, which must be for FSRS.
+ * @param[in] log The reviews.
+ * @param[out] loss_out Receives the mean log loss of the predicted probability of recall over every review but each card's first. Lower is better.
+ * @return False on bad input, or if no review could be scored.
+ */
+kiokuAPI bool srsOptimizer_GetLoss(const srsSCHEDULER *scheduler, const srsREVIEW_LOG *log, double *loss_out);
+
+/**
+ * Fits the FSRS weights of a scheduler to the reviews of a log by gradient descent, starting from its current weights.
+ * Each step scores a batch of shards with the current weights and with each weight nudged in turn, and moves the weights along the resulting gradient. Weights are kept within the ranges the FSRS model allows.
+ * @param[in,out] scheduler The settings, which must be for FSRS. Only the weights are changed.
+ * @param[in] log The reviews.
+ * @param[in] opts How to fit. See @ref srsOPTIMIZER_OPTS_INIT.
+ * @return False on bad input, or if no review could be scored, in which case scheduler is unchanged.
+ */
+kiokuAPI bool srsOptimizer_Fit(srsSCHEDULER *scheduler, const srsREVIEW_LOG *log, srsOPTIMIZER_OPTS opts);
+
+#endif /* _KIOKU_OPTIMIZER_H */
+
+/** @} */
@@ -47,6 +47,32 @@ typedef struct _srsTIME_s
   uint8_t minute;
 } srsTIME;
 
+/**
+ * Year in which packed times begin. Packing counts minutes from the start of it.
+ */
+#define srsTIME_PACKED_EPOCH_YEAR 1900
+
+/**
+ * Latest year a packed time can hold. It is the last year that fits the four digit year of @ref srsTIME_DATE_FORMAT.
+ */
+#define srsTIME_PACKED_MAX_YEAR 9999
+
+/**
+ * Packed equivalent of @ref srsTIME_NONE. It is earlier than any other packed time.
+ */
+#define srsTIME_PACKED_NONE 0
+
+/**
+ * Packed equivalent of @ref srsTIME_NEVER. It is later than any other packed time.
+ */
+#define srsTIME_PACKED_NEVER UINT32_MAX
+
+/**
+ * A schedule time packed into a single integer: one more than the number of minutes since the start of @ref srsTIME_PACKED_EPOCH_YEAR.
+ * Packed times order the same way as the times they hold, so sorting and filtering them is plain integer comparison.
+ */
+typedef uint32_t srsTIME_PACKED;
+
 typedef struct _srsSCHED_REP_s
 {
   const char *algorithm;
@@ -73,8 +99,8 @@ kiokuAPI bool srsTime_ToString(const srsTIME time, srsTIME_STRING string);
 kiokuAPI bool srsTime_FromString(const srsTIME_STRING string, srsTIME *time);
 
 /**
- * Get the current time.
- * TODO Add timezone handling, daylight savings handling, and leapyear/leapsecond handling
+ * Get the current local time. Unpacks @ref srsClock_Now, so it is as cheap and thread-safe.
+ * TODO Add leapyear/leapsecond handling
  * @return srsTIME representing the moment this function is invoked.
  */
 kiokuAPI srsTIME srsTime_Now();
@@ -87,6 +113,189 @@ kiokuAPI srsTIME srsTime_Now();
  */
 kiokuAPI int srsTime_Compare(const srsTIME left, const srsTIME right);
 
+/**
+ * Packs an @ref srsTIME struct into an @ref srsTIME_PACKED.
+ * @param[in] time The time struct.
+ * @return The packed time. A zeroed time packs to @ref srsTIME_PACKED_NONE, and times after @ref srsTIME_PACKED_MAX_YEAR (including @ref srsTIME_NEVER) pack to @ref srsTIME_PACKED_NEVER. Any other time that is not a valid date from @ref srsTIME_PACKED_EPOCH_YEAR on also packs to @ref srsTIME_PACKED_NONE.
+ */
+kiokuAPI srsTIME_PACKED srsTime_Pack(const srsTIME time);
+
+/**
+ * Unpacks an @ref srsTIME_PACKED into an @ref srsTIME struct.
+ * @param[in] packed The packed time.
+ * @return The time struct. @ref srsTIME_PACKED_NONE unpacks to a zeroed time and @ref srsTIME_PACKED_NEVER unpacks to @ref srsTIME_NEVER.
+ */
+kiokuAPI srsTIME srsTime_Unpack(srsTIME_PACKED packed);
+
+/**
+ * Parses many time strings into packed times.
+ * Strings in the exact layout written by @ref srsTime_ToString are decoded with fixed offsets and no library calls. Anything else falls back to the same rules as @ref srsTime_FromString.
+ * @param[in] strings The time strings. NULL entries count as unparsable.
+ * @param[in] count Number of strings.
+ * @param[out] times_out Receives count packed times. Strings that could not be parsed get @ref srsTIME_PACKED_NONE.
+ * @return The number of strings that were parsed.
+ */
+kiokuAPI size_t srsTime_ParseMany(const char *const *strings, size_t count, srsTIME_PACKED *times_out);
+
+/**
+ * Formats many packed times as time strings.
+ * @param[in] times The packed times.
+ * @param[in] count Number of times.
+ * @param[out] strings_out Receives count time strings. Times that cannot be written, such as @ref srsTIME_PACKED_NONE and @ref srsTIME_PACKED_NEVER, get an empty string.
+ * @return The number of times that were formatted.
+ */
+kiokuAPI size_t srsTime_FormatMany(const srsTIME_PACKED *times, size_t count, srsTIME_STRING *strings_out);
+
+/**
+ * A priority queue of cards ordered by when they are due, soonest first. Cards due at the same time come out in order of their index.
+ * Cards are identified by an index, such as their position in a deck's snapshot, so the queue never has to touch card IDs.
+ * Peeking is constant time, and popping, rescheduling, or removing a card is logarithmic in the number of cards queued.
+ * It is not thread safe.
+ */
+typedef struct _srsSCHEDULE_QUEUE_s srsSCHEDULE_QUEUE;
+
+/**
+ * Builds a queue in linear time from a column of due times.
+ * @param[in] due Due times of count cards. Card i is due at due[i]. May be NULL if count is 0.
+ * @param[in] count Number of cards. Every card index used with the queue must be less than this.
+ * @return The queue with every card in it, or NULL on bad input or allocation failure. Must be released with @ref srsScheduleQueue_Free.
+ */
+kiokuAPI srsSCHEDULE_QUEUE *srsScheduleQueue_Create(const srsTIME_PACKED *due, size_t count);
+
+/**
+ * Releases a queue.
+ * @param[in] queue The queue. NULL is ignored.
+ */
+kiokuAPI void srsScheduleQueue_Free(srsSCHEDULE_QUEUE *queue);
+
+/**
+ * Get the number of cards in a queue.
+ * @param[in] queue The queue.
+ * @return The number of cards queued, or 0 if queue is NULL.
+ */
+kiokuAPI size_t srsScheduleQueue_GetCount(const srsSCHEDULE_QUEUE *queue);
+
+/**
+ * Get the card that is due next without removing it.
+ * @param[in] queue The queue.
+ * @param[out] card_out Receives the index of the card. May be NULL.
+ * @param[out] due_out Receives when it is due. May be NULL.
+ * @return Whether there was a card in the queue.
+ */
+kiokuAPI bool srsScheduleQueue_Peek(const srsSCHEDULE_QUEUE *queue, uint32_t *card_out, srsTIME_PACKED *due_out);
+
+/**
+ * Removes the cards that are due next.
+ * @param[in] queue The queue.
+ * @param[in] count The most cards to remove.
+ * @param[out] cards_out Receives the indices of the removed cards, soonest first. Must have room for count cards.
+ * @return The number of cards removed, which is less than count once the queue runs out.
+ */
+kiokuAPI size_t srsScheduleQueue_Pop(srsSCHEDULE_QUEUE *queue, size_t count, uint32_t *cards_out);
+
+/**
+ * Changes when a card is due, such as after it has been graded. A card that was popped or removed is queued again.
+ * @param[in] queue The queue.
+ * @param[in] card Index of the card.
+ * @param[in] due When it is now due.
+ * @return False if card is out of range.
+ */
+kiokuAPI bool srsScheduleQueue_Update(srsSCHEDULE_QUEUE *queue, uint32_t card, srsTIME_PACKED due);
+
+/**
+ * Takes a card out of the queue.
+ * @param[in] queue The queue.
+ * @param[in] card Index of the card.
+ * @return Whether the card was queued.
+ */
+kiokuAPI bool srsScheduleQueue_Remove(srsSCHEDULE_QUEUE *queue, uint32_t card);
+
+/**
+ * A timer that can be scheduled on an @ref srsTIMER_WHEEL. Timers are owned by the caller, who can embed them in larger structures or allocate them in bulk, so the wheel itself never allocates per timer.
+ * Zero it before first use. The fields other than data are managed by the wheel.
+ */
+typedef struct _srsTIMER_s
+{
+  struct _srsTIMER_s *next;
+  struct _srsTIMER_s *prev;
+  srsTIME_PACKED due;
+  uint16_t slot;
+  bool active;
+  void *data; /**< Free for the caller to use */
+} srsTIMER;
+
+/**
+ * Called when a timer expires. The timer has already been taken off the wheel, so it may be added again or released.
+ * @param[in] timer The timer.
+ * @param[in] userdata The userdata the wheel was created with.
+ */
+typedef void (*srsTIMER_FUNC)(srsTIMER *timer, void *userdata);
+
+/**
+ * A hierarchical timing wheel of @ref srsTIMER keyed by packed time, to the minute.
+ * The lowest level has a slot for each of the next 64 minutes, and each level above covers 64 times the span of the one below, up to the full range of @ref srsTIME_PACKED.
+ * Adding and removing timers is constant time. Advancing skips straight to the next occupied slot, so time passing without anything expiring costs next to nothing however far it moves.
+ * It is not thread safe.
+ */
+typedef struct _srsTIMER_WHEEL_s srsTIMER_WHEEL;
+
+/**
+ * Creates a timing wheel.
+ * @param[in] now The current time. Timers due at or before it expire on the next advance.
+ * @param[in] func Called for each timer that expires.
+ * @param[in] userdata Passed through to func.
+ * @return The wheel, or NULL if func is NULL or allocation failed. Must be released with @ref srsTimerWheel_Free.
+ */
+kiokuAPI srsTIMER_WHEEL *srsTimerWheel_Create(srsTIME_PACKED now, srsTIMER_FUNC func, void *userdata);
+
+/**
+ * Releases a timing wheel. Timers still on it are left as they are and must not be used with it again.
+ * @param[in] wheel The wheel. NULL is ignored.
+ */
+kiokuAPI void srsTimerWheel_Free(srsTIMER_WHEEL *wheel);
+
+/**
+ * Schedules a timer, moving it if it is already scheduled.
+ * @param[in] wheel The wheel.
+ * @param[in] timer The timer.
+ * @param[in] due When it expires. Times that have already passed expire on the next advance.
+ * @return False on bad input, or if due is @ref srsTIME_PACKED_NEVER.
+ */
+kiokuAPI bool srsTimerWheel_Add(srsTIMER_WHEEL *wheel, srsTIMER *timer, srsTIME_PACKED due);
+
+/**
+ * Unschedules a timer.
+ * @param[in] wheel The wheel.
+ * @param[in] timer The timer.
+ * @return Whether the timer was scheduled.
+ */
+kiokuAPI bool srsTimerWheel_Remove(srsTIMER_WHEEL *wheel, srsTIMER *timer);
+
+/**
+ * Moves the wheel forward, expiring every timer due at or before now in order of the minute it is due.
+ * Timers added by the callback for a minute that has already been passed expire on the next advance.
+ * @param[in] wheel The wheel.
+ * @param[in] now The current time. Moving backwards does nothing.
+ * @return The number of timers that expired.
+ */
+kiokuAPI size_t srsTimerWheel_Advance(srsTIMER_WHEEL *wheel, srsTIME_PACKED now);
+
+/**
+ * Get a time no later than when the next timer expires, to know how long nothing needs to be done.
+ * It is the start of the earliest occupied slot, so it is exact for timers due within the hour and may be earlier for later ones.
+ * @param[in] wheel The wheel.
+ * @param[out] due_out Receives the time.
+ * @return Whether any timers are scheduled.
+ */
+kiokuAPI bool srsTimerWheel_GetNextExpiry(const srsTIMER_WHEEL *wheel, srsTIME_PACKED *due_out);
+
+/**
+ * Get the number of timers scheduled on a wheel.
+ * @param[in] wheel The wheel.
+ * @return The number of timers, or 0 if wheel is NULL.
+ */
+kiokuAPI size_t srsTimerWheel_GetCount(const srsTIMER_WHEEL *wheel);
+
 #endif /* _KIOKU_SCHEDULE_H */
 
 /** @} */
@@ -0,0 +1,166 @@
+/**
+ * @addtogroup Scheduler
+ *
+ * Scheduler module
+ * Implements the spaced repetition algorithms that decide when a card is next due after it has been graded.
+ * Two are available: SM-2, as popularized by SuperMemo and Anki, and FSRS, which models how likely a card is to be recalled and schedules it for when that falls to the desired retention.
+ * Single cards are graded with @ref srsScheduler_Grade. Whole collections are graded with @ref srsScheduler_GradeMany, which takes the state of many cards as separate arrays so the per-card math runs as straight vector loops.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_SCHEDULER_H
+#define _KIOKU_SCHEDULER_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+#include "kioku/schedule.h"
+
+/**
+ * Grades a card can be given, matching the grades of the buttons served by the REST API.
+ */
+typedef enum _srsGRADE_e
+{
+  srsGRADE_AGAIN = 1,
+  srsGRADE_HARD = 2,
+  srsGRADE_GOOD = 3,
+  srsGRADE_EASY = 4
+} srsGRADE;
+
+typedef enum _srsSCHEDULER_ALGORITHM_e
+{
+  srsSCHEDULER_SM2,
+  srsSCHEDULER_FSRS
+} srsSCHEDULER_ALGORITHM;
+
+/**
+ * Number of weights of the FSRS model.
+ */
+#define srsSCHEDULER_FSRS_WEIGHTS 19
+
+/**
+ * Name of the file in the model root that holds the scheduler's settings, as written by the optimizer.
+ */
+#ifndef srsSCHEDULER_OPTIONS_FILENAME
+#define srsSCHEDULER_OPTIONS_FILENAME "scheduler.json"
+#endif
+
+/**
+ * Settings of a scheduler. Fill it in with @ref srsScheduler_Init and adjust as needed.
+ */
+typedef struct _srsSCHEDULER_s
+{
+  srsSCHEDULER_ALGORITHM algorithm;
+  float desired_retention;                      /**< FSRS only: probability of recall cards are scheduled at, between 0 and 1 */
+  float maximum_interval;                       /**< Longest time in days a card can be scheduled ahead */
+  float weights[srsSCHEDULER_FSRS_WEIGHTS];     /**< FSRS only: the model's weights, as found by an optimizer */
+} srsSCHEDULER;
+
+/**
+ * What a scheduler knows about a card. A zeroed state is a card that has never been reviewed.
+ */
+typedef struct _srsCARD_STATE_s
+{
+  float stability;             /**< Days until recall falls to 90% for FSRS, or the current interval in days for SM-2 */
+  float difficulty;            /**< Between 1 and 10 for FSRS, or the ease factor for SM-2 */
+  srsTIME_PACKED last_review;  /**< When it was last graded */
+  srsTIME_PACKED due;          /**< When it is next due */
+  uint16_t reps;               /**< Successful reviews in a row */
+  uint16_t lapses;             /**< Times it has been forgotten */
+} srsCARD_STATE;
+
+/**
+ * The states of many cards, one array per field, as taken by @ref srsScheduler_GradeMany.
+ * The arrays must not overlap.
+ */
+typedef struct _srsCARD_STATES_s
+{
+  float *stability;
+  float *difficulty;
+  srsTIME_PACKED *last_review;
+  srsTIME_PACKED *due;
+  uint16_t *reps;
+  uint16_t *lapses;
+} srsCARD_STATES;
+
+/**
+ * Fills in the default settings of an algorithm.
+ * @param[out] scheduler The settings.
+ * @param[in] algorithm The algorithm.
+ * @return False if scheduler is NULL or the algorithm is unknown.
+ */
+kiokuAPI bool srsScheduler_Init(srsSCHEDULER *scheduler, srsSCHEDULER_ALGORITHM algorithm);
+
+/**
+ * Reads settings from an options file, such as one written by the optimizer.
+ * The file is a JSON object with an "algorithm" of "sm2" or "fsrs", and optionally "desired_retention", "maximum_interval" and "weights". Settings it leaves out keep the algorithm's defaults.
+ * @param[out] scheduler The settings. Unchanged if the file cannot be used.
+ * @param[in] path Path to the file.
+ * @return Whether the file could be read and all of its settings are valid.
+ */
+kiokuAPI bool srsScheduler_Load(srsSCHEDULER *scheduler, const char *path);
+
+/**
+ * Writes settings to an options file that @ref srsScheduler_Load reads.
+ * @param[in] scheduler The settings.
+ * @param[in] path Path to the file, which is replaced.
+ * @return Whether the file could be written.
+ */
+kiokuAPI bool srsScheduler_Save(const srsSCHEDULER *scheduler, const char *path);
+
+/**
+ * Grades a card.
+ * @param[in] scheduler The settings.
+ * @param[in] state The state of the card before it was graded.
+ * @param[in] grade The grade.
+ * @param[in] now When it was graded.
+ * @param[out] state_out Receives the state of the card after it was graded, including when it is next due. May be the same as state.
+ * @return False on bad input, in which case state_out is unchanged.
+ */
+kiokuAPI bool srsScheduler_Grade(const srsSCHEDULER *scheduler, const srsCARD_STATE *state, srsGRADE grade, srsTIME_PACKED now, srsCARD_STATE *state_out);
+
+/**
+ * Grades many cards at once. It gives the same results as grading each with @ref srsScheduler_Grade.
+ * @param[in] scheduler The settings.
+ * @param[in,out] states The states of count cards, which are updated in place.
+ * @param[in] grades The grade of each card. Cards with a grade that is out of range are left unchanged.
+ * @param[in] times When each card was graded.
+ * @param[in] count Number of cards.
+ * @return False on bad input.
+ */
+kiokuAPI bool srsScheduler_GradeMany(const srsSCHEDULER *scheduler, srsCARD_STATES *states, const uint8_t *grades, const srsTIME_PACKED *times, size_t count);
+
+/**
+ * Get how likely a card is to be recalled. SM-2 does not model this, so it assumes the FSRS curve using the interval as stability.
+ * @param[in] scheduler The settings.
+ * @param[in] state The state of the card.
+ * @param[in] now The time to get it for.
+ * @return The probability of recall between 0 and 1, or 0 for a card that has never been reviewed.
+ */
+kiokuAPI float srsScheduler_GetRetrievability(const srsSCHEDULER *scheduler, const srsCARD_STATE *state, srsTIME_PACKED now);
+
+/**
+ * Get how likely many cards are to be recalled, as @ref srsScheduler_GetRetrievability does for each.
+ * @param[in] scheduler The settings.
+ * @param[in] states The states of count cards. Only stability and last_review are read.
+ * @param[in] times The time to get it for, for each card.
+ * @param[in] count Number of cards.
+ * @param[out] retrievability_out Receives count probabilities.
+ * @return False on bad input.
+ */
+kiokuAPI bool srsScheduler_GetRetrievabilityMany(const srsSCHEDULER *scheduler, const srsCARD_STATES *states, const srsTIME_PACKED *times, size_t count, float *retrievability_out);
+
+/**
+ * Adds up how many cards fall due on each of a number of days, for forecasting the workload.
+ * Cards that are already due count towards the first day. Cards due after the last day are not counted.
+ * @param[in] due When each card is due.
+ * @param[in] count Number of cards.
+ * @param[in] start When the first day starts. Each day is the 24 hours after the previous one.
+ * @param[in] days Number of days.
+ * @param[in,out] counts Counters for each of the days. They are added to rather than reset, so that many decks can be counted into one forecast.
+ */
+kiokuAPI void srsScheduler_CountDue(const srsTIME_PACKED *due, size_t count, srsTIME_PACKED start, uint32_t days, uint32_t *counts);
+
+#endif /* _KIOKU_SCHEDULER_H */
+
+/** @} */
@@ -0,0 +1,148 @@
+/**
+ * @addtogroup Snapshot
+ *
+ * Snapshot module
+ * Keeps a packed binary copy of a deck's card table so it can be loaded without reading every card's files.
+ * The snapshot lives in @ref srsSNAPSHOT_DIRNAME inside the deck. It is derived data that is never committed, and it can be deleted at any time.
+ * Cards are stored in columns sorted by ID: an offset into a pool of ID strings, the packed added time, the packed due time, and the modification time of the card's files.
+ * Each snapshot is stamped with the git HEAD of the model and the modification time of the cards directory. A snapshot whose stamp still matches is mapped and used as is.
+ * Otherwise it is rebuilt incrementally, re-reading only cards whose files have changed since it was written.
+ * While the model is watched, changes to cards reported by the watcher mark the snapshots of this process as needing that incremental check too.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_SNAPSHOT_H
+#define _KIOKU_SNAPSHOT_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+#include "kioku/schedule.h"
+
+/**
+ * Name of the directory inside a deck that holds derived data.
+ */
+#define srsSNAPSHOT_DIRNAME ".kioku-cache"
+
+/**
+ * Name of the snapshot file inside @ref srsSNAPSHOT_DIRNAME.
+ */
+#define srsSNAPSHOT_FILENAME "deck.bin"
+
+typedef struct _srsSNAPSHOT_s srsSNAPSHOT;
+
+/**
+ * Opens the snapshot of a deck, building or refreshing it first if needed.
+ * @param[in] deck_path Path to the deck, relative to the model root.
+ * @return The snapshot, or NULL if the deck has no cards directory or could not be read. Must be released with @ref srsSnapshot_Close.
+ */
+kiokuAPI srsSNAPSHOT *srsSnapshot_Open(const char *deck_path);
+
+/**
+ * Behaves like @ref srsSnapshot_Open, for a deck of a model context.
+ * @param[in] model The context.
+ * @param[in] deck_path Path to the deck, relative to the root of the context.
+ */
+kiokuAPI srsSNAPSHOT *srsSnapshot_OpenAt(srsMODEL *model, const char *deck_path);
+
+/**
+ * Like @ref srsSnapshot_Open, but always checks every card's files for changes, even when the stamp matches.
+ * This picks up edits that neither moved HEAD nor added or removed cards, which are otherwise only noticed while the model is watched.
+ * @param[in] deck_path Path to the deck, relative to the model root.
+ * @return The snapshot, or NULL if the deck could not be read. Must be released with @ref srsSnapshot_Close.
+ */
+kiokuAPI srsSNAPSHOT *srsSnapshot_Refresh(const char *deck_path);
+
+/**
+ * Behaves like @ref srsSnapshot_Refresh, for a deck of a model context.
+ * @param[in] model The context.
+ * @param[in] deck_path Path to the deck, relative to the root of the context.
+ */
+kiokuAPI srsSNAPSHOT *srsSnapshot_RefreshAt(srsMODEL *model, const char *deck_path);
+
+/**
+ * Forget what was remembered about the decks of a model context, before it is closed.
+ * @param[in] model The context.
+ */
+kiokuAPI void srsSnapshot_Forget(const srsMODEL *model);
+
+/**
+ * Releases a snapshot.
+ * @param[in] snapshot The snapshot. NULL is ignored.
+ */
+kiokuAPI void srsSnapshot_Close(srsSNAPSHOT *snapshot);
+
+/**
+ * Get the cards directory a snapshot describes. Each card lives in the subdirectory named after its ID.
+ * @param[in] snapshot The snapshot.
+ * @return The absolute path, owned by the snapshot. NULL if snapshot is NULL.
+ */
+kiokuAPI const char *srsSnapshot_GetCardsPath(const srsSNAPSHOT *snapshot);
+
+/**
+ * Get the number of cards in a snapshot.
+ * @param[in] snapshot The snapshot.
+ * @return The number of cards, or 0 if snapshot is NULL.
+ */
+kiokuAPI size_t srsSnapshot_GetCount(const srsSNAPSHOT *snapshot);
+
+/**
+ * Get the ID of a card. Cards are sorted by ID.
+ * @param[in] snapshot The snapshot.
+ * @param[in] index Index of the card.
+ * @return The ID, owned by the snapshot. NULL if index is out of range.
+ */
+kiokuAPI const char *srsSnapshot_GetID(const srsSNAPSHOT *snapshot, size_t index);
+
+/**
+ * Get when a card was added.
+ * @param[in] snapshot The snapshot.
+ * @param[in] index Index of the card.
+ * @return The time, or a zeroed time if index is out of range.
+ */
+kiokuAPI srsTIME srsSnapshot_GetAdded(const srsSNAPSHOT *snapshot, size_t index);
+
+/**
+ * Get when a card is next due.
+ * @param[in] snapshot The snapshot.
+ * @param[in] index Index of the card.
+ * @return The time, or a zeroed time if index is out of range.
+ */
+kiokuAPI srsTIME srsSnapshot_GetDue(const srsSNAPSHOT *snapshot, size_t index);
+
+/**
+ * Get the added times of every card as one column, in the same order as the IDs.
+ * Scanning this is a tight loop over integers, which is the fastest way to sort or filter a deck by when cards were added.
+ * @param[in] snapshot The snapshot.
+ * @return @ref srsSnapshot_GetCount packed times owned by the snapshot, or NULL if it is empty.
+ */
+kiokuAPI const srsTIME_PACKED *srsSnapshot_GetAddedTimes(const srsSNAPSHOT *snapshot);
+
+/**
+ * Get the due times of every card as one column, in the same order as the IDs.
+ * @param[in] snapshot The snapshot.
+ * @return @ref srsSnapshot_GetCount packed times owned by the snapshot, or NULL if it is empty.
+ */
+kiokuAPI const srsTIME_PACKED *srsSnapshot_GetDueTimes(const srsSNAPSHOT *snapshot);
+
+/**
+ * Whether two snapshots of a deck were taken of the same state, having the same git HEAD, cards directory and number of cards.
+ * Like the stamp check of @ref srsSnapshot_Open, this does not notice edits to cards that changed neither.
+ * @param[in] a A snapshot.
+ * @param[in] b Another snapshot.
+ * @return False if either is NULL, or if either was built while its cards may still have been changing.
+ */
+kiokuAPI bool srsSnapshot_IsSameState(const srsSNAPSHOT *a, const srsSNAPSHOT *b);
+
+/**
+ * Find a card by ID. The first call builds a hash index of the IDs that later calls look up in constant time, falling back to a binary search if it could not be built. Thread-safe.
+ * @param[in] snapshot The snapshot.
+ * @param[in] card_id The ID to look for.
+ * @param[out] index_out Receives the index of the card. May be NULL.
+ * @return Whether the card is in the snapshot.
+ */
+kiokuAPI bool srsSnapshot_Find(const srsSNAPSHOT *snapshot, const char *card_id, size_t *index_out);
+
+#endif /* _KIOKU_SNAPSHOT_H */
+
+/** @} */
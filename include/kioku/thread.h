@@ -0,0 +1,189 @@
+/**
+ * @addtogroup Thread
+ *
+ * Thread module
+ * Thin portable wrappers around the native threading primitives and atomics.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_THREAD_H
+#define _KIOKU_THREAD_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+
+#ifdef kiokuOS_WINDOWS
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+typedef CRITICAL_SECTION srsMUTEX;
+typedef CONDITION_VARIABLE srsCOND;
+typedef HANDLE srsTHREAD;
+#else
+  #include <pthread.h>
+typedef pthread_mutex_t srsMUTEX;
+typedef pthread_cond_t srsCOND;
+typedef pthread_t srsTHREAD;
+#endif
+
+/**
+ * Entry point of a thread started by @ref srsThread_Create.
+ * @param[in] arg User-specified data via @ref srsThread_Create.
+ * @return Value handed back by @ref srsThread_Join.
+ */
+typedef void *(*srsTHREAD_FUNC)(void *arg);
+
+/**
+ * 32-bit integer that may only be accessed through the srsAtomic functions.
+ * All of them are sequentially consistent.
+ */
+typedef volatile int32_t srsATOMIC32;
+
+#if defined __GNUC__
+static inline int32_t srsAtomic_Load(srsATOMIC32 *atomic)
+{
+  return __atomic_load_n(atomic, __ATOMIC_SEQ_CST);
+}
+static inline void srsAtomic_Store(srsATOMIC32 *atomic, int32_t value)
+{
+  __atomic_store_n(atomic, value, __ATOMIC_SEQ_CST);
+}
+/** Adds delta and returns the resulting value */
+static inline int32_t srsAtomic_Add(srsATOMIC32 *atomic, int32_t delta)
+{
+  return __atomic_add_fetch(atomic, delta, __ATOMIC_SEQ_CST);
+}
+/** Stores desired if the current value is expected, returning whether it did */
+static inline bool srsAtomic_CompareExchange(srsATOMIC32 *atomic, int32_t expected, int32_t desired)
+{
+  return __atomic_compare_exchange_n(atomic, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#elif defined _MSC_VER
+static __inline int32_t srsAtomic_Load(srsATOMIC32 *atomic)
+{
+  return (int32_t)InterlockedCompareExchange((volatile LONG *)atomic, 0, 0);
+}
+static __inline void srsAtomic_Store(srsATOMIC32 *atomic, int32_t value)
+{
+  InterlockedExchange((volatile LONG *)atomic, (LONG)value);
+}
+static __inline int32_t srsAtomic_Add(srsATOMIC32 *atomic, int32_t delta)
+{
+  return (int32_t)InterlockedExchangeAdd((volatile LONG *)atomic, (LONG)delta) + delta;
+}
+static __inline bool srsAtomic_CompareExchange(srsATOMIC32 *atomic, int32_t expected, int32_t desired)
+{
+  return InterlockedCompareExchange((volatile LONG *)atomic, (LONG)desired, (LONG)expected) == (LONG)expected;
+}
+#else
+  #error Cannot define srsAtomic functions
+#endif
+
+/**
+ * Lock that can be statically initialized with @ref srsSPINLOCK_INIT and needs no teardown.
+ * Waiters yield rather than sleep, so only use it to guard short critical sections.
+ */
+typedef srsATOMIC32 srsSPINLOCK;
+#define srsSPINLOCK_INIT 0
+
+/**
+ * Yields the remainder of the calling thread's time slice.
+ */
+kiokuAPI void srsThread_Yield();
+
+static inline void srsSpinLock_Lock(srsSPINLOCK *lock)
+{
+  while (!srsAtomic_CompareExchange(lock, 0, 1))
+  {
+    srsThread_Yield();
+  }
+}
+static inline void srsSpinLock_Unlock(srsSPINLOCK *lock)
+{
+  srsAtomic_Store(lock, 0);
+}
+
+/**
+ * Initializes a mutex.
+ * @param[in] mutex The mutex to initialize.
+ * @return Whether the mutex could be initialized.
+ */
+kiokuAPI bool srsMutex_Init(srsMUTEX *mutex);
+
+/**
+ * Destroys a mutex previously initialized via @ref srsMutex_Init. It must not be locked.
+ * @param[in] mutex The mutex to destroy.
+ */
+kiokuAPI void srsMutex_Destroy(srsMUTEX *mutex);
+
+/**
+ * Blocks until the mutex is acquired by the calling thread.
+ * @param[in] mutex The mutex to lock.
+ */
+kiokuAPI void srsMutex_Lock(srsMUTEX *mutex);
+
+/**
+ * Releases a mutex held by the calling thread.
+ * @param[in] mutex The mutex to unlock.
+ */
+kiokuAPI void srsMutex_Unlock(srsMUTEX *mutex);
+
+/**
+ * Initializes a condition variable.
+ * @param[in] cond The condition variable to initialize.
+ * @return Whether the condition variable could be initialized.
+ */
+kiokuAPI bool srsCond_Init(srsCOND *cond);
+
+/**
+ * Destroys a condition variable previously initialized via @ref srsCond_Init. No thread may be waiting on it.
+ * @param[in] cond The condition variable to destroy.
+ */
+kiokuAPI void srsCond_Destroy(srsCOND *cond);
+
+/**
+ * Atomically releases the mutex and waits for the condition variable to be signalled, reacquiring the mutex before returning.
+ * Spurious wakeups are possible, so the caller must re-check its predicate.
+ * @param[in] cond The condition variable to wait on.
+ * @param[in] mutex The mutex held by the caller.
+ */
+kiokuAPI void srsCond_Wait(srsCOND *cond, srsMUTEX *mutex);
+
+/**
+ * Wakes at least one thread waiting on the condition variable.
+ * @param[in] cond The condition variable to signal.
+ */
+kiokuAPI void srsCond_Signal(srsCOND *cond);
+
+/**
+ * Wakes all threads waiting on the condition variable.
+ * @param[in] cond The condition variable to broadcast.
+ */
+kiokuAPI void srsCond_Broadcast(srsCOND *cond);
+
+/**
+ * Starts a new thread.
+ * @param[out] thread Receives the handle of the new thread.
+ * @param[in] func Entry point of the new thread.
+ * @param[in] arg Passed through to func.
+ * @return Whether the thread could be started.
+ */
+kiokuAPI bool srsThread_Create(srsTHREAD *thread, srsTHREAD_FUNC func, void *arg);
+
+/**
+ * Waits for a thread started via @ref srsThread_Create to finish and releases its handle.
+ * @param[in] thread The thread to join.
+ * @param[out] result_out Receives the return value of the thread function, which is always NULL on Windows. May be NULL.
+ * @return Whether the thread could be joined.
+ */
+kiokuAPI bool srsThread_Join(srsTHREAD thread, void **result_out);
+
+/**
+ * Gets the number of hardware threads available to the process.
+ * @return The number of hardware threads, or 1 if it could not be determined.
+ */
+kiokuAPI uint32_t srsThread_GetHardwareConcurrency();
+
+#endif /* _KIOKU_THREAD_H */
+
+/** @} */
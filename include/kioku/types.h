@@ -14,6 +14,13 @@
 #include <limits.h>
 #include <stddef.h> /* size_t */
 
+/**
+ * srsMODEL
+ * A model context: a root with its own repository, watcher, caches and locks. Each of the srsModel_*At functions works with the context it is given, and the functions without one work with the default context.
+ * Separate contexts share no state, so one process can serve many roots at once, each from any thread. Changing a context's root must not overlap other calls on that context.
+ */
+typedef struct _srsMODEL_s srsMODEL;
+
 #endif /* _KIOKU_TYPES_H */
 
 /** @} */
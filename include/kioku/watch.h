@@ -0,0 +1,68 @@
+/**
+ * @addtogroup Watch
+ *
+ * Watch module
+ * Reports changes made to a directory tree as they happen, so in-memory state derived from it can be updated incrementally instead of rescanning.
+ * Currently only implemented on Linux via inotify. Elsewhere @ref srsWatch_Open fails and callers are expected to fall back to re-reading from disk.
+ * Every watcher of a process shares one inotify instance and one thread, so the number of watchers is only limited by the number of directories watched.
+ *
+ * @{
+ */
+
+#ifndef _KIOKU_WATCH_H
+#define _KIOKU_WATCH_H
+
+#include "kioku/decl.h"
+#include "kioku/types.h"
+
+/**
+ * Kinds of changes reported to a @ref srsWATCH_FUNC.
+ */
+typedef enum _srsWATCH_EVENT_e
+{
+  srsWATCH_CREATED,  /**< An entry appeared, either created or moved in. It may replace an entry of the same name. */
+  srsWATCH_MODIFIED, /**< The content of a file changed */
+  srsWATCH_DELETED,  /**< An entry disappeared, either deleted or moved out */
+  srsWATCH_RESCAN    /**< Events were lost. Anything derived from the tree must be considered stale. The path is empty. */
+} srsWATCH_EVENT;
+
+/**
+ * Called from the thread shared by every watcher for each change. Callbacks of different watchers never run at the same time, so a slow one holds up the others.
+ * It must not open or close any watcher.
+ * @param[in] event What happened.
+ * @param[in] path Path of the entry relative to the watched directory, using '/' as the separator.
+ * @param[in] is_dir Whether the entry is a directory.
+ * @param[in] userdata User-specified data via @ref srsWatch_Open.
+ */
+typedef void (*srsWATCH_FUNC)(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata);
+
+typedef struct _srsWATCH_s srsWATCH;
+
+/**
+ * Starts watching a directory and everything beneath it. Directories created later are watched as they appear.
+ * Entries found inside a newly created directory are reported as @ref srsWATCH_CREATED, since they may have been added before it was watched.
+ * Must not be called from within a watcher callback.
+ * @param[in] path Path to an existing directory.
+ * @param[in] func Callback for each change.
+ * @param[in] userdata Passed through to func.
+ * @return The watcher, or NULL if the directory could not be watched or watching is not supported on this platform. Must be released with @ref srsWatch_Close.
+ */
+kiokuAPI srsWATCH *srsWatch_Open(const char *path, srsWATCH_FUNC func, void *userdata);
+
+/**
+ * Stops a watcher started via @ref srsWatch_Open. No callbacks are running or will run once it returns.
+ * Must not be called from within a watcher callback.
+ * @param[in] watch The watcher. May be NULL.
+ */
+kiokuAPI void srsWatch_Close(srsWATCH *watch);
+
+/**
+ * Get the path a watcher was opened with.
+ * @param[in] watch The watcher.
+ * @return The path, or NULL if watch is NULL.
+ */
+kiokuAPI const char *srsWatch_GetPath(const srsWATCH *watch);
+
+#endif /* _KIOKU_WATCH_H */
+
+/** @} */
@@ -0,0 +1,128 @@
+#include "kioku.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Fits the FSRS weights to the review history of a model root and writes them to an options file the scheduler reads */
+
+static void usage(const char *name)
+{
+  srsLOG_ERROR("Usage: %s [-o options-file] [-e epochs] [-t threads] model-root", name);
+}
+
+int main(int argc, char *argv[])
+{
+  srsOPTIMIZER_OPTS opts = srsOPTIMIZER_OPTS_INIT;
+  srsSCHEDULER scheduler;
+  srsREVIEW_LOG *log = NULL;
+  const char *root = NULL;
+  const char *options_path = NULL;
+  char default_path[srsPATH_MAX];
+  double loss = 0.0;
+  int32_t number = 0;
+  int result = 1;
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+    {
+      options_path = argv[++i];
+    }
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+    {
+      if (!srsString_ToU32(argv[++i], &number) || number <= 0)
+      {
+        usage(argv[0]);
+        goto done;
+      }
+      opts.epochs = (uint32_t)number;
+    }
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+    {
+      if (!srsString_ToU32(argv[++i], &number) || number < 0)
+      {
+        usage(argv[0]);
+        goto done;
+      }
+      opts.thread_count = (uint32_t)number;
+    }
+    else if (root == NULL && argv[i][0] != '-')
+    {
+      root = argv[i];
+    }
+    else
+    {
+      usage(argv[0]);
+      goto done;
+    }
+  }
+  if (root == NULL)
+  {
+    usage(argv[0]);
+    goto done;
+  }
+
+  if (srsModel_SetRoot(root) != srsOK)
+  {
+    srsLOG_ERROR("Failed to set model root to %s", root);
+    goto done;
+  }
+  if (options_path == NULL)
+  {
+    int needed = snprintf(default_path, sizeof(default_path), "%s/%s", srsModel_GetRoot(), srsSCHEDULER_OPTIONS_FILENAME);
+    if (needed < 0 || (size_t)needed >= sizeof(default_path))
+    {
+      srsLOG_ERROR("Model root path is too long: %s", srsModel_GetRoot());
+      goto done;
+    }
+    options_path = default_path;
+  }
+
+  /* Start from the settings written last time, if there are any. Fitting only makes sense for FSRS, so that is what gets written back. */
+  srsScheduler_Init(&scheduler, srsSCHEDULER_FSRS);
+  if (srsFile_Exists(options_path) && !srsScheduler_Load(&scheduler, options_path))
+  {
+    srsLOG_ERROR("Failed to read %s, leaving it as it is", options_path);
+    goto done;
+  }
+  if (scheduler.algorithm != srsSCHEDULER_FSRS)
+  {
+    srsLOG_PRINT("Switching %s from SM-2 to FSRS", options_path);
+    scheduler.algorithm = srsSCHEDULER_FSRS;
+  }
+
+  log = srsReviewLog_Create();
+  if (log == NULL || !srsReviewLog_LoadHistory(log))
+  {
+    srsLOG_ERROR("Failed to read the review history of %s", srsModel_GetRoot());
+    goto done;
+  }
+  srsLOG_PRINT("Found %u reviews", (unsigned)srsReviewLog_GetCount(log));
+
+  if (!srsOptimizer_GetLoss(&scheduler, log, &loss))
+  {
+    srsLOG_ERROR("Not enough reviews to fit the scheduler to");
+    goto done;
+  }
+  srsLOG_PRINT("Loss before fitting: %f", loss);
+  if (!srsOptimizer_Fit(&scheduler, log, opts) || !srsOptimizer_GetLoss(&scheduler, log, &loss))
+  {
+    srsLOG_ERROR("Failed to fit the scheduler");
+    goto done;
+  }
+  srsLOG_PRINT("Loss after fitting: %f", loss);
+
+  if (!srsScheduler_Save(&scheduler, options_path))
+  {
+    srsLOG_ERROR("Failed to write %s", options_path);
+    goto done;
+  }
+  srsLOG_PRINT("Wrote %s", options_path);
+  result = 0;
+
+done:
+  srsReviewLog_Free(log);
+  srsModel_SetRoot(NULL);
+  srsLog_Exit();
+  return result;
+}
@@ -1,6 +1,8 @@
 #include "kioku.h"
 #include "mongoose.h"
 #include "parson.h"
+#include <stdarg.h>
+#include <stddef.h>
 /* #include "json.h" */
 
 static const char *s_http_port = "8000";
@@ -9,19 +11,231 @@ static bool kill_me_now = false;
 #define HTTP_BAD_REQUEST "400 Bad Request"
 #define HTTP_INTERNAL_ERROR "500 Internal Server Error"
 #define HTTP_OK "200 OK"
+#define HTTP_SERVICE_UNAVAILABLE "503 Service Unavailable"
 
-#define rest_respond(connection, codestring, format, ...)               \
+/* A request copied out of the connection's buffer, which is reused as soon as the event returns, and the response built for it */
+typedef struct _REQUEST_s
+{
+  void (*handler)(struct _REQUEST_s *request);
+  struct _REQUEST_s *next;     /* The next request of the same connection */
+  bool answered;               /* Set by the event loop once the response is built */
+  struct mg_str query_string;
+  struct mg_str body;
+  const char *status;
+  char *response;
+  char data[1];                /* The query string and body */
+} REQUEST;
+
+/* Parson allocates a node per JSON value. Everything a request builds is released in one go once it has been answered. Each thread answering requests has its own arena. */
+static srsTHREADLOCAL srsARENA *request_arena = NULL;
+
+static void *request_malloc(size_t size)
+{
+  return (request_arena != NULL) ? srsArena_Alloc(request_arena, size) : malloc(size);
+}
+static void request_free(void *memory)
+{
+  /* Memory allocated outside of a request still came from the heap */
+  if ((request_arena == NULL) || !srsArena_Owns(request_arena, memory))
+  {
+    free(memory);
+  }
+}
+
+static REQUEST *request_create(struct http_message *hm, void (*handler)(REQUEST *request))
+{
+  REQUEST *request = malloc(offsetof(REQUEST, data) + hm->query_string.len + hm->body.len + 2);
+  if (request == NULL)
+  {
+    return NULL;
+  }
+  request->handler = handler;
+  request->next = NULL;
+  request->answered = false;
+  request->status = NULL;
+  request->response = NULL;
+  memcpy(request->data, hm->query_string.p, hm->query_string.len);
+  request->data[hm->query_string.len] = '\0';
+  request->query_string.p = request->data;
+  request->query_string.len = hm->query_string.len;
+  char *body = request->data + hm->query_string.len + 1;
+  memcpy(body, hm->body.p, hm->body.len);
+  body[hm->body.len] = '\0';
+  request->body.p = body;
+  request->body.len = hm->body.len;
+  return request;
+}
+
+static void request_destroy(REQUEST *request)
+{
+  if (request != NULL)
+  {
+    free(request->response);
+    free(request);
+  }
+}
+
+/* Answers a request. Only builds the response, so it may be called from any thread. */
+static void request_respond(REQUEST *request, const char *status, const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int needed = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  free(request->response);
+  request->response = (needed < 0) ? NULL : malloc((size_t)needed + 1);
+  if (request->response == NULL)
+  {
+    request->status = HTTP_INTERNAL_ERROR;
+    return;
+  }
+  va_start(args, format);
+  vsnprintf(request->response, (size_t)needed + 1, format, args);
+  va_end(args);
+  request->status = status;
+}
+
+#define rest_respond(request, codestring, format, ...)                  \
   do {                                                                  \
     srsLOG_ERROR(format "\r\n", __VA_ARGS__);                        \
-    mg_printf(connection, "HTTP/1.1 %s\r\nTransfer-Encoding: chunked\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\n\r\n", codestring); \
-    mg_printf_http_chunk(connection, format, __VA_ARGS__);              \
-    mg_send_http_chunk(connection, "", 0); /* Send empty chunk, the end of response */ \
+    request_respond(request, codestring, format, __VA_ARGS__);          \
   } while(0)
 
-static bool parse_request(struct http_message *hm, JSON_Value **root_value, JSON_Object **root_object, const char **error_msg)
+/* Runs a request's handler with the arena of the calling thread */
+static void request_run(REQUEST *request, srsARENA *arena)
+{
+  srsARENA_MARK start = srsArena_GetMark(arena);
+  request_arena = arena;
+  request->handler(request);
+  request_arena = NULL;
+  srsArena_Reset(arena, start);
+}
+
+/* Only the event loop may write to a connection */
+static void request_send(struct mg_connection *nc, const REQUEST *request)
+{
+  const char *status = (request->status == NULL) ? HTTP_INTERNAL_ERROR : request->status;
+  const char *response = (request->response == NULL) ? "{\"error\":\"failed to construct response\"}" : request->response;
+  mg_printf(nc, "HTTP/1.1 %s\r\nTransfer-Encoding: chunked\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: application/json\r\n\r\n", status);
+  mg_send_http_chunk(nc, response, strlen(response));
+  mg_send_http_chunk(nc, "", 0); /* Send empty chunk, the end of response */
+}
+
+/* Requests of one connection that are not sent yet, oldest first. Pipelined requests must be answered in the order they came in, so an answer is held until the ones before it are sent.
+ * Kept as the user_data of the connection, and only ever used by the event loop. */
+typedef struct _CONNECTION_s
+{
+  REQUEST *first;
+  REQUEST *last;
+} CONNECTION;
+
+static bool connection_push(struct mg_connection *nc, REQUEST *request)
+{
+  CONNECTION *connection = nc->user_data;
+  if (connection == NULL)
+  {
+    connection = calloc(1, sizeof(*connection));
+    if (connection == NULL)
+    {
+      return false;
+    }
+    nc->user_data = connection;
+  }
+  request->next = NULL;
+  if (connection->last == NULL)
+  {
+    connection->first = request;
+  }
+  else
+  {
+    connection->last->next = request;
+  }
+  connection->last = request;
+  return true;
+}
+
+/* Sends every answer that no longer waits on an earlier request */
+static void connection_flush(struct mg_connection *nc)
+{
+  CONNECTION *connection = nc->user_data;
+  if (connection == NULL)
+  {
+    return;
+  }
+  while ((connection->first != NULL) && connection->first->answered)
+  {
+    REQUEST *request = connection->first;
+    connection->first = request->next;
+    request_send(nc, request);
+    request_destroy(request);
+  }
+  if (connection->first == NULL)
+  {
+    free(connection);
+    nc->user_data = NULL;
+  }
+}
+
+/* Sends the answer to a request the event loop ran itself, after any the connection is still waiting on */
+static void connection_send(struct mg_connection *nc, REQUEST *request)
+{
+  request->answered = true;
+  if (nc->user_data == NULL)
+  {
+    request_send(nc, request);
+    request_destroy(request);
+    return;
+  }
+  connection_push(nc, request);
+  connection_flush(nc);
+}
+
+/* Finds the connection waiting on a request. Connections that closed meanwhile are not found. */
+static struct mg_connection *connection_find(struct mg_mgr *mgr, const REQUEST *request)
+{
+  struct mg_connection *c = NULL;
+  for (c = mg_next(mgr, NULL); c != NULL; c = mg_next(mgr, c))
+  {
+    const CONNECTION *connection = c->user_data;
+    const REQUEST *waiting = (connection == NULL) ? NULL : connection->first;
+    while ((waiting != NULL) && (waiting != request))
+    {
+      waiting = waiting->next;
+    }
+    if (waiting != NULL)
+    {
+      return c;
+    }
+  }
+  return NULL;
+}
+
+/* Drops the answers a closed connection was still holding. Requests a worker has are left to it, and dropped when they come back. */
+static void connection_close(struct mg_connection *nc)
+{
+  CONNECTION *connection = nc->user_data;
+  if (connection == NULL)
+  {
+    return;
+  }
+  REQUEST *request = connection->first;
+  while (request != NULL)
+  {
+    REQUEST *next = request->next;
+    if (request->answered)
+    {
+      request_destroy(request);
+    }
+    request = next;
+  }
+  free(connection);
+  nc->user_data = NULL;
+}
+
+static bool parse_request(REQUEST *request, JSON_Value **root_value, JSON_Object **root_object, const char **error_msg)
 {
   char buf[1024] = {0};
-  memcpy(buf, hm->body.p, sizeof(buf) - 1 < hm->body.len ? sizeof(buf) - 1 : hm->body.len);
+  memcpy(buf, request->body.p, sizeof(buf) - 1 < request->body.len ? sizeof(buf) - 1 : request->body.len);
   /* See if JSON value was provided as data */
   *root_value = json_parse_string(buf);
   *root_object = NULL;
@@ -53,15 +267,137 @@ static bool precheck_response(JSON_Value **root_value, JSON_Object **root_object
   return true;
 }
 
-static void handle_exit_call(struct mg_connection *nc, struct http_message *hm)
+/* With -c, every directory in the collections directory is a model root of its own, and a request picks one by naming it as its collection.
+ * Their contexts are opened the first time a request asks for them and kept until the server stops. Requests that name none use the default context, rooted at the document root. */
+#define COLLECTION_NAME_MAX 256
+
+static const char *collections_path = NULL;
+static srsMUTEX collections_lock;
+/* Collection name to srsMODEL, looked up by every request that names one */
+static srsHASHMAP collections_index;
+static srsMODEL **collections = NULL;
+static size_t collection_count = 0;
+
+static void due_add_collection(const char *name, srsMODEL *model);
+
+static bool collections_start(const char *path)
+{
+  if (!srsMutex_Init(&collections_lock))
+  {
+    return false;
+  }
+  if (!srsHashMap_Init(&collections_index, 0))
+  {
+    srsMutex_Destroy(&collections_lock);
+    return false;
+  }
+  collections_path = path;
+  srsLOG_PRINT("Serving the collections in %s", collections_path);
+  return true;
+}
+
+/* Opens a collection's context outside of the lock, since that reads its whole root. If another worker opened it meanwhile, theirs is kept. */
+static srsMODEL *collections_open(const char *name)
+{
+  void *found = NULL;
+  srsMutex_Lock(&collections_lock);
+  bool exists = srsHashMap_Get(&collections_index, name, &found);
+  srsMutex_Unlock(&collections_lock);
+  if (exists)
+  {
+    return (srsMODEL *)found;
+  }
+  char path[srsPATH_MAX];
+  int32_t needed = kioku_path_concat(path, sizeof(path), collections_path, name);
+  if ((needed < 0) || ((size_t)needed >= sizeof(path)) || !srsDir_Exists(path))
+  {
+    return NULL;
+  }
+  srsMODEL *model = srsModel_Open(path);
+  if (model == NULL)
+  {
+    return NULL;
+  }
+  srsMutex_Lock(&collections_lock);
+  if (srsHashMap_Get(&collections_index, name, &found))
+  {
+    srsMutex_Unlock(&collections_lock);
+    srsModel_Close(model);
+    return (srsMODEL *)found;
+  }
+  srsMODEL **grown = realloc(collections, (collection_count + 1) * sizeof(*collections));
+  if ((grown == NULL) || !srsHashMap_Set(&collections_index, name, model))
+  {
+    collections = (grown == NULL) ? collections : grown;
+    srsMutex_Unlock(&collections_lock);
+    srsModel_Close(model);
+    return NULL;
+  }
+  collections = grown;
+  collections[collection_count++] = model;
+  srsMutex_Unlock(&collections_lock);
+  srsLOG_PRINT("Opened collection %s at %s", name, srsModel_GetRootAt(model));
+  due_add_collection(name, model);
+  return model;
+}
+
+static void collections_stop()
+{
+  size_t i = 0;
+  if (collections_path == NULL)
+  {
+    return;
+  }
+  for (i = 0; i < collection_count; i++)
+  {
+    srsModel_Close(collections[i]);
+  }
+  free(collections);
+  collections = NULL;
+  collection_count = 0;
+  srsHashMap_Free(&collections_index);
+  srsMutex_Destroy(&collections_lock);
+  collections_path = NULL;
+}
+
+/* Finds the context a request is for. On failure, the status and message to answer with are set. */
+static srsMODEL *request_get_model(REQUEST *request, const char **codestring, const char **error_msg)
+{
+  char name[COLLECTION_NAME_MAX] = {0};
+  int length = mg_get_http_var(&request->query_string, "collection", name, sizeof(name));
+  if ((length == 0) || (length == -1))
+  {
+    return srsModel_GetDefault();
+  }
+  *codestring = HTTP_BAD_REQUEST;
+  if (collections_path == NULL)
+  {
+    *error_msg = "collections are not being served";
+    return NULL;
+  }
+  /* Names are single directories in the collections directory, never a way out of it */
+  if ((length < 0) || (name[0] == '.') || (strchr(name, '/') != NULL) || (strchr(name, '\\') != NULL))
+  {
+    *error_msg = "invalid collection name";
+    return NULL;
+  }
+  srsMODEL *model = collections_open(name);
+  if (model == NULL)
+  {
+    *error_msg = "collection does not exist";
+  }
+  return model;
+}
+
+static void handle_exit_call(REQUEST *request)
 {
   kill_me_now = true;
   kLOG_WRITE("%s", "Set kill flag");
-  rest_respond(nc, HTTP_OK, "%s", "{\"result\":\"OK\"}");
+  rest_respond(request, HTTP_OK, "%s", "{\"result\":\"OK\"}");
 }
 
-/* Ex: http://localhost:8000/api/v1/card/next?deck=client/testdeck */
-static void handle_GetNextCard(struct mg_connection *nc, struct http_message *hm)
+/* Ex: http://localhost:8000/api/v1/card/next?deck=client/testdeck or, with -c, ?collection=alice&deck=decks/japanese */
+static void handle_GetNextCard(REQUEST *request)
 {
   const char *error_msg = NULL;
   const char *codestring = NULL;
@@ -69,16 +405,23 @@ static void handle_GetNextCard(struct mg_connection *nc, struct http_message *hm
   JSON_Object *root_object = NULL;
   char *serialized_string = NULL;
   char deck_id[srsMODEL_DECK_ID_MAX] = {0};
-  mg_get_http_var(&hm->query_string, "deck", deck_id, sizeof(deck_id));
-  srsLOG_PRINT("User attempting to open Deck %s from %s", deck_id, srsDir_GetCWD());
-  if (!srsDir_Exists(deck_id))
+  srsMODEL *model = request_get_model(request, &codestring, &error_msg);
+  if (model == NULL)
+  {
+    rest_respond(request, codestring, "{\"error\":\"%s\"}", error_msg);
+    goto end;
+  }
+  mg_get_http_var(&request->query_string, "deck", deck_id, sizeof(deck_id));
+  srsLOG_PRINT("User attempting to open Deck %s from %s", deck_id, srsModel_GetRootAt(model));
+  /* Decks are found from the root of the collection, whatever the working directory of the server */
+  if (!srsModel_ExistsInRootAt(model, deck_id) || !srsDir_ExistsAt(srsModel_GetRootDirAt(model), deck_id))
   {
     codestring = HTTP_BAD_REQUEST;
-    rest_respond(nc, codestring, "{\"error\":\"Deck [%s] does not exist!\"}", deck_id);
+    rest_respond(request, codestring, "{\"error\":\"Deck [%s] does not exist!\"}", deck_id);
     goto end;
   }
   char card_id[srsMODEL_CARD_ID_MAX] = {0};
-  if (srsModel_Card_GetNextID(deck_id, card_id, sizeof(card_id)))
+  if (srsModel_Card_GetNextIDAt(model, deck_id, card_id, sizeof(card_id)))
   {
     root_value = json_value_init_object();
     root_object = json_value_get_object(root_value);
@@ -119,19 +462,19 @@ static void handle_GetNextCard(struct mg_connection *nc, struct http_message *hm
   if (serialized_string == NULL)
   {
     codestring = HTTP_INTERNAL_ERROR;
-    rest_respond(nc, codestring, "%s", "{\"error\":\"failed to construct response\"}");
+    rest_respond(request, codestring, "%s", "{\"error\":\"failed to construct response\"}");
   }
   else
   {
     codestring = HTTP_OK;
-    rest_respond(nc, codestring, "%s", serialized_string);
+    rest_respond(request, codestring, "%s", serialized_string);
     json_free_serialized_string(serialized_string);
   }
 end:
   json_value_free(root_value);
 }
 
-static void handle_GetVersion(struct mg_connection *nc, struct http_message *hm)
+static void handle_GetVersion(REQUEST *request)
 {
   JSON_Value *root_value = json_value_init_object();
   JSON_Object *root_object = json_value_get_object(root_value);
@@ -144,51 +487,684 @@ static void handle_GetVersion(struct mg_connection *nc, struct http_message *hm)
     codestring = HTTP_INTERNAL_ERROR;
     serialized_string = "{\"error\":\"failed to construct response\"}";
   }
-  rest_respond(nc, codestring, "%s", serialized_string);
+  rest_respond(request, codestring, "%s", serialized_string);
   json_free_serialized_string(serialized_string);
   json_value_free(root_value);
 }
 
-static void handle_GetModelRoot(struct mg_connection *nc, struct http_message *hm)
+static void handle_GetModelRoot(REQUEST *request)
 {
+  const char *codestring = NULL;
+  const char *error_msg = NULL;
+  srsMODEL *model = request_get_model(request, &codestring, &error_msg);
+  if (model == NULL)
+  {
+    rest_respond(request, codestring, "{\"error\":\"%s\"}", error_msg);
+    return;
+  }
   JSON_Value *root_value = json_value_init_object();
   JSON_Object *root_object = json_value_get_object(root_value);
   char *serialized_string = NULL;
-  srsLOG_PRINT("Asked for model root: Currently %s", srsModel_GetRoot());
-  json_object_set_string(root_object, "model-root", srsModel_GetRoot());
+  srsLOG_PRINT("Asked for model root: Currently %s", srsModel_GetRootAt(model));
+  json_object_set_string(root_object, "model-root", srsModel_GetRootAt(model));
   serialized_string = json_serialize_to_string_pretty(root_value);
-  const char *codestring = HTTP_OK;
+  codestring = HTTP_OK;
   if (serialized_string == NULL)
   {
     codestring = HTTP_INTERNAL_ERROR;
     serialized_string = "{\"error\":\"failed to construct response\"}";
   }
-  rest_respond(nc, codestring, "%s", serialized_string);
+  rest_respond(request, codestring, "%s", serialized_string);
   json_free_serialized_string(serialized_string);
   json_value_free(root_value);
 }
 
-static void ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
-  struct http_message *hm = (struct http_message *) ev_data;
+#define FORECAST_DAYS_DEFAULT 30
+#define FORECAST_DAYS_MAX 3650
 
-  switch (ev) {
-    case MG_EV_HTTP_REQUEST:
+/* Ex: http://localhost:8000/api/v1/forecast?days=7 */
+static void handle_GetForecast(REQUEST *request)
+{
+  char days_string[16] = {0};
+  int32_t days = FORECAST_DAYS_DEFAULT;
+  const char *codestring = NULL;
+  const char *error_msg = NULL;
+  srsMODEL *model = request_get_model(request, &codestring, &error_msg);
+  if (model == NULL)
+  {
+    rest_respond(request, codestring, "{\"error\":\"%s\"}", error_msg);
+    return;
+  }
+  if ((mg_get_http_var(&request->query_string, "days", days_string, sizeof(days_string)) > 0) && (!srsString_ToU32(days_string, &days) || (days < 1) || (days > FORECAST_DAYS_MAX)))
+  {
+    rest_respond(request, HTTP_BAD_REQUEST, "{\"error\":\"days must be between 1 and %d\"}", FORECAST_DAYS_MAX);
+    return;
+  }
+  uint32_t counts[FORECAST_DAYS_MAX];
+  if (!srsModel_GetForecastAt(model, srsTime_Now(), (uint32_t)days, counts))
+  {
+    rest_respond(request, HTTP_INTERNAL_ERROR, "%s", "{\"error\":\"failed to read every deck\"}");
+    return;
+  }
+  JSON_Value *root_value = json_value_init_object();
+  JSON_Object *root_object = json_value_get_object(root_value);
+  JSON_Value *counts_value = json_value_init_array();
+  JSON_Array *counts_array = json_value_get_array(counts_value);
+  char *serialized_string = NULL;
+  int32_t i = 0;
+  for (i = 0; i < days; i++)
+  {
+    json_array_append_number(counts_array, counts[i]);
+  }
+  json_object_set_value(root_object, "counts", counts_value);
+  serialized_string = json_serialize_to_string(root_value);
+  if (serialized_string == NULL)
+  {
+    rest_respond(request, HTTP_INTERNAL_ERROR, "%s", "{\"error\":\"failed to construct response\"}");
+  }
+  else
+  {
+    rest_respond(request, HTTP_OK, "%s", serialized_string);
+    json_free_serialized_string(serialized_string);
+  }
+  json_value_free(root_value);
+}
+
+/* Pushes a message to every connected websocket client when cards of a deck become due. Cards are scheduled on a timing wheel, so nothing is done until one is.
+ * Decks of the default context are watched from the start, and those of a collection from when a request first opens it. */
+#define DUE_DIRTY_MAX 32
+
+/* A context whose decks are watched. The default context has no name. */
+typedef struct _DUE_COLLECTION_s
+{
+  char name[COLLECTION_NAME_MAX];
+  srsMODEL *model;
+} DUE_COLLECTION;
+
+typedef struct _DUE_DECK_s
+{
+  char path[srsMODEL_DECK_ID_MAX];
+  const DUE_COLLECTION *collection;
+  srsTIMER *timers;
+  size_t timer_count;
+  uint32_t newly_due;
+} DUE_DECK;
+
+/* A deck the watcher saw change, or every deck of a collection if path is empty */
+typedef struct _DUE_DIRTY_s
+{
+  const DUE_COLLECTION *collection;
+  char path[srsMODEL_DECK_ID_MAX];
+} DUE_DIRTY;
+
+static srsTIMER_WHEEL *due_wheel = NULL;
+static DUE_DECK **due_decks = NULL;
+static size_t due_deck_count = 0;
+/* Collection name and deck path to DUE_DECK, since every change the watcher reports is looked up by path */
+static srsHASHMAP due_deck_index;
+static time_t due_minute = 0;
+static DUE_COLLECTION due_default = {"", NULL};
+/* Collections and decks whose cards changed, to be reloaded by the poll loop. Collections are added by workers as they open them. */
+static srsSPINLOCK due_dirty_lock = srsSPINLOCK_INIT;
+static DUE_COLLECTION **due_collections = NULL;
+static size_t due_collection_count = 0;
+static DUE_DIRTY due_dirty[DUE_DIRTY_MAX];
+static size_t due_dirty_count = 0;
+static bool due_dirty_all = false;
+
+static void due_on_expired(srsTIMER *timer, void *userdata)
+{
+  (void)userdata;
+  ((DUE_DECK *)timer->data)->newly_due++;
+}
+
+/* Schedules a timer for every card of a deck that is not due yet. Cards that are already due were either announced already or are found by asking for the next card. */
+static void due_load_deck(DUE_DECK *deck, srsTIME_PACKED now)
+{
+  size_t i = 0;
+  for (i = 0; i < deck->timer_count; i++)
+  {
+    srsTimerWheel_Remove(due_wheel, &deck->timers[i]);
+  }
+  free(deck->timers);
+  deck->timers = NULL;
+  deck->timer_count = 0;
+  srsSNAPSHOT *snapshot = srsSnapshot_OpenAt(deck->collection->model, deck->path);
+  size_t count = srsSnapshot_GetCount(snapshot);
+  const srsTIME_PACKED *due = srsSnapshot_GetDueTimes(snapshot);
+  deck->timers = (count == 0) ? NULL : calloc(count, sizeof(*deck->timers));
+  if (deck->timers != NULL)
+  {
+    deck->timer_count = count;
+    for (i = 0; i < count; i++)
+    {
+      deck->timers[i].data = deck;
+      if (due[i] > now)
+      {
+        srsTimerWheel_Add(due_wheel, &deck->timers[i], due[i]);
+      }
+    }
+  }
+  srsSnapshot_Close(snapshot);
+}
+
+static DUE_DECK *due_get_deck(const DUE_COLLECTION *collection, const char *path)
+{
+  void *found = NULL;
+  /* Collection names never contain a slash, so the name of the default context being empty cannot clash with one */
+  char key[COLLECTION_NAME_MAX + srsMODEL_DECK_ID_MAX + 1];
+  int needed = snprintf(key, sizeof(key), "%s/%s", collection->name, path);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(key)))
+  {
+    return NULL;
+  }
+  if (srsHashMap_Get(&due_deck_index, key, &found))
+  {
+    return (DUE_DECK *)found;
+  }
+  DUE_DECK **grown = realloc(due_decks, (due_deck_count + 1) * sizeof(*due_decks));
+  if (grown == NULL)
+  {
+    return NULL;
+  }
+  due_decks = grown;
+  DUE_DECK *deck = calloc(1, sizeof(*deck));
+  if (deck == NULL)
+  {
+    return NULL;
+  }
+  snprintf(deck->path, sizeof(deck->path), "%s", path);
+  deck->collection = collection;
+  if (!srsHashMap_Set(&due_deck_index, key, deck))
+  {
+    free(deck);
+    return NULL;
+  }
+  due_decks[due_deck_count++] = deck;
+  return deck;
+}
+
+static void due_load_collection(const DUE_COLLECTION *collection, srsTIME_PACKED now)
+{
+  const char *name = NULL;
+  bool is_dir = false;
+  char path[srsMODEL_DECK_ID_MAX];
+  srsDIR_STREAM *stream = srsDirStream_Open(srsModel_GetRootDirAt(collection->model), "decks");
+  while ((stream != NULL) && srsDirStream_Next(stream, &name, &is_dir))
+  {
+    int needed = snprintf(path, sizeof(path), "decks/%s", name);
+    if (!is_dir || (name[0] == '.') || (needed <= 0) || ((size_t)needed >= sizeof(path)))
+    {
+      continue;
+    }
+    DUE_DECK *deck = due_get_deck(collection, path);
+    if (deck != NULL)
+    {
+      due_load_deck(deck, now);
+    }
+  }
+  srsDirStream_Close(stream);
+}
+
+static void due_load_all(srsTIME_PACKED now)
+{
+  size_t i = 0;
+  due_load_collection(&due_default, now);
+  /* Collections are only ever added, and never freed before the loop stops */
+  srsSpinLock_Lock(&due_dirty_lock);
+  size_t count = due_collection_count;
+  srsSpinLock_Unlock(&due_dirty_lock);
+  for (i = 0; i < count; i++)
+  {
+    srsSpinLock_Lock(&due_dirty_lock);
+    const DUE_COLLECTION *collection = due_collections[i];
+    srsSpinLock_Unlock(&due_dirty_lock);
+    due_load_collection(collection, now);
+  }
+}
+
+/* Called with due_dirty_lock held */
+static void due_mark_dirty(const DUE_COLLECTION *collection, const char *path, size_t length)
+{
+  size_t i = 0;
+  if ((length >= srsMODEL_DECK_ID_MAX) || (due_dirty_count == DUE_DIRTY_MAX))
+  {
+    due_dirty_all = true;
+    return;
+  }
+  for (i = 0; i < due_dirty_count; i++)
+  {
+    if ((due_dirty[i].collection == collection) && (strncmp(due_dirty[i].path, path, length) == 0) && (due_dirty[i].path[length] == '\0'))
+    {
+      return;
+    }
+  }
+  due_dirty[due_dirty_count].collection = collection;
+  memcpy(due_dirty[due_dirty_count].path, path, length);
+  due_dirty[due_dirty_count++].path[length] = '\0';
+}
+
+/* Runs on the watcher thread of the collection passed as userdata, so it only notes which deck changed */
+static void due_on_change(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata)
+{
+  (void)is_dir;
+  const char *cards = strstr(path, "/cards/");
+  size_t length = (cards == NULL) ? 0 : (size_t)(cards - path);
+  if ((event != srsWATCH_RESCAN) && ((cards == NULL) || (strstr(path, "/" srsSNAPSHOT_DIRNAME) != NULL)))
+  {
+    return;
+  }
+  srsSpinLock_Lock(&due_dirty_lock);
+  /* A rescan reloads the whole collection */
+  due_mark_dirty(userdata, path, (event == srsWATCH_RESCAN) ? 0 : length);
+  srsSpinLock_Unlock(&due_dirty_lock);
+}
+
+/* Runs on the worker that opened the collection. Its decks are loaded by the next poll. */
+static void due_add_collection(const char *name, srsMODEL *model)
+{
+  if (due_wheel == NULL)
+  {
+    return;
+  }
+  DUE_COLLECTION *collection = calloc(1, sizeof(*collection));
+  if (collection == NULL)
+  {
+    srsLOG_ERROR("Unable to watch collection %s - its due cards will not be announced", name);
+    return;
+  }
+  snprintf(collection->name, sizeof(collection->name), "%s", name);
+  collection->model = model;
+  srsSpinLock_Lock(&due_dirty_lock);
+  DUE_COLLECTION **grown = realloc(due_collections, (due_collection_count + 1) * sizeof(*due_collections));
+  if (grown != NULL)
+  {
+    due_collections = grown;
+    due_collections[due_collection_count++] = collection;
+    due_mark_dirty(collection, "", 0);
+  }
+  srsSpinLock_Unlock(&due_dirty_lock);
+  if (grown == NULL)
+  {
+    srsLOG_ERROR("Unable to watch collection %s - its due cards will not be announced", name);
+    free(collection);
+    return;
+  }
+  if (!srsModel_AddListenerAt(model, due_on_change, collection))
+  {
+    srsLOG_ERROR("Unable to listen for card changes of collection %s - rescheduled cards will not be announced", name);
+  }
+}
+
+static void due_broadcast(struct mg_mgr *mgr, const DUE_DECK *deck)
+{
+  JSON_Value *root_value = json_value_init_object();
+  JSON_Object *root_object = json_value_get_object(root_value);
+  json_object_set_string(root_object, "event", "cards-due");
+  if (deck->collection->name[0] != '\0')
+  {
+    json_object_set_string(root_object, "collection", deck->collection->name);
+  }
+  json_object_set_string(root_object, "deck", deck->path);
+  json_object_set_number(root_object, "count", deck->newly_due);
+  char *serialized_string = json_serialize_to_string(root_value);
+  if (serialized_string != NULL)
+  {
+    struct mg_connection *c = NULL;
+    for (c = mg_next(mgr, NULL); c != NULL; c = mg_next(mgr, c))
     {
-      if (mg_vcmp(&hm->uri, KIOKU_REST_API_PATH "exit") == 0)
+      if (c->flags & MG_F_IS_WEBSOCKET)
       {
-        handle_exit_call(nc, hm);
+        mg_send_websocket_frame(c, WEBSOCKET_OP_TEXT, serialized_string, strlen(serialized_string));
       }
-      else if (mg_vcmp(&hm->uri, KIOKU_REST_API_PATH "version") == 0)
+    }
+    json_free_serialized_string(serialized_string);
+  }
+  json_value_free(root_value);
+}
+
+static void due_start()
+{
+  if (!srsHashMap_Init(&due_deck_index, 0))
+  {
+    srsLOG_ERROR("Unable to index decks - due cards will not be announced");
+    return;
+  }
+  due_wheel = srsTimerWheel_Create(srsClock_Now(), due_on_expired, NULL);
+  if (due_wheel == NULL)
+  {
+    srsLOG_ERROR("Unable to create the timing wheel - due cards will not be announced");
+    srsHashMap_Free(&due_deck_index);
+    return;
+  }
+  due_default.model = srsModel_GetDefault();
+  if (!srsModel_AddListenerAt(due_default.model, due_on_change, &due_default))
+  {
+    srsLOG_ERROR("Unable to listen for card changes - rescheduled cards will not be announced");
+  }
+  due_minute = time(NULL) / 60;
+  due_load_all(srsClock_Now());
+  srsLOG_PRINT("Watching %zu cards for when they become due", srsTimerWheel_GetCount(due_wheel));
+}
+
+/* Called after every poll. Nothing can become due within the same minute, so most calls return straight away. */
+static void due_poll(struct mg_mgr *mgr)
+{
+  DUE_DIRTY dirty[DUE_DIRTY_MAX];
+  size_t dirty_count = 0;
+  bool dirty_all = false;
+  size_t i = 0;
+  time_t minute = time(NULL) / 60;
+  if ((due_wheel == NULL) || (minute == due_minute))
+  {
+    return;
+  }
+  due_minute = minute;
+  srsTIME_PACKED now = srsClock_Now();
+  srsSpinLock_Lock(&due_dirty_lock);
+  dirty_all = due_dirty_all;
+  dirty_count = due_dirty_count;
+  memcpy(dirty, due_dirty, dirty_count * sizeof(dirty[0]));
+  due_dirty_all = false;
+  due_dirty_count = 0;
+  srsSpinLock_Unlock(&due_dirty_lock);
+  if (dirty_all)
+  {
+    due_load_all(now);
+  }
+  for (i = 0; !dirty_all && (i < dirty_count); i++)
+  {
+    if (dirty[i].path[0] == '\0')
+    {
+      due_load_collection(dirty[i].collection, now);
+      continue;
+    }
+    DUE_DECK *deck = due_get_deck(dirty[i].collection, dirty[i].path);
+    if (deck != NULL)
+    {
+      due_load_deck(deck, now);
+    }
+  }
+  srsTIME_PACKED next = 0;
+  if (!srsTimerWheel_GetNextExpiry(due_wheel, &next) || (next > now))
+  {
+    return;
+  }
+  srsTimerWheel_Advance(due_wheel, now);
+  for (i = 0; i < due_deck_count; i++)
+  {
+    if (due_decks[i]->newly_due > 0)
+    {
+      due_broadcast(mgr, due_decks[i]);
+      due_decks[i]->newly_due = 0;
+    }
+  }
+}
+
+/* Runs once the workers have stopped and before the collections are closed */
+static void due_stop()
+{
+  size_t i = 0;
+  if (due_wheel == NULL)
+  {
+    return;
+  }
+  srsModel_RemoveListenerAt(due_default.model, due_on_change, &due_default);
+  for (i = 0; i < due_collection_count; i++)
+  {
+    srsModel_RemoveListenerAt(due_collections[i]->model, due_on_change, due_collections[i]);
+  }
+  for (i = 0; i < due_deck_count; i++)
+  {
+    free(due_decks[i]->timers);
+    free(due_decks[i]);
+  }
+  free(due_decks);
+  due_decks = NULL;
+  due_deck_count = 0;
+  srsHashMap_Free(&due_deck_index);
+  srsTimerWheel_Free(due_wheel);
+  due_wheel = NULL;
+  /* The watchers may still be running a listener that has just been removed, so the collections they were given are freed last */
+  for (i = 0; i < due_collection_count; i++)
+  {
+    free(due_collections[i]);
+  }
+  free(due_collections);
+  due_collections = NULL;
+  due_collection_count = 0;
+}
+
+/* Requests that read the model are answered on worker threads, so that one slow deck scan or git commit only holds up its own client.
+ * The event loop hands requests over through one lock-free queue and the workers hand them back through another, waking the loop with mg_broadcast to send the responses.
+ * Each connection keeps the requests it is waiting on, so answers to pipelined requests go out in order however the workers finish them. */
+#ifndef WORKER_QUEUE_CAPACITY
+#define WORKER_QUEUE_CAPACITY 256
+#endif
+#define WORKER_THREADS_MAX 64
+
+typedef struct _WORKER_POOL_s
+{
+  struct mg_mgr *mgr;
+  srsMPMC_QUEUE requests;
+  srsMPMC_QUEUE answered;
+  srsMUTEX lock;               /* Only for idle workers to sleep on */
+  srsCOND wake;
+  bool stopping;
+  srsATOMIC32 running;
+  srsTHREAD threads[WORKER_THREADS_MAX];
+  uint32_t thread_count;
+  uint32_t in_flight;          /* Requests handed over and not yet handed back. Only the event loop uses it. */
+} WORKER_POOL;
+
+static WORKER_POOL workers;
+
+static void workers_on_answered(struct mg_connection *nc, int ev, void *ev_data)
+{
+  (void)nc;
+  (void)ev;
+  (void)ev_data;
+  /* Nothing to do per connection. The broadcast only wakes the event loop, which then sends every answer in workers_poll. */
+}
+
+static void *workers_run(void *arg)
+{
+  (void)arg;
+  srsARENA arena;
+  void *value = NULL;
+  srsArena_Init(&arena, 0);
+  for (;;)
+  {
+    bool found = srsMPMCQueue_Pop(&workers.requests, &value);
+    if (!found)
+    {
+      srsMutex_Lock(&workers.lock);
+      while (!(found = srsMPMCQueue_Pop(&workers.requests, &value)) && !workers.stopping)
       {
-        handle_GetVersion(nc, hm);
+        srsCond_Wait(&workers.wake, &workers.lock);
       }
-      else if (mg_vcmp(&hm->uri, KIOKU_REST_API_PATH "model-root") == 0)
+      srsMutex_Unlock(&workers.lock);
+    }
+    if (!found)
+    {
+      break;
+    }
+    request_run(value, &arena);
+    /* There is room for every request in flight, so this cannot fail */
+    srsMPMCQueue_Push(&workers.answered, value);
+    char wake = 0;
+    mg_broadcast(workers.mgr, workers_on_answered, &wake, sizeof(wake));
+  }
+  srsArena_Free(&arena);
+  srsAtomic_Add(&workers.running, -1);
+  return NULL;
+}
+
+static void workers_start(struct mg_mgr *mgr, uint32_t thread_count)
+{
+  uint32_t i = 0;
+  memset(&workers, 0, sizeof(workers));
+  workers.mgr = mgr;
+  if (thread_count > WORKER_THREADS_MAX)
+  {
+    thread_count = WORKER_THREADS_MAX;
+  }
+  if ((thread_count == 0) || !srsMPMCQueue_Init(&workers.requests, WORKER_QUEUE_CAPACITY) || !srsMPMCQueue_Init(&workers.answered, WORKER_QUEUE_CAPACITY))
+  {
+    srsMPMCQueue_Free(&workers.requests);
+    return;
+  }
+  if (!srsMutex_Init(&workers.lock) || !srsCond_Init(&workers.wake))
+  {
+    srsLOG_ERROR("Unable to start workers - requests will be answered on the event loop");
+    srsMPMCQueue_Free(&workers.requests);
+    srsMPMCQueue_Free(&workers.answered);
+    return;
+  }
+  for (i = 0; i < thread_count; i++)
+  {
+    srsAtomic_Add(&workers.running, 1);
+    if (!srsThread_Create(&workers.threads[workers.thread_count], workers_run, NULL))
+    {
+      srsAtomic_Add(&workers.running, -1);
+      srsLOG_ERROR("Unable to start worker %u of %u", i + 1, thread_count);
+      break;
+    }
+    workers.thread_count++;
+  }
+  srsLOG_PRINT("Answering requests on %u workers", workers.thread_count);
+}
+
+/* Hands a request to a worker, or answers it on the spot if there are none */
+static void workers_submit(struct mg_connection *nc, REQUEST *request, srsARENA *arena)
+{
+  if (workers.thread_count == 0)
+  {
+    request_run(request, arena);
+    connection_send(nc, request);
+    return;
+  }
+  if (workers.in_flight >= srsMPMCQueue_GetCapacity(&workers.requests))
+  {
+    request_respond(request, HTTP_SERVICE_UNAVAILABLE, "%s", "{\"error\":\"too many requests\"}");
+    connection_send(nc, request);
+    return;
+  }
+  if (!connection_push(nc, request))
+  {
+    request_respond(request, HTTP_INTERNAL_ERROR, "%s", "{\"error\":\"failed to queue request\"}");
+    connection_send(nc, request);
+    return;
+  }
+  srsMPMCQueue_Push(&workers.requests, request);
+  workers.in_flight++;
+  srsMutex_Lock(&workers.lock);
+  srsCond_Signal(&workers.wake);
+  srsMutex_Unlock(&workers.lock);
+}
+
+/* Sends the answers the workers handed back, as far as the requests before them allow. Answers for connections that closed meanwhile are dropped. */
+static void workers_poll()
+{
+  void *value = NULL;
+  while (srsMPMCQueue_Pop(&workers.answered, &value))
+  {
+    REQUEST *request = value;
+    struct mg_connection *c = connection_find(workers.mgr, request);
+    workers.in_flight--;
+    if (c == NULL)
+    {
+      request_destroy(request);
+      continue;
+    }
+    request->answered = true;
+    connection_flush(c);
+  }
+}
+
+static void workers_stop()
+{
+  uint32_t i = 0;
+  void *value = NULL;
+  if (workers.thread_count == 0)
+  {
+    return;
+  }
+  srsMutex_Lock(&workers.lock);
+  workers.stopping = true;
+  srsCond_Broadcast(&workers.wake);
+  srsMutex_Unlock(&workers.lock);
+  /* Workers finish what was handed to them first, and each answer waits for the event loop to take its broadcast */
+  while (srsAtomic_Load(&workers.running) > 0)
+  {
+    mg_mgr_poll(workers.mgr, 10);
+    workers_poll();
+  }
+  for (i = 0; i < workers.thread_count; i++)
+  {
+    srsThread_Join(workers.threads[i], NULL);
+  }
+  workers_poll();
+  while (srsMPMCQueue_Pop(&workers.requests, &value))
+  {
+    request_destroy(value);
+  }
+  srsMPMCQueue_Free(&workers.requests);
+  srsMPMCQueue_Free(&workers.answered);
+  srsCond_Destroy(&workers.wake);
+  srsMutex_Destroy(&workers.lock);
+  workers.thread_count = 0;
+}
+
+/* Requests answered by a handler. Those that touch the model go to the workers, while the rest are answered on the event loop. */
+typedef struct _ROUTE_s
+{
+  const char *uri;
+  void (*handler)(REQUEST *request);
+  bool on_worker;
+} ROUTE;
+
+static const ROUTE routes[] = {
+  {KIOKU_REST_API_PATH "exit", handle_exit_call, false},
+  {KIOKU_REST_API_PATH "version", handle_GetVersion, false},
+  {KIOKU_REST_API_PATH "model-root", handle_GetModelRoot, true},
+  {KIOKU_REST_API_PATH "card/next", handle_GetNextCard, true},
+  {KIOKU_REST_API_PATH "forecast", handle_GetForecast, true},
+};
+
+/* The event loop's own arena, for requests it answers itself */
+static srsARENA loop_arena;
+
+static void ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
+  struct http_message *hm = (struct http_message *) ev_data;
+
+  switch (ev) {
+    case MG_EV_HTTP_REQUEST:
+    {
+      size_t i = 0;
+      for (i = 0; i < sizeof(routes) / sizeof(routes[0]); i++)
       {
-        handle_GetModelRoot(nc, hm);
+        if (mg_vcmp(&hm->uri, routes[i].uri) == 0)
+        {
+          break;
+        }
       }
-      else if (mg_vcmp(&hm->uri, KIOKU_REST_API_PATH "card/next") == 0)
+      if (i < sizeof(routes) / sizeof(routes[0]))
       {
-        handle_GetNextCard(nc, hm);
+        REQUEST *request = request_create(hm, routes[i].handler);
+        if (request == NULL)
+        {
+          mg_printf(nc, "HTTP/1.1 %s\r\nContent-Length: 0\r\n\r\n", HTTP_INTERNAL_ERROR);
+        }
+        else if (routes[i].on_worker)
+        {
+          workers_submit(nc, request, &loop_arena);
+        }
+        else
+        {
+          request_run(request, &loop_arena);
+          connection_send(nc, request);
+        }
       }
       else if (mg_vcmp(&hm->uri, "/printcontent") == 0)
       {
@@ -201,6 +1177,9 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data) {
       }
       break;
     }
+    case MG_EV_CLOSE:
+      connection_close(nc);
+      break;
     default:
       break;
   }
@@ -211,6 +1190,8 @@ int main(int argc, char *argv[]) {
   struct mg_connection *nc;
   struct mg_bind_opts bind_opts;
   int i;
+  int32_t worker_count = (int32_t)srsThread_GetHardwareConcurrency();
+  const char *collections_dir = NULL;
   char *cp;
   const char *err_str;
 #if MG_ENABLE_SSL
@@ -218,6 +1199,8 @@ int main(int argc, char *argv[]) {
 #endif
 
   mg_mgr_init(&mgr, NULL);
+  srsArena_Init(&loop_arena, 0);
+  json_set_allocation_functions(request_malloc, request_free);
 
   /* Use current binary directory as document root */
   if (argc > 0 && ((cp = strrchr(argv[0], DIRSEP)) != NULL)) {
@@ -246,6 +1229,18 @@ int main(int argc, char *argv[]) {
       s_http_server_opts.per_directory_auth_file = argv[++i];
     } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
       s_http_server_opts.url_rewrites = argv[++i];
+    } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      /* Directory of collections, each a model root of its own */
+      collections_dir = argv[++i];
+    } else if (strcmp(argv[i], "-S") == 0) {
+      /* Flush every write to disk before acknowledging it */
+      srsFileSystem_SetDurable(true);
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      /* Worker threads answering requests, 0 to answer them all on the event loop */
+      if (!srsString_ToU32(argv[++i], &worker_count) || (worker_count < 0)) {
+        srsLOG_ERROR("Invalid worker count: [%s]", argv[i]);
+        exit(1);
+      }
 #if MG_ENABLE_HTTP_CGI
     } else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) {
       s_http_server_opts.cgi_interpreter = argv[++i];
@@ -292,13 +1287,26 @@ int main(int argc, char *argv[]) {
   else
   {
     srsLOG_PRINT("Set model root to %s using %s", srsModel_GetRoot(), s_http_server_opts.document_root);
+    if ((collections_dir != NULL) && !collections_start(collections_dir))
+    {
+      srsLOG_ERROR("Unable to serve the collections in %s", collections_dir);
+      kill_me_now = true;
+    }
+    due_start();
+    workers_start(&mgr, (uint32_t)worker_count);
   }
   while (!kill_me_now)
   {
     mg_mgr_poll(&mgr, 1000);
+    workers_poll();
+    due_poll(&mgr);
   }
+  workers_stop();
   mg_mgr_free(&mgr);
+  due_stop();
+  collections_stop();
   srsModel_SetRoot(NULL);
+  srsArena_Free(&loop_arena);
 
   /* Cleanup logger resources */
   srsLog_Exit();
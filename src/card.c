@@ -1,6 +1,11 @@
 #include "kioku/card.h"
+#include "kioku/model.h"
+#include "kioku/snapshot.h"
 #include "kioku/filesystem.h"
+#include "kioku/io.h"
 #include "kioku/schedule.h"
+#include "kioku/clock.h"
+#include "kioku/thread.h"
 #include "kioku/datastructure.h"
 #include "kioku/string.h"
 #include "kioku/debug.h"
@@ -8,56 +13,147 @@
 #include "kioku/error.h"
 #include "kioku/result.h"
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <stdio.h>
 
-static srsFILESYSTEM_VISIT_ACTION get_cards(const char *path, void *userdata)
-{
-  srsMEMSTACK *list = (srsMEMSTACK *)userdata;
-  srsTIME_STRING added_time_str = {0};
-  srsTIME_STRING scheduled_time_str = {0};
-  /** TODO We should not rely on the push/pop/get CWD functions. It's not very robust. */
-  /* Go into the card's folder */
-  srsDir_PushCWD(path);
-  {
-    srsTIME added_time = srsTime_Now();
-    srsTIME scheduled_time = srsTime_Now();
-    bool ok = false;
+/* The cards srsCard_GetAll collects, which are handed to the caller */
+srsVECTOR_DEFINE(srsCARD_LIST, srsCardList, srsCARD, 0)
 
-    /* TODO handle case where files are missing */
+/* Per-card scratch space for load_card_times */
+typedef struct _srsCARD_TIMES_s
+{
+  srsTIME_STRING strings[2];
+  char paths[2][srsMODEL_CARD_ID_MAX + sizeof("/scheduled.txt")];
+} srsCARD_TIMES;
 
-    /* Try to load added time */
-    ok = srsFile_GetContent("added.txt", added_time_str, sizeof(added_time_str));
-    ok = srsTime_FromString(added_time_str, &added_time);
-    if (!ok)
+/**
+ * Loads the added and scheduled times of a batch of cards in one batch of reads, then writes back defaults for any that were missing or malformed in a second batch.
+ * Doing this per card costs several blocking round trips each, which dominates loading a deck from a cold cache.
+ * The caller provides scratch space for count cards so the same buffers can be reused from batch to batch, and the time to give any card whose times are missing.
+ */
+static bool load_card_times(srsIO_ENGINE *engine, srsDIR *cards_dir, srsCARD *cards, size_t count, srsCARD_TIMES *times, srsIO_REQUEST *requests, srsTIME now)
+{
+  static const char *files[2] = {"added.txt", "scheduled.txt"};
+  size_t i = 0;
+  size_t j = 0;
+  if (count == 0)
+  {
+    return true;
+  }
+  memset(requests, 0, count * 2 * sizeof(*requests));
+  for (i = 0; i < count; i++)
+  {
+    for (j = 0; j < 2; j++)
     {
-      srsTime_ToString(added_time, added_time_str);
-      srsFile_SetContent("added.txt", added_time_str);
+      srsIO_REQUEST *request = &requests[i * 2 + j];
+      int needed = snprintf(times[i].paths[j], sizeof(times[i].paths[j]), "%s/%s", cards[i].id, files[j]);
+      request->op = srsIO_READ;
+      request->dir = cards_dir;
+      request->path = times[i].paths[j];
+      request->buffer = (char *)times[i].strings[j];
+      request->size = sizeof(times[i].strings[j]) - 1;
+      if ((needed <= 0) || ((size_t)needed >= sizeof(times[i].paths[j])))
+      {
+        /* Point it at nothing so it fails and gets a default like any other unreadable file */
+        request->path = "";
+      }
     }
-    /* Try to load scheduled time */
-    ok = srsFile_GetContent("scheduled.txt", scheduled_time_str, sizeof(scheduled_time_str));
-    ok = srsTime_FromString(scheduled_time_str, &scheduled_time);
-    if (!ok)
+  }
+  if (!srsIO_Submit(engine, requests, count * 2))
+  {
+    srsERROR_SET(srsFAIL, "Unable to read card times");
+    return false;
+  }
+  /* Parse what was read, queueing write-backs for anything unusable. They are compacted to the front of the same array, which never overtakes the request being parsed. */
+  size_t writes = 0;
+  for (i = 0; i < count; i++)
+  {
+    srsTIME *targets[2] = {&cards[i].when_added, &cards[i].when_next_scheduled};
+    for (j = 0; j < 2; j++)
     {
-      srsTime_ToString(scheduled_time, scheduled_time_str);
-      srsFile_SetContent("scheduled.txt", added_time_str);
+      srsIO_REQUEST *request = &requests[i * 2 + j];
+      char *text = (char *)times[i].strings[j];
+      text[(request->result > 0) ? request->result : 0] = kiokuCHAR_NULL;
+      if ((request->result > 0) && srsTime_FromString(times[i].strings[j], targets[j]))
+      {
+        continue;
+      }
+      *targets[j] = now;
+      srsTime_ToString(*targets[j], times[i].strings[j]);
+      /* Files that could not be opened stay missing, as before */
+      srsIO_REQUEST *write = &requests[writes++];
+      *write = *request;
+      write->op = srsIO_WRITE;
+      write->size = strlen(text);
     }
+  }
+  if ((writes > 0) && !srsIO_Submit(engine, requests, writes))
+  {
+    srsERROR_SET(srsFAIL, "Unable to write back card times");
+    return false;
+  }
+  return true;
+}
 
-    /* Create card */
-    srsCARD card = {0};
-    card.id = strdup(path);
-    /** TODO If we switch to a new filesystem iterator implementation, the srsDir_GetCWD usage here will be invalid */
-    card.path = strdup(srsDir_GetCWD());
-    srsASSERT(card.id != NULL);
-    srsASSERT(card.path != NULL);
-    card.when_added = added_time;
-    card.when_next_scheduled = scheduled_time;
-    /* Add to list */
-    ok = srsMemStack_Push(list, &card);
-    srsASSERT(ok);
+/* Engines for srsCard_LoadTimes and card cursors, kept once created since setting up a ring or a thread pool can cost more than reading a small deck.
+ * An engine serves one thread at a time, so each call or cursor takes one out and puts it back. They are deep enough for two reads per card of a cursor batch to be in flight at once. */
+static srsSPINLOCK srsCard_ENGINES_LOCK = srsSPINLOCK_INIT;
+static srsIO_ENGINE *srsCard_ENGINES[srsCARD_ENGINES_MAX];
+static size_t srsCard_ENGINE_COUNT = 0;
+
+static srsIO_ENGINE *srsCard_AcquireEngine()
+{
+  srsIO_ENGINE *engine = NULL;
+  srsSpinLock_Lock(&srsCard_ENGINES_LOCK);
+  if (srsCard_ENGINE_COUNT > 0)
+  {
+    engine = srsCard_ENGINES[--srsCard_ENGINE_COUNT];
+  }
+  srsSpinLock_Unlock(&srsCard_ENGINES_LOCK);
+  return (engine != NULL) ? engine : srsIO_Create(srsCARD_CURSOR_BATCH * 2, 0);
+}
+
+static void srsCard_ReleaseEngine(srsIO_ENGINE *engine)
+{
+  if (engine == NULL)
+  {
+    return;
+  }
+  srsSpinLock_Lock(&srsCard_ENGINES_LOCK);
+  if (srsCard_ENGINE_COUNT < srsCARD_ENGINES_MAX)
+  {
+    srsCard_ENGINES[srsCard_ENGINE_COUNT++] = engine;
+    engine = NULL;
+  }
+  srsSpinLock_Unlock(&srsCard_ENGINES_LOCK);
+  srsIO_Destroy(engine);
+}
+
+bool srsCard_LoadTimes(srsDIR *cards_dir, srsCARD *cards, size_t count)
+{
+  bool ok = false;
+  srsIO_ENGINE *engine = NULL;
+  srsCARD_TIMES *times = NULL;
+  srsIO_REQUEST *requests = NULL;
+  if ((cards == NULL) || (count == 0))
+  {
+    return (count == 0);
+  }
+  times = malloc(count * sizeof(*times));
+  requests = malloc(count * 2 * sizeof(*requests));
+  engine = srsCard_AcquireEngine();
+  if ((times == NULL) || (requests == NULL) || (engine == NULL))
+  {
+    srsERROR_SET(srsFAIL, "Unable to allocate card loading state");
+    goto done;
   }
-  /* Go out of the card's folder */
-  srsDir_PopCWD(NULL);
-  return srsFILESYSTEM_VISIT_CONTINUE;
+  ok = load_card_times(engine, cards_dir, cards, count, times, requests, srsTime_Now());
+done:
+  srsCard_ReleaseEngine(engine);
+  free(requests);
+  free(times);
+  return ok;
 }
 
 bool srsDeck_IsValidName(const char *deck_name)
@@ -65,22 +161,307 @@ bool srsDeck_IsValidName(const char *deck_name)
   return !(deck_name == NULL || strchr(deck_name, '\\') || strchr(deck_name, '/'));
 }
 
-/**
- * Returns a list of all cards for a deck.
- * TODO Some day we need to support decks with thousands of cards. We cannot allocate that much memory, and we have no real reason to. We will need a new function to replace this one that allows us to filter them.
- * @param[in] deck_name Name of the deck to get the cards from.
- * @param[out] count_out Place to store the number of elements in the returned array.
- * @return Unmanaged dynamically allocated card array, or NULL if no cards are found.
- */
-srsCARD *srsCard_GetAll(const char *deck_name, size_t *count_out)
+struct _srsCARD_CURSOR_s
+{
+  srsDIR_STREAM *stream;
+  srsIO_ENGINE *engine;
+  srsCARD_FILTER filter;
+  /* Taken when the cursor is opened, so every batch of the scan sees the same time */
+  srsCLOCK_SNAPSHOT clock;
+  size_t yielded;
+  /* The current batch. Cards before next have already been considered. */
+  size_t count;
+  size_t next;
+  bool exhausted;
+  bool failed;
+  srsCARD cards[srsCARD_CURSOR_BATCH];
+  char ids[srsCARD_CURSOR_BATCH][srsMODEL_CARD_ID_MAX + 1];
+  srsCARD_TIMES times[srsCARD_CURSOR_BATCH];
+  srsIO_REQUEST requests[srsCARD_CURSOR_BATCH * 2];
+  char path[srsPATH_MAX + 1];
+};
+
+/* Every scan of a deck opens a cursor, and cursors are large, so they are kept for reuse */
+srsPOOL_DEFINE(srsCARD_CURSOR_POOL, srsCardCursorPool, srsCARD_CURSOR)
+static srsCARD_CURSOR_POOL srsCardCursor_POOL = srsPOOL_DEFINE_INIT(srsCARD_CURSOR);
+
+/* A zeroed time leaves that part of a filter unconstrained */
+static bool srsCardCursor_IsSet(const srsTIME *time)
+{
+  return (time->year | time->month | time->day | time->hour | time->minute) != 0;
+}
+
+static bool srsCardCursor_Matches(const srsCARD_FILTER *filter, const srsCARD *card)
+{
+  if (srsCardCursor_IsSet(&filter->due_before) && (srsTime_Compare(card->when_next_scheduled, filter->due_before) >= 0))
+  {
+    return false;
+  }
+  if (srsCardCursor_IsSet(&filter->added_after) && (srsTime_Compare(card->when_added, filter->added_after) <= 0))
+  {
+    return false;
+  }
+  return true;
+}
+
+/* Reads the next batch of cards from the directory. Returns false once there are none left or reading failed. */
+static bool srsCardCursor_Fill(srsCARD_CURSOR *cursor)
+{
+  const char *name = NULL;
+  bool is_dir = false;
+  cursor->count = 0;
+  cursor->next = 0;
+  while ((cursor->count < srsCARD_CURSOR_BATCH) && srsDirStream_Next(cursor->stream, &name, &is_dir))
+  {
+    /* Anything that isn't a directory can't be a card */
+    if (!is_dir)
+    {
+      continue;
+    }
+    size_t length = strlen(name);
+    if (length > srsMODEL_CARD_ID_MAX)
+    {
+      srsLOG_ERROR("Card ID %s is too long", name);
+      continue;
+    }
+    memcpy(cursor->ids[cursor->count], name, length + 1);
+    srsCARD *card = &cursor->cards[cursor->count++];
+    memset(card, 0, sizeof(*card));
+    card->id = cursor->ids[cursor->count - 1];
+  }
+  if (cursor->count == 0)
+  {
+    cursor->exhausted = true;
+    return false;
+  }
+  if (!load_card_times(cursor->engine, srsDirStream_GetDir(cursor->stream), cursor->cards, cursor->count, cursor->times, cursor->requests, cursor->clock.time))
+  {
+    cursor->failed = true;
+    return false;
+  }
+  return true;
+}
+
+/* Opens a cursor, leaving it to the caller to log any error */
+static srsCARD_CURSOR *srsCardCursor_Create(srsMODEL *model, const char *deck_name, const srsCARD_FILTER *filter)
+{
+  srsCARD_CURSOR *cursor = NULL;
+  srsDIR *deck_dir = NULL;
+
+  /* Check API state */
+  if (srsModel_GetRootAt(model) == NULL)
+  {
+    srsERROR_SET(srsE_API, "Model Root not set!");
+    return NULL;
+  }
+
+  /* Check input */
+  if (!srsDeck_IsValidName(deck_name))
+  {
+    srsERROR_SET(srsFAIL, "Invalid deck name");
+    goto done;
+  }
+
+  /* Try to open deck relative to the model root */
+  if (!srsModel_ExistsInRootAt(model, deck_name))
+  {
+    srsERROR_SET(srsFAIL, "Deck does not exist");
+    goto done;
+  }
+  deck_dir = srsDir_OpenAt(srsModel_GetRootDirAt(model), deck_name);
+  if (deck_dir == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to open deck directory");
+    goto done;
+  }
+
+  /* Check for cards */
+  if (!srsDir_ExistsAt(deck_dir, "cards"))
+  {
+    srsERROR_SET(srsFAIL, "Deck path does not contain a cards directory");
+    goto done;
+  }
+
+  cursor = srsCardCursorPool_Alloc(&srsCardCursor_POOL);
+  if (cursor == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to allocate card cursor");
+    goto done;
+  }
+  /* The batch buffers from cards onwards are always written before they are read */
+  memset(cursor, 0, offsetof(srsCARD_CURSOR, cards));
+  if (filter != NULL)
+  {
+    cursor->filter = *filter;
+  }
+  cursor->clock = srsClock_Capture();
+  cursor->stream = srsDirStream_Open(deck_dir, "cards");
+  if (cursor->stream == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to open cards directory");
+    srsCardCursor_Close(cursor);
+    cursor = NULL;
+    goto done;
+  }
+  cursor->engine = srsCard_AcquireEngine();
+  if (cursor->engine == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to create card loading engine");
+    srsCardCursor_Close(cursor);
+    cursor = NULL;
+    goto done;
+  }
+
+done:
+  srsDir_Close(deck_dir);
+  return cursor;
+}
+
+srsCARD_CURSOR *srsCardCursor_OpenAt(srsMODEL *model, const char *deck_name, const srsCARD_FILTER *filter)
+{
+  srsCARD_CURSOR *cursor = srsCardCursor_Create(model, deck_name, filter);
+  if (cursor == NULL)
+  {
+    srsERROR_LOG();
+  }
+  return cursor;
+}
+
+srsCARD_CURSOR *srsCardCursor_Open(const char *deck_name, const srsCARD_FILTER *filter)
+{
+  return srsCardCursor_OpenAt(srsModel_GetDefault(), deck_name, filter);
+}
+
+bool srsCardCursor_Next(srsCARD_CURSOR *cursor, srsCARD *card_out)
+{
+  if ((cursor == NULL) || (card_out == NULL))
+  {
+    return false;
+  }
+  while (!cursor->exhausted && !cursor->failed)
+  {
+    if ((cursor->filter.limit > 0) && (cursor->yielded >= cursor->filter.limit))
+    {
+      cursor->exhausted = true;
+      break;
+    }
+    if ((cursor->next == cursor->count) && !srsCardCursor_Fill(cursor))
+    {
+      break;
+    }
+    srsCARD *card = &cursor->cards[cursor->next++];
+    if (!srsCardCursor_Matches(&cursor->filter, card))
+    {
+      continue;
+    }
+    int32_t needed = kioku_path_concat(cursor->path, sizeof(cursor->path), srsDir_GetPath(srsDirStream_GetDir(cursor->stream)), card->id);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(cursor->path)))
+    {
+      srsLOG_ERROR("Card path for %s is too long", card->id);
+      continue;
+    }
+    *card_out = *card;
+    card_out->path = cursor->path;
+    cursor->yielded++;
+    return true;
+  }
+  return false;
+}
+
+bool srsCardCursor_HasFailed(const srsCARD_CURSOR *cursor)
+{
+  return (cursor != NULL) && cursor->failed;
+}
+
+void srsCardCursor_Close(srsCARD_CURSOR *cursor)
+{
+  if (cursor == NULL)
+  {
+    return;
+  }
+  srsCard_ReleaseEngine(cursor->engine);
+  srsDirStream_Close(cursor->stream);
+  srsCardCursorPool_Release(&srsCardCursor_POOL, cursor);
+}
+
+/* Fills in a card from a deck snapshot. Its id points into the snapshot and its path into path_out. */
+static bool srsCard_FromSnapshot(const srsSNAPSHOT *snapshot, size_t index, srsCARD *card_out, char *path_out, size_t path_size)
+{
+  card_out->id = srsSnapshot_GetID(snapshot, index);
+  int32_t needed = kioku_path_concat(path_out, path_size, srsSnapshot_GetCardsPath(snapshot), card_out->id);
+  if ((needed <= 0) || ((size_t)needed >= path_size))
+  {
+    srsLOG_ERROR("Card path for %s is too long", card_out->id);
+    return false;
+  }
+  card_out->path = path_out;
+  card_out->when_added = srsSnapshot_GetAdded(snapshot, index);
+  card_out->when_next_scheduled = srsSnapshot_GetDue(snapshot, index);
+  return true;
+}
+
+/* Copies cards of a resident deck for srsCard_GetAll */
+static bool srsCard_GetAll_Copy(const srsCARD *card, void *userdata)
+{
+  srsCARD copy = *card;
+  copy.id = strdup(card->id);
+  copy.path = strdup(card->path);
+  srsASSERT(copy.id != NULL);
+  srsASSERT(copy.path != NULL);
+  bool pushed = srsCardList_Push((srsCARD_LIST *)userdata, copy);
+  srsASSERT(pushed);
+  return true;
+}
+
+typedef struct _srsCARD_ARENA_COPY_s
+{
+  srsARENA *arena;
+  srsCARD *cards;
+  size_t count;
+  size_t capacity;
+} srsCARD_ARENA_COPY;
+
+/* Copies cards of a resident deck for srsCard_GetAllInArena */
+static bool srsCard_GetAllInArena_Copy(const srsCARD *card, void *userdata)
+{
+  srsCARD_ARENA_COPY *copy = userdata;
+  if (copy->count == copy->capacity)
+  {
+    size_t grown_capacity = (copy->capacity == 0) ? 16 : copy->capacity * 2;
+    srsCARD *grown = srsArena_Realloc(copy->arena, copy->cards, copy->capacity * sizeof(*copy->cards), grown_capacity * sizeof(*copy->cards));
+    if (grown == NULL)
+    {
+      srsERROR_SET(srsFAIL, "Unable to grow card array");
+      return false;
+    }
+    copy->cards = grown;
+    copy->capacity = grown_capacity;
+  }
+  srsCARD *copied = &copy->cards[copy->count];
+  *copied = *card;
+  copied->id = srsArena_StrDup(copy->arena, card->id);
+  copied->path = srsArena_StrDup(copy->arena, card->path);
+  if ((copied->id == NULL) || (copied->path == NULL))
+  {
+    srsERROR_SET(srsFAIL, "Unable to copy card");
+    return false;
+  }
+  copy->count++;
+  return true;
+}
+
+srsCARD *srsCard_GetAllAt(srsMODEL *model, const char *deck_name, size_t *count_out)
 {
   bool ok = false;
-  srsMEMSTACK list = {0};
-  const char *root_path = NULL;
-  const char *deck_path = NULL;
+  srsCARD_LIST list = {0};
+  srsCARD *cards = NULL;
+  srsCARD_CURSOR *cursor = NULL;
+  srsSNAPSHOT *snapshot = NULL;
+  srsCARD card = {0};
+  char path[srsPATH_MAX + 1];
 
   /* Check API state */
-  if (srsModel_GetRoot() == NULL)
+  if (srsModel_GetRootAt(model) == NULL)
   {
     srsERROR_SET(srsE_API, "Model Root not set!");
     return false;
@@ -97,58 +478,217 @@ srsCARD *srsCard_GetAll(const char *deck_name, size_t *count_out)
     srsERROR_SET(srsFAIL, "Invalid deck name");
     goto done;
   }
-
-  /* Open model root */
-  root_path = srsDir_PushCWD(srsModel_GetRoot());
-  if (root_path == NULL)
+  /* Names like ".." or a link out of the root pass the name check, and neither copy nor snapshot may be taken of a deck outside it */
+  if (!srsModel_ExistsInRootAt(model, deck_name))
   {
-    srsERROR_SET(srsFAIL, "Unable to set CWD to model root");
+    srsERROR_SET(srsFAIL, "Deck does not exist");
     goto done;
   }
 
-  /* Try to open deck */
-  if (!srsModel_ExistsInRoot(deck_name))
+  /* A deck kept in memory is copied from there */
+  if (srsModel_Deck_ForEachCardAt(model, deck_name, srsCard_GetAll_Copy, &list))
   {
-    srsERROR_SET(srsFAIL, "Deck does not exist");
+    ok = true;
     goto done;
   }
-  deck_path = srsDir_PushCWD(deck_name);
-  if (deck_path == NULL)
+
+  /* The deck's snapshot already holds every card's times, so none of their files need to be read */
+  snapshot = srsSnapshot_OpenAt(model, deck_name);
+  if (snapshot != NULL)
   {
-    srsERROR_SET(srsFAIL, "Unable to push CWD");
+    size_t count = srsSnapshot_GetCount(snapshot);
+    srsCardList_Reserve(&list, count);
+    for (size_t i = 0; i < count; i++)
+    {
+      if (!srsCard_FromSnapshot(snapshot, i, &card, path, sizeof(path)))
+      {
+        continue;
+      }
+      card.id = strdup(card.id);
+      card.path = strdup(card.path);
+      srsASSERT(card.id != NULL);
+      srsASSERT(card.path != NULL);
+      bool pushed = srsCardList_Push(&list, card);
+      srsASSERT(pushed);
+    }
+    ok = true;
     goto done;
   }
 
-  /* Check for cards */
-  if (!srsDir_Exists("cards"))
+  cursor = srsCardCursor_Create(model, deck_name, NULL);
+  if (cursor == NULL)
   {
-    srsERROR_SET(srsFAIL, "Deck path does not contain a cards directory");
     goto done;
   }
 
   /* List cards */
-  srsMemStack_Init(&list, sizeof(srsCARD), 16);
-  ok = srsFileSystem_Iterate("cards", (void *)&list, get_cards);
+  while (srsCardCursor_Next(cursor, &card))
+  {
+    card.id = strdup(card.id);
+    card.path = strdup(card.path);
+    srsASSERT(card.id != NULL);
+    srsASSERT(card.path != NULL);
+    bool pushed = srsCardList_Push(&list, card);
+    srsASSERT(pushed);
+  }
+  ok = !srsCardCursor_HasFailed(cursor);
 
 done:
-  if (root_path != NULL)
+  srsSnapshot_Close(snapshot);
+  srsCardCursor_Close(cursor);
+  cards = srsCardList_Detach(&list, count_out);
+  if (!ok)
   {
-    srsDir_PopCWD(NULL);
+    srsERROR_LOG();
   }
-  if (deck_path != NULL)
+  return cards;
+}
+
+/**
+ * Returns a list of all cards for a deck.
+ * For large decks prefer @ref srsCardCursor_Open, which does not need to hold every card in memory at once.
+ * @param[in] deck_name Name of the deck to get the cards from.
+ * @param[out] count_out Place to store the number of elements in the returned array.
+ * @return Unmanaged dynamically allocated card array, or NULL if no cards are found.
+ */
+srsCARD *srsCard_GetAll(const char *deck_name, size_t *count_out)
+{
+  return srsCard_GetAllAt(srsModel_GetDefault(), deck_name, count_out);
+}
+
+srsCARD *srsCard_GetAllInArenaAt(srsMODEL *model, const char *deck_name, srsARENA *arena, size_t *count_out)
+{
+  bool ok = false;
+  srsCARD_CURSOR *cursor = NULL;
+  srsSNAPSHOT *snapshot = NULL;
+  srsCARD card = {0};
+  srsCARD *cards = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  char path[srsPATH_MAX + 1];
+  srsARENA_MARK mark = srsArena_GetMark(arena);
+
+  /* Check input */
+  if ((arena == NULL) || (count_out == NULL))
   {
-    srsDir_PopCWD(NULL);
+    srsERROR_SET(srsFAIL, "Arena or count output is NULL");
+    goto done;
   }
-  if (count_out != NULL)
+  if (!srsDeck_IsValidName(deck_name))
   {
-    *count_out = list.count;
+    srsERROR_SET(srsFAIL, "Invalid deck name");
+    goto done;
   }
+  /* Names like ".." or a link out of the root pass the name check, and neither copy nor snapshot may be taken of a deck outside it */
+  if (!srsModel_ExistsInRootAt(model, deck_name))
+  {
+    srsERROR_SET(srsFAIL, "Deck does not exist");
+    goto done;
+  }
+
+  /* A deck kept in memory is copied from there. Should copying fail partway, the arena is rewound before falling back. */
+  if (srsModel_IsResidentAt(model))
+  {
+    srsCARD_ARENA_COPY copy = {.arena = arena, .cards = NULL, .count = 0, .capacity = 0};
+    if (srsModel_Deck_ForEachCardAt(model, deck_name, srsCard_GetAllInArena_Copy, &copy))
+    {
+      cards = copy.cards;
+      count = copy.count;
+      ok = true;
+      goto done;
+    }
+    srsArena_Reset(arena, mark);
+  }
+
+  /* With a snapshot the size is known up front, so the array is allocated once */
+  snapshot = srsSnapshot_OpenAt(model, deck_name);
+  if (snapshot != NULL)
+  {
+    capacity = srsSnapshot_GetCount(snapshot);
+    cards = (capacity == 0) ? NULL : srsArena_Calloc(arena, capacity, sizeof(*cards));
+    if ((cards == NULL) && (capacity > 0))
+    {
+      srsERROR_SET(srsFAIL, "Unable to allocate card array");
+      goto done;
+    }
+    for (size_t i = 0; i < capacity; i++)
+    {
+      if (!srsCard_FromSnapshot(snapshot, i, &card, path, sizeof(path)))
+      {
+        continue;
+      }
+      card.id = srsArena_StrDup(arena, card.id);
+      card.path = srsArena_StrDup(arena, card.path);
+      if ((card.id == NULL) || (card.path == NULL))
+      {
+        srsERROR_SET(srsFAIL, "Unable to copy card");
+        goto done;
+      }
+      cards[count++] = card;
+    }
+    ok = true;
+    goto done;
+  }
+
+  cursor = srsCardCursor_Create(model, deck_name, NULL);
+  if (cursor == NULL)
+  {
+    goto done;
+  }
+
+  /* List cards. The array is interleaved with the strings, so growing it usually moves it, but the copies left behind are bounded by the final size. */
+  while (srsCardCursor_Next(cursor, &card))
+  {
+    if (count == capacity)
+    {
+      size_t grown_capacity = (capacity == 0) ? 16 : capacity * 2;
+      srsCARD *grown = srsArena_Realloc(arena, cards, capacity * sizeof(*cards), grown_capacity * sizeof(*cards));
+      if (grown == NULL)
+      {
+        srsERROR_SET(srsFAIL, "Unable to grow card array");
+        goto done;
+      }
+      cards = grown;
+      capacity = grown_capacity;
+    }
+    card.id = srsArena_StrDup(arena, card.id);
+    card.path = srsArena_StrDup(arena, card.path);
+    if ((card.id == NULL) || (card.path == NULL))
+    {
+      srsERROR_SET(srsFAIL, "Unable to copy card");
+      goto done;
+    }
+    cards[count++] = card;
+  }
+  ok = !srsCardCursor_HasFailed(cursor);
+
+done:
+  srsSnapshot_Close(snapshot);
+  srsCardCursor_Close(cursor);
   if (!ok)
   {
+    srsArena_Reset(arena, mark);
+    cards = NULL;
+    count = 0;
     srsERROR_LOG();
   }
-  /* We can safely lose reference to the list since the internal malloc'd memory will still exist */
-  return list.memory;
+  if (count_out != NULL)
+  {
+    *count_out = count;
+  }
+  return cards;
+}
+
+/**
+ * Returns a list of all cards for a deck, allocating the array and every string in it from an arena.
+ * @param[in] deck_name Name of the deck to get the cards from.
+ * @param[in] arena The arena to allocate from. Nothing is left allocated in it on failure.
+ * @param[out] count_out Place to store the number of elements in the returned array.
+ * @return Card array owned by the arena, or NULL if no cards are found.
+ */
+srsCARD *srsCard_GetAllInArena(const char *deck_name, srsARENA *arena, size_t *count_out)
+{
+  return srsCard_GetAllInArenaAt(srsModel_GetDefault(), deck_name, arena, count_out);
 }
 
 /**
@@ -174,52 +714,73 @@ srsRESULT srsCard_FreeArray(srsCARD *cards, size_t count)
 }
 
 /**
- * Returns the content of a file associated with the specified card.
+ * Maps a file associated with the specified card without copying it.
  * @param[in] card The card.
  * @param[in] file The filename to find relative to the card's directory.
- * @return Unmanaged dynamically allocated text of a file for the specified card. Returns NULL if the file doesn't exist relative to the card directory.
+ * @param[out] view_out Receives the view of the file. It must be released with @ref srsFile_Unmap when this succeeds.
+ * @return Whether the file could be mapped. Fails if the file doesn't exist relative to the card directory.
  */
-char *srsCard_GetContent(srsCARD card, const char *file)
+bool srsCard_MapContent(srsCARD card, const char *file, srsFILE_VIEW *view_out)
 {
   bool ok = false;
-  size_t content_size = 0;
-  char *content = NULL;
-  const char *cwd = srsDir_PushCWD(card.path);
-  if (cwd == NULL)
+  char filepath[srsPATH_MAX + 1] = {0};
+  int32_t needed = 0;
+  if (file == NULL)
   {
-    srsERROR_SET(srsFAIL, "Unable to navigate to card path");
+    srsERROR_SET(srsFAIL, "File is NULL");
     goto done;
   }
-  if (!srsFile_Exists(file))
+  if (view_out == NULL)
   {
-    srsERROR_SET(srsFAIL, "File does not exist");
+    srsERROR_SET(srsFAIL, "View output is NULL");
     goto done;
   }
-  content_size = srsFile_GetLength(file) + 1;
-  if (content_size <= 0)
+  /* Card paths are absolute, so the file can be addressed directly without navigating to it */
+  needed = kioku_path_concat(filepath, sizeof(filepath), card.path, file);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(filepath)))
   {
-    srsERROR_SET(srsFAIL, "Empty file");
+    srsERROR_SET(srsFAIL, "Unable to build path to card file");
     goto done;
   }
-  content = malloc(content_size);
-  if (content == NULL)
-  {
-    srsERROR_SET(srsFAIL, "Unable to allocate enough memory for file content");
-    goto done;
-  }
-  ok = srsFile_GetContent(file, content, content_size);
+  ok = srsFile_Map(filepath, view_out);
   if (!ok)
   {
-    srsERROR_SET(srsFAIL, "Unable to get file contents");
+    srsERROR_SET(srsFAIL, "Unable to map card file");
     goto done;
   }
 done:
   if (!ok)
   {
     srsERROR_LOG();
-    free(content);
-    content = NULL;
   }
-  srsDir_PopCWD(NULL);
+  return ok;
+}
+
+/**
+ * Returns the content of a file associated with the specified card.
+ * @param[in] card The card.
+ * @param[in] file The filename to find relative to the card's directory.
+ * @return Unmanaged dynamically allocated text of a file for the specified card. Returns NULL if the file doesn't exist relative to the card directory.
+ */
+char *srsCard_GetContent(srsCARD card, const char *file)
+{
+  char *content = NULL;
+  srsFILE_VIEW view = {0};
+  if (!srsCard_MapContent(card, file, &view))
+  {
+    return NULL;
+  }
+  content = malloc(view.size + 1);
+  if (content == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to allocate enough memory for file content");
+    srsERROR_LOG();
+  }
+  else
+  {
+    memcpy(content, view.data, view.size);
+    content[view.size] = kiokuCHAR_NULL;
+  }
+  srsFile_Unmap(&view);
   return content;
 }
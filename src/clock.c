@@ -0,0 +1,98 @@
+#include "kioku/clock.h"
+#include "kioku/thread.h"
+
+#include <time.h>
+
+#define srsCLOCK_MINUTES_PER_DAY 1440
+/* Days from 1900-01-01, where packed times begin, to 1970-01-01 */
+#define srsCLOCK_UNIX_EPOCH_DAYS 25567
+/* Days from 1900-01-01 to 10000-01-01, the first day too late to pack */
+#define srsCLOCK_PACKED_DAYS 2958464
+
+/* The cached offset and the Unix time it expires at. Nothing is cached while that is 0. */
+static srsSPINLOCK srsClock_LOCK = srsSPINLOCK_INIT;
+static int32_t srsClock_UTC_OFFSET = 0;
+static int64_t srsClock_EXPIRES = 0;
+
+/* Finds the offset the way localtime_r applies it, comparing the fields of the local and UTC times of the same moment */
+static int32_t srsClock_LookUpUTCOffset(time_t utc)
+{
+  struct tm local;
+  struct tm universal;
+#ifdef kiokuOS_WINDOWS
+  bool ok = (localtime_s(&local, &utc) == 0) && (gmtime_s(&universal, &utc) == 0);
+#else
+  bool ok = (localtime_r(&utc, &local) != NULL) && (gmtime_r(&utc, &universal) != NULL);
+#endif
+  if (!ok)
+  {
+    return 0;
+  }
+  /* The two are never more than a day apart, so a different year means the turn of the year lies between them */
+  int32_t days = (local.tm_year == universal.tm_year) ? (local.tm_yday - universal.tm_yday) : ((local.tm_year > universal.tm_year) ? 1 : -1);
+  return days * srsCLOCK_MINUTES_PER_DAY + (local.tm_hour - universal.tm_hour) * 60 + (local.tm_min - universal.tm_min);
+}
+
+static int32_t srsClock_GetUTCOffsetAt(int64_t utc)
+{
+  srsSpinLock_Lock(&srsClock_LOCK);
+  bool cached = (utc < srsClock_EXPIRES);
+  int32_t utc_offset = srsClock_UTC_OFFSET;
+  srsSpinLock_Unlock(&srsClock_LOCK);
+  if (cached)
+  {
+    return utc_offset;
+  }
+  utc_offset = srsClock_LookUpUTCOffset((time_t)utc);
+  srsSpinLock_Lock(&srsClock_LOCK);
+  srsClock_UTC_OFFSET = utc_offset;
+  srsClock_EXPIRES = (utc / srsCLOCK_REFRESH_SECONDS + 1) * srsCLOCK_REFRESH_SECONDS;
+  srsSpinLock_Unlock(&srsClock_LOCK);
+  return utc_offset;
+}
+
+int32_t srsClock_GetUTCOffset()
+{
+  return srsClock_GetUTCOffsetAt((int64_t)time(NULL));
+}
+
+srsTIME_PACKED srsClock_Pack(int64_t utc, int32_t utc_offset)
+{
+  int64_t seconds = utc + (int64_t)utc_offset * 60;
+  /* Round down, also before the Unix epoch */
+  int64_t minutes = ((seconds >= 0) ? (seconds / 60) : ((seconds - 59) / 60)) + (int64_t)srsCLOCK_UNIX_EPOCH_DAYS * srsCLOCK_MINUTES_PER_DAY;
+  if ((minutes < 0) || (minutes >= (int64_t)srsCLOCK_PACKED_DAYS * srsCLOCK_MINUTES_PER_DAY))
+  {
+    return srsTIME_PACKED_NONE;
+  }
+  return (srsTIME_PACKED)(minutes + 1);
+}
+
+srsTIME_PACKED srsClock_Now()
+{
+  int64_t utc = (int64_t)time(NULL);
+  return srsClock_Pack(utc, srsClock_GetUTCOffsetAt(utc));
+}
+
+srsCLOCK_SNAPSHOT srsClock_Capture()
+{
+  srsCLOCK_SNAPSHOT snapshot;
+  snapshot.utc = (int64_t)time(NULL);
+  snapshot.utc_offset = srsClock_GetUTCOffsetAt(snapshot.utc);
+  snapshot.packed = srsClock_Pack(snapshot.utc, snapshot.utc_offset);
+  snapshot.time = srsTime_Unpack(snapshot.packed);
+  return snapshot;
+}
+
+void srsClock_Refresh()
+{
+  /* localtime_r need not notice a change of time zone by itself */
+#ifdef kiokuOS_WINDOWS
+  _tzset();
+#else
+  tzset();
+#endif
+  srsSpinLock_Lock(&srsClock_LOCK);
+  srsClock_EXPIRES = 0;
+  srsSpinLock_Unlock(&srsClock_LOCK);
+}
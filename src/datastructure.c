@@ -3,6 +3,7 @@
 #include "kioku/datastructure.h"
 #include <stdlib.h>
 #include <memory.h>
+#include <string.h>
 
 static void *srsMemStack_ElementPointerByNumber(srsMEMSTACK *stack, size_t count)
 {
@@ -236,3 +237,968 @@ done:
   }
   return result;
 }
+
+bool srsVector_SetCapacity(void **data, size_t *capacity, void *inline_data, size_t inline_capacity, size_t count, size_t element_size, size_t new_capacity)
+{
+  bool is_inline = (*data == NULL) || (*data == inline_data);
+  void *memory = NULL;
+  srsASSERT(count <= new_capacity);
+  if (new_capacity <= inline_capacity)
+  {
+    /* Move back into the inline storage, which is always at its full capacity */
+    if (!is_inline)
+    {
+      memcpy(inline_data, *data, count * element_size);
+      free(*data);
+    }
+    *data = inline_data;
+    *capacity = inline_capacity;
+    return true;
+  }
+  if (new_capacity > SIZE_MAX / element_size)
+  {
+    return false;
+  }
+  memory = is_inline ? malloc(new_capacity * element_size) : realloc(*data, new_capacity * element_size);
+  if (memory == NULL)
+  {
+    srsLOG_ERROR("Failed to resize vector to %zu elements of %zu bytes", new_capacity, element_size);
+    return false;
+  }
+  if (is_inline && (count > 0))
+  {
+    memcpy(memory, inline_data, count * element_size);
+  }
+  *data = memory;
+  *capacity = new_capacity;
+  return true;
+}
+
+struct _srsARENA_CHUNK_s
+{
+  srsARENA_CHUNK *prev;
+  size_t capacity; /* Bytes available after the header */
+};
+
+static size_t srsArena_AlignUp(size_t size)
+{
+  return (size + srsARENA_ALIGNMENT - 1) & ~((size_t)srsARENA_ALIGNMENT - 1);
+}
+
+static uint8_t *srsArena_ChunkData(srsARENA_CHUNK *chunk)
+{
+  return ((uint8_t *)chunk) + srsArena_AlignUp(sizeof(*chunk));
+}
+
+/* Hands a chunk that is no longer in use back, keeping the largest one around as the spare */
+static void srsArena_ReleaseChunk(srsARENA *arena, srsARENA_CHUNK *chunk)
+{
+  if ((arena->spare == NULL) || (chunk->capacity > arena->spare->capacity))
+  {
+    free(arena->spare);
+    arena->spare = chunk;
+  }
+  else
+  {
+    free(chunk);
+  }
+}
+
+static bool srsArena_AddChunk(srsARENA *arena, size_t needed)
+{
+  srsARENA_CHUNK *chunk = NULL;
+  size_t capacity = arena->chunk_size;
+  if (arena->chunk != NULL)
+  {
+    capacity = (arena->chunk->capacity > SIZE_MAX / 4) ? arena->chunk->capacity : arena->chunk->capacity * 2;
+  }
+  if (capacity < needed)
+  {
+    capacity = needed;
+  }
+  if ((arena->spare != NULL) && (arena->spare->capacity >= needed))
+  {
+    chunk = arena->spare;
+    arena->spare = NULL;
+  }
+  else
+  {
+    if (capacity > SIZE_MAX - srsArena_AlignUp(sizeof(*chunk)))
+    {
+      return false;
+    }
+    chunk = malloc(srsArena_AlignUp(sizeof(*chunk)) + capacity);
+    if (chunk == NULL)
+    {
+      srsLOG_ERROR("Failed to allocate arena chunk of %zu bytes", capacity);
+      return false;
+    }
+    chunk->capacity = capacity;
+  }
+  chunk->prev = arena->chunk;
+  arena->chunk = chunk;
+  arena->used = 0;
+  return true;
+}
+
+bool srsArena_Init(srsARENA *arena, size_t chunk_size)
+{
+  if (arena == NULL)
+  {
+    return false;
+  }
+  memset(arena, 0, sizeof(*arena));
+  arena->chunk_size = srsArena_AlignUp((chunk_size > 0) ? chunk_size : srsARENA_DEFAULT_CHUNK_SIZE);
+  return true;
+}
+
+void srsArena_Free(srsARENA *arena)
+{
+  srsARENA_MARK empty = {0};
+  if (arena == NULL)
+  {
+    return;
+  }
+  srsArena_Reset(arena, empty);
+  free(arena->spare);
+  memset(arena, 0, sizeof(*arena));
+}
+
+void *srsArena_Alloc(srsARENA *arena, size_t size)
+{
+  void *memory = NULL;
+  if ((arena == NULL) || (arena->chunk_size == 0) || (size > SIZE_MAX - srsARENA_ALIGNMENT))
+  {
+    return NULL;
+  }
+  size = srsArena_AlignUp((size > 0) ? size : 1);
+  if ((arena->chunk == NULL) || (size > arena->chunk->capacity - arena->used))
+  {
+    if (!srsArena_AddChunk(arena, size))
+    {
+      return NULL;
+    }
+  }
+  memory = srsArena_ChunkData(arena->chunk) + arena->used;
+  arena->used += size;
+  arena->last = memory;
+  return memory;
+}
+
+void *srsArena_Calloc(srsARENA *arena, size_t count, size_t size)
+{
+  void *memory = NULL;
+  if ((size > 0) && (count > SIZE_MAX / size))
+  {
+    return NULL;
+  }
+  memory = srsArena_Alloc(arena, count * size);
+  if (memory != NULL)
+  {
+    memset(memory, 0, count * size);
+  }
+  return memory;
+}
+
+void *srsArena_Realloc(srsARENA *arena, void *memory, size_t old_size, size_t new_size)
+{
+  void *moved = NULL;
+  if ((arena == NULL) || (memory == NULL))
+  {
+    return srsArena_Alloc(arena, new_size);
+  }
+  /* The last allocation has nothing after it in its chunk, so it can simply be extended */
+  if ((memory == arena->last) && (arena->chunk != NULL))
+  {
+    size_t start = (size_t)((uint8_t *)memory - srsArena_ChunkData(arena->chunk));
+    if (new_size <= arena->chunk->capacity - start)
+    {
+      arena->used = start + srsArena_AlignUp((new_size > 0) ? new_size : 1);
+      return memory;
+    }
+  }
+  moved = srsArena_Alloc(arena, new_size);
+  if (moved != NULL)
+  {
+    memcpy(moved, memory, (old_size < new_size) ? old_size : new_size);
+  }
+  return moved;
+}
+
+char *srsArena_StrDup(srsARENA *arena, const char *string)
+{
+  char *copy = NULL;
+  if (string == NULL)
+  {
+    return NULL;
+  }
+  size_t size = strlen(string) + 1;
+  copy = srsArena_Alloc(arena, size);
+  if (copy != NULL)
+  {
+    memcpy(copy, string, size);
+  }
+  return copy;
+}
+
+bool srsArena_Owns(const srsARENA *arena, const void *memory)
+{
+  srsARENA_CHUNK *chunk = NULL;
+  if ((arena == NULL) || (memory == NULL))
+  {
+    return false;
+  }
+  for (chunk = arena->chunk; chunk != NULL; chunk = chunk->prev)
+  {
+    const uint8_t *data = srsArena_ChunkData(chunk);
+    size_t used = (chunk == arena->chunk) ? arena->used : chunk->capacity;
+    if (((const uint8_t *)memory >= data) && ((const uint8_t *)memory < data + used))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+srsARENA_MARK srsArena_GetMark(const srsARENA *arena)
+{
+  srsARENA_MARK mark = {0};
+  if (arena != NULL)
+  {
+    mark.chunk = arena->chunk;
+    mark.used = arena->used;
+  }
+  return mark;
+}
+
+void srsArena_Reset(srsARENA *arena, srsARENA_MARK mark)
+{
+  if (arena == NULL)
+  {
+    return;
+  }
+  while ((arena->chunk != NULL) && (arena->chunk != mark.chunk))
+  {
+    srsARENA_CHUNK *chunk = arena->chunk;
+    arena->chunk = chunk->prev;
+    srsArena_ReleaseChunk(arena, chunk);
+  }
+  arena->used = (arena->chunk == NULL) ? 0 : mark.used;
+  arena->last = NULL;
+}
+
+/* A slot is empty while its distance is 0. Otherwise the distance is one more than how far it lies past its home slot. Entries removed from a table that is being moved out of keep their distance but lose their key, so probing past them still works. */
+struct _srsHASHMAP_SLOT_s
+{
+  const char *key;
+  void *value;
+  uint32_t hash;
+  uint32_t distance;
+};
+
+/* FNV-1a, with the finalizer of MurmurHash3 so that the low bits used to pick a slot depend on every byte */
+static uint32_t srsHashMap_Hash(const char *key)
+{
+  uint32_t hash = 2166136261u;
+  for (const uint8_t *c = (const uint8_t *)key; *c != 0; c++)
+  {
+    hash = (hash ^ *c) * 16777619u;
+  }
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35u;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+static srsHASHMAP_SLOT *srsHashMap_FindIn(srsHASHMAP_SLOT *slots, size_t capacity, const char *key, uint32_t hash)
+{
+  size_t mask = capacity - 1;
+  size_t i = hash & mask;
+  uint32_t distance = 1;
+  if (slots == NULL)
+  {
+    return NULL;
+  }
+  /* An entry would have displaced any slot closer to its home than it, so reaching one means it is not there */
+  while (slots[i].distance >= distance)
+  {
+    if ((slots[i].hash == hash) && (slots[i].key != NULL) && (strcmp(slots[i].key, key) == 0))
+    {
+      return &slots[i];
+    }
+    distance++;
+    i = (i + 1) & mask;
+  }
+  return NULL;
+}
+
+static srsHASHMAP_SLOT *srsHashMap_Find(const srsHASHMAP *map, const char *key, uint32_t hash)
+{
+  srsHASHMAP_SLOT *slot = srsHashMap_FindIn(map->slots, map->capacity, key, hash);
+  return (slot != NULL) ? slot : srsHashMap_FindIn(map->old_slots, map->old_capacity, key, hash);
+}
+
+/* Places an entry that is in neither table, taking the slot of any entry nearer its home than the one being placed */
+static void srsHashMap_Place(srsHASHMAP *map, const char *key, void *value, uint32_t hash)
+{
+  size_t mask = map->capacity - 1;
+  size_t i = hash & mask;
+  srsHASHMAP_SLOT incoming = {key, value, hash, 1};
+  while (map->slots[i].distance != 0)
+  {
+    if (map->slots[i].distance < incoming.distance)
+    {
+      srsHASHMAP_SLOT displaced = map->slots[i];
+      map->slots[i] = incoming;
+      incoming = displaced;
+    }
+    incoming.distance++;
+    i = (i + 1) & mask;
+  }
+  map->slots[i] = incoming;
+  map->used++;
+}
+
+static void srsHashMap_Migrate(srsHASHMAP *map, size_t steps)
+{
+  while ((map->old_slots != NULL) && (steps-- > 0))
+  {
+    if (map->migrated == map->old_capacity)
+    {
+      free(map->old_slots);
+      map->old_slots = NULL;
+      map->old_capacity = 0;
+      map->migrated = 0;
+      break;
+    }
+    srsHASHMAP_SLOT *slot = &map->old_slots[map->migrated++];
+    if ((slot->distance != 0) && (slot->key != NULL))
+    {
+      srsHashMap_Place(map, slot->key, slot->value, slot->hash);
+      slot->key = NULL;
+    }
+  }
+}
+
+static bool srsHashMap_Allocate(srsHASHMAP *map, size_t capacity)
+{
+  srsHASHMAP_SLOT *slots = calloc(capacity, sizeof(*slots));
+  if (slots == NULL)
+  {
+    srsLOG_ERROR("Failed to allocate hash map of %zu slots", capacity);
+    return false;
+  }
+  map->old_slots = map->slots;
+  map->old_capacity = (map->slots == NULL) ? 0 : map->capacity;
+  map->migrated = 0;
+  map->slots = slots;
+  map->capacity = capacity;
+  map->used = 0;
+  return true;
+}
+
+/* Makes sure one more entry fits in the current table, starting to grow if it would not */
+static bool srsHashMap_MakeRoom(srsHASHMAP *map)
+{
+  if ((map->used + 1) * 100 <= map->capacity * srsHASHMAP_MAX_LOAD_PERCENT)
+  {
+    return true;
+  }
+  /* A table twice the size normally holds everything before the old one is empty, but finish moving out of it before moving again */
+  srsHashMap_Migrate(map, SIZE_MAX);
+  if ((map->used + 1) * 100 <= map->capacity * srsHASHMAP_MAX_LOAD_PERCENT)
+  {
+    return true;
+  }
+  if (map->capacity > SIZE_MAX / 2 / sizeof(srsHASHMAP_SLOT))
+  {
+    return false;
+  }
+  return srsHashMap_Allocate(map, map->capacity * 2);
+}
+
+bool srsHashMap_Init(srsHASHMAP *map, size_t capacity)
+{
+  size_t slots = srsHASHMAP_MINIMUM_CAPACITY;
+  if (map == NULL)
+  {
+    return false;
+  }
+  memset(map, 0, sizeof(*map));
+  while ((slots * srsHASHMAP_MAX_LOAD_PERCENT / 100 < capacity) && (slots <= SIZE_MAX / 4 / sizeof(srsHASHMAP_SLOT)))
+  {
+    slots *= 2;
+  }
+  srsArena_Init(&map->keys, 0);
+  if (!srsHashMap_Allocate(map, slots))
+  {
+    srsHashMap_Free(map);
+    return false;
+  }
+  return true;
+}
+
+void srsHashMap_Free(srsHASHMAP *map)
+{
+  if (map == NULL)
+  {
+    return;
+  }
+  free(map->slots);
+  free(map->old_slots);
+  srsArena_Free(&map->keys);
+  memset(map, 0, sizeof(*map));
+}
+
+static srsHASHMAP_SLOT *srsHashMap_Insert(srsHASHMAP *map, const char *key, void *value)
+{
+  if ((map == NULL) || (map->slots == NULL) || (key == NULL))
+  {
+    return NULL;
+  }
+  uint32_t hash = srsHashMap_Hash(key);
+  srsHashMap_Migrate(map, srsHASHMAP_MIGRATE_STEP);
+  srsHASHMAP_SLOT *slot = srsHashMap_FindIn(map->slots, map->capacity, key, hash);
+  if (slot != NULL)
+  {
+    slot->value = value;
+    return slot;
+  }
+  /* An entry still in the old table is moved over now, keeping its key */
+  srsHASHMAP_SLOT *old_slot = srsHashMap_FindIn(map->old_slots, map->old_capacity, key, hash);
+  const char *interned = (old_slot == NULL) ? NULL : old_slot->key;
+  if (old_slot != NULL)
+  {
+    old_slot->key = NULL;
+  }
+  if (!srsHashMap_MakeRoom(map))
+  {
+    if (old_slot != NULL)
+    {
+      old_slot->key = interned;
+    }
+    return NULL;
+  }
+  if (interned == NULL)
+  {
+    interned = srsArena_StrDup(&map->keys, key);
+    if (interned == NULL)
+    {
+      return NULL;
+    }
+    map->count++;
+  }
+  srsHashMap_Place(map, interned, value, hash);
+  return srsHashMap_FindIn(map->slots, map->capacity, interned, hash);
+}
+
+bool srsHashMap_Set(srsHASHMAP *map, const char *key, void *value)
+{
+  return srsHashMap_Insert(map, key, value) != NULL;
+}
+
+bool srsHashMap_Get(const srsHASHMAP *map, const char *key, void **value_out)
+{
+  if ((map == NULL) || (key == NULL))
+  {
+    return false;
+  }
+  srsHASHMAP_SLOT *slot = srsHashMap_Find(map, key, srsHashMap_Hash(key));
+  if ((slot != NULL) && (value_out != NULL))
+  {
+    *value_out = slot->value;
+  }
+  return slot != NULL;
+}
+
+bool srsHashMap_Remove(srsHASHMAP *map, const char *key)
+{
+  if ((map == NULL) || (map->slots == NULL) || (key == NULL))
+  {
+    return false;
+  }
+  uint32_t hash = srsHashMap_Hash(key);
+  srsHashMap_Migrate(map, srsHASHMAP_MIGRATE_STEP);
+  srsHASHMAP_SLOT *slot = srsHashMap_FindIn(map->slots, map->capacity, key, hash);
+  if (slot != NULL)
+  {
+    /* Shift the rest of the run back a slot, so that no entry is left further from home than it needs to be */
+    size_t mask = map->capacity - 1;
+    size_t i = (size_t)(slot - map->slots);
+    size_t next = (i + 1) & mask;
+    while (map->slots[next].distance > 1)
+    {
+      map->slots[i] = map->slots[next];
+      map->slots[i].distance--;
+      i = next;
+      next = (i + 1) & mask;
+    }
+    memset(&map->slots[i], 0, sizeof(map->slots[i]));
+    map->used--;
+    map->count--;
+    return true;
+  }
+  slot = srsHashMap_FindIn(map->old_slots, map->old_capacity, key, hash);
+  if (slot != NULL)
+  {
+    slot->key = NULL;
+    map->count--;
+    return true;
+  }
+  return false;
+}
+
+const char *srsHashMap_Intern(srsHASHMAP *map, const char *key)
+{
+  if ((map == NULL) || (key == NULL))
+  {
+    return NULL;
+  }
+  srsHASHMAP_SLOT *slot = srsHashMap_Find(map, key, srsHashMap_Hash(key));
+  if (slot == NULL)
+  {
+    slot = srsHashMap_Insert(map, key, NULL);
+  }
+  return (slot == NULL) ? NULL : slot->key;
+}
+
+size_t srsHashMap_GetCount(const srsHASHMAP *map)
+{
+  return (map == NULL) ? 0 : map->count;
+}
+
+struct _srsMPMC_QUEUE_CELL_s
+{
+  srsATOMIC32 sequence;
+  void *value;
+};
+
+bool srsMPMCQueue_Init(srsMPMC_QUEUE *queue, uint32_t capacity)
+{
+  uint32_t size = 2;
+  uint32_t i = 0;
+  if ((queue == NULL) || (capacity < 2) || (capacity > (UINT32_C(1) << 30)))
+  {
+    return false;
+  }
+  memset(queue, 0, sizeof(*queue));
+  while (size < capacity)
+  {
+    size *= 2;
+  }
+  queue->cells = malloc(size * sizeof(*queue->cells));
+  if (queue->cells == NULL)
+  {
+    return false;
+  }
+  /* A cell is ready for the push at the position equal to its sequence, and for the pop when its sequence is one past that */
+  for (i = 0; i < size; i++)
+  {
+    srsAtomic_Store(&queue->cells[i].sequence, (int32_t)i);
+    queue->cells[i].value = NULL;
+  }
+  queue->mask = size - 1;
+  srsAtomic_Store(&queue->push_position, 0);
+  srsAtomic_Store(&queue->pop_position, 0);
+  return true;
+}
+
+void srsMPMCQueue_Free(srsMPMC_QUEUE *queue)
+{
+  if (queue == NULL)
+  {
+    return;
+  }
+  free(queue->cells);
+  memset(queue, 0, sizeof(*queue));
+}
+
+/* Positions wrap around, so they are only ever compared by the sign of their difference */
+static int32_t srsMPMCQueue_Distance(int32_t sequence, uint32_t position)
+{
+  return (int32_t)((uint32_t)sequence - position);
+}
+
+bool srsMPMCQueue_Push(srsMPMC_QUEUE *queue, void *value)
+{
+  if ((queue == NULL) || (queue->cells == NULL))
+  {
+    return false;
+  }
+  uint32_t position = (uint32_t)srsAtomic_Load(&queue->push_position);
+  for (;;)
+  {
+    srsMPMC_QUEUE_CELL *cell = &queue->cells[position & queue->mask];
+    int32_t distance = srsMPMCQueue_Distance(srsAtomic_Load(&cell->sequence), position);
+    if (distance == 0)
+    {
+      if (srsAtomic_CompareExchange(&queue->push_position, (int32_t)position, (int32_t)(position + 1)))
+      {
+        cell->value = value;
+        srsAtomic_Store(&cell->sequence, (int32_t)(position + 1));
+        return true;
+      }
+    }
+    else if (distance < 0)
+    {
+      /* The cell still holds the value pushed a lap ago */
+      return false;
+    }
+    /* Another producer got there first */
+    position = (uint32_t)srsAtomic_Load(&queue->push_position);
+  }
+}
+
+bool srsMPMCQueue_Pop(srsMPMC_QUEUE *queue, void **value_out)
+{
+  if ((queue == NULL) || (queue->cells == NULL) || (value_out == NULL))
+  {
+    return false;
+  }
+  uint32_t position = (uint32_t)srsAtomic_Load(&queue->pop_position);
+  for (;;)
+  {
+    srsMPMC_QUEUE_CELL *cell = &queue->cells[position & queue->mask];
+    int32_t distance = srsMPMCQueue_Distance(srsAtomic_Load(&cell->sequence), position + 1);
+    if (distance == 0)
+    {
+      if (srsAtomic_CompareExchange(&queue->pop_position, (int32_t)position, (int32_t)(position + 1)))
+      {
+        *value_out = cell->value;
+        /* Ready for the push a lap later */
+        srsAtomic_Store(&cell->sequence, (int32_t)(position + queue->mask + 1));
+        return true;
+      }
+    }
+    else if (distance < 0)
+    {
+      /* Nothing has been pushed to the cell yet */
+      return false;
+    }
+    position = (uint32_t)srsAtomic_Load(&queue->pop_position);
+  }
+}
+
+uint32_t srsMPMCQueue_GetCapacity(const srsMPMC_QUEUE *queue)
+{
+  return ((queue == NULL) || (queue->cells == NULL)) ? 0 : queue->mask + 1;
+}
+
+/* Slabs are a header followed by their objects */
+struct _srsPOOL_SLAB_s
+{
+  srsPOOL_SLAB *next;
+};
+
+/* Released objects cached by one thread for one pool. They are linked through their first bytes. */
+typedef struct _srsPOOL_CACHE_s
+{
+  int32_t serial;
+  uint32_t count;
+  void *head;
+} srsPOOL_CACHE;
+
+static srsTHREADLOCAL srsPOOL_CACHE srsPool_CACHES[srsPOOL_CACHES_MAX];
+static srsSPINLOCK srsPool_CACHES_LOCK = srsSPINLOCK_INIT;
+/* The pool using each cache, so that a thread's caches can be given back when it exits */
+static srsPOOL *srsPool_CACHE_OWNERS[srsPOOL_CACHES_MAX];
+static srsATOMIC32 srsPool_SERIAL = 0;
+static srsTHREADLOCAL bool srsPool_EXIT_WATCHED = false;
+
+static size_t srsPool_GetStride(const srsPOOL *pool)
+{
+  return srsArena_AlignUp((pool->object_size < sizeof(void *)) ? sizeof(void *) : pool->object_size);
+}
+
+static void *srsPool_Next(void *object)
+{
+  void *next = NULL;
+  memcpy(&next, object, sizeof(next));
+  return next;
+}
+
+static void srsPool_SetNext(void *object, void *next)
+{
+  memcpy(object, &next, sizeof(next));
+}
+
+void srsPool_Init(srsPOOL *pool, size_t object_size)
+{
+  if (pool != NULL)
+  {
+    *pool = (srsPOOL)srsPOOL_INIT(object_size);
+  }
+}
+
+/* Gives a pool its serial, and a cache if one is free, the first time it is used */
+static int32_t srsPool_GetSerial(srsPOOL *pool)
+{
+  int32_t serial = srsAtomic_Load(&pool->serial);
+  if (serial != 0)
+  {
+    return serial;
+  }
+  srsSpinLock_Lock(&pool->lock);
+  serial = srsAtomic_Load(&pool->serial);
+  if (serial == 0)
+  {
+    int32_t i = 0;
+    srsSpinLock_Lock(&srsPool_CACHES_LOCK);
+    for (i = 0; (i < srsPOOL_CACHES_MAX) && (srsPool_CACHE_OWNERS[i] != NULL); i++)
+    {
+    }
+    if (i < srsPOOL_CACHES_MAX)
+    {
+      srsPool_CACHE_OWNERS[i] = pool;
+      pool->cache = i;
+    }
+    /* Serials only need to differ between pools that share a cache in turn, so wrapping around after billions is harmless. 0 is skipped. */
+    do
+    {
+      serial = srsAtomic_Add(&srsPool_SERIAL, 1);
+    } while (serial == 0);
+    srsAtomic_Store(&pool->serial, serial);
+    srsSpinLock_Unlock(&srsPool_CACHES_LOCK);
+  }
+  srsSpinLock_Unlock(&pool->lock);
+  return serial;
+}
+
+/* Runs as a thread exits, giving the objects in its caches back to their pools so that threads that come and go do not strand them */
+static void srsPool_OnThreadExit()
+{
+  for (size_t i = 0; i < srsPOOL_CACHES_MAX; i++)
+  {
+    srsPOOL_CACHE *cache = &srsPool_CACHES[i];
+    if (cache->head == NULL)
+    {
+      continue;
+    }
+    /* Holding the caches' lock keeps the pool from being freed meanwhile. A pool only takes it after its own lock before it has a cache, so this cannot deadlock. */
+    srsSpinLock_Lock(&srsPool_CACHES_LOCK);
+    srsPOOL *pool = srsPool_CACHE_OWNERS[i];
+    if ((pool != NULL) && (srsAtomic_Load(&pool->serial) == cache->serial))
+    {
+      void *last = cache->head;
+      while (srsPool_Next(last) != NULL)
+      {
+        last = srsPool_Next(last);
+      }
+      srsSpinLock_Lock(&pool->lock);
+      srsPool_SetNext(last, pool->free_list);
+      pool->free_list = cache->head;
+      srsSpinLock_Unlock(&pool->lock);
+    }
+    srsSpinLock_Unlock(&srsPool_CACHES_LOCK);
+    cache->head = NULL;
+    cache->count = 0;
+  }
+}
+
+#ifdef kiokuOS_WINDOWS
+static INIT_ONCE srsPool_EXIT_ONCE = INIT_ONCE_STATIC_INIT;
+static DWORD srsPool_EXIT_KEY = FLS_OUT_OF_INDEXES;
+
+static void WINAPI srsPool_OnExitKey(void *value)
+{
+  if (value != NULL)
+  {
+    srsPool_OnThreadExit();
+  }
+}
+
+static BOOL CALLBACK srsPool_InitExitKey(PINIT_ONCE once, PVOID parameter, PVOID *context)
+{
+  (void)once;
+  (void)parameter;
+  (void)context;
+  srsPool_EXIT_KEY = FlsAlloc(srsPool_OnExitKey);
+  return TRUE;
+}
+#else
+static pthread_once_t srsPool_EXIT_ONCE = PTHREAD_ONCE_INIT;
+static pthread_key_t srsPool_EXIT_KEY;
+static bool srsPool_EXIT_KEY_READY = false;
+
+static void srsPool_OnExitKey(void *value)
+{
+  (void)value;
+  srsPool_OnThreadExit();
+}
+
+static void srsPool_InitExitKey()
+{
+  srsPool_EXIT_KEY_READY = (pthread_key_create(&srsPool_EXIT_KEY, srsPool_OnExitKey) == 0);
+}
+#endif
+
+/* Has the calling thread's caches given back when it exits. Objects cached by a thread the key cannot be set for stay with it as before. */
+static void srsPool_WatchThreadExit()
+{
+  if (srsPool_EXIT_WATCHED)
+  {
+    return;
+  }
+  srsPool_EXIT_WATCHED = true;
+#ifdef kiokuOS_WINDOWS
+  InitOnceExecuteOnce(&srsPool_EXIT_ONCE, srsPool_InitExitKey, NULL, NULL);
+  if (srsPool_EXIT_KEY != FLS_OUT_OF_INDEXES)
+  {
+    FlsSetValue(srsPool_EXIT_KEY, (void *)1);
+  }
+#else
+  pthread_once(&srsPool_EXIT_ONCE, srsPool_InitExitKey);
+  if (srsPool_EXIT_KEY_READY)
+  {
+    pthread_setspecific(srsPool_EXIT_KEY, (void *)1);
+  }
+#endif
+}
+
+/* The calling thread's cache for a pool. A cache left behind by a freed pool holds objects that are gone, so it is emptied without touching them. */
+static srsPOOL_CACHE *srsPool_GetCache(srsPOOL *pool)
+{
+  int32_t serial = srsPool_GetSerial(pool);
+  if (pool->cache < 0)
+  {
+    return NULL;
+  }
+  srsPool_WatchThreadExit();
+  srsPOOL_CACHE *cache = &srsPool_CACHES[pool->cache];
+  if (cache->serial != serial)
+  {
+    cache->serial = serial;
+    cache->count = 0;
+    cache->head = NULL;
+  }
+  return cache;
+}
+
+/* Must be called with the pool locked */
+static bool srsPool_AddSlab(srsPOOL *pool)
+{
+  size_t stride = srsPool_GetStride(pool);
+  size_t header = srsArena_AlignUp(sizeof(srsPOOL_SLAB));
+  size_t objects = (stride >= srsPOOL_SLAB_SIZE) ? 1 : (srsPOOL_SLAB_SIZE / stride);
+  size_t i = 0;
+  if (stride > (SIZE_MAX - header) / objects)
+  {
+    return false;
+  }
+  srsPOOL_SLAB *slab = malloc(header + stride * objects);
+  if (slab == NULL)
+  {
+    return false;
+  }
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  /* Linked backwards so that objects are handed out in address order */
+  for (i = objects; i > 0; i--)
+  {
+    void *object = (uint8_t *)slab + header + (i - 1) * stride;
+    srsPool_SetNext(object, pool->free_list);
+    pool->free_list = object;
+  }
+  return true;
+}
+
+void *srsPool_Alloc(srsPOOL *pool)
+{
+  void *object = NULL;
+  if (pool == NULL)
+  {
+    return NULL;
+  }
+  srsPOOL_CACHE *cache = srsPool_GetCache(pool);
+  if ((cache != NULL) && (cache->head != NULL))
+  {
+    object = cache->head;
+    cache->head = srsPool_Next(object);
+    cache->count--;
+    return object;
+  }
+  /* Take one object, and half a cache more while the lock is held anyway */
+  srsSpinLock_Lock(&pool->lock);
+  if ((pool->free_list != NULL) || srsPool_AddSlab(pool))
+  {
+    object = pool->free_list;
+    pool->free_list = srsPool_Next(object);
+    while ((cache != NULL) && (cache->count < srsPOOL_CACHE_SIZE / 2) && (pool->free_list != NULL))
+    {
+      void *cached = pool->free_list;
+      pool->free_list = srsPool_Next(cached);
+      srsPool_SetNext(cached, cache->head);
+      cache->head = cached;
+      cache->count++;
+    }
+  }
+  srsSpinLock_Unlock(&pool->lock);
+  return object;
+}
+
+void srsPool_Release(srsPOOL *pool, void *object)
+{
+  if ((pool == NULL) || (object == NULL))
+  {
+    return;
+  }
+  srsPOOL_CACHE *cache = srsPool_GetCache(pool);
+  if (cache == NULL)
+  {
+    srsSpinLock_Lock(&pool->lock);
+    srsPool_SetNext(object, pool->free_list);
+    pool->free_list = object;
+    srsSpinLock_Unlock(&pool->lock);
+    return;
+  }
+  srsPool_SetNext(object, cache->head);
+  cache->head = object;
+  cache->count++;
+  if (cache->count <= srsPOOL_CACHE_SIZE)
+  {
+    return;
+  }
+  /* Give back the older half, keeping the objects released last, which are likeliest to still be in the CPU cache */
+  void *tail = cache->head;
+  uint32_t kept = 1;
+  for (kept = 1; kept < srsPOOL_CACHE_SIZE / 2; kept++)
+  {
+    tail = srsPool_Next(tail);
+  }
+  void *given = srsPool_Next(tail);
+  void *last = given;
+  while (srsPool_Next(last) != NULL)
+  {
+    last = srsPool_Next(last);
+  }
+  srsPool_SetNext(tail, NULL);
+  cache->count = kept;
+  srsSpinLock_Lock(&pool->lock);
+  srsPool_SetNext(last, pool->free_list);
+  pool->free_list = given;
+  srsSpinLock_Unlock(&pool->lock);
+}
+
+void srsPool_Free(srsPOOL *pool)
+{
+  if (pool == NULL)
+  {
+    return;
+  }
+  /* Given up before the slabs go, so that an exiting thread no longer gives objects back to them */
+  if (pool->cache >= 0)
+  {
+    srsSpinLock_Lock(&srsPool_CACHES_LOCK);
+    srsPool_CACHE_OWNERS[pool->cache] = NULL;
+    srsSpinLock_Unlock(&srsPool_CACHES_LOCK);
+  }
+  while (pool->slabs != NULL)
+  {
+    srsPOOL_SLAB *next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  srsPool_Init(pool, pool->object_size);
+}
@@ -2,14 +2,19 @@
 #include "kioku/filesystem.h"
 #include "kioku/datastructure.h"
 #include "kioku/log.h"
+#include "kioku/thread.h"
+#include "kioku/io.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 
 #ifdef kiokuOS_WINDOWS
 #include <direct.h>
 #include <io.h>
+#include <fcntl.h>
+#include <process.h>
 /* Microsoft (correctly) refuses to recognize a number of functions as being ISO C compliant,
    despite being part of POSIX, and recommends its own standard-compliant name. */
 #define strdup _strdup
@@ -18,28 +23,29 @@
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#endif
+#ifdef kiokuOS_LINUX
+#include <sys/syscall.h>
 #endif
 
-static srsMEMSTACK dirstack = {0};
+/* Paths pushed by srsDir_PushCWD, which rarely nest deeply */
+srsVECTOR_DEFINE(srsDIR_STACK, srsDirStack, char *, 8)
+static srsDIR_STACK dirstack = {0};
 static char *directory_current = NULL;
+/* Guards directory_current, which is read lazily by threads that key caches by it while the CWD stays put */
+static srsSPINLOCK srsDir_CWD_LOCK = srsSPINLOCK_INIT;
+/* The CWD and every path on the stack, which are allocated and released on every push and pop */
+static srsPOOL srsDir_PATH_POOL = srsPOOL_INIT(srsPATH_MAX + 1);
 
 static void ClearDirectoryStack()
 {
-  if (dirstack.memory == NULL)
-  {
-    bool ok = srsMemStack_Init(&dirstack, sizeof(char *), -1);
-    srsASSERT(ok);
-  }
-  size_t i = 0;
   char *string_ptr = NULL;
-  while (dirstack.count > 0)
+  while (srsDirStack_Pop(&dirstack, &string_ptr))
   {
-    srsMemStack_Pop(&dirstack, &string_ptr);
-    if (string_ptr != NULL)
-    {
-      free(string_ptr);
-    }
+    srsPool_Release(&srsDir_PATH_POOL, string_ptr);
   }
 }
 
@@ -94,16 +100,17 @@ bool srsDir_SetSystemCWD(const char *buf)
 
 const char *srsDir_GetCWD()
 {
+  srsSpinLock_Lock(&srsDir_CWD_LOCK);
   if (directory_current == NULL)
   {
-    directory_current = malloc(srsPATH_MAX);
+    directory_current = srsPool_Alloc(&srsDir_PATH_POOL);
     if (directory_current != NULL)
     {
       char *cwd = srsDir_GetSystemCWD(directory_current, srsPATH_MAX);
       if (cwd != directory_current || cwd == NULL)
       {
         srsLOG_ERROR("Failed to get the underlying system CWD when attempting to initialize the API CWD");
-        free(directory_current);
+        srsPool_Release(&srsDir_PATH_POOL, directory_current);
         directory_current = NULL;
       }
     }
@@ -113,7 +120,18 @@ const char *srsDir_GetCWD()
     }
   }
   /** @todo Consider doing a realloc to save a little heap space */
-  return directory_current;
+  const char *result = directory_current;
+  srsSpinLock_Unlock(&srsDir_CWD_LOCK);
+  return result;
+}
+
+/* Frees the current directory so the next call to srsDir_GetCWD regenerates it */
+static void srsDir_ResetCWD()
+{
+  srsSpinLock_Lock(&srsDir_CWD_LOCK);
+  srsPool_Release(&srsDir_PATH_POOL, directory_current);
+  directory_current = NULL;
+  srsSpinLock_Unlock(&srsDir_CWD_LOCK);
 }
 
 const char *srsDir_SetCWD(const char *path)
@@ -121,13 +139,13 @@ const char *srsDir_SetCWD(const char *path)
   /* Clear stack */
   ClearDirectoryStack();
   /* Free the current directory so our next call to srsDir_GetCWD regenerates it */
-  free(directory_current);
-  directory_current = NULL;
+  srsDir_ResetCWD();
   /* Attempt to change the directory, and if it succeeds cause the current directory to be reallocated */
   if ((path != NULL) && srsDir_SetSystemCWD(path))
   {
-    srsLOG_PRINT("Set CWD to %s - Directory Stack has been cleared", directory_current);
-    return srsDir_GetCWD();
+    const char *cwd = srsDir_GetCWD();
+    srsLOG_PRINT("Set CWD to %s - Directory Stack has been cleared", cwd);
+    return cwd;
   }
   /* Failure to do the actual directory changing returns NULL */
   return NULL;
@@ -142,37 +160,27 @@ const char *srsDir_PushCWD(const char *path)
     srsLOG_ERROR("Failed attempt to navigate to invalid directory: %s", path);
     return NULL;
   }
-  /* Initialize the dirstack if it isn't */
-  if (dirstack.memory == NULL)
-  {
-    srsLOG_PRINT("Directory Stack appears to be uninitialized - run srsMemStack_Init");
-    bool ok = srsMemStack_Init(&dirstack, sizeof(char *), -1);
-    srsASSERT(ok);
-    srsASSERT(dirstack.element_size > 0);
-    srsASSERT(dirstack.capacity > 0);
-    srsASSERT(dirstack.memory != NULL);
-  }
   /* Get the current working directory to be pushed (so that a subsequent pop can restore it) */
   cwd = srsDir_GetCWD();
   srsASSERT(cwd != NULL);
   /** TODO Check result of srsDir_GetCWD */
-  char *push_me = strdup(cwd);
-  /** TODO Check result of strdup - not exactly sure how best to handle it. */
+  char *push_me = srsPool_Alloc(&srsDir_PATH_POOL);
+  /** TODO Check result of srsPool_Alloc - not exactly sure how best to handle it. */
   srsASSERT(push_me != NULL);
-  srsASSERT(dirstack.memory != NULL);
+  /* The CWD was read into a buffer of the same size, so it fits */
+  snprintf(push_me, srsPATH_MAX + 1, "%s", cwd);
   /* Try to push the current directory onto the stack before navigating to the new one*/
-  if (!srsMemStack_Push(&dirstack, &push_me))
+  if (!srsDirStack_Push(&dirstack, push_me))
   {
     srsLOG_ERROR("Failed attempt to push directory onto stack: %s", push_me);
-    free(push_me);
+    srsPool_Release(&srsDir_PATH_POOL, push_me);
     return NULL;
   }
   /* Try changing to the directory we're pushing */
   if ((path != NULL) && srsDir_SetSystemCWD(path))
   {
     /* Free the current directory so our next call to srsDir_GetCWD regenerates it */
-    free(directory_current);
-    directory_current = NULL;
+    srsDir_ResetCWD();
     cwd = srsDir_GetCWD();
     srsASSERT(cwd != NULL);
     srsLOG_PRINT("Pushed Directory (%s): CWD = %s", path, cwd);
@@ -180,7 +188,7 @@ const char *srsDir_PushCWD(const char *path)
   else
   {
     srsLOG_PRINT("Failed to change to directory %s - undo change to stack!", path);
-    bool ok = srsMemStack_Pop(&dirstack, NULL);
+    bool ok = srsDirStack_Pop(&dirstack, NULL);
     /* TODO There may be a better way to handle this */
     srsASSERT(ok);
   }
@@ -197,48 +205,45 @@ bool srsDir_PopCWD(char **popped)
 {
   char *change_to = NULL;
   bool popped_to_valid_dir = false;
-  if (dirstack.memory == NULL)
-  {
-    srsLOG_PRINT("Initializing memory stack before popping, perhaps against our better judgement...");
-    bool ok = srsMemStack_Init(&dirstack, sizeof(char *), -1);
-    srsASSERT(ok);
-  }
   /* Perform the following until we pop to a valid directory */
   while (!popped_to_valid_dir)
   {
     /* If the new top of the stack is NULL, it means we ran out of directories to try changing to, so we break from the loop */
-    if (dirstack.top == NULL)
+    if (srsDirStack_Top(&dirstack) == NULL)
     {
       break;
     }
     /* Grab the directory to change to */
-    change_to = *((char **)dirstack.top);
+    change_to = *srsDirStack_Top(&dirstack);
     /* Attempt to change to the new directory */
     popped_to_valid_dir = srsDir_SetSystemCWD(change_to);
     if (!popped_to_valid_dir)
     {
       /* Free it and try the next one. */
       srsLOG_ERROR("Unable to pop directory to %s - try the next one", change_to);
-      free(change_to);
+      srsPool_Release(&srsDir_PATH_POOL, change_to);
       change_to = NULL;
     }
     else
     {
+      srsSpinLock_Lock(&srsDir_CWD_LOCK);
       srsLOG_PRINT("Popped Directory (%s): CWD = %s", directory_current, change_to);
+      srsSpinLock_Unlock(&srsDir_CWD_LOCK);
       /* Reset CWD so next call to srsDir_GetCWD regenerates it */
-      free(directory_current);
-      directory_current = NULL;
+      srsDir_ResetCWD();
     }
     /* If we can't pop, there's nothing left to try changing to and must break out of the loop. */
-    if (!srsMemStack_Pop(&dirstack, NULL))
+    if (!srsDirStack_Pop(&dirstack, NULL))
     {
       break;
     }
   }
+  /* Callers own what they are handed, so they get a copy they can free() */
   if (popped != NULL)
   {
-    *popped = change_to;
+    *popped = (change_to == NULL) ? NULL : strdup(change_to);
   }
+  srsPool_Release(&srsDir_PATH_POOL, change_to);
   return popped_to_valid_dir;
 }
 
@@ -246,6 +251,11 @@ bool srsDir_PopCWD(char **popped)
 
 FILE *srsFile_Open(const char *path, const char *mode)
 {
+  if ((path != NULL) && (mode != NULL) && (mode[0] != 'r'))
+  {
+    /* Writing and appending create the file */
+    srsFileSystem_Invalidate(path);
+  }
 #ifdef kiokuOS_WINDOWS
   FILE *fp = NULL;
   fopen_s(&fp, path, mode);
@@ -613,6 +623,7 @@ bool srsDir_Create(const char *path)
 #else
     ok = mkdir(create_dir, 0700) == 0;
 #endif
+    srsFileSystem_Invalidate(create_dir);
     if (!ok)
     {
       srsLOG_ERROR("Error occurred while attempting to create directory [%s]: %s", create_dir, strerror(errno));
@@ -701,9 +712,29 @@ bool srsPath_Move(const char *path, const char *newpath)
     return result;
   }
   result = rename(path, newpath) == 0;
+  srsFileSystem_Invalidate(path);
+  srsFileSystem_Invalidate(newpath);
   return result;
 }
 
+/* Numbers the temporary files of this process, so that writers never share one */
+static srsATOMIC32 srsFile_TEMP_COUNTER = 0;
+
+bool srsFile_GetTempPath(const char *path, char *temp_out, size_t temp_size)
+{
+  if ((path == NULL) || (temp_out == NULL))
+  {
+    return false;
+  }
+#ifdef kiokuOS_WINDOWS
+  long pid = (long)_getpid();
+#else
+  long pid = (long)getpid();
+#endif
+  int needed = snprintf(temp_out, temp_size, "%s.%ld.%d.tmp", path, pid, srsAtomic_Add(&srsFile_TEMP_COUNTER, 1));
+  return (needed > 0) && ((size_t)needed < temp_size);
+}
+
 #define KIOKU_DIR_MAX_DEPTH 128
 bool srsPath_Remove(const char *path)
 {
@@ -724,6 +755,341 @@ bool srsPath_Remove(const char *path)
   {
     result = remove(path) == 0;
   }
+  srsFileSystem_Invalidate(path);
+  return result;
+}
+
+/* Stat cache */
+
+#define srsSTAT_CACHE_SETS 256
+#define srsSTAT_CACHE_WAYS 4
+
+#define srsSTAT_MISSING 0
+#define srsSTAT_FILE 1
+#define srsSTAT_DIR 2
+
+/* What a path resolved to when it was last checked */
+typedef struct _srsSTAT_ENTRY_s
+{
+  char *path;
+  uint32_t hash;
+  uint8_t kind;
+  bool readable;
+  bool trusted; /* Cached while a watcher covered the path, so it stays valid until invalidated */
+  uint64_t when;
+} srsSTAT_ENTRY;
+
+static srsSTAT_ENTRY srsStatCache_ENTRIES[srsSTAT_CACHE_SETS][srsSTAT_CACHE_WAYS];
+/* Watched directories by key, each with the number of watchers covering it. Freed whenever it empties, since its keys are never released otherwise. */
+static srsHASHMAP srsStatCache_WATCHED = {0};
+static srsATOMIC32 srsStatCache_WATCHED_COUNT = 0;
+/* Bumped by every invalidation so a lookup racing with one does not cache what it saw before it */
+static uint32_t srsStatCache_GENERATION = 0;
+static srsSPINLOCK srsStatCache_LOCK = srsSPINLOCK_INIT;
+
+static uint64_t srsStatCache_Now()
+{
+#ifdef kiokuOS_WINDOWS
+  return (uint64_t)GetTickCount64();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+#endif
+}
+
+static uint32_t srsStatCache_Hash(const char *key)
+{
+  /* FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (; *key != kiokuCHAR_NULL; key++)
+  {
+    hash = (hash ^ (uint8_t)*key) * 16777619u;
+  }
+  return hash;
+}
+
+static bool srsStatCache_HasPrefix(const char *path, const char *prefix, size_t prefixlen)
+{
+  if (strncmp(path, prefix, prefixlen) != 0)
+  {
+    return false;
+  }
+  return (path[prefixlen] == kiokuCHAR_NULL) || (path[prefixlen] == '/') || ((prefixlen > 0) && (prefix[prefixlen - 1] == '/'));
+}
+
+/**
+ * Builds the key a path is cached under: an absolute path with '/' separators, no repeated separators and no "." components.
+ * Paths with ".." components are never cached, since they cannot be resolved without following links.
+ */
+static bool srsStatCache_GetKey(srsDIR *dir, const char *path, char *key, size_t key_size)
+{
+  int32_t needed;
+  if (srsPath_IsAbsolute(path))
+  {
+    needed = snprintf(key, key_size, "%s", path);
+  }
+  else
+  {
+    const char *base = (dir != NULL) ? srsDir_GetPath(dir) : srsDir_GetCWD();
+    needed = (base == NULL) ? -1 : kioku_path_concat(key, key_size, base, path);
+  }
+  if ((needed <= 0) || ((size_t)needed >= key_size))
+  {
+    return false;
+  }
+  char *out = key;
+  const char *in = key;
+  while (*in != kiokuCHAR_NULL)
+  {
+    if (!srsCHAR_ISDIRSEP(*in))
+    {
+      *out++ = *in++;
+      continue;
+    }
+    while (srsCHAR_ISDIRSEP(*in))
+    {
+      in++;
+    }
+    if ((in[0] == '.') && ((in[1] == kiokuCHAR_NULL) || srsCHAR_ISDIRSEP(in[1])))
+    {
+      in++;
+      continue;
+    }
+    if ((in[0] == '.') && (in[1] == '.') && ((in[2] == kiokuCHAR_NULL) || srsCHAR_ISDIRSEP(in[2])))
+    {
+      return false;
+    }
+    if ((*in != kiokuCHAR_NULL) || (out == key))
+    {
+      *out++ = '/';
+    }
+  }
+  *out = kiokuCHAR_NULL;
+  return true;
+}
+
+/* Whether a watcher is keeping the cache informed about changes to a path, found by looking up the key and each of its parents. The caller holds the lock. */
+static bool srsStatCache_IsWatched(const char *key)
+{
+  char prefix[srsPATH_MAX + 1];
+  if (srsHashMap_GetCount(&srsStatCache_WATCHED) == 0)
+  {
+    return false;
+  }
+  size_t length = strlen(key);
+  if (length >= sizeof(prefix))
+  {
+    return false;
+  }
+  memcpy(prefix, key, length + 1);
+  for (;;)
+  {
+    if (srsHashMap_Get(&srsStatCache_WATCHED, prefix, NULL))
+    {
+      return true;
+    }
+    char *slash = strrchr(prefix, '/');
+    if ((slash == NULL) || (slash == prefix))
+    {
+      /* Keys are absolute, so the last parent to check is the filesystem root */
+      return (slash == prefix) && (prefix[1] != kiokuCHAR_NULL) && srsHashMap_Get(&srsStatCache_WATCHED, "/", NULL);
+    }
+    *slash = kiokuCHAR_NULL;
+  }
+}
+
+/* Drops every entry at or beneath a key, or every entry if key is NULL */
+static void srsStatCache_Invalidate(const char *key)
+{
+  size_t keylen = (key == NULL) ? 0 : strlen(key);
+  srsSpinLock_Lock(&srsStatCache_LOCK);
+  srsStatCache_GENERATION++;
+  for (size_t set = 0; set < srsSTAT_CACHE_SETS; set++)
+  {
+    for (size_t way = 0; way < srsSTAT_CACHE_WAYS; way++)
+    {
+      srsSTAT_ENTRY *entry = &srsStatCache_ENTRIES[set][way];
+      if ((entry->path != NULL) && ((key == NULL) || srsStatCache_HasPrefix(entry->path, key, keylen)))
+      {
+        free(entry->path);
+        entry->path = NULL;
+      }
+    }
+  }
+  srsSpinLock_Unlock(&srsStatCache_LOCK);
+}
+
+/* Asks the filesystem directly */
+static void srsStatCache_Query(srsDIR *dir, const char *path, uint8_t *kind_out, bool *readable_out)
+{
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  const char *resolved = path;
+  if ((dir != NULL) && !srsPath_IsAbsolute(path))
+  {
+    int32_t needed = kioku_path_concat(buf, sizeof(buf), srsDir_GetPath(dir), path);
+    resolved = ((needed > 0) && ((size_t)needed < sizeof(buf))) ? buf : NULL;
+  }
+  DWORD attributes = (resolved == NULL) ? INVALID_FILE_ATTRIBUTES : GetFileAttributes(resolved);
+  if (attributes == INVALID_FILE_ATTRIBUTES)
+  {
+    *kind_out = srsSTAT_MISSING;
+    *readable_out = false;
+    return;
+  }
+  *kind_out = (attributes & FILE_ATTRIBUTE_DIRECTORY) ? srsSTAT_DIR : srsSTAT_FILE;
+  *readable_out = true;
+#else
+  struct stat statbuf;
+  int dirfd = srsDir_GetDescriptor(dir);
+  if (fstatat(dirfd, path, &statbuf, 0) != 0)
+  {
+    *kind_out = srsSTAT_MISSING;
+    *readable_out = false;
+    return;
+  }
+  *kind_out = S_ISDIR(statbuf.st_mode) ? srsSTAT_DIR : srsSTAT_FILE;
+  *readable_out = (faccessat(dirfd, path, R_OK, 0) == 0);
+#endif
+}
+
+/**
+ * Looks a path up in the cache, asking the filesystem and remembering the answer on a miss.
+ * Only paths covered by a watcher are cached indefinitely. Others are cached for @ref srsSTAT_CACHE_TTL_MS, which is off by default.
+ * @return False if the path cannot be cached, in which case the caller should check the filesystem itself.
+ */
+static bool srsStatCache_Get(srsDIR *dir, const char *path, uint8_t *kind_out, bool *readable_out)
+{
+  char key[srsPATH_MAX + 1];
+  if ((srsSTAT_CACHE_TTL_MS == 0) && (srsAtomic_Load(&srsStatCache_WATCHED_COUNT) == 0))
+  {
+    return false;
+  }
+  if (!srsStatCache_GetKey(dir, path, key, sizeof(key)))
+  {
+    return false;
+  }
+  uint32_t hash = srsStatCache_Hash(key);
+  srsSTAT_ENTRY *set = srsStatCache_ENTRIES[hash % srsSTAT_CACHE_SETS];
+  uint64_t now = srsStatCache_Now();
+  srsSpinLock_Lock(&srsStatCache_LOCK);
+  bool trusted = srsStatCache_IsWatched(key);
+  uint32_t generation = srsStatCache_GENERATION;
+  for (size_t way = 0; way < srsSTAT_CACHE_WAYS; way++)
+  {
+    srsSTAT_ENTRY *entry = &set[way];
+    if ((entry->path != NULL) && (entry->hash == hash) && (strcmp(entry->path, key) == 0))
+    {
+      bool fresh = (entry->trusted && trusted);
+#if srsSTAT_CACHE_TTL_MS > 0
+      fresh = fresh || (now - entry->when < srsSTAT_CACHE_TTL_MS);
+#endif
+      if (fresh)
+      {
+        *kind_out = entry->kind;
+        *readable_out = entry->readable;
+        srsSpinLock_Unlock(&srsStatCache_LOCK);
+        return true;
+      }
+      break;
+    }
+  }
+  srsSpinLock_Unlock(&srsStatCache_LOCK);
+  if (!trusted && (srsSTAT_CACHE_TTL_MS == 0))
+  {
+    return false;
+  }
+  srsStatCache_Query(dir, path, kind_out, readable_out);
+  char *copy = strdup(key);
+  if (copy == NULL)
+  {
+    return true;
+  }
+  srsSpinLock_Lock(&srsStatCache_LOCK);
+  if (srsStatCache_GENERATION != generation)
+  {
+    /* Something changed while we were looking, so what we saw may already be stale */
+    srsSpinLock_Unlock(&srsStatCache_LOCK);
+    free(copy);
+    return true;
+  }
+  /* Replace the same path, else an empty way, else the oldest */
+  srsSTAT_ENTRY *victim = &set[0];
+  for (size_t way = 0; way < srsSTAT_CACHE_WAYS; way++)
+  {
+    srsSTAT_ENTRY *entry = &set[way];
+    if ((entry->path != NULL) && (entry->hash == hash) && (strcmp(entry->path, key) == 0))
+    {
+      victim = entry;
+      break;
+    }
+    if ((victim->path != NULL) && ((entry->path == NULL) || (entry->when < victim->when)))
+    {
+      victim = entry;
+    }
+  }
+  free(victim->path);
+  victim->path = copy;
+  victim->hash = hash;
+  victim->kind = *kind_out;
+  victim->readable = *readable_out;
+  victim->trusted = trusted;
+  victim->when = now;
+  srsSpinLock_Unlock(&srsStatCache_LOCK);
+  return true;
+}
+
+/* Forgets what is cached about a path we are about to change, or just changed */
+static void srsStatCache_Forget(srsDIR *dir, const char *path)
+{
+  char key[srsPATH_MAX + 1];
+  if ((srsSTAT_CACHE_TTL_MS == 0) && (srsAtomic_Load(&srsStatCache_WATCHED_COUNT) == 0))
+  {
+    return;
+  }
+  srsStatCache_Invalidate(((path != NULL) && srsStatCache_GetKey(dir, path, key, sizeof(key))) ? key : NULL);
+}
+
+bool srsFileSystem_SetWatched(const char *path, bool watched)
+{
+  char key[srsPATH_MAX + 1];
+  if ((path == NULL) || !srsStatCache_GetKey(NULL, path, key, sizeof(key)))
+  {
+    return false;
+  }
+  bool result = false;
+  void *found = NULL;
+  srsSpinLock_Lock(&srsStatCache_LOCK);
+  uintptr_t watchers = srsHashMap_Get(&srsStatCache_WATCHED, key, &found) ? (uintptr_t)found : 0;
+  if (watched)
+  {
+    /* The map is only kept while it has entries */
+    result = ((watchers > 0) || (srsHashMap_GetCount(&srsStatCache_WATCHED) > 0) || srsHashMap_Init(&srsStatCache_WATCHED, 0)) && srsHashMap_Set(&srsStatCache_WATCHED, key, (void *)(watchers + 1));
+    if (!result && (srsHashMap_GetCount(&srsStatCache_WATCHED) == 0))
+    {
+      srsHashMap_Free(&srsStatCache_WATCHED);
+    }
+  }
+  else if (watchers > 1)
+  {
+    result = srsHashMap_Set(&srsStatCache_WATCHED, key, (void *)(watchers - 1));
+  }
+  else if (watchers == 1)
+  {
+    result = srsHashMap_Remove(&srsStatCache_WATCHED, key);
+    if (srsHashMap_GetCount(&srsStatCache_WATCHED) == 0)
+    {
+      srsHashMap_Free(&srsStatCache_WATCHED);
+    }
+  }
+  srsAtomic_Store(&srsStatCache_WATCHED_COUNT, (int32_t)srsHashMap_GetCount(&srsStatCache_WATCHED));
+  srsSpinLock_Unlock(&srsStatCache_LOCK);
+  if (!watched && (watchers == 1))
+  {
+    /* Nothing keeps what was cached beneath it up to date anymore */
+    srsStatCache_Invalidate(key);
+  }
   return result;
 }
 
@@ -734,6 +1100,12 @@ bool srsPath_Exists(const char *path)
   {
     return result;
   }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(NULL, path, &kind, &readable))
+  {
+    return readable;
+  }
 #ifdef kiokuOS_WINDOWS
   /* https://stackoverflow.com/a/6218957 */
   result = GetFileAttributes(path) != INVALID_FILE_ATTRIBUTES;
@@ -743,6 +1115,26 @@ bool srsPath_Exists(const char *path)
   return result;
 }
 
+bool srsPath_IsAbsolute(const char *path)
+{
+  if (path == NULL)
+  {
+    return false;
+  }
+  if (srsCHAR_ISDIRSEP(path[0]))
+  {
+    return true;
+  }
+#ifdef kiokuOS_WINDOWS
+  /* Drive letter */
+  if ((path[0] != kiokuCHAR_NULL) && (path[1] == ':'))
+  {
+    return true;
+  }
+#endif
+  return false;
+}
+
 /** @todo Add tests */
 bool srsFile_Exists(const char *path)
 {
@@ -751,6 +1143,12 @@ bool srsFile_Exists(const char *path)
   {
     return result;
   }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(NULL, path, &kind, &readable))
+  {
+    return readable && (kind == srsSTAT_FILE);
+  }
   if (!srsPath_Exists(path))
   {
     return result;
@@ -766,6 +1164,12 @@ bool srsDir_Exists(const char *path)
   {
     return result;
   }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(NULL, path, &kind, &readable))
+  {
+    return readable && (kind == srsSTAT_DIR);
+  }
   if (!srsPath_Exists(path))
   {
     return result;
@@ -820,6 +1224,10 @@ bool srsFile_SetContent(const char *filepath, const char *content)
   {
     return result;
   }
+  if (srsFileSystem_IsDurable())
+  {
+    return srsFile_SetContentAt(NULL, filepath, content);
+  }
   if (!srsPath_Exists(filepath))
   {
     return result;
@@ -877,7 +1285,8 @@ int32_t srsFile_ReadLineByNumber(const char *path, uint32_t linenum, char *lineb
   /* Initialize results */
   int32_t result = -1;
   size_t linelen = 0;
-  FILE *fp = NULL;
+  srsFILE_VIEW view = {0};
+  bool mapped = false;
   /* Must be valid line number */
   if (linenum < 1)
   {
@@ -893,35 +1302,38 @@ int32_t srsFile_ReadLineByNumber(const char *path, uint32_t linenum, char *lineb
   {
     goto done;
   }
-  /* Attempt to open file */
-  fp = srsFile_Open(path, "r");
+  /* Attempt to map file */
+  mapped = srsFile_Map(path, &view);
   /* Must be valid file */
-  if (fp == NULL)
+  if (!mapped)
   {
     srsLOG_ERROR("Failed to open %s for line reading", path);
     goto done;
   }
-  int ch = EOF;
-  int i = 1;
+  const char *cursor = view.data;
+  const char *end = view.data + view.size;
+  uint32_t i = 1;
   /* Seek to the line */
-  for (ch = fgetc(fp); (i < linenum) && (ch != EOF); ch = fgetc(fp))
+  for (; i < linenum; i++)
   {
-    if (ch == '\n')
+    const char *newline = memchr(cursor, '\n', (size_t)(end - cursor));
+    if (newline == NULL)
     {
-      i++;
+      break;
     }
+    cursor = newline + 1;
   }
   /* If we reached the end of file, it means the line number was greater than the number of lines in the file */
-  if (ch == EOF)
+  if ((i < linenum) || (cursor == end))
   {
     goto done;
   }
   /* Read the line into the buffer up to buffer size excluding null terminator, and stripping carriage returns. */
-  for (; (linelen < linebuf_size-1) && (ch != '\n') && (ch != EOF); ch = fgetc(fp))
+  for (; (linelen < linebuf_size-1) && (cursor != end) && (*cursor != '\n'); cursor++)
   {
-    if (ch != '\r')
+    if (*cursor != '\r')
     {
-      linebuf[linelen] = (char) ch;
+      linebuf[linelen] = *cursor;
       linelen++;
     }
   }
@@ -935,10 +1347,10 @@ done:
   {
     linebuf[linelen] = '\0';
   }
-  /* Don't close an invalid file handle */
-  if (fp != NULL)
+  /* Don't unmap an invalid view */
+  if (mapped)
   {
-    fclose(fp);
+    srsFile_Unmap(&view);
   }
   return result;
 }
@@ -1073,3 +1485,1966 @@ bool srsFileSystem_Iterate(const char *dirpath, void *userdata, srsFILESYSTEM_VI
   }
   return result;
 }
+
+struct _srsDIR_s
+{
+#ifndef kiokuOS_WINDOWS
+  int fd;
+#endif
+  char *path;
+};
+
+#ifdef kiokuOS_WINDOWS
+/* Without *at() system calls we fall back to joining paths onto the handle's absolute path. */
+static const char *srsDir_ResolvePath(srsDIR *dir, const char *path, char *buf, size_t bufsize)
+{
+  if ((dir == NULL) || (path == NULL) || srsPath_IsAbsolute(path))
+  {
+    return path;
+  }
+  int32_t needed = kioku_path_concat(buf, bufsize, dir->path, path);
+  if ((needed <= 0) || ((size_t)needed >= bufsize))
+  {
+    return NULL;
+  }
+  return buf;
+}
+#else
+static int srsDir_GetFD(srsDIR *dir)
+{
+  return (dir == NULL) ? AT_FDCWD : dir->fd;
+}
+
+int srsDir_GetDescriptor(const srsDIR *dir)
+{
+  return (dir == NULL) ? AT_FDCWD : dir->fd;
+}
+#endif
+
+srsDIR *srsDir_Open(const char *path)
+{
+  return srsDir_OpenAt(NULL, path);
+}
+
+srsDIR *srsDir_OpenAt(srsDIR *dir, const char *path)
+{
+  srsDIR *result = NULL;
+  char *fullpath = NULL;
+  char joined[srsPATH_MAX + 1] = {0};
+  size_t pathlen = 0;
+  if (path == NULL)
+  {
+    goto done;
+  }
+  /* The handle path is absolute so that it stays meaningful no matter what happens to the CWD later. */
+  if ((dir != NULL) && !srsPath_IsAbsolute(path))
+  {
+    int32_t needed = kioku_path_concat(joined, sizeof(joined), dir->path, path);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(joined)))
+    {
+      srsLOG_ERROR("Path to open is too long: %s + %s", dir->path, path);
+      goto done;
+    }
+    fullpath = strdup(joined);
+  }
+  else
+  {
+#ifdef kiokuOS_WINDOWS
+    fullpath = _fullpath(NULL, path, 0);
+#else
+    fullpath = realpath(path, NULL);
+#endif
+  }
+  if (fullpath == NULL)
+  {
+    goto done;
+  }
+  kioku_path_replace_separators(fullpath, strlen(fullpath) + 1);
+  pathlen = strlen(fullpath);
+  /* Keep the path in the same allocation as the handle */
+  result = malloc(sizeof(*result) + pathlen + 1);
+  if (result == NULL)
+  {
+    srsLOG_ERROR("Failed to allocate directory handle for %s", fullpath);
+    goto done;
+  }
+  result->path = (char *)(result + 1);
+  memcpy(result->path, fullpath, pathlen + 1);
+#ifdef kiokuOS_WINDOWS
+  if (!srsDir_Exists(result->path))
+  {
+    free(result);
+    result = NULL;
+  }
+#else
+  result->fd = openat(srsDir_GetFD(dir), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (result->fd < 0)
+  {
+    free(result);
+    result = NULL;
+  }
+#endif
+done:
+  free(fullpath);
+  return result;
+}
+
+void srsDir_Close(srsDIR *dir)
+{
+  if (dir == NULL)
+  {
+    return;
+  }
+#ifndef kiokuOS_WINDOWS
+  close(dir->fd);
+#endif
+  free(dir);
+}
+
+const char *srsDir_GetPath(const srsDIR *dir)
+{
+  return (dir == NULL) ? NULL : dir->path;
+}
+
+bool srsPath_ExistsAt(srsDIR *dir, const char *path)
+{
+  if (path == NULL)
+  {
+    return false;
+  }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(dir, path, &kind, &readable))
+  {
+    return readable;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsPath_Exists(srsDir_ResolvePath(dir, path, buf, sizeof(buf)));
+#else
+  return faccessat(srsDir_GetFD(dir), path, R_OK, 0) == 0;
+#endif
+}
+
+bool srsFile_ExistsAt(srsDIR *dir, const char *path)
+{
+  if (path == NULL)
+  {
+    return false;
+  }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(dir, path, &kind, &readable))
+  {
+    return kind == srsSTAT_FILE;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsFile_Exists(srsDir_ResolvePath(dir, path, buf, sizeof(buf)));
+#else
+  struct stat statbuf;
+  return (fstatat(srsDir_GetFD(dir), path, &statbuf, 0) == 0) && !S_ISDIR(statbuf.st_mode);
+#endif
+}
+
+bool srsDir_ExistsAt(srsDIR *dir, const char *path)
+{
+  if (path == NULL)
+  {
+    return false;
+  }
+  uint8_t kind;
+  bool readable;
+  if (srsStatCache_Get(dir, path, &kind, &readable))
+  {
+    return kind == srsSTAT_DIR;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsDir_Exists(srsDir_ResolvePath(dir, path, buf, sizeof(buf)));
+#else
+  struct stat statbuf;
+  return (fstatat(srsDir_GetFD(dir), path, &statbuf, 0) == 0) && S_ISDIR(statbuf.st_mode);
+#endif
+}
+
+FILE *srsFile_OpenAt(srsDIR *dir, const char *path, const char *mode)
+{
+  if ((path == NULL) || (mode == NULL))
+  {
+    return NULL;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  const char *resolved = srsDir_ResolvePath(dir, path, buf, sizeof(buf));
+  return (resolved == NULL) ? NULL : srsFile_Open(resolved, mode);
+#else
+  /* Translate the fopen mode into open flags */
+  int flags = 0;
+  bool update = (strchr(mode, '+') != NULL);
+  switch (mode[0])
+  {
+    case 'r':
+      flags = update ? O_RDWR : O_RDONLY;
+      break;
+    case 'w':
+      flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+      break;
+    case 'a':
+      flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+      break;
+    default:
+      return NULL;
+  }
+  int fd = openat(srsDir_GetFD(dir), path, flags | O_CLOEXEC, 0666);
+  if (flags & O_CREAT)
+  {
+    srsFileSystem_InvalidateAt(dir, path);
+  }
+  if (fd < 0)
+  {
+    return NULL;
+  }
+  FILE *fp = fdopen(fd, mode);
+  if (fp == NULL)
+  {
+    close(fd);
+  }
+  return fp;
+#endif
+}
+
+int32_t srsFile_GetLengthAt(srsDIR *dir, const char *filepath)
+{
+  if (filepath == NULL)
+  {
+    return -1;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsFile_GetLength(srsDir_ResolvePath(dir, filepath, buf, sizeof(buf)));
+#else
+  struct stat statbuf;
+  if (fstatat(srsDir_GetFD(dir), filepath, &statbuf, 0) != 0)
+  {
+    return -1;
+  }
+  if (S_ISDIR(statbuf.st_mode) || (statbuf.st_size > INT32_MAX))
+  {
+    return -1;
+  }
+  return (int32_t)statbuf.st_size;
+#endif
+}
+
+static srsATOMIC32 srsFile_DURABLE = 0;
+
+void srsFileSystem_SetDurable(bool durable)
+{
+  srsAtomic_Store(&srsFile_DURABLE, durable ? 1 : 0);
+}
+
+bool srsFileSystem_IsDurable()
+{
+  return srsAtomic_Load(&srsFile_DURABLE) != 0;
+}
+
+#ifndef kiokuOS_WINDOWS
+/* Writes all of content to a file opened relative to dirfd */
+static bool srsFile_WriteAllAt(int dirfd, const char *path, const char *content, int flags, mode_t mode)
+{
+  int fd = openat(dirfd, path, O_WRONLY | O_CLOEXEC | flags, mode);
+  if (fd < 0)
+  {
+    return false;
+  }
+  bool result = true;
+  size_t remaining = strlen(content);
+  while (result && (remaining > 0))
+  {
+    ssize_t wrote = write(fd, content, remaining);
+    if (wrote < 0)
+    {
+      result = (errno == EINTR);
+      continue;
+    }
+    content += wrote;
+    remaining -= (size_t)wrote;
+  }
+  close(fd);
+  return result;
+}
+#endif
+
+/* A path waiting to be flushed by the group commit */
+typedef struct _srsFILE_SYNC_s
+{
+  srsDIR *dir;
+  const char *path;
+  bool done;
+  bool ok;
+} srsFILE_SYNC;
+
+static srsATOMIC32 srsFile_SYNC_STATE = 0; /* 0 until initialized, 1 while initializing, 2 once ready */
+static srsMUTEX srsFile_SYNC_LOCK;
+static srsCOND srsFile_SYNC_COND;
+static srsFILE_SYNC *srsFile_SYNC_QUEUE[srsFILE_SYNC_BATCH_MAX];
+static size_t srsFile_SYNC_QUEUED = 0;
+static bool srsFile_SYNC_LEADING = false;
+/* Durable writes in progress, including those still writing their temporary file */
+static srsATOMIC32 srsFile_SYNC_WRITERS = 0;
+
+static bool srsFile_InitSync()
+{
+  while (srsAtomic_Load(&srsFile_SYNC_STATE) != 2)
+  {
+    if (!srsAtomic_CompareExchange(&srsFile_SYNC_STATE, 0, 1))
+    {
+      srsThread_Yield();
+      continue;
+    }
+    if (!srsMutex_Init(&srsFile_SYNC_LOCK))
+    {
+      srsAtomic_Store(&srsFile_SYNC_STATE, 0);
+      return false;
+    }
+    if (!srsCond_Init(&srsFile_SYNC_COND))
+    {
+      srsMutex_Destroy(&srsFile_SYNC_LOCK);
+      srsAtomic_Store(&srsFile_SYNC_STATE, 0);
+      return false;
+    }
+    srsAtomic_Store(&srsFile_SYNC_STATE, 2);
+  }
+  return true;
+}
+
+/* Flushes a batch with a single submission, syncing each distinct path once */
+static void srsFile_SyncBatch(srsFILE_SYNC **batch, size_t count)
+{
+  srsIO_REQUEST requests[srsFILE_SYNC_BATCH_MAX];
+  size_t slots[srsFILE_SYNC_BATCH_MAX];
+  size_t unique = 0;
+  memset(requests, 0, sizeof(requests));
+  for (size_t i = 0; i < count; i++)
+  {
+    size_t j = 0;
+    while ((j < unique) && !((requests[j].dir == batch[i]->dir) && (strcmp(requests[j].path, batch[i]->path) == 0)))
+    {
+      j++;
+    }
+    if (j == unique)
+    {
+      requests[j].op = srsIO_SYNC;
+      requests[j].dir = batch[i]->dir;
+      requests[j].path = batch[i]->path;
+      unique++;
+    }
+    slots[i] = j;
+  }
+  /* A lone sync is cheapest done inline */
+  srsIO_ENGINE *engine = srsIO_Create((uint32_t)unique, (unique == 1) ? srsIO_FLAG_BLOCKING : 0);
+  bool submitted = (engine != NULL) && srsIO_Submit(engine, requests, unique);
+  srsIO_Destroy(engine);
+  for (size_t i = 0; i < count; i++)
+  {
+    int64_t synced = submitted ? requests[slots[i]].result : -EIO;
+    batch[i]->ok = (synced == 0);
+    if (!batch[i]->ok)
+    {
+      srsLOG_ERROR("Failed to flush [%s] to disk (%s)", batch[i]->path, strerror((int)-synced));
+    }
+  }
+}
+
+/**
+ * Blocks until a file or directory is on stable storage.
+ * Callers that arrive while a flush is underway queue up, and whichever of them runs next flushes everyone queued by then in one go.
+ * This group commit lets many concurrent writers share the cost of each round of syncs instead of paying one each in turn.
+ */
+static bool srsFile_Commit(srsDIR *dir, const char *path)
+{
+  srsFILE_SYNC sync = {dir, path, false, false};
+  srsMutex_Lock(&srsFile_SYNC_LOCK);
+  while (srsFile_SYNC_QUEUED == srsFILE_SYNC_BATCH_MAX)
+  {
+    srsCond_Wait(&srsFile_SYNC_COND, &srsFile_SYNC_LOCK);
+  }
+  srsFile_SYNC_QUEUE[srsFile_SYNC_QUEUED++] = &sync;
+  while (!sync.done)
+  {
+    if (srsFile_SYNC_LEADING)
+    {
+      srsCond_Wait(&srsFile_SYNC_COND, &srsFile_SYNC_LOCK);
+      continue;
+    }
+    srsFile_SYNC_LEADING = true;
+    /* Give writers that are about to commit a moment to join this round rather than waiting out the next one */
+    for (uint32_t spins = 0; (spins < srsFILE_SYNC_WINDOW_SPINS) && (srsFile_SYNC_QUEUED < srsFILE_SYNC_BATCH_MAX) && (srsFile_SYNC_QUEUED < (size_t)srsAtomic_Load(&srsFile_SYNC_WRITERS)); spins++)
+    {
+      srsMutex_Unlock(&srsFile_SYNC_LOCK);
+      srsThread_Yield();
+      srsMutex_Lock(&srsFile_SYNC_LOCK);
+    }
+    srsFILE_SYNC *batch[srsFILE_SYNC_BATCH_MAX];
+    size_t count = srsFile_SYNC_QUEUED;
+    memcpy(batch, srsFile_SYNC_QUEUE, count * sizeof(*batch));
+    srsFile_SYNC_QUEUED = 0;
+    srsCond_Broadcast(&srsFile_SYNC_COND);
+    srsMutex_Unlock(&srsFile_SYNC_LOCK);
+
+    srsFile_SyncBatch(batch, count);
+
+    srsMutex_Lock(&srsFile_SYNC_LOCK);
+    for (size_t i = 0; i < count; i++)
+    {
+      batch[i]->done = true;
+    }
+    srsFile_SYNC_LEADING = false;
+    srsCond_Broadcast(&srsFile_SYNC_COND);
+  }
+  bool result = sync.ok;
+  srsMutex_Unlock(&srsFile_SYNC_LOCK);
+  return result;
+}
+
+/**
+ * Replaces the content of an existing file so that a crash leaves either the old or the new content, never a mix.
+ * The content goes to a temporary file next to it, which is flushed and then renamed over the original. On POSIX the directory is flushed afterwards so the rename itself is durable.
+ */
+static bool srsFile_SetContentDurable(srsDIR *dir, const char *filepath, const char *content)
+{
+  bool result = false;
+  bool temp_exists = false;
+  char temppath[srsPATH_MAX + 1];
+  if (!srsFile_InitSync())
+  {
+    return false;
+  }
+  srsAtomic_Add(&srsFile_SYNC_WRITERS, 1);
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  const char *path = srsDir_ResolvePath(dir, filepath, buf, sizeof(buf));
+  if (!srsFile_GetTempPath(path, temppath, sizeof(temppath)))
+  {
+    goto done;
+  }
+  /* Like srsFile_SetContent, only existing files are written to */
+  DWORD attributes = GetFileAttributesA(path);
+  if ((attributes == INVALID_FILE_ATTRIBUTES) || (attributes & FILE_ATTRIBUTE_DIRECTORY))
+  {
+    goto done;
+  }
+  int fd = _open(temppath, _O_WRONLY | _O_CREAT | _O_EXCL | _O_TEXT, _S_IREAD | _S_IWRITE);
+  if (fd < 0)
+  {
+    goto done;
+  }
+  temp_exists = true;
+  size_t remaining = strlen(content);
+  bool wrote_all = true;
+  while (wrote_all && (remaining > 0))
+  {
+    unsigned chunk = (remaining > INT32_MAX) ? INT32_MAX : (unsigned)remaining;
+    int wrote = _write(fd, content, chunk);
+    wrote_all = (wrote > 0);
+    content += (wrote > 0) ? wrote : 0;
+    remaining -= (wrote > 0) ? (size_t)wrote : 0;
+  }
+  _close(fd);
+  if (!wrote_all || !srsFile_Commit(NULL, temppath))
+  {
+    goto done;
+  }
+  /* Write-through makes the rename durable once it returns, so there is no directory to flush */
+  if (!MoveFileExA(temppath, path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+  {
+    goto done;
+  }
+  srsStatCache_Forget(NULL, path);
+  temp_exists = false;
+  result = true;
+done:
+  if (temp_exists)
+  {
+    _unlink(temppath);
+  }
+#else
+  int dirfd = srsDir_GetFD(dir);
+  char parent[srsPATH_MAX + 1];
+  if (!srsFile_GetTempPath(filepath, temppath, sizeof(temppath)))
+  {
+    goto done;
+  }
+  const char *slash = strrchr(filepath, '/');
+  if (slash == NULL)
+  {
+    strcpy(parent, ".");
+  }
+  else
+  {
+    size_t parentlen = (slash == filepath) ? 1 : (size_t)(slash - filepath);
+    memcpy(parent, filepath, parentlen);
+    parent[parentlen] = kiokuCHAR_NULL;
+  }
+  /* Like srsFile_SetContent, only existing files are written to */
+  struct stat statbuf;
+  if (fstatat(dirfd, filepath, &statbuf, AT_SYMLINK_NOFOLLOW) != 0)
+  {
+    goto done;
+  }
+  if (S_ISLNK(statbuf.st_mode))
+  {
+    /* Renaming over a link would replace the link rather than what it points to, so just flush it in place */
+    result = srsFile_WriteAllAt(dirfd, filepath, content, O_TRUNC, 0) && srsFile_Commit(dir, filepath);
+    goto done;
+  }
+  if (!S_ISREG(statbuf.st_mode))
+  {
+    goto done;
+  }
+  temp_exists = true;
+  if (!srsFile_WriteAllAt(dirfd, temppath, content, O_CREAT | O_EXCL, statbuf.st_mode & 07777))
+  {
+    goto done;
+  }
+  if (!srsFile_Commit(dir, temppath))
+  {
+    goto done;
+  }
+  if (renameat(dirfd, temppath, dirfd, filepath) != 0)
+  {
+    goto done;
+  }
+  srsStatCache_Forget(dir, filepath);
+  temp_exists = false;
+  result = srsFile_Commit(dir, parent);
+done:
+  if (temp_exists)
+  {
+    unlinkat(dirfd, temppath, 0);
+  }
+#endif
+  srsAtomic_Add(&srsFile_SYNC_WRITERS, -1);
+  return result;
+}
+
+bool srsFile_SetContentAt(srsDIR *dir, const char *filepath, const char *content)
+{
+  if ((filepath == NULL) || (content == NULL))
+  {
+    return false;
+  }
+  if (srsFileSystem_IsDurable())
+  {
+    return srsFile_SetContentDurable(dir, filepath, content);
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsFile_SetContent(srsDir_ResolvePath(dir, filepath, buf, sizeof(buf)), content);
+#else
+  /* Without O_CREAT this fails for missing files, and opening a directory for writing fails with EISDIR, which covers the checks done by srsFile_SetContent in one call. */
+  return srsFile_WriteAllAt(srsDir_GetFD(dir), filepath, content, O_TRUNC, 0);
+#endif
+}
+
+bool srsFile_GetContentAt(srsDIR *dir, const char *filepath, char *content_out, size_t count)
+{
+  if ((filepath == NULL) || (content_out == NULL) || (count == 0))
+  {
+    return false;
+  }
+#ifdef kiokuOS_WINDOWS
+  char buf[srsPATH_MAX + 1];
+  return srsFile_GetContent(srsDir_ResolvePath(dir, filepath, buf, sizeof(buf)), content_out, count);
+#else
+  int fd = openat(srsDir_GetFD(dir), filepath, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  /* Mimic fgets: read up to count - 1 characters, stopping after the first newline. Reading a directory fails with EISDIR. */
+  size_t total = 0;
+  bool failed = false;
+  while (total < count - 1)
+  {
+    ssize_t got = read(fd, content_out + total, count - 1 - total);
+    if (got < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      failed = true;
+      break;
+    }
+    if (got == 0)
+    {
+      break;
+    }
+    char *newline = memchr(content_out + total, '\n', (size_t)got);
+    if (newline != NULL)
+    {
+      total = (size_t)(newline - content_out) + 1;
+      break;
+    }
+    total += (size_t)got;
+  }
+  close(fd);
+  content_out[total] = kiokuCHAR_NULL;
+  return !failed && (total > 0);
+#endif
+}
+
+struct _srsDIR_STREAM_s
+{
+  srsDIR *dir;
+  bool owns_dir;
+#ifdef kiokuOS_WINDOWS
+  tinydir_dir stream;
+  tinydir_file file;
+#else
+  DIR *stream;
+#endif
+};
+
+/* Starts reading the entries of an already open handle, which the stream does not take ownership of */
+static bool srsDirStream_Init(srsDIR_STREAM *stream, srsDIR *dir)
+{
+  stream->dir = dir;
+  stream->owns_dir = false;
+#ifdef kiokuOS_WINDOWS
+  return tinydir_open(&stream->stream, dir->path) != -1;
+#else
+  /* Open a fresh description rather than dup'ing so the handle's own offset is never shared with this stream */
+  int fd = openat(dir->fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  stream->stream = (fd < 0) ? NULL : fdopendir(fd);
+  if ((stream->stream == NULL) && (fd >= 0))
+  {
+    close(fd);
+  }
+  return stream->stream != NULL;
+#endif
+}
+
+static void srsDirStream_Finish(srsDIR_STREAM *stream)
+{
+#ifdef kiokuOS_WINDOWS
+  tinydir_close(&stream->stream);
+#else
+  closedir(stream->stream);
+#endif
+  if (stream->owns_dir)
+  {
+    srsDir_Close(stream->dir);
+  }
+}
+
+srsDIR_STREAM *srsDirStream_Open(srsDIR *dir, const char *path)
+{
+  srsDIR_STREAM *stream = NULL;
+  srsDIR *opened = NULL;
+  if (path == NULL)
+  {
+    return NULL;
+  }
+  stream = malloc(sizeof(*stream));
+  opened = srsDir_OpenAt(dir, path);
+  if ((stream == NULL) || (opened == NULL) || !srsDirStream_Init(stream, opened))
+  {
+    srsDir_Close(opened);
+    free(stream);
+    return NULL;
+  }
+  stream->owns_dir = true;
+  return stream;
+}
+
+bool srsDirStream_Next(srsDIR_STREAM *stream, const char **name_out, bool *is_dir_out)
+{
+  if ((stream == NULL) || (name_out == NULL))
+  {
+    return false;
+  }
+  for (;;)
+  {
+    const char *name = NULL;
+    bool is_dir = false;
+#ifdef kiokuOS_WINDOWS
+    if (!stream->stream.has_next)
+    {
+      return false;
+    }
+    int read_result = tinydir_readfile(&stream->stream, &stream->file);
+    tinydir_next(&stream->stream);
+    if (read_result == -1)
+    {
+      continue;
+    }
+    name = stream->file.name;
+    is_dir = stream->file.is_dir;
+#else
+    struct dirent *entry = readdir(stream->stream);
+    if (entry == NULL)
+    {
+      return false;
+    }
+    name = entry->d_name;
+  #ifdef _DIRENT_HAVE_D_TYPE
+    if ((entry->d_type != DT_UNKNOWN) && (entry->d_type != DT_LNK))
+    {
+      is_dir = (entry->d_type == DT_DIR);
+    }
+    else
+  #endif
+    {
+      is_dir = srsDir_ExistsAt(stream->dir, name);
+    }
+#endif
+    /* Nobody iterating a directory wants the current or parent directory */
+    if ((strcmp(name, ".") == 0) || (strcmp(name, "..") == 0))
+    {
+      continue;
+    }
+    *name_out = name;
+    if (is_dir_out != NULL)
+    {
+      *is_dir_out = is_dir;
+    }
+    return true;
+  }
+}
+
+srsDIR *srsDirStream_GetDir(const srsDIR_STREAM *stream)
+{
+  return (stream == NULL) ? NULL : stream->dir;
+}
+
+void srsDirStream_Close(srsDIR_STREAM *stream)
+{
+  if (stream == NULL)
+  {
+    return;
+  }
+  srsDirStream_Finish(stream);
+  free(stream);
+}
+
+static bool srsFileSystem_IterateAt_Internal(srsDIR *dir, void *userdata, srsFILESYSTEM_VISIT_AT_FUNC iterate, bool *exit_out)
+{
+  bool result = true;
+  srsDIR_STREAM stream;
+  const char *name = NULL;
+  bool is_dir = false;
+  if (!srsDirStream_Init(&stream, dir))
+  {
+    return false;
+  }
+  while (srsDirStream_Next(&stream, &name, &is_dir))
+  {
+    srsFILESYSTEM_VISIT_ACTION action = iterate(dir, name, is_dir, userdata);
+    if ((action == srsFILESYSTEM_VISIT_RECURSE) && is_dir)
+    {
+      srsDIR *subdir = srsDir_OpenAt(dir, name);
+      result = (subdir != NULL) && srsFileSystem_IterateAt_Internal(subdir, userdata, iterate, exit_out);
+      srsDir_Close(subdir);
+      if (!result || *exit_out)
+      {
+        break;
+      }
+    }
+    else if (action == srsFILESYSTEM_VISIT_STOP)
+    {
+      break;
+    }
+    else if (action == srsFILESYSTEM_VISIT_EXIT)
+    {
+      *exit_out = true;
+      break;
+    }
+  }
+  srsDirStream_Finish(&stream);
+  return result;
+}
+
+bool srsFileSystem_IterateAt(srsDIR *dir, const char *dirpath, void *userdata, srsFILESYSTEM_VISIT_AT_FUNC iterate)
+{
+  bool exit_triggered = false;
+  if ((dirpath == NULL) || (iterate == NULL))
+  {
+    return false;
+  }
+  srsDIR *start = srsDir_OpenAt(dir, dirpath);
+  if (start == NULL)
+  {
+    return false;
+  }
+  bool result = srsFileSystem_IterateAt_Internal(start, userdata, iterate, &exit_triggered);
+  srsDir_Close(start);
+  return result;
+}
+
+/* Parallel walker: every directory is a task owned by a per-worker deque. Owners pop their newest task (depth-first, warm caches) while idle workers steal the oldest task of another worker, which tends to be the root of a large unexplored subtree. */
+#define srsFILESYSTEM_WALK_MAX_THREADS 64
+#define srsFILESYSTEM_WALK_BATCH_SIZE (32 * 1024)
+
+typedef struct _srsWALK_DEQUE_s
+{
+  srsMUTEX lock;
+  srsDIR **tasks; /* Ring buffer */
+  size_t capacity;
+  size_t head;    /* Oldest task */
+  size_t count;
+} srsWALK_DEQUE;
+
+typedef struct _srsWALK_s
+{
+  srsFILESYSTEM_VISIT_AT_FUNC iterate;
+  void *userdata;
+  uint32_t worker_count;
+  srsWALK_DEQUE *deques;
+  srsATOMIC32 pending; /* Directories queued or being scanned */
+  srsATOMIC32 queued;  /* Directories sitting in a deque */
+  srsATOMIC32 idle;    /* Workers waiting for tasks */
+  srsATOMIC32 exit;
+  srsATOMIC32 failed;
+  srsMUTEX idle_lock;
+  srsCOND idle_cond;
+} srsWALK;
+
+typedef struct _srsWALK_WORKER_s
+{
+  srsWALK *walk;
+  uint32_t index;
+} srsWALK_WORKER;
+
+static bool srsWalkDeque_Push(srsWALK_DEQUE *deque, srsDIR *dir)
+{
+  bool result = true;
+  srsMutex_Lock(&deque->lock);
+  if (deque->count == deque->capacity)
+  {
+    size_t capacity = (deque->capacity > 0) ? deque->capacity * 2 : 16;
+    srsDIR **tasks = malloc(capacity * sizeof(*tasks));
+    if (tasks == NULL)
+    {
+      result = false;
+      goto done;
+    }
+    for (size_t i = 0; i < deque->count; i++)
+    {
+      tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+    }
+    free(deque->tasks);
+    deque->tasks = tasks;
+    deque->capacity = capacity;
+    deque->head = 0;
+  }
+  deque->tasks[(deque->head + deque->count) % deque->capacity] = dir;
+  deque->count++;
+done:
+  srsMutex_Unlock(&deque->lock);
+  return result;
+}
+
+static srsDIR *srsWalkDeque_Pop(srsWALK_DEQUE *deque, bool steal)
+{
+  srsDIR *dir = NULL;
+  srsMutex_Lock(&deque->lock);
+  if (deque->count > 0)
+  {
+    deque->count--;
+    if (steal)
+    {
+      dir = deque->tasks[deque->head];
+      deque->head = (deque->head + 1) % deque->capacity;
+    }
+    else
+    {
+      dir = deque->tasks[(deque->head + deque->count) % deque->capacity];
+    }
+  }
+  srsMutex_Unlock(&deque->lock);
+  return dir;
+}
+
+static void srsWalk_Wake(srsWALK *walk, bool all)
+{
+  srsMutex_Lock(&walk->idle_lock);
+  if (all)
+  {
+    srsCond_Broadcast(&walk->idle_cond);
+  }
+  else
+  {
+    srsCond_Signal(&walk->idle_cond);
+  }
+  srsMutex_Unlock(&walk->idle_lock);
+}
+
+static void srsWalk_Exit(srsWALK *walk, bool failed)
+{
+  if (failed)
+  {
+    srsAtomic_Store(&walk->failed, 1);
+  }
+  srsAtomic_Store(&walk->exit, 1);
+  srsWalk_Wake(walk, true);
+}
+
+static srsDIR *srsWalk_Take(srsWALK *walk, uint32_t self)
+{
+  srsDIR *dir = srsWalkDeque_Pop(&walk->deques[self], false);
+  for (uint32_t i = 1; (dir == NULL) && (i < walk->worker_count); i++)
+  {
+    dir = srsWalkDeque_Pop(&walk->deques[(self + i) % walk->worker_count], true);
+  }
+  if (dir != NULL)
+  {
+    srsAtomic_Add(&walk->queued, -1);
+  }
+  return dir;
+}
+
+/* Visits one entry, returning whether the rest of the directory should be visited */
+static bool srsWalk_Visit(srsWALK *walk, uint32_t self, srsDIR *dir, const char *name, bool is_dir)
+{
+  /* Do not risk endless loop recursing on the current or parent directory */
+  if ((strcmp(name, ".") == 0) || (strcmp(name, "..") == 0))
+  {
+    return true;
+  }
+  if (srsAtomic_Load(&walk->exit))
+  {
+    return false;
+  }
+  srsFILESYSTEM_VISIT_ACTION action = walk->iterate(dir, name, is_dir, walk->userdata);
+  if ((action == srsFILESYSTEM_VISIT_RECURSE) && is_dir)
+  {
+    srsDIR *subdir = srsDir_OpenAt(dir, name);
+    if (subdir == NULL)
+    {
+      srsWalk_Exit(walk, true);
+      return false;
+    }
+    srsAtomic_Add(&walk->pending, 1);
+    if (!srsWalkDeque_Push(&walk->deques[self], subdir))
+    {
+      srsAtomic_Add(&walk->pending, -1);
+      srsDir_Close(subdir);
+      srsWalk_Exit(walk, true);
+      return false;
+    }
+    srsAtomic_Add(&walk->queued, 1);
+    if (srsAtomic_Load(&walk->idle) > 0)
+    {
+      srsWalk_Wake(walk, false);
+    }
+  }
+  else if (action == srsFILESYSTEM_VISIT_STOP)
+  {
+    return false;
+  }
+  else if (action == srsFILESYSTEM_VISIT_EXIT)
+  {
+    srsWalk_Exit(walk, false);
+    return false;
+  }
+  return true;
+}
+
+#if defined kiokuOS_LINUX
+/* glibc only gained a getdents64 wrapper in 2.30, so go through syscall(2) with the kernel's record layout */
+typedef struct _srsLINUX_DIRENT64_s
+{
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+} srsLINUX_DIRENT64;
+#endif
+
+static void srsWalk_ScanDir(srsWALK *walk, uint32_t self, srsDIR *dir, char *buffer, size_t bufsize)
+{
+#if defined kiokuOS_WINDOWS
+  (void)buffer;
+  (void)bufsize;
+  tinydir_dir stream;
+  if (tinydir_open(&stream, dir->path) == -1)
+  {
+    srsWalk_Exit(walk, true);
+    return;
+  }
+  for (; stream.has_next; tinydir_next(&stream))
+  {
+    tinydir_file file;
+    if ((tinydir_readfile(&stream, &file) != -1) && !srsWalk_Visit(walk, self, dir, file.name, file.is_dir))
+    {
+      break;
+    }
+  }
+  tinydir_close(&stream);
+#elif defined kiokuOS_LINUX
+  /* The walker owns the handle, so its descriptor's offset can be consumed directly, saving an open per directory */
+  for (;;)
+  {
+    long got = syscall(SYS_getdents64, dir->fd, buffer, bufsize);
+    if (got < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      srsWalk_Exit(walk, true);
+      return;
+    }
+    if (got == 0)
+    {
+      return;
+    }
+    for (long offset = 0; offset < got;)
+    {
+      srsLINUX_DIRENT64 *entry = (srsLINUX_DIRENT64 *)(buffer + offset);
+      offset += entry->d_reclen;
+      bool is_dir = false;
+      if ((entry->d_type != DT_UNKNOWN) && (entry->d_type != DT_LNK))
+      {
+        is_dir = (entry->d_type == DT_DIR);
+      }
+      else
+      {
+        is_dir = srsDir_ExistsAt(dir, entry->d_name);
+      }
+      if (!srsWalk_Visit(walk, self, dir, entry->d_name, is_dir))
+      {
+        return;
+      }
+    }
+  }
+#else
+  (void)buffer;
+  (void)bufsize;
+  int fd = openat(dir->fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  DIR *stream = (fd < 0) ? NULL : fdopendir(fd);
+  if (stream == NULL)
+  {
+    if (fd >= 0)
+    {
+      close(fd);
+    }
+    srsWalk_Exit(walk, true);
+    return;
+  }
+  struct dirent *entry = NULL;
+  while ((entry = readdir(stream)) != NULL)
+  {
+    bool is_dir = false;
+  #ifdef _DIRENT_HAVE_D_TYPE
+    if ((entry->d_type != DT_UNKNOWN) && (entry->d_type != DT_LNK))
+    {
+      is_dir = (entry->d_type == DT_DIR);
+    }
+    else
+  #endif
+    {
+      is_dir = srsDir_ExistsAt(dir, entry->d_name);
+    }
+    if (!srsWalk_Visit(walk, self, dir, entry->d_name, is_dir))
+    {
+      break;
+    }
+  }
+  closedir(stream);
+#endif
+}
+
+static void *srsWalk_Worker(void *arg)
+{
+  srsWALK_WORKER *worker = arg;
+  srsWALK *walk = worker->walk;
+  char *buffer = NULL;
+#if defined kiokuOS_LINUX
+  buffer = malloc(srsFILESYSTEM_WALK_BATCH_SIZE);
+  if (buffer == NULL)
+  {
+    srsWalk_Exit(walk, true);
+    return NULL;
+  }
+#endif
+  for (;;)
+  {
+    srsDIR *dir = srsWalk_Take(walk, worker->index);
+    if (dir != NULL)
+    {
+      if (!srsAtomic_Load(&walk->exit))
+      {
+        srsWalk_ScanDir(walk, worker->index, dir, buffer, srsFILESYSTEM_WALK_BATCH_SIZE);
+      }
+      srsDir_Close(dir);
+      if (srsAtomic_Add(&walk->pending, -1) == 0)
+      {
+        srsWalk_Wake(walk, true);
+      }
+      continue;
+    }
+    /* Nothing to take - sleep until a task is published, the walk completes, or it is aborted */
+    srsMutex_Lock(&walk->idle_lock);
+    srsAtomic_Add(&walk->idle, 1);
+    while ((srsAtomic_Load(&walk->pending) > 0) && !srsAtomic_Load(&walk->exit) && (srsAtomic_Load(&walk->queued) == 0))
+    {
+      srsCond_Wait(&walk->idle_cond, &walk->idle_lock);
+    }
+    srsAtomic_Add(&walk->idle, -1);
+    srsMutex_Unlock(&walk->idle_lock);
+    if ((srsAtomic_Load(&walk->pending) == 0) || srsAtomic_Load(&walk->exit))
+    {
+      break;
+    }
+  }
+  free(buffer);
+  return NULL;
+}
+
+bool srsFileSystem_IterateParallel(srsDIR *dir, const char *dirpath, uint32_t thread_count, void *userdata, srsFILESYSTEM_VISIT_AT_FUNC iterate)
+{
+  bool result = false;
+  srsWALK walk = {0};
+  srsWALK_WORKER workers[srsFILESYSTEM_WALK_MAX_THREADS];
+  srsTHREAD threads[srsFILESYSTEM_WALK_MAX_THREADS];
+  uint32_t deques_ready = 0;
+  uint32_t spawned = 0;
+  bool sync_ready = false;
+  if ((dirpath == NULL) || (iterate == NULL))
+  {
+    return false;
+  }
+  srsDIR *start = srsDir_OpenAt(dir, dirpath);
+  if (start == NULL)
+  {
+    return false;
+  }
+  if (thread_count == 0)
+  {
+    thread_count = srsThread_GetHardwareConcurrency();
+  }
+  if (thread_count > srsFILESYSTEM_WALK_MAX_THREADS)
+  {
+    thread_count = srsFILESYSTEM_WALK_MAX_THREADS;
+  }
+  walk.iterate = iterate;
+  walk.userdata = userdata;
+  walk.worker_count = thread_count;
+  walk.deques = calloc(thread_count, sizeof(*walk.deques));
+  if (walk.deques == NULL)
+  {
+    goto done;
+  }
+  for (; deques_ready < thread_count; deques_ready++)
+  {
+    if (!srsMutex_Init(&walk.deques[deques_ready].lock))
+    {
+      goto done;
+    }
+  }
+  if (!srsMutex_Init(&walk.idle_lock))
+  {
+    goto done;
+  }
+  if (!srsCond_Init(&walk.idle_cond))
+  {
+    srsMutex_Destroy(&walk.idle_lock);
+    goto done;
+  }
+  sync_ready = true;
+  if (!srsWalkDeque_Push(&walk.deques[0], start))
+  {
+    goto done;
+  }
+  start = NULL;
+  walk.pending = 1;
+  walk.queued = 1;
+  /* The calling thread is worker 0. Running with fewer threads than asked for is fine since every deque can be stolen from. */
+  for (uint32_t i = 0; i < thread_count; i++)
+  {
+    workers[i].walk = &walk;
+    workers[i].index = i;
+  }
+  for (uint32_t i = 1; i < thread_count; i++)
+  {
+    if (!srsThread_Create(&threads[spawned], srsWalk_Worker, &workers[i]))
+    {
+      break;
+    }
+    spawned++;
+  }
+  srsWalk_Worker(&workers[0]);
+  for (uint32_t i = 0; i < spawned; i++)
+  {
+    srsThread_Join(threads[i], NULL);
+  }
+  result = !srsAtomic_Load(&walk.failed);
+done:
+  srsDir_Close(start);
+  for (uint32_t i = 0; i < deques_ready; i++)
+  {
+    /* Directories left behind by an early exit */
+    srsDIR *leftover = NULL;
+    while ((leftover = srsWalkDeque_Pop(&walk.deques[i], false)) != NULL)
+    {
+      srsDir_Close(leftover);
+    }
+    free(walk.deques[i].tasks);
+    srsMutex_Destroy(&walk.deques[i].lock);
+  }
+  free(walk.deques);
+  if (sync_ready)
+  {
+    srsCond_Destroy(&walk.idle_cond);
+    srsMutex_Destroy(&walk.idle_lock);
+  }
+  return result;
+}
+
+/* Small files are read into one of these static buffers rather than mapped, since a single read is cheaper than setting up and tearing down a mapping. The spare byte keeps pooled views NUL-terminated. */
+#define srsFILE_VIEW_POOL_COUNT 8
+static char srsFile_VIEW_POOL[srsFILE_VIEW_POOL_COUNT][srsFILE_MAP_THRESHOLD + 1];
+static srsATOMIC32 srsFile_VIEW_POOL_USED[srsFILE_VIEW_POOL_COUNT];
+
+enum
+{
+  srsFILE_VIEW_EMPTY,
+  srsFILE_VIEW_POOLED,
+  srsFILE_VIEW_ALLOCATED,
+  srsFILE_VIEW_MAPPED
+};
+
+static char *srsFileView_Acquire(srsFILE_VIEW *view)
+{
+  for (int32_t i = 0; i < srsFILE_VIEW_POOL_COUNT; i++)
+  {
+    if (srsAtomic_CompareExchange(&srsFile_VIEW_POOL_USED[i], 0, 1))
+    {
+      view->kind = srsFILE_VIEW_POOLED;
+      view->slot = i;
+      return srsFile_VIEW_POOL[i];
+    }
+  }
+  /* Every pooled buffer is in use, so fall back to the heap */
+  view->kind = srsFILE_VIEW_ALLOCATED;
+  view->slot = -1;
+  return malloc(srsFILE_MAP_THRESHOLD + 1);
+}
+
+void srsFile_Unmap(srsFILE_VIEW *view)
+{
+  if (view == NULL)
+  {
+    return;
+  }
+  switch (view->kind)
+  {
+    case srsFILE_VIEW_POOLED:
+      srsAtomic_Store(&srsFile_VIEW_POOL_USED[view->slot], 0);
+      break;
+    case srsFILE_VIEW_ALLOCATED:
+      free((char *)view->data);
+      break;
+    case srsFILE_VIEW_MAPPED:
+#ifdef kiokuOS_WINDOWS
+      UnmapViewOfFile(view->data);
+#else
+      munmap((void *)view->data, view->size);
+#endif
+      break;
+  }
+  view->data = NULL;
+  view->size = 0;
+  view->kind = srsFILE_VIEW_EMPTY;
+  view->slot = -1;
+}
+
+/* Identity and version of a file, used to tell whether data derived from it is still current */
+typedef struct _srsFILE_STAMP_s
+{
+  uint64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t inode;
+} srsFILE_STAMP;
+
+#ifdef kiokuOS_WINDOWS
+typedef HANDLE srsFILE_NATIVE;
+#define srsFILE_NATIVE_INVALID INVALID_HANDLE_VALUE
+#else
+typedef int srsFILE_NATIVE;
+#define srsFILE_NATIVE_INVALID -1
+#endif
+
+/* Opens a file for reading relative to a directory handle without going through stdio */
+static srsFILE_NATIVE srsFile_OpenNative(srsDIR *dir, const char *path)
+{
+#ifdef kiokuOS_WINDOWS
+  char resolved[srsPATH_MAX + 1];
+  if (srsDir_ResolvePath(dir, path, resolved, sizeof(resolved)) == NULL)
+  {
+    return srsFILE_NATIVE_INVALID;
+  }
+  return CreateFileA(resolved, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+  return openat(srsDir_GetFD(dir), path, O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+static void srsFile_CloseNative(srsFILE_NATIVE file)
+{
+#ifdef kiokuOS_WINDOWS
+  CloseHandle(file);
+#else
+  close(file);
+#endif
+}
+
+/* Reads up to size bytes at offset without moving any shared file position, returning the number read or -1 */
+static int64_t srsFile_ReadNative(srsFILE_NATIVE file, char *buffer, size_t size, uint64_t offset)
+{
+  for (;;)
+  {
+#ifdef kiokuOS_WINDOWS
+    OVERLAPPED overlapped = {0};
+    DWORD got = 0;
+    overlapped.Offset = (DWORD)offset;
+    overlapped.OffsetHigh = (DWORD)(offset >> 32);
+    if (!ReadFile(file, buffer, (DWORD)size, &got, &overlapped))
+    {
+      return (GetLastError() == ERROR_HANDLE_EOF) ? 0 : -1;
+    }
+    return (int64_t)got;
+#else
+    ssize_t got = pread(file, buffer, size, (off_t)offset);
+    if ((got < 0) && (errno == EINTR))
+    {
+      continue;
+    }
+    return (int64_t)got;
+#endif
+  }
+}
+
+/* Gets the identity and version of an open file. Directories are rejected. */
+static bool srsFile_GetStampNative(srsFILE_NATIVE file, srsFILE_STAMP *stamp_out)
+{
+#ifdef kiokuOS_WINDOWS
+  BY_HANDLE_FILE_INFORMATION info;
+  if (!GetFileInformationByHandle(file, &info) || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+  {
+    return false;
+  }
+  /* FILETIME counts 100ns intervals since 1601 */
+  uint64_t ticks = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+  stamp_out->size = ((uint64_t)info.nFileSizeHigh << 32) | info.nFileSizeLow;
+  stamp_out->mtime_sec = (int64_t)(ticks / 10000000) - INT64_C(11644473600);
+  stamp_out->mtime_nsec = (int64_t)(ticks % 10000000) * 100;
+  stamp_out->inode = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+#else
+  struct stat statbuf;
+  if ((fstat(file, &statbuf) != 0) || S_ISDIR(statbuf.st_mode))
+  {
+    return false;
+  }
+  stamp_out->size = (uint64_t)statbuf.st_size;
+  stamp_out->mtime_sec = (int64_t)statbuf.st_mtime;
+  #if defined kiokuOS_APPLE
+  stamp_out->mtime_nsec = (int64_t)statbuf.st_mtimespec.tv_nsec;
+  #else
+  stamp_out->mtime_nsec = (int64_t)statbuf.st_mtim.tv_nsec;
+  #endif
+  stamp_out->inode = (uint64_t)statbuf.st_ino;
+#endif
+  return true;
+}
+
+/* Maps an open file of the given size. The caller keeps ownership of the file. */
+static bool srsFile_MapNative(srsFILE_NATIVE file, size_t size, srsFILE_VIEW *view_out)
+{
+  bool result = false;
+  char *buffer = NULL;
+  view_out->data = "";
+  view_out->size = 0;
+  view_out->kind = srsFILE_VIEW_EMPTY;
+  view_out->slot = -1;
+  if (size == 0)
+  {
+    return true;
+  }
+  if (size > srsFILE_MAP_THRESHOLD)
+  {
+#ifdef kiokuOS_WINDOWS
+    /* The view keeps the mapping object alive once the handle is closed */
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    void *data = (mapping == NULL) ? NULL : MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+    if (mapping != NULL)
+    {
+      CloseHandle(mapping);
+    }
+    if (data == NULL)
+    {
+      return false;
+    }
+#else
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED)
+    {
+      return false;
+    }
+#endif
+    view_out->data = data;
+    view_out->size = size;
+    view_out->kind = srsFILE_VIEW_MAPPED;
+    return true;
+  }
+  buffer = srsFileView_Acquire(view_out);
+  if (buffer == NULL)
+  {
+    goto done;
+  }
+  /* The file may have shrunk or grown since it was sized, so the view covers whatever one pass of reads returns */
+  size_t total = 0;
+  while (total < size)
+  {
+    int64_t got = srsFile_ReadNative(file, buffer + total, size - total, total);
+    if (got < 0)
+    {
+      goto done;
+    }
+    if (got == 0)
+    {
+      break;
+    }
+    total += (size_t)got;
+  }
+  buffer[total] = kiokuCHAR_NULL;
+  view_out->data = buffer;
+  view_out->size = total;
+  result = true;
+done:
+  if (!result)
+  {
+    if ((view_out->kind == srsFILE_VIEW_POOLED) || (view_out->kind == srsFILE_VIEW_ALLOCATED))
+    {
+      /* Let srsFile_Unmap hand the buffer back */
+      view_out->data = buffer;
+    }
+    srsFile_Unmap(view_out);
+  }
+  return result;
+}
+
+bool srsFile_MapAt(srsDIR *dir, const char *path, srsFILE_VIEW *view_out)
+{
+  bool result = false;
+  srsFILE_STAMP stamp;
+  if ((path == NULL) || (view_out == NULL))
+  {
+    return false;
+  }
+  srsFILE_NATIVE file = srsFile_OpenNative(dir, path);
+  if (file == srsFILE_NATIVE_INVALID)
+  {
+    return false;
+  }
+  if (srsFile_GetStampNative(file, &stamp) && (stamp.size <= SIZE_MAX))
+  {
+    result = srsFile_MapNative(file, (size_t)stamp.size, view_out);
+  }
+  srsFile_CloseNative(file);
+  return result;
+}
+
+bool srsFile_Map(const char *path, srsFILE_VIEW *view_out)
+{
+  return srsFile_MapAt(NULL, path, view_out);
+}
+
+/* Line index sidecar layout, in native byte order: header followed by count uint32 line start offsets */
+#define srsLINE_INDEX_MAGIC 0x58494C4B /* "KLIX" */
+#define srsLINE_INDEX_VERSION 1
+
+typedef struct _srsLINE_INDEX_HEADER_s
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  uint64_t inode;
+  uint32_t count;
+  uint32_t reserved;
+} srsLINE_INDEX_HEADER;
+
+struct _srsLINE_INDEX_s
+{
+  char *path;
+  bool persist;
+  /* Set when the file was modified too recently for its mtime to reveal a later same-size write */
+  bool racy;
+  srsFILE_STAMP stamp;
+  uint32_t count;
+  uint32_t *offsets;
+};
+
+static bool srsLineIndex_StampEquals(const srsFILE_STAMP *a, const srsFILE_STAMP *b)
+{
+  return (a->size == b->size) && (a->mtime_sec == b->mtime_sec) && (a->mtime_nsec == b->mtime_nsec) && (a->inode == b->inode);
+}
+
+/* Sidecars go in srsLINE_INDEX_DIRNAME next to the file, so they stay out of the repository the file is in */
+static bool srsLineIndex_GetSidecarPath(const srsLINE_INDEX *index, char *path_out, size_t nbytes)
+{
+  const char *slash = strrchr(index->path, '/');
+  int dir_length = (slash == NULL) ? 0 : (int)(slash - index->path + 1);
+  int needed = snprintf(path_out, nbytes, "%.*s%s/%s%s", dir_length, index->path, srsLINE_INDEX_DIRNAME, index->path + dir_length, srsLINE_INDEX_SUFFIX);
+  return (needed > 0) && ((size_t)needed < nbytes);
+}
+
+static bool srsLineIndex_Load(srsLINE_INDEX *index)
+{
+  bool result = false;
+  char sidecar[srsPATH_MAX + 1];
+  srsFILE_VIEW view = {0};
+  if (!srsLineIndex_GetSidecarPath(index, sidecar, sizeof(sidecar)) || !srsFile_Map(sidecar, &view))
+  {
+    return false;
+  }
+  srsLINE_INDEX_HEADER header;
+  if (view.size < sizeof(header))
+  {
+    goto done;
+  }
+  memcpy(&header, view.data, sizeof(header));
+  srsFILE_STAMP stamp = {header.size, header.mtime_sec, header.mtime_nsec, header.inode};
+  if ((header.magic != srsLINE_INDEX_MAGIC) || (header.version != srsLINE_INDEX_VERSION) || !srsLineIndex_StampEquals(&stamp, &index->stamp))
+  {
+    goto done;
+  }
+  if (view.size != sizeof(header) + (uint64_t)header.count * sizeof(uint32_t))
+  {
+    goto done;
+  }
+  uint32_t *offsets = malloc((header.count > 0 ? header.count : 1) * sizeof(uint32_t));
+  if (offsets == NULL)
+  {
+    goto done;
+  }
+  memcpy(offsets, view.data + sizeof(header), header.count * sizeof(uint32_t));
+  free(index->offsets);
+  index->offsets = offsets;
+  index->count = header.count;
+  result = true;
+done:
+  srsFile_Unmap(&view);
+  return result;
+}
+
+static void srsLineIndex_Save(const srsLINE_INDEX *index)
+{
+  char sidecar[srsPATH_MAX + 1];
+  char temp[srsPATH_MAX + 1];
+  if (!srsLineIndex_GetSidecarPath(index, sidecar, sizeof(sidecar)))
+  {
+    return;
+  }
+  /* Indexes are built outside the cache lock, so several threads or processes may save the same one at once. Each writes its own temporary file. */
+  if (!srsFile_GetTempPath(sidecar, temp, sizeof(temp)))
+  {
+    return;
+  }
+  char *name = strrchr(temp, '/');
+  *name = kiokuCHAR_NULL;
+  if (!srsDir_Exists(temp))
+  {
+    if (!srsDir_Create(temp))
+    {
+      return;
+    }
+    /* Keep derived data out of the repository without touching the user's own ignore rules */
+    char ignore[srsPATH_MAX + 1];
+    int needed = snprintf(ignore, sizeof(ignore), "%s/.gitignore", temp);
+    if ((needed > 0) && ((size_t)needed < sizeof(ignore)) && srsFile_Create(ignore))
+    {
+      srsFile_SetContent(ignore, "*" kiokuSTRING_LF);
+    }
+  }
+  *name = '/';
+  srsLINE_INDEX_HEADER header = {srsLINE_INDEX_MAGIC, srsLINE_INDEX_VERSION, index->stamp.size, index->stamp.mtime_sec, index->stamp.mtime_nsec, index->stamp.inode, index->count, 0};
+  FILE *fp = fopen(temp, "wb");
+  if (fp == NULL)
+  {
+    return;
+  }
+  bool ok = (fwrite(&header, sizeof(header), 1, fp) == 1);
+  ok = ok && (fwrite(index->offsets, sizeof(uint32_t), index->count, fp) == index->count);
+  ok = (fclose(fp) == 0) && ok;
+  /* Readers never see a partial sidecar since it only appears under its real name once complete, and the last complete one renamed there wins */
+#ifdef kiokuOS_WINDOWS
+  /* rename refuses to replace an existing file on Windows */
+  remove(sidecar);
+#endif
+  if (!ok || !srsPath_Move(temp, sidecar))
+  {
+    remove(temp);
+  }
+}
+
+static bool srsLineIndex_Build(srsLINE_INDEX *index, srsFILE_NATIVE file, const srsFILE_STAMP *stamp)
+{
+  bool result = false;
+  srsFILE_VIEW view = {0};
+  if ((stamp->size > UINT32_MAX) || !srsFile_MapNative(file, (size_t)stamp->size, &view))
+  {
+    return false;
+  }
+  /* A line exists wherever at least one byte follows the start of the file or a newline */
+  const char *end = view.data + view.size;
+  const char *cursor = view.data;
+  uint32_t count = (view.size > 0) ? 1 : 0;
+  while ((cursor = memchr(cursor, '\n', (size_t)(end - cursor))) != NULL)
+  {
+    cursor++;
+    count += (cursor != end) ? 1 : 0;
+  }
+  uint32_t *offsets = malloc((count > 0 ? count : 1) * sizeof(uint32_t));
+  if (offsets == NULL)
+  {
+    goto done;
+  }
+  if (count > 0)
+  {
+    uint32_t i = 0;
+    offsets[i++] = 0;
+    for (cursor = view.data; (i < count) && ((cursor = memchr(cursor, '\n', (size_t)(end - cursor))) != NULL);)
+    {
+      cursor++;
+      offsets[i++] = (uint32_t)(cursor - view.data);
+    }
+  }
+  free(index->offsets);
+  index->offsets = offsets;
+  index->count = count;
+  index->stamp = *stamp;
+  /* Same-second writes could leave the size and mtime untouched, so do not trust an index of a file that may still be changing */
+  index->racy = ((int64_t)time(NULL) - stamp->mtime_sec) <= 1;
+  result = true;
+  if (index->persist && !index->racy)
+  {
+    srsLineIndex_Save(index);
+  }
+done:
+  srsFile_Unmap(&view);
+  return result;
+}
+
+/* Makes sure the index describes the file as it is now */
+static bool srsLineIndex_Validate(srsLINE_INDEX *index, srsFILE_NATIVE file)
+{
+  srsFILE_STAMP stamp;
+  if (!srsFile_GetStampNative(file, &stamp))
+  {
+    return false;
+  }
+  if (!index->racy && (index->offsets != NULL) && srsLineIndex_StampEquals(&stamp, &index->stamp))
+  {
+    return true;
+  }
+  index->stamp = stamp;
+  if (index->persist && srsLineIndex_Load(index))
+  {
+    index->racy = false;
+    return true;
+  }
+  return srsLineIndex_Build(index, file, &stamp);
+}
+
+srsLINE_INDEX *srsLineIndex_Open(const char *path, bool persist)
+{
+  srsLINE_INDEX *index = NULL;
+  if (path == NULL)
+  {
+    return NULL;
+  }
+  srsFILE_NATIVE file = srsFile_OpenNative(NULL, path);
+  if (file == srsFILE_NATIVE_INVALID)
+  {
+    return NULL;
+  }
+  size_t pathlen = strlen(path);
+  index = calloc(1, sizeof(*index) + pathlen + 1);
+  if (index == NULL)
+  {
+    goto done;
+  }
+  index->path = (char *)(index + 1);
+  memcpy(index->path, path, pathlen + 1);
+  index->persist = persist;
+  if (!srsLineIndex_Validate(index, file))
+  {
+    srsLineIndex_Close(index);
+    index = NULL;
+  }
+done:
+  srsFile_CloseNative(file);
+  return index;
+}
+
+void srsLineIndex_Close(srsLINE_INDEX *index)
+{
+  if (index == NULL)
+  {
+    return;
+  }
+  free(index->offsets);
+  free(index);
+}
+
+int32_t srsLineIndex_GetCount(srsLINE_INDEX *index)
+{
+  if (index == NULL)
+  {
+    return -1;
+  }
+  srsFILE_NATIVE file = srsFile_OpenNative(NULL, index->path);
+  if (file == srsFILE_NATIVE_INVALID)
+  {
+    return -1;
+  }
+  bool valid = srsLineIndex_Validate(index, file);
+  srsFile_CloseNative(file);
+  return (valid && (index->count <= INT32_MAX)) ? (int32_t)index->count : -1;
+}
+
+int32_t srsLineIndex_ReadLine(srsLINE_INDEX *index, uint32_t linenum, char *linebuf, size_t linebuf_size)
+{
+  int32_t result = -1;
+  size_t linelen = 0;
+  srsFILE_NATIVE file = srsFILE_NATIVE_INVALID;
+  if ((index == NULL) || (linenum < 1) || (linebuf == NULL) || (linebuf_size == 0))
+  {
+    goto done;
+  }
+  file = srsFile_OpenNative(NULL, index->path);
+  if ((file == srsFILE_NATIVE_INVALID) || !srsLineIndex_Validate(index, file))
+  {
+    goto done;
+  }
+  if (linenum > index->count)
+  {
+    goto done;
+  }
+  uint64_t start = index->offsets[linenum - 1];
+  uint64_t end = (linenum < index->count) ? index->offsets[linenum] : index->stamp.size;
+  /* Usually one read covers the line. More are only needed when stripped carriage returns leave room in the buffer. */
+  bool eol = false;
+  while (!eol && (linelen < linebuf_size - 1) && (start < end))
+  {
+    size_t want = linebuf_size - 1 - linelen;
+    if (want > end - start)
+    {
+      want = (size_t)(end - start);
+    }
+    char *chunk = linebuf + linelen;
+    int64_t got = srsFile_ReadNative(file, chunk, want, start);
+    if (got <= 0)
+    {
+      break;
+    }
+    start += (uint64_t)got;
+    /* Compact in place, dropping carriage returns and stopping at the newline */
+    for (int64_t i = 0; i < got; i++)
+    {
+      if (chunk[i] == '\n')
+      {
+        eol = true;
+        break;
+      }
+      if (chunk[i] != '\r')
+      {
+        linebuf[linelen] = chunk[i];
+        linelen++;
+      }
+    }
+  }
+  result = (int32_t)linelen;
+done:
+  if ((linebuf != NULL) && (linebuf_size > 0))
+  {
+    linebuf[linelen] = kiokuCHAR_NULL;
+  }
+  if (file != srsFILE_NATIVE_INVALID)
+  {
+    srsFile_CloseNative(file);
+  }
+  return result;
+}
+
+/* Indexes kept in memory by srsFile_ReadLineIndexed, replaced round-robin */
+#define srsLINE_INDEX_CACHE_COUNT 8
+static srsLINE_INDEX *srsLineIndex_CACHE[srsLINE_INDEX_CACHE_COUNT];
+static uint32_t srsLineIndex_CACHE_NEXT = 0;
+/* Bumped whenever indexes are invalidated, so one in use at the time is not put back */
+static uint32_t srsLineIndex_CACHE_GENERATION = 0;
+static srsSPINLOCK srsLineIndex_CACHE_LOCK = srsSPINLOCK_INIT;
+
+/* Keys relative paths by the CWD so a later change of directory cannot return another file's index. The stamp check would catch it anyway, but only after a wasted rebuild. */
+static bool srsLineIndex_GetCacheKey(const char *path, char *key, size_t key_size)
+{
+  int32_t needed;
+  if (srsPath_IsAbsolute(path))
+  {
+    needed = snprintf(key, key_size, "%s", path);
+  }
+  else
+  {
+    const char *cwd = srsDir_GetCWD();
+    needed = (cwd == NULL) ? -1 : kioku_path_concat(key, key_size, cwd, path);
+  }
+  return (needed > 0) && ((size_t)needed < key_size);
+}
+
+/* Returns an index to the cache after use. It is dropped instead if indexes were invalidated meanwhile, or if another thread put back one for the same file first. */
+static void srsLineIndex_PutBack(srsLINE_INDEX *index, uint32_t generation)
+{
+  srsLINE_INDEX *dropped = index;
+  srsSpinLock_Lock(&srsLineIndex_CACHE_LOCK);
+  bool present = (generation != srsLineIndex_CACHE_GENERATION);
+  uint32_t slot = srsLineIndex_CACHE_NEXT;
+  for (uint32_t i = 0; !present && (i < srsLINE_INDEX_CACHE_COUNT); i++)
+  {
+    if (srsLineIndex_CACHE[i] == NULL)
+    {
+      slot = i;
+    }
+    else if (strcmp(srsLineIndex_CACHE[i]->path, index->path) == 0)
+    {
+      present = true;
+    }
+  }
+  if (!present)
+  {
+    if (slot == srsLineIndex_CACHE_NEXT)
+    {
+      srsLineIndex_CACHE_NEXT = (srsLineIndex_CACHE_NEXT + 1) % srsLINE_INDEX_CACHE_COUNT;
+    }
+    dropped = srsLineIndex_CACHE[slot];
+    srsLineIndex_CACHE[slot] = index;
+  }
+  srsSpinLock_Unlock(&srsLineIndex_CACHE_LOCK);
+  srsLineIndex_Close(dropped);
+}
+
+int32_t srsFile_ReadLineIndexed(const char *path, uint32_t linenum, char *linebuf, size_t linebuf_size)
+{
+  int32_t result = -1;
+  char key[srsPATH_MAX + 1];
+  if ((path == NULL) || (linebuf == NULL) || (linebuf_size == 0) || !srsLineIndex_GetCacheKey(path, key, sizeof(key)))
+  {
+    return srsFile_ReadLineByNumber(path, linenum, linebuf, linebuf_size);
+  }
+  /* An index is taken out of the cache while it is used, since it serves one thread at a time. Building and reading happen outside of the lock, so one slow file does not hold up readers of the others. */
+  srsSpinLock_Lock(&srsLineIndex_CACHE_LOCK);
+  srsLINE_INDEX *index = NULL;
+  for (uint32_t i = 0; (index == NULL) && (i < srsLINE_INDEX_CACHE_COUNT); i++)
+  {
+    if ((srsLineIndex_CACHE[i] != NULL) && (strcmp(srsLineIndex_CACHE[i]->path, key) == 0))
+    {
+      index = srsLineIndex_CACHE[i];
+      srsLineIndex_CACHE[i] = NULL;
+    }
+  }
+  uint32_t generation = srsLineIndex_CACHE_GENERATION;
+  srsSpinLock_Unlock(&srsLineIndex_CACHE_LOCK);
+  if (index == NULL)
+  {
+    index = srsLineIndex_Open(key, true);
+  }
+  if (index == NULL)
+  {
+    /* The file exists but could not be indexed, e.g. because it is too large */
+    return srsFile_ReadLineByNumber(path, linenum, linebuf, linebuf_size);
+  }
+  result = srsLineIndex_ReadLine(index, linenum, linebuf, linebuf_size);
+  srsLineIndex_PutBack(index, generation);
+  return result;
+}
+
+int32_t srsFile_ReadLineIndexedAt(srsDIR *dir, const char *path, uint32_t linenum, char *linebuf, size_t linebuf_size)
+{
+  char joined[srsPATH_MAX + 1];
+  if ((dir == NULL) || (path == NULL) || srsPath_IsAbsolute(path))
+  {
+    return srsFile_ReadLineIndexed(path, linenum, linebuf, linebuf_size);
+  }
+  /* Indexes are cached by absolute path, so resolve against the handle's path rather than the CWD */
+  int32_t needed = kioku_path_concat(joined, sizeof(joined), srsDir_GetPath(dir), path);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(joined)))
+  {
+    if ((linebuf != NULL) && (linebuf_size > 0))
+    {
+      linebuf[0] = kiokuCHAR_NULL;
+    }
+    return -1;
+  }
+  return srsFile_ReadLineIndexed(joined, linenum, linebuf, linebuf_size);
+}
+
+void srsFileSystem_Invalidate(const char *path)
+{
+  char key[srsPATH_MAX + 1];
+  srsStatCache_Forget(NULL, path);
+  if ((path == NULL) || !srsLineIndex_GetCacheKey(path, key, sizeof(key)))
+  {
+    return;
+  }
+  size_t keylen = strlen(key);
+  while ((keylen > 1) && (key[keylen - 1] == '/'))
+  {
+    keylen--;
+  }
+  srsLINE_INDEX *dropped[srsLINE_INDEX_CACHE_COUNT];
+  uint32_t dropped_count = 0;
+  srsSpinLock_Lock(&srsLineIndex_CACHE_LOCK);
+  srsLineIndex_CACHE_GENERATION++;
+  for (uint32_t i = 0; i < srsLINE_INDEX_CACHE_COUNT; i++)
+  {
+    const srsLINE_INDEX *index = srsLineIndex_CACHE[i];
+    if ((index != NULL) && (strncmp(index->path, key, keylen) == 0) && ((index->path[keylen] == kiokuCHAR_NULL) || (index->path[keylen] == '/')))
+    {
+      dropped[dropped_count++] = srsLineIndex_CACHE[i];
+      srsLineIndex_CACHE[i] = NULL;
+    }
+  }
+  srsSpinLock_Unlock(&srsLineIndex_CACHE_LOCK);
+  /* Free outside the lock so readers of other files are not held up */
+  for (uint32_t i = 0; i < dropped_count; i++)
+  {
+    srsLineIndex_Close(dropped[i]);
+  }
+}
+
+void srsFileSystem_InvalidateAt(srsDIR *dir, const char *path)
+{
+  char joined[srsPATH_MAX + 1];
+  if ((dir == NULL) || (path == NULL) || srsPath_IsAbsolute(path))
+  {
+    srsFileSystem_Invalidate(path);
+    return;
+  }
+  int32_t needed = kioku_path_concat(joined, sizeof(joined), srsDir_GetPath(dir), path);
+  if ((needed > 0) && ((size_t)needed < sizeof(joined)))
+  {
+    srsFileSystem_Invalidate(joined);
+  }
+  else
+  {
+    srsStatCache_Invalidate(NULL);
+  }
+}
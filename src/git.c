@@ -4,10 +4,22 @@
 #include "kioku/log.h"
 #include "kioku/result.h"
 #include "kioku/error.h"
+#include "kioku/thread.h"
+#include <stdlib.h>
 #include <string.h>
 
-static git_repository *srsGit_REPO = NULL;
-static char *srsGit_REPO_PATH = NULL;
+/**
+ * An open repository. Operations on it are serialized by its lock, so one repository may be handed between threads, while separate repositories are used concurrently.
+ */
+struct _srsGIT_REPO_s
+{
+  git_repository *repo;
+  char *path;
+  srsMUTEX lock;
+};
+
+/* The repository the srsGit_Repo_* functions work with */
+static srsGIT_REPO *srsGit_CURRENT = NULL;
 static int srsGIT_READY = 0;
 /** Useful resources:
  *  - https://libgit2.github.com/docs/guides/101-samples/
@@ -46,16 +58,25 @@ uint32_t srsGit_InitCount()
   return srsGIT_READY;
 }
 
-void srsGit_Repo_Close()
+void srsGitRepo_Close(srsGIT_REPO *repo)
 {
   /* \todo The docs say that any objects associated with the freed repo will remain until freed, and accessing them without their backing repo will result in undefined behaviour. Come up with a strategy to ensure they are all freed here, or at least assert that there's nothing remaining (since not freeing them would be the fault of the programmer). */
-  if (srsGit_REPO != NULL)
+  if (repo == NULL)
   {
-    git_repository_free(srsGit_REPO);
-    srsGit_REPO = NULL;
+    return;
   }
-  free(srsGit_REPO_PATH);
-  srsGit_REPO_PATH = NULL;
+  git_repository_free(repo->repo);
+  free(repo->path);
+  srsMutex_Destroy(&repo->lock);
+  free(repo);
+  /* Balances the init of opening it */
+  srsGIT_EXIT_LIB();
+}
+
+void srsGit_Repo_Close()
+{
+  srsGitRepo_Close(srsGit_CURRENT);
+  srsGit_CURRENT = NULL;
 }
 
 bool srsGit_Shutdown()
@@ -88,24 +109,177 @@ bool srsGit_IsRepo(const char *path)
   return result;
 }
 
+/* Wraps a freshly opened or created repository, taking ownership of it */
+static srsGIT_REPO *srsGitRepo_Wrap(git_repository *git_repo)
+{
+  srsGIT_REPO *repo = calloc(1, sizeof(*repo));
+  const char *workdir = git_repository_workdir(git_repo);
+  if ((repo == NULL) || (workdir == NULL) || ((repo->path = strdup(workdir)) == NULL) || !srsMutex_Init(&repo->lock))
+  {
+    if (repo != NULL)
+    {
+      free(repo->path);
+    }
+    free(repo);
+    git_repository_free(git_repo);
+    return NULL;
+  }
+  repo->repo = git_repo;
+  return repo;
+}
+
+const char *srsGitRepo_GetPath(const srsGIT_REPO *repo)
+{
+  return (repo == NULL) ? NULL : repo->path;
+}
+
 const char *srsGit_Repo_GetCurrent()
 {
-  if (srsGit_REPO != NULL)
+  return srsGitRepo_GetPath(srsGit_CURRENT);
+}
+
+srsGIT_REPO *srsGit_Repo_GetCurrentRepo()
+{
+  return srsGit_CURRENT;
+}
+
+bool srsGitRepo_GetHead(srsGIT_REPO *repo, char *oid_out, size_t oid_out_size)
+{
+  bool result = false;
+  git_oid oid;
+  if ((repo == NULL) || (oid_out == NULL) || (oid_out_size < srsGIT_OID_STRING_SIZE))
   {
-    if (srsGit_REPO_PATH == NULL)
+    return false;
+  }
+  srsGIT_INIT_LIB();
+  srsMutex_Lock(&repo->lock);
+  result = (git_reference_name_to_id(&oid, repo->repo, "HEAD") == 0);
+  srsMutex_Unlock(&repo->lock);
+  if (result)
+  {
+    git_oid_tostr(oid_out, oid_out_size, &oid);
+  }
+  srsGIT_EXIT_LIB();
+  return result;
+}
+
+bool srsGit_Repo_GetHead(char *oid_out, size_t oid_out_size)
+{
+  return srsGitRepo_GetHead(srsGit_CURRENT, oid_out, oid_out_size);
+}
+
+/* Visits the files a commit added or changed compared to its first parent */
+static bool srsGit_VisitCommit(git_repository *repo, git_commit *commit, const git_diff_options *options, srsGIT_HISTORY_FUNC func, void *userdata, bool *stop)
+{
+  bool result = false;
+  git_commit *parent = NULL;
+  git_tree *tree = NULL;
+  git_tree *parent_tree = NULL;
+  git_diff *diff = NULL;
+  size_t i = 0;
+  int64_t time = (int64_t)git_commit_time(commit) + (int64_t)git_commit_time_offset(commit) * 60;
+  if ((git_commit_tree(&tree, commit) != 0) || ((git_commit_parentcount(commit) > 0) && ((git_commit_parent(&parent, commit, 0) != 0) || (git_commit_tree(&parent_tree, parent) != 0))))
+  {
+    goto done;
+  }
+  if (git_diff_tree_to_tree(&diff, repo, parent_tree, tree, options) != 0)
+  {
+    goto done;
+  }
+  result = true;
+  for (i = 0; result && !*stop && (i < git_diff_num_deltas(diff)); i++)
+  {
+    const git_diff_delta *delta = git_diff_get_delta(diff, i);
+    git_blob *blob = NULL;
+    if ((delta->status != GIT_DELTA_ADDED) && (delta->status != GIT_DELTA_MODIFIED))
     {
-      srsGIT_INIT_LIB();
-      const char *workdir = git_repository_workdir(srsGit_REPO);
-      srsGIT_EXIT_LIB();
-      srsGit_REPO_PATH = strdup(workdir);
+      continue;
+    }
+    result = (git_blob_lookup(&blob, repo, &delta->new_file.id) == 0);
+    if (result)
+    {
+      *stop = !func(delta->new_file.path, (const char *)git_blob_rawcontent(blob), (size_t)git_blob_rawsize(blob), time, userdata);
+      git_blob_free(blob);
     }
   }
-  return srsGit_REPO_PATH;
+done:
+  git_diff_free(diff);
+  git_tree_free(parent_tree);
+  git_tree_free(tree);
+  git_commit_free(parent);
+  return result;
 }
 
-srsRESULT srsGit_Repo_Open(const char *path)
+bool srsGitRepo_WalkHistory(srsGIT_REPO *repo, const char *pathspec, srsGIT_HISTORY_FUNC func, void *userdata)
 {
+  bool result = false;
+  bool stop = false;
+  git_revwalk *walk = NULL;
+  git_oid oid;
+  char *patterns[1] = {(char *)pathspec};
+  git_diff_options options = GIT_DIFF_OPTIONS_INIT;
+  if ((repo == NULL) || (func == NULL))
+  {
+    return false;
+  }
+  if (pathspec != NULL)
+  {
+    options.pathspec.strings = patterns;
+    options.pathspec.count = 1;
+  }
   srsGIT_INIT_LIB();
+  srsMutex_Lock(&repo->lock);
+  if ((git_revwalk_new(&walk, repo->repo) != 0) || (git_revwalk_push_head(walk) != 0))
+  {
+    srsLOG_ERROR("Unable to walk the history of %s", repo->path);
+    goto done;
+  }
+  git_revwalk_sorting(walk, GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+  git_revwalk_simplify_first_parent(walk);
+  result = true;
+  while (result && !stop && (git_revwalk_next(&oid, walk) == 0))
+  {
+    git_commit *commit = NULL;
+    result = (git_commit_lookup(&commit, repo->repo, &oid) == 0) && srsGit_VisitCommit(repo->repo, commit, &options, func, userdata, &stop);
+    git_commit_free(commit);
+  }
+  if (!result)
+  {
+    const git_error *error = giterr_last();
+    srsLOG_ERROR("Unable to read commit %s: %s", git_oid_tostr_s(&oid), (error != NULL) ? error->message : "unknown error");
+  }
+done:
+  git_revwalk_free(walk);
+  srsMutex_Unlock(&repo->lock);
+  srsGIT_EXIT_LIB();
+  return result;
+}
+
+bool srsGit_Repo_WalkHistory(const char *pathspec, srsGIT_HISTORY_FUNC func, void *userdata)
+{
+  return srsGitRepo_WalkHistory(srsGit_CURRENT, pathspec, func, userdata);
+}
+
+srsGIT_REPO *srsGitRepo_Open(const char *path)
+{
+  git_repository *git_repo = NULL;
+  srsGIT_INIT_LIB();
+  if (git_repository_open(&git_repo, path) != 0)
+  {
+    srsGIT_EXIT_LIB();
+    return NULL;
+  }
+  /* We do not call srsGIT_EXIT_LIB here because we want the user to be able to continue using the repository. Closing it does. */
+  srsGIT_REPO *repo = srsGitRepo_Wrap(git_repo);
+  if (repo == NULL)
+  {
+    srsGIT_EXIT_LIB();
+  }
+  return repo;
+}
+
+srsRESULT srsGit_Repo_Open(const char *path)
+{
   /* Free the current repository first, if any */
   const char *currepo = srsGit_Repo_GetCurrent();
   if (currepo != NULL)
@@ -113,16 +287,9 @@ srsRESULT srsGit_Repo_Open(const char *path)
     srsLOG_PRINT("Closing out %s before opening %s", currepo, path);
     srsGit_Repo_Close();
   }
-  srsASSERT(srsGit_REPO == NULL);
-  srsASSERT(srsGit_REPO_PATH == NULL);
-
-  int git_result = git_repository_open(&srsGit_REPO, path);
-  if (git_result != 0)
-  {
-    return srsFAIL;
-  }
-  /* We do not call srsGIT_EXIT_LIB here because we want the user to be able to continue using the repository */
-  return srsOK;
+  srsASSERT(srsGit_CURRENT == NULL);
+  srsGit_CURRENT = srsGitRepo_Open(path);
+  return (srsGit_CURRENT != NULL) ? srsOK : srsFAIL;
 }
 
 #if 0
@@ -131,7 +298,8 @@ bool srsGit_Repo_Clone(const char *path, const char *remote_url)
   bool result = false;
   git_clone_options opts = GIT_CLONE_OPTIONS_INIT;
   srsGIT_INIT_LIB();
-  int git_result = git_clone(&srsGit_REPO, remote_url, path, &opts);
+  git_repository *git_repo = NULL;
+  int git_result = git_clone(&git_repo, remote_url, path, &opts);
   /* \todo handle errors */
   result = git_result == GIT_OK;
   srsGIT_EXIT_LIB();
@@ -139,10 +307,12 @@ bool srsGit_Repo_Clone(const char *path, const char *remote_url)
 }
 #endif
 
-bool srsGit_Repo_Create(const char *path, const srsGIT_CREATE_OPTS opts)
+srsGIT_REPO *srsGitRepo_Create(const char *path, const srsGIT_CREATE_OPTS opts)
 {
   bool result = false;
   char *fullpath = NULL;
+  git_repository *git_repo = NULL;
+  srsGIT_REPO *repo = NULL;
   /* Replace opts accordingly */
   /** TODO Test defaulting of opts */
   srsGIT_CREATE_OPTS opts_default = srsGIT_CREATE_OPTS_INIT;
@@ -156,20 +326,26 @@ bool srsGit_Repo_Create(const char *path, const srsGIT_CREATE_OPTS opts)
   srsGIT_INIT_LIB();
 
   gitinitopts.flags = GIT_REPOSITORY_INIT_MKPATH;
-  int git_result = git_repository_init_ext(&srsGit_REPO, path, &gitinitopts);
+  int git_result = git_repository_init_ext(&git_repo, path, &gitinitopts);
   if (git_result != 0)
   {
     srsGIT_DEBUG_ERROR();
     srsGIT_EXIT_LIB();
-    return result;
+    return NULL;
+  }
+  repo = srsGitRepo_Wrap(git_repo);
+  if (repo == NULL)
+  {
+    srsGIT_EXIT_LIB();
+    return NULL;
   }
 
   int32_t pathlen = kioku_path_concat(NULL, 0, path, opts_copy.first_file_name);
   if (pathlen <= 0)
   {
     srsLOG_ERROR("Couldn't calculate pathlength for %s", opts_copy.first_file_name);
-    srsGIT_EXIT_LIB();
-    return result;
+    srsGitRepo_Close(repo);
+    return NULL;
   }
   fullpath = malloc(pathlen + 1);
   int32_t wrote = kioku_path_concat(fullpath, pathlen + 1, path, opts_copy.first_file_name);
@@ -185,21 +361,32 @@ bool srsGit_Repo_Create(const char *path, const srsGIT_CREATE_OPTS opts)
   if (result)
   {
     srsLOG_PRINT("Running add...");
-    result = srsGit_Add(opts_copy.first_file_name);
+    result = srsGitRepo_Add(repo, opts_copy.first_file_name);
   }
   if (result)
   {
     srsLOG_PRINT("Running commit...");
-    result = srsGit_Commit(opts_copy.first_commit_message);
+    result = srsGitRepo_Commit(repo, opts_copy.first_commit_message);
   }
   free(fullpath);
 
-  /* We do not call srsGIT_EXIT_LIB here because we want the user to be able to continue using the repository */
+  /* We do not call srsGIT_EXIT_LIB here because we want the user to be able to continue using the repository. Closing it does. */
+  if (!result)
+  {
+    srsGitRepo_Close(repo);
+    repo = NULL;
+  }
+  return repo;
+}
 
-  return result;
+bool srsGit_Repo_Create(const char *path, const srsGIT_CREATE_OPTS opts)
+{
+  srsGit_Repo_Close();
+  srsGit_CURRENT = srsGitRepo_Create(path, opts);
+  return srsGit_CURRENT != NULL;
 }
 
-bool srsGit_Commit(const char *message)
+bool srsGitRepo_Commit(srsGIT_REPO *repo, const char *message)
 {
   int git_result = GIT_OK;
   bool result = true;
@@ -208,15 +395,16 @@ bool srsGit_Commit(const char *message)
 	git_commit *parent;
 	char oid_hex[GIT_OID_HEXSZ+1] = { 0 };
 	git_index *index;
-  if (srsGit_REPO == NULL)
+  if (repo == NULL)
   {
     return false;
   }
 
   srsGIT_INIT_LIB();
+  srsMutex_Lock(&repo->lock);
 
   /* Try to open the index */
-  git_result = git_repository_index(&index, srsGit_REPO);
+  git_result = git_repository_index(&index, repo->repo);
   result = result && (git_result == 0);
   if (!result)
   {
@@ -225,7 +413,7 @@ bool srsGit_Commit(const char *message)
   }
 
   /* See if this is the first commit */
-  git_result = git_repository_head_unborn(srsGit_REPO);
+  git_result = git_repository_head_unborn(repo->repo);
   result = result && (git_result == 0 || git_result == 1);
   if (git_result == 1)
   {
@@ -263,11 +451,11 @@ bool srsGit_Commit(const char *message)
 	 * but you can also use
 	 */
 
-  /* git_result = git_reference_name_to_id(&oid, srsGit_REPO, "HEAD"); */
-	git_result = git_tree_lookup(&tree, srsGit_REPO, &oid);
+  /* git_result = git_reference_name_to_id(&oid, repo->repo, "HEAD"); */
+	git_result = git_tree_lookup(&tree, repo->repo, &oid);
   result = result && (git_result == 0);
   srsASSERT_MSG(result, "failed to lookup tree");
-  git_result = git_repository_head_unborn(srsGit_REPO);
+  git_result = git_repository_head_unborn(repo->repo);
   result = result && (git_result == 0 || git_result == 1);
   if (git_result == 1)
   {
@@ -275,7 +463,7 @@ bool srsGit_Commit(const char *message)
   }
   else if (git_result == 0)
   {
-    git_result = git_commit_lookup(&parent, srsGit_REPO, &oid);
+    git_result = git_commit_lookup(&parent, repo->repo, &oid);
     result = result && (git_result == 0);
     if (!result)
     {
@@ -302,7 +490,7 @@ bool srsGit_Commit(const char *message)
 	 */
 	git_result = git_commit_create(
     &commit_id, /* out id */
-    srsGit_REPO,
+    repo->repo,
     "HEAD", /* name of ref to update */
     me, me, /* author & committer */
     "UTF-8",
@@ -332,12 +520,18 @@ bool srsGit_Commit(const char *message)
   }
 	git_signature_free(me);
 
+  srsMutex_Unlock(&repo->lock);
   srsGIT_EXIT_LIB();
 
   return result;
 }
 
-bool srsGit_Add(const char *path)
+bool srsGit_Commit(const char *message)
+{
+  return srsGitRepo_Commit(srsGit_CURRENT, message);
+}
+
+bool srsGitRepo_Add(srsGIT_REPO *repo, const char *path)
 {
   bool result = true;
   int git_result = 0;
@@ -345,20 +539,21 @@ bool srsGit_Add(const char *path)
 	git_tree *tree = NULL;
 	git_index *index = NULL;
 
-  if (srsGit_REPO == NULL)
+  if (repo == NULL)
   {
     return false;
   }
 
   srsGIT_INIT_LIB();
+  srsMutex_Lock(&repo->lock);
 
   /* See if this is the first commit */
-  git_result = git_repository_head_unborn(srsGit_REPO);
+  git_result = git_repository_head_unborn(repo->repo);
   if (git_result == 1)
   {
     srsLOG_PRINT("Adding - Unborn HEAD");
   }
-  git_result = git_repository_index(&index, srsGit_REPO);
+  git_result = git_repository_index(&index, repo->repo);
   result = result && (git_result == 0) && (index != NULL);
   if (!result)
   {
@@ -372,7 +567,7 @@ bool srsGit_Add(const char *path)
     srsLOG_ERROR("Unable to write initial tree from index");
     abort();
   }
-  git_result = git_tree_lookup(&tree, srsGit_REPO, &oid);
+  git_result = git_tree_lookup(&tree, repo->repo, &oid);
   result = result && (git_result == 0) && (tree != NULL);
   if (!result)
   {
@@ -380,7 +575,7 @@ bool srsGit_Add(const char *path)
     abort();
   }
 
-  const char *repo_path = srsGit_Repo_GetCurrent();
+  const char *repo_path = repo->path;
   srsLOG_PRINT("Adding %s to %s", path, repo_path);
   git_result = git_index_add_bypath(index, path);
 
@@ -398,8 +593,14 @@ bool srsGit_Add(const char *path)
 	git_tree_free(tree);
 
   assert(count == 1);
+  srsMutex_Unlock(&repo->lock);
   srsGIT_EXIT_LIB();
 
   return result;
 }
 
+bool srsGit_Add(const char *path)
+{
+  return srsGitRepo_Add(srsGit_CURRENT, path);
+}
+
@@ -0,0 +1,711 @@
+#include "kioku/io.h"
+#include "kioku/thread.h"
+#include "kioku/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef kiokuOS_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined kiokuOS_LINUX
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h> /* struct statx */
+/* Only build the io_uring backend when the headers know every operation we submit */
+#if defined __NR_io_uring_setup && defined IO_URING_OP_SUPPORTED
+#define srsIO_URING
+#endif
+#endif
+
+/* Upper bound on the size of the fallback thread pool, including the submitting thread */
+#define srsIO_POOL_MAX_THREADS 4
+
+#ifdef srsIO_URING
+typedef struct _srsIO_URING_s
+{
+  int fd;
+  uint32_t entries;
+  void *sq_ring;
+  size_t sq_ring_size;
+  void *cq_ring;
+  size_t cq_ring_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  /* Per-slot state for the chunk of requests currently in flight */
+  int *fds;
+  struct statx *statxs;
+} srsIO_URING_STATE;
+#endif
+
+struct _srsIO_ENGINE_s
+{
+#ifdef srsIO_URING
+  bool async;
+  srsIO_URING_STATE ring;
+#endif
+  /* Thread pool */
+  uint32_t thread_count;
+  srsTHREAD threads[srsIO_POOL_MAX_THREADS];
+  srsMUTEX lock;
+  srsCOND work_cond;
+  srsCOND done_cond;
+  uint32_t generation;
+  bool shutdown;
+  uint32_t active;
+  srsIO_REQUEST *batch;
+  size_t batch_count;
+  srsATOMIC32 next;
+  srsATOMIC32 done;
+};
+
+static int64_t srsIO_Errno()
+{
+  return (errno != 0) ? -(int64_t)errno : -EIO;
+}
+
+/* Finishes a transfer that came back short, which regular files only do when interrupted or near EOF */
+static int64_t srsIO_Transfer(int fd, srsIO_REQUEST *request, size_t done)
+{
+  while (done < request->size)
+  {
+#ifdef kiokuOS_WINDOWS
+    int moved = (request->op == srsIO_READ) ? _read(fd, request->buffer + done, (unsigned)(request->size - done)) : _write(fd, request->buffer + done, (unsigned)(request->size - done));
+#else
+    ssize_t moved = (request->op == srsIO_READ) ? pread(fd, request->buffer + done, request->size - done, (off_t)done) : pwrite(fd, request->buffer + done, request->size - done, (off_t)done);
+#endif
+    if (moved < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      return srsIO_Errno();
+    }
+    if (moved == 0)
+    {
+      break;
+    }
+    done += (size_t)moved;
+  }
+  return (int64_t)done;
+}
+
+/* Flushes an open file to stable storage */
+static int64_t srsIO_Sync(int fd)
+{
+#if defined kiokuOS_WINDOWS
+  return (_commit(fd) == 0) ? 0 : srsIO_Errno();
+#elif defined kiokuOS_APPLE
+  /* fsync only reaches the drive's cache on Apple platforms */
+  return ((fcntl(fd, F_FULLFSYNC) == 0) || (fsync(fd) == 0)) ? 0 : srsIO_Errno();
+#else
+  while (fsync(fd) != 0)
+  {
+    if (errno != EINTR)
+    {
+      return srsIO_Errno();
+    }
+  }
+  return 0;
+#endif
+}
+
+static int srsIO_OpenFlags(const srsIO_REQUEST *request)
+{
+#ifdef kiokuOS_WINDOWS
+  int flags = _O_BINARY;
+  if (request->op == srsIO_SYNC)
+  {
+    /* _commit needs write access */
+    return flags | _O_RDWR;
+  }
+  flags |= (request->op == srsIO_READ) ? _O_RDONLY : (_O_WRONLY | _O_TRUNC);
+  flags |= ((request->op == srsIO_WRITE) && (request->flags & srsIO_FLAG_CREATE)) ? _O_CREAT : 0;
+#else
+  int flags = O_CLOEXEC;
+  if (request->op == srsIO_SYNC)
+  {
+    /* Read-only is enough to sync, and is the only way to open a directory */
+    return flags | O_RDONLY;
+  }
+  flags |= (request->op == srsIO_READ) ? O_RDONLY : (O_WRONLY | O_TRUNC);
+  flags |= ((request->op == srsIO_WRITE) && (request->flags & srsIO_FLAG_CREATE)) ? O_CREAT : 0;
+#endif
+  return flags;
+}
+
+/* Performs one request with blocking calls */
+static void srsIO_Execute(srsIO_REQUEST *request)
+{
+  errno = 0;
+#ifdef kiokuOS_WINDOWS
+  char resolved[srsPATH_MAX + 1];
+  const char *path = request->path;
+  if ((request->dir != NULL) && !srsPath_IsAbsolute(path))
+  {
+    int32_t needed = kioku_path_concat(resolved, sizeof(resolved), srsDir_GetPath(request->dir), path);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(resolved)))
+    {
+      request->result = -ENAMETOOLONG;
+      return;
+    }
+    path = resolved;
+  }
+  if (request->op == srsIO_STAT)
+  {
+    struct _stat64 statbuf;
+    if (_stat64(path, &statbuf) != 0)
+    {
+      request->result = srsIO_Errno();
+      return;
+    }
+    request->file_size = (uint64_t)statbuf.st_size;
+    request->mtime_sec = (int64_t)statbuf.st_mtime;
+    request->mtime_nsec = 0;
+    request->is_dir = ((statbuf.st_mode & _S_IFDIR) != 0);
+    request->result = 0;
+    return;
+  }
+  int fd = _open(path, srsIO_OpenFlags(request), _S_IREAD | _S_IWRITE);
+  if (fd < 0)
+  {
+    request->result = srsIO_Errno();
+    return;
+  }
+  request->result = (request->op == srsIO_SYNC) ? srsIO_Sync(fd) : srsIO_Transfer(fd, request, 0);
+  _close(fd);
+#else
+  int dirfd = srsDir_GetDescriptor(request->dir);
+  if (request->op == srsIO_STAT)
+  {
+    struct stat statbuf;
+    if (fstatat(dirfd, request->path, &statbuf, 0) != 0)
+    {
+      request->result = srsIO_Errno();
+      return;
+    }
+    request->file_size = (uint64_t)statbuf.st_size;
+    request->mtime_sec = (int64_t)statbuf.st_mtime;
+  #if defined kiokuOS_APPLE
+    request->mtime_nsec = (int64_t)statbuf.st_mtimespec.tv_nsec;
+  #else
+    request->mtime_nsec = (int64_t)statbuf.st_mtim.tv_nsec;
+  #endif
+    request->is_dir = S_ISDIR(statbuf.st_mode);
+    request->result = 0;
+    return;
+  }
+  int fd = openat(dirfd, request->path, srsIO_OpenFlags(request), 0666);
+  if (fd < 0)
+  {
+    request->result = srsIO_Errno();
+    return;
+  }
+  request->result = (request->op == srsIO_SYNC) ? srsIO_Sync(fd) : srsIO_Transfer(fd, request, 0);
+  close(fd);
+#endif
+}
+
+/* Claims and executes requests of the current batch until none are left */
+static void srsIO_Drain(srsIO_ENGINE *engine, srsIO_REQUEST *batch, size_t count)
+{
+  for (;;)
+  {
+    int32_t index = srsAtomic_Add(&engine->next, 1) - 1;
+    if ((index < 0) || ((size_t)index >= count))
+    {
+      return;
+    }
+    srsIO_Execute(&batch[index]);
+    srsAtomic_Add(&engine->done, 1);
+  }
+}
+
+static void *srsIO_Worker(void *arg)
+{
+  srsIO_ENGINE *engine = arg;
+  uint32_t seen = 0;
+  for (;;)
+  {
+    srsMutex_Lock(&engine->lock);
+    while (!engine->shutdown && (engine->generation == seen))
+    {
+      srsCond_Wait(&engine->work_cond, &engine->lock);
+    }
+    if (engine->shutdown)
+    {
+      srsMutex_Unlock(&engine->lock);
+      return NULL;
+    }
+    seen = engine->generation;
+    srsIO_REQUEST *batch = engine->batch;
+    size_t count = engine->batch_count;
+    /* The submitter waits for active workers too, so a straggler can never claim an index of the next batch */
+    engine->active++;
+    srsMutex_Unlock(&engine->lock);
+
+    srsIO_Drain(engine, batch, count);
+
+    srsMutex_Lock(&engine->lock);
+    engine->active--;
+    srsCond_Signal(&engine->done_cond);
+    srsMutex_Unlock(&engine->lock);
+  }
+}
+
+static bool srsIO_SubmitBlocking(srsIO_ENGINE *engine, srsIO_REQUEST *requests, size_t count)
+{
+  if (count > INT32_MAX)
+  {
+    return false;
+  }
+  srsMutex_Lock(&engine->lock);
+  engine->batch = requests;
+  engine->batch_count = count;
+  srsAtomic_Store(&engine->next, 0);
+  srsAtomic_Store(&engine->done, 0);
+  engine->generation++;
+  srsCond_Broadcast(&engine->work_cond);
+  srsMutex_Unlock(&engine->lock);
+
+  srsIO_Drain(engine, requests, count);
+
+  srsMutex_Lock(&engine->lock);
+  while (((size_t)srsAtomic_Load(&engine->done) < count) || (engine->active > 0))
+  {
+    srsCond_Wait(&engine->done_cond, &engine->lock);
+  }
+  engine->batch = NULL;
+  engine->batch_count = 0;
+  srsMutex_Unlock(&engine->lock);
+  return true;
+}
+
+#ifdef srsIO_URING
+static void srsIO_Uring_Close(srsIO_URING_STATE *ring)
+{
+  free(ring->fds);
+  free(ring->statxs);
+  if (ring->sqes != NULL)
+  {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if ((ring->cq_ring != NULL) && (ring->cq_ring != ring->sq_ring))
+  {
+    munmap(ring->cq_ring, ring->cq_ring_size);
+  }
+  if (ring->sq_ring != NULL)
+  {
+    munmap(ring->sq_ring, ring->sq_ring_size);
+  }
+  if (ring->fd >= 0)
+  {
+    close(ring->fd);
+  }
+  memset(ring, 0, sizeof(*ring));
+  ring->fd = -1;
+}
+
+/* Sets up a ring and makes sure the kernel supports every operation we use, which were all available by 5.6 */
+static bool srsIO_Uring_Open(srsIO_URING_STATE *ring, uint32_t depth)
+{
+  struct io_uring_params params;
+  memset(ring, 0, sizeof(*ring));
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+  if (ring->fd < 0)
+  {
+    ring->fd = -1;
+    return false;
+  }
+  const size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe = calloc(1, probe_size);
+  if (probe == NULL)
+  {
+    goto fail;
+  }
+  bool supported = (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) >= 0);
+  const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_CLOSE, IORING_OP_STATX};
+  for (size_t i = 0; supported && (i < sizeof(ops) / sizeof(ops[0])); i++)
+  {
+    supported = (ops[i] <= probe->last_op) && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+  }
+  free(probe);
+  if (!supported)
+  {
+    goto fail;
+  }
+  ring->entries = params.sq_entries;
+  ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (ring->cq_ring_size > ring->sq_ring_size)
+    {
+      ring->sq_ring_size = ring->cq_ring_size;
+    }
+    ring->cq_ring_size = ring->sq_ring_size;
+  }
+  ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ring == MAP_FAILED)
+  {
+    ring->sq_ring = NULL;
+    goto fail;
+  }
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    ring->cq_ring = ring->sq_ring;
+  }
+  else
+  {
+    ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED)
+    {
+      ring->cq_ring = NULL;
+      goto fail;
+    }
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+  {
+    ring->sqes = NULL;
+    goto fail;
+  }
+  ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+  ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+  ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+  ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+  ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+  ring->fds = malloc(ring->entries * sizeof(*ring->fds));
+  ring->statxs = malloc(ring->entries * sizeof(*ring->statxs));
+  if ((ring->fds == NULL) || (ring->statxs == NULL))
+  {
+    goto fail;
+  }
+  return true;
+fail:
+  srsIO_Uring_Close(ring);
+  return false;
+}
+
+static struct io_uring_sqe *srsIO_Uring_GetSQE(srsIO_URING_STATE *ring, unsigned *tail)
+{
+  unsigned index = *tail & *ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  ring->sq_array[index] = index;
+  (*tail)++;
+  return sqe;
+}
+
+/* Publishes queued entries and waits until all of them complete, passing each result to its slot. Returns false if the ring itself failed. */
+static bool srsIO_Uring_Run(srsIO_URING_STATE *ring, unsigned tail, unsigned queued, int64_t *results)
+{
+  __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+  unsigned completed = 0;
+  unsigned to_submit = queued;
+  while (completed < queued)
+  {
+    int entered = (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, queued - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (entered < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      srsLOG_ERROR("io_uring_enter failed: %s", strerror(errno));
+      return false;
+    }
+    to_submit -= ((unsigned)entered < to_submit) ? (unsigned)entered : to_submit;
+    unsigned head = *ring->cq_head;
+    unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != cq_tail; head++)
+    {
+      struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+      results[cqe->user_data] = cqe->res;
+      completed++;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+  }
+  return true;
+}
+
+/* Each chunk of requests runs in three round trips: open (or statx), transfer (or fsync), and close */
+static bool srsIO_SubmitUring(srsIO_ENGINE *engine, srsIO_REQUEST *requests, size_t count)
+{
+  srsIO_URING_STATE *ring = &engine->ring;
+  int64_t *results = malloc(ring->entries * sizeof(*results));
+  if (results == NULL)
+  {
+    return false;
+  }
+  bool ok = true;
+  for (size_t base = 0; ok && (base < count); base += ring->entries)
+  {
+    size_t chunk = ((count - base) < ring->entries) ? (count - base) : ring->entries;
+    srsIO_REQUEST *batch = &requests[base];
+    unsigned tail = *ring->sq_tail;
+    unsigned queued = 0;
+    /* Open files and stat paths */
+    for (size_t i = 0; i < chunk; i++)
+    {
+      struct io_uring_sqe *sqe = srsIO_Uring_GetSQE(ring, &tail);
+      sqe->fd = srsDir_GetDescriptor(batch[i].dir);
+      sqe->addr = (uint64_t)(uintptr_t)batch[i].path;
+      sqe->user_data = i;
+      if (batch[i].op == srsIO_STAT)
+      {
+        sqe->opcode = IORING_OP_STATX;
+        sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+        sqe->off = (uint64_t)(uintptr_t)&ring->statxs[i];
+      }
+      else
+      {
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->open_flags = (uint32_t)srsIO_OpenFlags(&batch[i]);
+        sqe->len = 0666;
+      }
+      queued++;
+    }
+    ok = srsIO_Uring_Run(ring, tail, queued, results);
+    if (!ok)
+    {
+      break;
+    }
+    /* Transfer data for, or sync, everything that opened */
+    tail = *ring->sq_tail;
+    queued = 0;
+    for (size_t i = 0; i < chunk; i++)
+    {
+      ring->fds[i] = -1;
+      if (batch[i].op == srsIO_STAT)
+      {
+        batch[i].result = results[i];
+        if (results[i] == 0)
+        {
+          struct statx *stx = &ring->statxs[i];
+          batch[i].file_size = stx->stx_size;
+          batch[i].mtime_sec = stx->stx_mtime.tv_sec;
+          batch[i].mtime_nsec = stx->stx_mtime.tv_nsec;
+          batch[i].is_dir = S_ISDIR(stx->stx_mode);
+        }
+        continue;
+      }
+      if (results[i] < 0)
+      {
+        batch[i].result = results[i];
+        continue;
+      }
+      ring->fds[i] = (int)results[i];
+      struct io_uring_sqe *sqe = srsIO_Uring_GetSQE(ring, &tail);
+      sqe->fd = ring->fds[i];
+      sqe->user_data = i;
+      queued++;
+      if (batch[i].op == srsIO_SYNC)
+      {
+        sqe->opcode = IORING_OP_FSYNC;
+        continue;
+      }
+      sqe->opcode = (batch[i].op == srsIO_READ) ? IORING_OP_READ : IORING_OP_WRITE;
+      sqe->addr = (uint64_t)(uintptr_t)batch[i].buffer;
+      sqe->len = (batch[i].size > UINT32_MAX) ? UINT32_MAX : (uint32_t)batch[i].size;
+      sqe->off = 0;
+    }
+    if (queued > 0)
+    {
+      ok = srsIO_Uring_Run(ring, tail, queued, results);
+    }
+    /* Close whatever was opened, even if the ring failed */
+    tail = *ring->sq_tail;
+    queued = 0;
+    for (size_t i = 0; i < chunk; i++)
+    {
+      if (ring->fds[i] < 0)
+      {
+        continue;
+      }
+      if (ok)
+      {
+        batch[i].result = results[i];
+        /* A short read of a regular file only means it ended, so only writes that came back short and transfers that were interrupted are finished here */
+        bool retry = (results[i] == -EAGAIN) || (results[i] == -EINTR);
+        bool short_write = (batch[i].op == srsIO_WRITE) && (results[i] >= 0) && ((size_t)results[i] < batch[i].size);
+        if ((batch[i].op != srsIO_SYNC) && (retry || short_write))
+        {
+          batch[i].result = srsIO_Transfer(ring->fds[i], &batch[i], retry ? 0 : (size_t)results[i]);
+        }
+        struct io_uring_sqe *sqe = srsIO_Uring_GetSQE(ring, &tail);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = ring->fds[i];
+        sqe->user_data = i;
+        queued++;
+      }
+      else
+      {
+        close(ring->fds[i]);
+      }
+    }
+    if (ok && (queued > 0))
+    {
+      ok = srsIO_Uring_Run(ring, tail, queued, results);
+    }
+  }
+  free(results);
+  return ok;
+}
+#endif
+
+srsIO_ENGINE *srsIO_Create(uint32_t depth, uint32_t flags)
+{
+  srsIO_ENGINE *engine = calloc(1, sizeof(*engine));
+  if (engine == NULL)
+  {
+    return NULL;
+  }
+  if (depth == 0)
+  {
+    depth = srsIO_DEFAULT_DEPTH;
+  }
+#ifdef srsIO_URING
+  engine->ring.fd = -1;
+  if (!(flags & srsIO_FLAG_BLOCKING) && srsIO_Uring_Open(&engine->ring, depth))
+  {
+    engine->async = true;
+    return engine;
+  }
+#else
+  (void)flags;
+#endif
+  if (!srsMutex_Init(&engine->lock))
+  {
+    free(engine);
+    return NULL;
+  }
+  if (!srsCond_Init(&engine->work_cond))
+  {
+    srsMutex_Destroy(&engine->lock);
+    free(engine);
+    return NULL;
+  }
+  if (!srsCond_Init(&engine->done_cond))
+  {
+    srsCond_Destroy(&engine->work_cond);
+    srsMutex_Destroy(&engine->lock);
+    free(engine);
+    return NULL;
+  }
+  /* The submitting thread takes part too. Fewer workers than asked for still works, just more slowly. */
+  uint32_t wanted = (depth < srsIO_POOL_MAX_THREADS) ? depth : srsIO_POOL_MAX_THREADS;
+  while (engine->thread_count + 1 < wanted)
+  {
+    if (!srsThread_Create(&engine->threads[engine->thread_count], srsIO_Worker, engine))
+    {
+      break;
+    }
+    engine->thread_count++;
+  }
+  return engine;
+}
+
+void srsIO_Destroy(srsIO_ENGINE *engine)
+{
+  if (engine == NULL)
+  {
+    return;
+  }
+#ifdef srsIO_URING
+  if (engine->async)
+  {
+    srsIO_Uring_Close(&engine->ring);
+    free(engine);
+    return;
+  }
+#endif
+  srsMutex_Lock(&engine->lock);
+  engine->shutdown = true;
+  srsCond_Broadcast(&engine->work_cond);
+  srsMutex_Unlock(&engine->lock);
+  for (uint32_t i = 0; i < engine->thread_count; i++)
+  {
+    srsThread_Join(engine->threads[i], NULL);
+  }
+  srsCond_Destroy(&engine->done_cond);
+  srsCond_Destroy(&engine->work_cond);
+  srsMutex_Destroy(&engine->lock);
+  free(engine);
+}
+
+bool srsIO_IsAsync(const srsIO_ENGINE *engine)
+{
+#ifdef srsIO_URING
+  return (engine != NULL) && engine->async;
+#else
+  (void)engine;
+  return false;
+#endif
+}
+
+bool srsIO_Submit(srsIO_ENGINE *engine, srsIO_REQUEST *requests, size_t count)
+{
+  if ((engine == NULL) || ((requests == NULL) && (count > 0)))
+  {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    if ((requests[i].path == NULL) || ((requests[i].op != srsIO_STAT) && (requests[i].buffer == NULL) && (requests[i].size > 0)))
+    {
+      return false;
+    }
+    requests[i].result = -EINVAL;
+    requests[i].file_size = 0;
+    requests[i].mtime_sec = 0;
+    requests[i].mtime_nsec = 0;
+    requests[i].is_dir = false;
+  }
+  if (count == 0)
+  {
+    return true;
+  }
+  bool result = false;
+#ifdef srsIO_URING
+  if (engine->async)
+  {
+    result = srsIO_SubmitUring(engine, requests, count);
+  }
+  else
+#endif
+  {
+    result = srsIO_SubmitBlocking(engine, requests, count);
+  }
+  /* Files may have been created behind the filesystem module's back */
+  for (size_t i = 0; i < count; i++)
+  {
+    if ((requests[i].op == srsIO_WRITE) && (requests[i].flags & srsIO_FLAG_CREATE))
+    {
+      srsFileSystem_InvalidateAt(requests[i].dir, requests[i].path);
+    }
+  }
+  return result;
+}
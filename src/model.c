@@ -1,6 +1,12 @@
 #include "kioku/model.h"
 #include "kioku/git.h"
 #include "kioku/filesystem.h"
+#include "kioku/watch.h"
+#include "kioku/snapshot.h"
+#include "kioku/scheduler.h"
+#include "kioku/clock.h"
+#include "kioku/thread.h"
+#include "kioku/datastructure.h"
 #include "kioku/log.h"
 #include "kioku/string.h"
 #include "kioku/debug.h"
@@ -8,11 +14,11 @@
 #include "kioku/error.h"
 
 #include "parson.h"
-#include "hashmap.h"
 #include "utf8.h"
-#include "git2.h"
 
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #define srsMODEL_DECKS_DIRNAME "decks"
 #define srsMODEL_CARDS_DIRNAME "cards"
@@ -35,63 +41,508 @@ static bool kioku_model_load_userlist()
   return true;
 }
 
-static const char *srsModel_ROOT_PATH = NULL;
+/**
+ * The canonical form of the model root, taken once when it is set, and paths already found inside it.
+ * Checking containment is then a prefix compare on canonical paths rather than asking git where each path's repository is.
+ */
+typedef struct _srsMODEL_PATHS_s
+{
+  char *root;                  /* Canonical, ending in a separator */
+  size_t root_length;
+  srsHASHMAP known;            /* Resolved paths found inside the watched decks, as keys */
+  bool usable;                 /* Whether known could be allocated */
+  srsSPINLOCK lock;
+} srsMODEL_PATHS;
 
-srsRESULT srsModel_SetRoot(const char *path)
+typedef struct _srsMODEL_LISTENER_s
+{
+  srsWATCH_FUNC func;
+  void *userdata;
+} srsMODEL_LISTENER;
+
+/**
+ * The due queue of a deck whose next card was asked for, with the snapshot its card indices refer to.
+ * The watcher queues rescheduled cards in pending to be re-read by the next caller, and anything else that changes which cards exist invalidates it.
+ * Without a watcher it is kept for as long as the deck's snapshot stays in the same state.
+ */
+typedef struct _srsMODEL_DUE_QUEUE_s
+{
+  const char *deck_path;       /* Interned in the context's map of queues */
+  srsSNAPSHOT *snapshot;
+  srsSCHEDULE_QUEUE *queue;
+  bool valid;
+  uint32_t generation;
+  size_t pending_count;
+  uint32_t pending[srsMODEL_DUE_PENDING_MAX];
+} srsMODEL_DUE_QUEUE;
+
+srsVECTOR_DEFINE(srsMODEL_DUE_QUEUE_LIST, srsModelDueQueueList, srsMODEL_DUE_QUEUE *, 0)
+
+/**
+ * A deck of the resident model. Its snapshot gives the cards and when they were added, and due holds when they are due as the model last wrote or saw it, with a due queue over it.
+ * The watcher bumps changes whenever cards come or go, and the next caller that finds it differs from the value the deck was loaded at reloads the deck from disk.
+ */
+typedef struct _srsMODEL_DECK_s
+{
+  const char *path;            /* Interned in the resident model's map */
+  srsMUTEX lock;               /* Guards everything below but changes */
+  srsATOMIC32 changes;
+  int32_t loaded_changes;
+  srsSNAPSHOT *snapshot;
+  srsTIME_PACKED *due;
+  srsSCHEDULE_QUEUE *queue;
+  bool has_schedule;           /* Whether it has an .at file, which orders its cards from disk instead */
+} srsMODEL_DECK;
+
+srsVECTOR_DEFINE(srsMODEL_DECK_LIST, srsModelDeckList, srsMODEL_DECK *, 0)
+
+/* Every deck of the resident model, found by path. Decks are only freed when the root changes. */
+typedef struct _srsMODEL_RESIDENT_s
+{
+  bool enabled;
+  srsSPINLOCK lock;            /* Guards map and decks, but not the decks themselves */
+  srsHASHMAP map;
+  srsMODEL_DECK_LIST decks;
+} srsMODEL_RESIDENT;
+
+/**
+ * Everything the model keeps about one root. Contexts share nothing, so separate roots can be served from any number of threads at once.
+ * Locks start out zeroed, so a context can be allocated with calloc.
+ */
+struct _srsMODEL_s
+{
+  char *root_path;
+  srsDIR *root_dir;
+  srsGIT_REPO *repo;
+  bool owns_repo;              /* The default context uses git's current repository instead */
+  srsWATCH *watch;
+  srsATOMIC32 version;
+  srsMODEL_LISTENER listeners[srsMODEL_LISTENER_MAX];
+  srsSPINLOCK listeners_lock;
+  srsHASHMAP due_queues;        /* Deck path to srsMODEL_DUE_QUEUE, so switching decks keeps each one's queue */
+  srsMODEL_DUE_QUEUE_LIST due_list;
+  uint32_t due_generation;     /* Given out to queues as they are built or invalidated */
+  srsSPINLOCK due_lock;        /* Guards the queues and everything in them */
+  /* Changes to cards seen by the watcher, so a queue built while one arrives is not trusted */
+  srsATOMIC32 card_changes;
+  srsMODEL_RESIDENT resident;
+  srsMODEL_PATHS paths;
+};
+
+/* The context the functions without a model argument work with */
+static srsMODEL srsModel_DEFAULT = {0};
+
+static void srsModel_Paths_Open(srsMODEL *model);
+static void srsModel_Paths_Close(srsMODEL *model);
+static void srsModel_Paths_OnChange(srsMODEL *model, srsWATCH_EVENT event);
+static void srsModel_Resident_Load(srsMODEL *model);
+static void srsModel_Resident_Unload(srsMODEL *model);
+static void srsModel_Resident_OnChange(srsMODEL *model, srsWATCH_EVENT event, const char *path);
+
+/* Finds the queue of a deck. Called with due_lock held. */
+static srsMODEL_DUE_QUEUE *srsModel_DueQueue_Find(srsMODEL *model, const char *deck_key)
+{
+  void *queue = NULL;
+  srsHashMap_Get(&model->due_queues, deck_key, &queue);
+  return queue;
+}
+
+/* Finds the queue of a deck or adds an empty one. Called with due_lock held. */
+static srsMODEL_DUE_QUEUE *srsModel_DueQueue_Add(srsMODEL *model, const char *deck_key)
+{
+  srsMODEL_DUE_QUEUE *due = srsModel_DueQueue_Find(model, deck_key);
+  if (due != NULL)
+  {
+    return due;
+  }
+  if ((model->due_queues.capacity == 0) && !srsHashMap_Init(&model->due_queues, 0))
+  {
+    return NULL;
+  }
+  due = calloc(1, sizeof(*due));
+  if (due == NULL)
+  {
+    return NULL;
+  }
+  due->deck_path = srsHashMap_Intern(&model->due_queues, deck_key);
+  if ((due->deck_path == NULL) || !srsHashMap_Set(&model->due_queues, deck_key, due) || !srsModelDueQueueList_Push(&model->due_list, due))
+  {
+    srsHashMap_Remove(&model->due_queues, deck_key);
+    free(due);
+    return NULL;
+  }
+  return due;
+}
+
+/* Drops every queue along with the snapshots they refer to */
+static void srsModel_DueQueue_Release(srsMODEL *model)
+{
+  srsMODEL_DUE_QUEUE_LIST list = {0};
+  srsSpinLock_Lock(&model->due_lock);
+  list = model->due_list;
+  memset(&model->due_list, 0, sizeof(model->due_list));
+  /* Interned paths are only freed with the map */
+  srsHashMap_Free(&model->due_queues);
+  model->due_generation++;
+  srsSpinLock_Unlock(&model->due_lock);
+  srsMODEL_DUE_QUEUE *due = NULL;
+  while (srsModelDueQueueList_Pop(&list, &due))
+  {
+    srsScheduleQueue_Free(due->queue);
+    srsSnapshot_Close(due->snapshot);
+    free(due);
+  }
+  srsModelDueQueueList_Free(&list);
+}
+
+/* Runs on the watcher thread with a path relative to the root. It only looks at memory, leaving any reading to the next caller. */
+static void srsModel_DueQueue_OnChange(srsMODEL *model, srsWATCH_EVENT event, const char *path)
+{
+  static const char cards_dir[] = "/" srsMODEL_CARDS_DIRNAME "/";
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  size_t i = 0;
+  if ((event != srsWATCH_RESCAN) && ((strstr(path, "/" srsMODEL_CARDS_DIRNAME) == NULL) || (strstr(path, "/" srsSNAPSHOT_DIRNAME) != NULL)))
+  {
+    return;
+  }
+  srsAtomic_Add(&model->card_changes, 1);
+  if (event == srsWATCH_RESCAN)
+  {
+    srsSpinLock_Lock(&model->due_lock);
+    for (i = 0; i < model->due_list.count; i++)
+    {
+      model->due_list.data[i]->valid = false;
+      model->due_list.data[i]->generation = ++model->due_generation;
+    }
+    srsSpinLock_Unlock(&model->due_lock);
+    return;
+  }
+  const char *cards = strstr(path, cards_dir);
+  size_t deck_length = (cards == NULL) ? sizeof(deck_key) : (size_t)(cards - path);
+  if (deck_length >= sizeof(deck_key))
+  {
+    /* Something about the cards directory itself, which only matters to the snapshot */
+    return;
+  }
+  memcpy(deck_key, path, deck_length);
+  deck_key[deck_length] = kiokuCHAR_NULL;
+  srsSpinLock_Lock(&model->due_lock);
+  srsMODEL_DUE_QUEUE *due = srsModel_DueQueue_Find(model, deck_key);
+  if ((due == NULL) || !due->valid)
+  {
+    /* No queue of that deck to keep up to date */
+    srsSpinLock_Unlock(&model->due_lock);
+    return;
+  }
+  const char *card_path = cards + sizeof(cards_dir) - 1;
+  const char *slash = strchr(card_path, '/');
+  bool keep = (slash != NULL);
+  if (keep && (strcmp(slash, "/scheduled.txt") == 0))
+  {
+    char card_id[srsMODEL_CARD_ID_MAX];
+    size_t index = 0;
+    size_t length = (size_t)(slash - card_path);
+    keep = (length < sizeof(card_id)) && (due->pending_count < srsMODEL_DUE_PENDING_MAX);
+    if (keep)
+    {
+      memcpy(card_id, card_path, length);
+      card_id[length] = kiokuCHAR_NULL;
+      keep = srsSnapshot_Find(due->snapshot, card_id, &index);
+    }
+    if (keep)
+    {
+      due->pending[due->pending_count++] = (uint32_t)index;
+    }
+  }
+  /* Cards coming or going change which cards there are */
+  if (!keep)
+  {
+    due->valid = false;
+    due->generation = ++model->due_generation;
+  }
+  srsSpinLock_Unlock(&model->due_lock);
+}
+
+/* Runs on the watcher thread. The root cannot change underneath it, since the watcher is closed before the root is released. */
+static void srsModel_OnChange(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata)
+{
+  srsMODEL *model = (srsMODEL *)userdata;
+  char relpath[srsPATH_MAX + 1];
+  /* The watcher has already invalidated cached file state for the path */
+  int32_t needed = (path[0] == kiokuCHAR_NULL) ? snprintf(relpath, sizeof(relpath), "%s", srsMODEL_DECKS_DIRNAME) : snprintf(relpath, sizeof(relpath), "%s/%s", srsMODEL_DECKS_DIRNAME, path);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(relpath)))
+  {
+    return;
+  }
+  srsAtomic_Add(&model->version, 1);
+  srsModel_Paths_OnChange(model, event);
+  srsModel_DueQueue_OnChange(model, event, relpath);
+  srsModel_Resident_OnChange(model, event, relpath);
+  srsMODEL_LISTENER listeners[srsMODEL_LISTENER_MAX];
+  srsSpinLock_Lock(&model->listeners_lock);
+  memcpy(listeners, model->listeners, sizeof(listeners));
+  srsSpinLock_Unlock(&model->listeners_lock);
+  for (size_t i = 0; i < srsMODEL_LISTENER_MAX; i++)
+  {
+    if (listeners[i].func != NULL)
+    {
+      listeners[i].func(event, relpath, is_dir, listeners[i].userdata);
+    }
+  }
+}
+
+/* Watches the decks of the current root. Without a watcher everything is still read from disk, so failing to start one is not an error. */
+static void srsModel_StartWatching(srsMODEL *model)
+{
+  char deckspath[srsPATH_MAX + 1];
+  int32_t needed = kioku_path_concat(deckspath, sizeof(deckspath), model->root_path, srsMODEL_DECKS_DIRNAME);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(deckspath)))
+  {
+    return;
+  }
+  model->watch = srsWatch_Open(deckspath, srsModel_OnChange, model);
+  if (model->watch == NULL)
+  {
+    srsLOG_PRINT("Changes to [%s] will not be picked up until they are read again", deckspath);
+  }
+}
+
+static void srsModel_StopWatching(srsMODEL *model)
+{
+  srsWatch_Close(model->watch);
+  model->watch = NULL;
+  /* Nothing is keeping cached state in sync anymore */
+  if (model->root_path != NULL)
+  {
+    srsFileSystem_Invalidate(model->root_path);
+  }
+  srsModel_DueQueue_Release(model);
+  srsModel_Resident_Unload(model);
+  srsAtomic_Add(&model->version, 1);
+}
+
+/* The default context keeps git's current repository in step with its root, as callers of the srsGit_Repo_* functions expect */
+static bool srsModel_OpenRepo(srsMODEL *model, const char *path)
+{
+  model->owns_repo = (model != &srsModel_DEFAULT);
+  model->repo = model->owns_repo ? srsGitRepo_Open(path) : ((srsGit_Repo_Open(path) == srsOK) ? srsGit_Repo_GetCurrentRepo() : NULL);
+  return model->repo != NULL;
+}
+
+static void srsModel_CloseRepo(srsMODEL *model)
+{
+  if (model->owns_repo)
+  {
+    srsGitRepo_Close(model->repo);
+  }
+  else
+  {
+    srsGit_Repo_Close();
+  }
+  model->repo = NULL;
+}
+
+srsRESULT srsModel_SetRootAt(srsMODEL *model, const char *path)
 {
   if (path == NULL)
   {
     srsLOG_PRINT("Path is NULL - close the underlying repository and nullify the model root.");
-    srsGit_Repo_Close();
-    free(srsModel_ROOT_PATH);
-    srsModel_ROOT_PATH = NULL;
+    srsModel_StopWatching(model);
+    srsModel_Paths_Close(model);
+    srsModel_CloseRepo(model);
+    free(model->root_path);
+    model->root_path = NULL;
+    srsDir_Close(model->root_dir);
+    model->root_dir = NULL;
     return srsOK;
   }
-  if (!srsDir_Exists(path))
+  srsDIR *root_dir = srsDir_Open(path);
+  if (root_dir == NULL)
   {
     return srsFAIL;
   }
   if (!srsGit_IsRepo(path))
   {
+    srsDir_Close(root_dir);
     return srsFAIL;
   }
-  if (srsDir_PushCWD(path))
+  if (!srsFile_ExistsAt(root_dir, srsMODEL_DECKS_DIRNAME "/" srsMODEL_META_FILENAME))
   {
-    bool ok = srsFile_Exists(srsMODEL_DECKS_DIRNAME "/" srsMODEL_META_FILENAME);
-    srsDir_PopCWD(NULL);
-    if (!ok)
-    {
-      return srsFAIL;
-    }
+    srsDir_Close(root_dir);
+    return srsFAIL;
   }
-  free(srsModel_ROOT_PATH);
-  srsModel_ROOT_PATH = NULL;
-  srsRESULT result = srsGit_Repo_Open(path);
+  srsModel_StopWatching(model);
+  srsModel_Paths_Close(model);
+  srsModel_CloseRepo(model);
+  free(model->root_path);
+  model->root_path = NULL;
+  srsDir_Close(model->root_dir);
+  model->root_dir = NULL;
+  srsRESULT result = srsModel_OpenRepo(model, path) ? srsOK : srsFAIL;
   if (result == srsOK)
   {
     srsLOG_PRINT("Opened Git repository for the model root at [%s]", path);
-    srsModel_ROOT_PATH = strdup(srsGit_Repo_GetCurrent());
-    srsASSERT(srsModel_ROOT_PATH != NULL);
-    srsLOG_PRINT("Model root is now [%s]", srsModel_ROOT_PATH);
+    model->root_path = strdup(srsGitRepo_GetPath(model->repo));
+    srsASSERT(model->root_path != NULL);
+    model->root_dir = root_dir;
+    root_dir = NULL;
+    srsLOG_PRINT("Model root is now [%s]", model->root_path);
+    srsModel_Paths_Open(model);
+    srsModel_StartWatching(model);
+    if (model->resident.enabled)
+    {
+      srsModel_Resident_Load(model);
+    }
   }
   else
   {
     srsLOG_ERROR("Failed to use [%s] as the model root path - something went wrong trying to open the Git repository.", path);
   }
+  srsDir_Close(root_dir);
+  return result;
+}
+
+srsRESULT srsModel_SetRoot(const char *path)
+{
+  return srsModel_SetRootAt(&srsModel_DEFAULT, path);
+}
+
+srsMODEL *srsModel_Open(const char *path)
+{
+  srsMODEL *model = calloc(1, sizeof(*model));
+  if (model == NULL)
+  {
+    srsERROR_SET(srsFAIL, "Unable to allocate a model context");
+    return NULL;
+  }
+  if (srsModel_SetRootAt(model, path) != srsOK)
+  {
+    free(model);
+    return NULL;
+  }
+  return model;
+}
+
+void srsModel_Close(srsMODEL *model)
+{
+  if ((model == NULL) || (model == &srsModel_DEFAULT))
+  {
+    return;
+  }
+  srsModel_SetRootAt(model, NULL);
+  srsModel_SetResidentAt(model, false);
+  /* Memoized snapshots refer to the context by address */
+  srsSnapshot_Forget(model);
+  free(model);
+}
+
+srsMODEL *srsModel_GetDefault()
+{
+  return &srsModel_DEFAULT;
+}
+
+srsGIT_REPO *srsModel_GetRepoAt(srsMODEL *model)
+{
+  return model->repo;
+}
+
+int32_t srsModel_GetCardChangesAt(srsMODEL *model)
+{
+  return srsAtomic_Load(&model->card_changes);
+}
+
+bool srsModel_IsWatchedAt(srsMODEL *model)
+{
+  return model->watch != NULL;
+}
+
+bool srsModel_IsWatched()
+{
+  return srsModel_IsWatchedAt(&srsModel_DEFAULT);
+}
+
+uint32_t srsModel_GetVersionAt(srsMODEL *model)
+{
+  return (uint32_t)srsAtomic_Load(&model->version);
+}
+
+uint32_t srsModel_GetVersion()
+{
+  return srsModel_GetVersionAt(&srsModel_DEFAULT);
+}
+
+bool srsModel_AddListenerAt(srsMODEL *model, srsWATCH_FUNC func, void *userdata)
+{
+  bool result = false;
+  if (func == NULL)
+  {
+    return false;
+  }
+  srsSpinLock_Lock(&model->listeners_lock);
+  for (size_t i = 0; !result && (i < srsMODEL_LISTENER_MAX); i++)
+  {
+    if (model->listeners[i].func == NULL)
+    {
+      model->listeners[i].func = func;
+      model->listeners[i].userdata = userdata;
+      result = true;
+    }
+  }
+  srsSpinLock_Unlock(&model->listeners_lock);
   return result;
 }
 
+bool srsModel_AddListener(srsWATCH_FUNC func, void *userdata)
+{
+  return srsModel_AddListenerAt(&srsModel_DEFAULT, func, userdata);
+}
+
+void srsModel_RemoveListenerAt(srsMODEL *model, srsWATCH_FUNC func, void *userdata)
+{
+  srsSpinLock_Lock(&model->listeners_lock);
+  for (size_t i = 0; i < srsMODEL_LISTENER_MAX; i++)
+  {
+    if ((model->listeners[i].func == func) && (model->listeners[i].userdata == userdata))
+    {
+      model->listeners[i].func = NULL;
+      model->listeners[i].userdata = NULL;
+    }
+  }
+  srsSpinLock_Unlock(&model->listeners_lock);
+}
+
+void srsModel_RemoveListener(srsWATCH_FUNC func, void *userdata)
+{
+  srsModel_RemoveListenerAt(&srsModel_DEFAULT, func, userdata);
+}
+
+const char *srsModel_GetRootAt(srsMODEL *model)
+{
+  return model->root_path;
+}
+
 const char *srsModel_GetRoot()
 {
-  return srsModel_ROOT_PATH;
+  return srsModel_GetRootAt(&srsModel_DEFAULT);
+}
+
+srsDIR *srsModel_GetRootDirAt(srsMODEL *model)
+{
+  return model->root_dir;
+}
+
+srsDIR *srsModel_GetRootDir()
+{
+  return srsModel_GetRootDirAt(&srsModel_DEFAULT);
 }
 
 bool srsModel_IsValidRoot(const char *path)
 {
   bool result = false;
-  if (srsDir_PushCWD(path))
+  srsDIR *dir = srsDir_Open(path);
+  if (dir != NULL)
   {
-    bool model_exists = srsFile_Exists(srsMODEL_META_FILENAME);
+    bool model_exists = srsFile_ExistsAt(dir, srsMODEL_META_FILENAME);
     if (!model_exists)
     {
       srsERROR_SET(srsFAIL, "Path does not contain a model metadata file");
@@ -99,7 +550,7 @@ bool srsModel_IsValidRoot(const char *path)
     }
     else
     {
-      bool decks_exists = srsFile_Exists(srsMODEL_DECKS_DIRNAME"/"srsMODEL_META_FILENAME);
+      bool decks_exists = srsFile_ExistsAt(dir, srsMODEL_DECKS_DIRNAME"/"srsMODEL_META_FILENAME);
       if (!decks_exists)
       {
         srsERROR_SET(srsFAIL, "Path does not contain a deck metadata file");
@@ -110,7 +561,7 @@ bool srsModel_IsValidRoot(const char *path)
       }
       result = decks_exists;
     }
-    srsDir_PopCWD(NULL);
+    srsDir_Close(dir);
   }
   return result;
 }
@@ -119,7 +570,10 @@ srsRESULT srsModel_CreateRoot(const char *path)
 {
   srsRESULT result = srsOK;
   srsGIT_CREATE_OPTS opts = srsMODEL_CREATE_OPTS;
-  bool ok = srsGit_Repo_Create(path, opts);
+  /* Created on a handle of its own, so the repositories of open contexts are left alone */
+  srsGIT_REPO *repo = srsGitRepo_Create(path, opts);
+  bool ok = (repo != NULL);
+  srsGitRepo_Close(repo);
   if (!ok)
   {
     srsERROR_SET(srsFAIL, "Failed to create repository for model");
@@ -127,10 +581,16 @@ srsRESULT srsModel_CreateRoot(const char *path)
   }
   else
   {
-    if (srsDir_PushCWD(path))
+    char meta_path[srsPATH_MAX + 1] = {0};
+    int32_t needed = kioku_path_concat(meta_path, sizeof(meta_path), path, srsMODEL_DECKS_DIRNAME"/"srsMODEL_META_FILENAME);
+    if ((needed > 0) && ((size_t)needed < sizeof(meta_path)))
+    {
+      result = srsFile_Create(meta_path) ? srsOK : srsFAIL;
+    }
+    else
     {
-      result = srsFile_Create(srsMODEL_DECKS_DIRNAME"/"srsMODEL_META_FILENAME) ? srsOK : srsFAIL;
-      srsDir_PopCWD(NULL);
+      srsERROR_SET(srsFAIL, "Model path is too long");
+      result = srsFAIL;
     }
   }
   return result;
@@ -152,156 +612,1041 @@ srsRESULT srsModel_CreateAndSetRoot(const char *path)
   return srsOK;
 }
 
-bool srsModel_ExistsInRoot(const char *path)
+/* Gets the canonical form of an existing path, with separators replaced like the root's. Free it with free(). */
+static char *srsModel_Paths_Canonicalize(const char *path)
 {
-  if (srsModel_GetRoot() == NULL)
+#ifdef kiokuOS_WINDOWS
+  char *canonical = srsPath_Exists(path) ? _fullpath(NULL, path, 0) : NULL;
+#else
+  char *canonical = realpath(path, NULL);
+#endif
+  if (canonical != NULL)
   {
-    srsERROR_SET(srsE_API, "Model Root not set!");
-    return false;
+    kioku_path_replace_separators(canonical, strlen(canonical) + 1);
   }
-  if (path == NULL)
+  return canonical;
+}
+
+/* Gets the canonical form of an absolute path as given, so a symlink is followed before the ".." after it is. Free it with free().
+ * A ".." after something that is missing or not a directory goes back to the directory holding it, the way the path reads. realpath refuses those, so only then is the path resolved one segment at a time. */
+static char *srsModel_Paths_Resolve(const char *path)
+{
+  char *canonical = srsModel_Paths_Canonicalize(path);
+#ifndef kiokuOS_WINDOWS
+  if ((canonical != NULL) || ((errno != ENOENT) && (errno != ENOTDIR)))
   {
-    srsERROR_SET(srsE_INPUT, "Path was NULL");
-    return false;
+    return canonical;
   }
-  const char *root = srsModel_GetRoot();
-  size_t rootlen = strlen(root);
-  bool result = false;
-  char *cur_search_from = strdup(path);
-  git_buf rootbuf = {0};
-  const char *path_to_root = srsDir_PushCWD(root);
-  if (path_to_root != NULL)
+  char resolved[srsPATH_MAX + 1] = "/";
+  size_t resolved_length = 1;
+  bool missing = false;        /* The last segment was taken as written, since it does not exist */
+  const char *in = path;
+  while (*in != kiokuCHAR_NULL)
   {
-    /* Put this in a while loop with breaks in it so we can continue searching upward after hitting a potential subrepo */
-    while (true)
+    const char *end = strchr(in, '/');
+    size_t length = (end == NULL) ? strlen(in) : (size_t)(end - in);
+    if ((length == 2) && (in[0] == '.') && (in[1] == '.') && (missing || !srsDir_Exists(resolved)))
+    {
+      /* Everything before the last segment is canonical, so dropping it cannot skip a symlink */
+      while ((resolved_length > 1) && (resolved[resolved_length - 1] != '/'))
+      {
+        resolved_length--;
+      }
+      resolved_length -= (resolved_length > 1) ? 1 : 0;
+      resolved[resolved_length] = kiokuCHAR_NULL;
+      missing = false;
+    }
+    else if ((length > 0) && !((length == 1) && (in[0] == '.')))
     {
-      /* Asssumption: this returns a full path */
-      int error = git_repository_discover(&rootbuf, cur_search_from, 0, NULL);
-      if (error != 0)
+      size_t separator = (resolved[resolved_length - 1] == '/') ? 0 : 1;
+      if (missing || (resolved_length + separator + length >= sizeof(resolved)))
+      {
+        return NULL;
+      }
+      resolved[resolved_length] = '/';
+      memcpy(resolved + resolved_length + separator, in, length);
+      resolved[resolved_length + separator + length] = kiokuCHAR_NULL;
+      char *step = srsModel_Paths_Canonicalize(resolved);
+      if (step == NULL)
       {
-        const git_error *error_struct = giterr_last();
-        srsASSERT(error_struct != NULL);
-        srsERROR_SET(srsFAIL, error_struct->message);
-        result = false;
-        break;
+        resolved_length += separator + length;
+        missing = true;
       }
       else
       {
-        /* See if we found the root, or if it was some other repo to continue up from */
-        result = (strncmp(rootbuf.ptr, root, rootlen) == 0);
-        srsLOG_PRINT("Discovered a repo: %s (%s model root)", rootbuf.ptr, srsLOG_IS_ISNT(result));
-        if (result)
-        {
-          break;
-        }
-        /* Convert to workdir */
-        char *repo_segment = strstr(rootbuf.ptr, "/.git/");
-        if (repo_segment != NULL)
+        resolved_length = (size_t)snprintf(resolved, sizeof(resolved), "%s", step);
+        free(step);
+        if (resolved_length >= sizeof(resolved))
         {
-          repo_segment[0] = '\0';
-          /* Go out of workdir */
-          char *lastsep = strrchr(rootbuf.ptr, '/');
-          if (lastsep != NULL)
-          {
-            *lastsep = '\0';
-            /* Retry */
-            free(cur_search_from);
-            cur_search_from = NULL;
-            cur_search_from = strdup(rootbuf.ptr);
-            srsLOG_PRINT("Continuing search from %s", cur_search_from);
-            continue;
-          }
+          return NULL;
         }
-        /* Something prevents us from going up further */
-        srsERROR_SET(srsE_INPUT, "Discovered a root repo, but it was not the model root");
-        result = false;
-        break;
       }
     }
-    srsDir_PopCWD(NULL);
+    in += length + ((end == NULL) ? 0 : 1);
   }
-  /* Do a final check to see if this WAS the root dir, since that's not really "in" it. */
-  if (result)
+  canonical = missing ? NULL : strdup(resolved);
+#endif
+  return canonical;
+}
+
+/* Whether a resolved path only goes down from the root into the watched decks. The watcher reports on every entry such a path passes through, so it is safe to remember. */
+static bool srsModel_Paths_IsInDecks(const srsMODEL *model, const char *path)
+{
+  size_t root_length = strlen(model->root_path);
+  while ((root_length > 0) && (model->root_path[root_length - 1] == '/'))
+  {
+    root_length--;
+  }
+  if ((strncmp(path, model->root_path, root_length) != 0) || (path[root_length] != '/') || (strncmp(path + root_length + 1, srsMODEL_DECKS_DIRNAME "/", sizeof(srsMODEL_DECKS_DIRNAME)) != 0))
+  {
+    return false;
+  }
+  const char *segment = path + root_length + 1;
+  while (segment != NULL)
   {
-    const char *fullpath = srsDir_PushCWD(path);
-    srsLOG_PRINT("Root found: %s - testing against %s", root, fullpath);
-    if (fullpath)
+    if ((segment[0] == '.') && (segment[1] == '.') && ((segment[2] == '/') || (segment[2] == kiokuCHAR_NULL)))
     {
-      /* We check against strlen's fullpath since it may be missing a trailing '/' (I haven't specified whether CWD does or doesn't) */
-      if (strncmp(root, fullpath, strlen(fullpath)) == 0)
-      {
-        srsERROR_SET(srsE_INPUT, "Model Root is not technically \"in\" the root!");
-        result = false;
-      }
-      srsDir_PopCWD(NULL);
+      return false;
     }
+    segment = strchr(segment, '/');
+    segment = (segment == NULL) ? NULL : segment + 1;
   }
-  free(cur_search_from);
-  git_buf_free(&rootbuf); /* returned path data must be freed after use */
-  return result;
+  return true;
 }
 
-bool srsModel_Card_GetPath(const char *deck_path, const char *card_id, char *path_out, size_t path_size)
+/* Drops every cached path, keeping the map usable */
+static void srsModel_Paths_Clear(srsMODEL *model)
 {
-  int32_t needed = kioku_path_concat(path_out, path_size, deck_path, card_id);
-  const char *ext = ".txt";
-  size_t extsize = strlen(ext) + 1;
-  if (needed <= 0)
+  srsSpinLock_Lock(&model->paths.lock);
+  srsHashMap_Free(&model->paths.known);
+  model->paths.usable = srsHashMap_Init(&model->paths.known, 0);
+  srsSpinLock_Unlock(&model->paths.lock);
+}
+
+/* Canonicalizes the root that was just set, so containment is a prefix compare from then on */
+static void srsModel_Paths_Open(srsMODEL *model)
+{
+  char *canonical = srsModel_Paths_Canonicalize(model->root_path);
+  size_t length = (canonical == NULL) ? 0 : strlen(canonical);
+  char *root = (canonical == NULL) ? NULL : malloc(length + 2);
+  if (root != NULL)
   {
-    return false;
+    memcpy(root, canonical, length + 1);
+    /* With the separator a sibling that merely starts with the root's name does not match */
+    if ((length == 0) || (root[length - 1] != '/'))
+    {
+      root[length++] = '/';
+      root[length] = kiokuCHAR_NULL;
+    }
   }
-  if ((size_t)needed + extsize + 1 > path_size)
+  free(canonical);
+  srsModel_Paths_Clear(model);
+  srsSpinLock_Lock(&model->paths.lock);
+  free(model->paths.root);
+  model->paths.root = root;
+  model->paths.root_length = length;
+  srsSpinLock_Unlock(&model->paths.lock);
+  if (root == NULL)
   {
-    return false;
+    srsLOG_ERROR("Unable to canonicalize the model root [%s] - paths will not be found in it", model->root_path);
   }
-  strncpy(&path_out[needed], ext, extsize);
-  return true;
 }
 
-bool srsModel_Card_GetNextID(const char *deck_path, char *card_id_buf, size_t card_id_buf_size)
+static void srsModel_Paths_Close(srsMODEL *model)
 {
-  bool result = false;
-  char file_path[srsPATH_MAX] = {0};
+  srsSpinLock_Lock(&model->paths.lock);
+  free(model->paths.root);
+  model->paths.root = NULL;
+  model->paths.root_length = 0;
+  srsHashMap_Free(&model->paths.known);
+  model->paths.usable = false;
+  srsSpinLock_Unlock(&model->paths.lock);
+}
 
-  /* Get path to the .at file */
-  int32_t atlen = kioku_path_concat(file_path, sizeof(file_path), deck_path, ".at");
-  result = ((atlen > 0) && (atlen < sizeof(file_path)));
-  if (!result)
+/* Runs on the watcher thread. Entries that come and go could be symlinks or replace a path that was cached, so anything but edits to a file drops the cache. */
+static void srsModel_Paths_OnChange(srsMODEL *model, srsWATCH_EVENT event)
+{
+  if (event != srsWATCH_MODIFIED)
   {
-    return result;
+    srsModel_Paths_Clear(model);
   }
+}
 
-  /* Get content from .at file */
-  char atindex_string[16] = {0};
-  result = srsFile_GetContent(file_path, atindex_string, sizeof(atindex_string));
-  srsLOG_PRINT(".at = %s", atindex_string);
-  if (!result)
+void srsModel_RefreshPathsAt(srsMODEL *model)
+{
+  if (model->root_path != NULL)
   {
-    return result;
+    srsModel_Paths_Open(model);
   }
+}
 
-  /* Convert .at content to integer */
-  int32_t atindex = 0;
-  result = srsString_ToU32(atindex_string, &atindex);
-  if (!result)
+void srsModel_RefreshPaths()
+{
+  srsModel_RefreshPathsAt(&srsModel_DEFAULT);
+}
+
+bool srsModel_ExistsInRootAt(srsMODEL *model, const char *path)
+{
+  if (model->root_path == NULL)
   {
-    return result;
+    srsERROR_SET(srsE_API, "Model Root not set!");
+    return false;
   }
-  if (atindex < 1)
+  if (path == NULL)
   {
-    srsLOG_ERROR("Line number is out of range for line search (%d)", atindex);
+    srsERROR_SET(srsE_INPUT, "Path was NULL");
     return false;
   }
-
-  int32_t schedlen = kioku_path_concat(file_path, sizeof(file_path), deck_path, ".schedule");
-  result = ((schedlen > 0) && (schedlen < sizeof(file_path)));
-  if (!result)
+  const char *root = model->root_path;
+  char resolved[srsPATH_MAX + 1];
+  bool result = false;
+  /* Relative paths are relative to the root, so resolve them against it up front instead of navigating there */
+  int32_t needed = srsPath_IsAbsolute(path) ? snprintf(resolved, sizeof(resolved), "%s", path) : kioku_path_concat(resolved, sizeof(resolved), root, path);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(resolved)))
   {
-    srsLOG_ERROR("Schedule file path name length out of range: %d", schedlen);
-    return result;
+    srsERROR_SET(srsE_INPUT, "Path is too long");
+    return false;
+  }
+  kioku_path_replace_separators(resolved, strlen(resolved) + 1);
+
+  srsSpinLock_Lock(&model->paths.lock);
+  bool cached = model->paths.usable && srsHashMap_Get(&model->paths.known, resolved, NULL);
+  srsSpinLock_Unlock(&model->paths.lock);
+  if (cached)
+  {
+    return true;
+  }
+
+  /* ".." is only taken once symlinks before it are followed, so a link out of the root cannot be walked back into it */
+  char *canonical = srsModel_Paths_Resolve(resolved);
+  if (canonical == NULL)
+  {
+    srsERROR_SET(srsE_INPUT, "Path does not exist");
+    return false;
+  }
+  srsSpinLock_Lock(&model->paths.lock);
+  const char *canonical_root = model->paths.root;
+  size_t root_length = model->paths.root_length;
+  /* The root itself is not "in" the root, and it only matches without its trailing separator */
+  result = (canonical_root != NULL) && (strncmp(canonical, canonical_root, root_length) == 0) && (canonical[root_length] != kiokuCHAR_NULL);
+  /* Only paths inside the watched decks are cached, since nothing would say when anything else went away */
+  bool watched = result && (model->watch != NULL) && (strncmp(canonical + root_length, srsMODEL_DECKS_DIRNAME "/", sizeof(srsMODEL_DECKS_DIRNAME)) == 0);
+  if (watched && model->paths.usable)
+  {
+    if (srsHashMap_GetCount(&model->paths.known) >= srsMODEL_PATH_CACHE_MAX)
+    {
+      srsHashMap_Free(&model->paths.known);
+      model->paths.usable = srsHashMap_Init(&model->paths.known, 0);
+    }
+    /* The canonical path is always remembered, while the path as given only is if nothing it passes through could be left unreported */
+    if (model->paths.usable)
+    {
+      srsHashMap_Set(&model->paths.known, canonical, NULL);
+    }
+    if (model->paths.usable && srsModel_Paths_IsInDecks(model, resolved))
+    {
+      srsHashMap_Set(&model->paths.known, resolved, NULL);
+    }
+  }
+  srsSpinLock_Unlock(&model->paths.lock);
+  if (!result)
+  {
+    srsERROR_SET(srsE_INPUT, "Path is not inside the model root");
+  }
+  free(canonical);
+  return result;
+}
+
+bool srsModel_ExistsInRoot(const char *path)
+{
+  return srsModel_ExistsInRootAt(&srsModel_DEFAULT, path);
+}
+
+bool srsModel_Card_GetPath(const char *deck_path, const char *card_id, char *path_out, size_t path_size)
+{
+  int32_t needed = kioku_path_concat(path_out, path_size, deck_path, card_id);
+  const char *ext = ".txt";
+  size_t extsize = strlen(ext) + 1;
+  if (needed <= 0)
+  {
+    return false;
+  }
+  if ((size_t)needed + extsize + 1 > path_size)
+  {
+    return false;
+  }
+  strncpy(&path_out[needed], ext, extsize);
+  return true;
+}
+
+/* Normalizes a path the way it reads: separators become '/', empty and "." segments are dropped, and ".." takes back the segment before it where there is one */
+static bool srsModel_Paths_Normalize(const char *path, char *out, size_t out_size)
+{
+  size_t length = 0;
+  size_t floor = 0;            /* Segments before this are never taken back, being the leading "/" or ".." */
+  if (out_size < 2)
+  {
+    return false;
+  }
+  if ((path[0] == '/') || (path[0] == '\\'))
+  {
+    out[length++] = '/';
+    floor = length;
+  }
+  while (*path != kiokuCHAR_NULL)
+  {
+    size_t segment = strcspn(path, "/\\");
+    if ((segment == 2) && (path[0] == '.') && (path[1] == '.') && (length > floor))
+    {
+      while ((length > floor) && (out[length - 1] != '/'))
+      {
+        length--;
+      }
+      length -= ((length > floor) && (out[length - 1] == '/')) ? 1 : 0;
+    }
+    else if ((segment > 0) && !((segment == 1) && (path[0] == '.')))
+    {
+      size_t separator = ((length > 0) && (out[length - 1] != '/')) ? 1 : 0;
+      if (length + separator + segment >= out_size)
+      {
+        return false;
+      }
+      out[length] = '/';
+      memcpy(out + length + separator, path, segment);
+      length += separator + segment;
+      if ((segment == 2) && (path[0] == '.') && (path[1] == '.'))
+      {
+        floor = length;
+      }
+    }
+    path += segment;
+    path += (*path != kiokuCHAR_NULL) ? 1 : 0;
+  }
+  out[length] = kiokuCHAR_NULL;
+  return true;
+}
+
+/* Strips a root off a normalized absolute path, returning what is left of it, or NULL if the path is not under that root */
+static const char *srsModel_Paths_StripRoot(const char *path, const char *root)
+{
+  size_t root_length = strlen(root);
+  while ((root_length > 0) && (root[root_length - 1] == '/'))
+  {
+    root_length--;
+  }
+  if ((root_length == 0) || (strncmp(path, root, root_length) != 0) || (path[root_length] != '/'))
+  {
+    return NULL;
+  }
+  return path + root_length + 1;
+}
+
+/* Deck paths key the due queues and resident decks, and are compared against paths from the watcher, which are relative to the root and normalized.
+ * Deck paths given any other way, like absolute or with "./" or "//" in them, are brought to that form. */
+static bool srsModel_DueQueue_GetDeckKey(srsMODEL *model, const char *deck_path, char *key_out, size_t key_size)
+{
+  char normalized[srsPATH_MAX + 1];
+  char root[srsPATH_MAX + 1];
+  if (!srsModel_Paths_Normalize(deck_path, normalized, sizeof(normalized)))
+  {
+    return false;
+  }
+  const char *key = normalized;
+  if (srsPath_IsAbsolute(normalized) && (model->root_path != NULL))
+  {
+    const char *relative = srsModel_Paths_Normalize(model->root_path, root, sizeof(root)) ? srsModel_Paths_StripRoot(normalized, root) : NULL;
+    if (relative == NULL)
+    {
+      /* The root may have been given through a symlink, and the deck by where it leads */
+      srsSpinLock_Lock(&model->paths.lock);
+      bool copied = (model->paths.root != NULL) && (snprintf(root, sizeof(root), "%s", model->paths.root) < (int)sizeof(root));
+      srsSpinLock_Unlock(&model->paths.lock);
+      relative = copied ? srsModel_Paths_StripRoot(normalized, root) : NULL;
+    }
+    key = (relative != NULL) ? relative : normalized;
+  }
+  size_t length = strlen(key);
+  if (length >= key_size)
+  {
+    return false;
+  }
+  memcpy(key_out, key, length + 1);
+  return true;
+}
+
+/* Reads when a card is due from its schedule file. Like loading the card, an unreadable schedule counts as due now. */
+static srsTIME_PACKED srsModel_Card_ReadDue(srsMODEL *model, const char *deck_key, const char *card_id, srsTIME_PACKED now)
+{
+  char path[srsPATH_MAX + 1];
+  srsTIME_STRING content = {0};
+  srsTIME due;
+  int needed = snprintf(path, sizeof(path), "%s/" srsMODEL_CARDS_DIRNAME "/%s/scheduled.txt", deck_key, card_id);
+  if ((needed > 0) && ((size_t)needed < sizeof(path)) && srsFile_GetContentAt(model->root_dir, path, (char *)content, sizeof(content)) && srsTime_FromString(content, &due))
+  {
+    return srsTime_Pack(due);
+  }
+  return now;
+}
+
+/* Frees what a resident deck has loaded, leaving it to be loaded again */
+static void srsModel_Deck_Release(srsMODEL_DECK *deck)
+{
+  srsScheduleQueue_Free(deck->queue);
+  free(deck->due);
+  srsSnapshot_Close(deck->snapshot);
+  deck->queue = NULL;
+  deck->due = NULL;
+  deck->snapshot = NULL;
+}
+
+static bool srsModel_Deck_IsCurrent(srsMODEL_DECK *deck)
+{
+  return (deck->queue != NULL) && (srsAtomic_Load(&deck->changes) == deck->loaded_changes);
+}
+
+/* Reads a deck's snapshot. Loading every deck does this on the walker's threads, which only wait on each other for the git lookups of a refresh, since those are serialized by the repository's lock. */
+static bool srsModel_Deck_Open(srsMODEL *model, srsMODEL_DECK *deck)
+{
+  char at_path[srsPATH_MAX + 1];
+  srsModel_Deck_Release(deck);
+  deck->loaded_changes = srsAtomic_Load(&deck->changes);
+  deck->snapshot = srsSnapshot_OpenAt(model, deck->path);
+  int32_t needed = kioku_path_concat(at_path, sizeof(at_path), deck->path, ".at");
+  deck->has_schedule = (needed > 0) && ((size_t)needed < sizeof(at_path)) && srsFile_ExistsAt(model->root_dir, at_path);
+  return deck->snapshot != NULL;
+}
+
+/* Queues an opened deck's cards. Decks do not depend on each other for this, so loading every deck does it in parallel. */
+static bool srsModel_Deck_Build(srsMODEL_DECK *deck)
+{
+  size_t count = srsSnapshot_GetCount(deck->snapshot);
+  deck->due = malloc(((count > 0) ? count : 1) * sizeof(*deck->due));
+  if (deck->due == NULL)
+  {
+    return false;
+  }
+  if (count > 0)
+  {
+    memcpy(deck->due, srsSnapshot_GetDueTimes(deck->snapshot), count * sizeof(*deck->due));
+    /* Build the ID index now rather than on the first request */
+    srsSnapshot_Find(deck->snapshot, srsSnapshot_GetID(deck->snapshot, 0), NULL);
+  }
+  deck->queue = srsScheduleQueue_Create(deck->due, count);
+  return deck->queue != NULL;
+}
+
+static srsMODEL_DECK *srsModel_Resident_Find(srsMODEL *model, const char *deck_key)
+{
+  void *deck = NULL;
+  srsSpinLock_Lock(&model->resident.lock);
+  srsHashMap_Get(&model->resident.map, deck_key, &deck);
+  srsSpinLock_Unlock(&model->resident.lock);
+  return deck;
+}
+
+/* Adds a deck that is loaded by whoever asks for it first, or finds the one already added */
+static srsMODEL_DECK *srsModel_Resident_Add(srsMODEL *model, const char *deck_key)
+{
+  void *found = NULL;
+  srsSpinLock_Lock(&model->resident.lock);
+  if (!srsHashMap_Get(&model->resident.map, deck_key, &found))
+  {
+    srsMODEL_DECK *deck = calloc(1, sizeof(*deck));
+    if ((deck != NULL) && srsMutex_Init(&deck->lock))
+    {
+      srsAtomic_Store(&deck->changes, 1);
+      deck->path = srsHashMap_Intern(&model->resident.map, deck_key);
+      if ((deck->path != NULL) && srsHashMap_Set(&model->resident.map, deck_key, deck) && srsModelDeckList_Push(&model->resident.decks, deck))
+      {
+        found = deck;
+      }
+      else
+      {
+        srsHashMap_Remove(&model->resident.map, deck_key);
+        srsMutex_Destroy(&deck->lock);
+        free(deck);
+      }
+    }
+    else
+    {
+      free(deck);
+    }
+  }
+  srsSpinLock_Unlock(&model->resident.lock);
+  return found;
+}
+
+/**
+ * Finds a deck of the resident model, loading it if it is new or cards came or went since it was loaded, and returns it locked. Unlock it with srsMutex_Unlock.
+ * Decks that have not been seen yet are added if they exist, so decks created after the root was set become resident too.
+ * @return The deck, or NULL if the model is not resident or the deck cannot be read.
+ */
+static srsMODEL_DECK *srsModel_Resident_Acquire(srsMODEL *model, const char *deck_key)
+{
+  if (!model->resident.enabled || (model->root_dir == NULL))
+  {
+    return NULL;
+  }
+  srsMODEL_DECK *deck = srsModel_Resident_Find(model, deck_key);
+  if ((deck == NULL) && srsDir_ExistsAt(model->root_dir, deck_key))
+  {
+    deck = srsModel_Resident_Add(model, deck_key);
+  }
+  if (deck == NULL)
+  {
+    return NULL;
+  }
+  srsMutex_Lock(&deck->lock);
+  if (!srsModel_Deck_IsCurrent(deck) && !(srsModel_Deck_Open(model, deck) && srsModel_Deck_Build(deck)))
+  {
+    srsModel_Deck_Release(deck);
+    srsMutex_Unlock(&deck->lock);
+    return NULL;
+  }
+  return deck;
+}
+
+/* Moves a card of a resident deck within its queue. If the deck is current but has no such card, a card was added, so it is reloaded. */
+static bool srsModel_Resident_Reschedule(srsMODEL_DECK *deck, const char *card_id, srsTIME_PACKED due)
+{
+  size_t index = 0;
+  bool found = false;
+  srsMutex_Lock(&deck->lock);
+  if (srsModel_Deck_IsCurrent(deck))
+  {
+    found = srsSnapshot_Find(deck->snapshot, card_id, &index);
+    if (found)
+    {
+      deck->due[index] = due;
+      srsScheduleQueue_Update(deck->queue, (uint32_t)index, due);
+    }
+    else
+    {
+      srsAtomic_Add(&deck->changes, 1);
+    }
+  }
+  srsMutex_Unlock(&deck->lock);
+  return found;
+}
+
+/* Whether a card is in a resident deck that is current, sparing a look on disk */
+static bool srsModel_Resident_HasCard(srsMODEL_DECK *deck, const char *card_id)
+{
+  srsMutex_Lock(&deck->lock);
+  bool found = srsModel_Deck_IsCurrent(deck) && srsSnapshot_Find(deck->snapshot, card_id, NULL);
+  srsMutex_Unlock(&deck->lock);
+  return found;
+}
+
+/**
+ * Finds the card due soonest in a resident deck.
+ * @return Whether the resident model could answer, in which case result_out says whether a card was found. Decks with an .at file are left to be read from disk.
+ */
+static bool srsModel_Resident_GetNextID(srsMODEL *model, const char *deck_key, char *card_id_buf, size_t card_id_buf_size, bool *result_out)
+{
+  uint32_t index = 0;
+  srsMODEL_DECK *deck = srsModel_Resident_Acquire(model, deck_key);
+  if (deck == NULL)
+  {
+    return false;
+  }
+  bool answered = !deck->has_schedule;
+  if (answered)
+  {
+    *result_out = srsScheduleQueue_Peek(deck->queue, &index, NULL);
+    if (*result_out)
+    {
+      const char *id = srsSnapshot_GetID(deck->snapshot, index);
+      size_t length = strlen(id);
+      *result_out = (length < card_id_buf_size);
+      if (*result_out)
+      {
+        memcpy(card_id_buf, id, length + 1);
+      }
+      else
+      {
+        srsLOG_ERROR("Insufficient string size: %zu < %zu", card_id_buf_size, length + 1);
+      }
+    }
+  }
+  srsMutex_Unlock(&deck->lock);
+  return answered;
+}
+
+typedef struct _srsMODEL_RESIDENT_LOAD_s
+{
+  srsMODEL_DECK **decks;
+  size_t count;
+  srsATOMIC32 next;
+} srsMODEL_RESIDENT_LOAD;
+
+typedef struct _srsMODEL_RESIDENT_FIND_s
+{
+  srsMODEL *model;
+  const char *decks_path;      /* Path of the decks directory handle, to tell it from the decks in it */
+} srsMODEL_RESIDENT_FIND;
+
+/* Runs on the walker's threads. Every deck with cards is added and its snapshot opened, so decks are opened in parallel as the walk reaches them. */
+static srsFILESYSTEM_VISIT_ACTION srsModel_Resident_Visit(srsDIR *dir, const char *name, bool is_dir, void *userdata)
+{
+  srsMODEL_RESIDENT_FIND *find = userdata;
+  char path[srsMODEL_DECK_ID_MAX];
+  if (!is_dir || (name[0] == '.'))
+  {
+    return srsFILESYSTEM_VISIT_CONTINUE;
+  }
+  const char *dir_path = srsDir_GetPath(dir);
+  size_t decks_length = strlen(find->decks_path);
+  if (strcmp(dir_path, find->decks_path) == 0)
+  {
+    /* A deck, which is only kept if it has cards */
+    return srsFILESYSTEM_VISIT_RECURSE;
+  }
+  if ((strcmp(name, srsMODEL_CARDS_DIRNAME) != 0) || (strncmp(dir_path, find->decks_path, decks_length) != 0) || !srsCHAR_ISDIRSEP(dir_path[decks_length]))
+  {
+    return srsFILESYSTEM_VISIT_CONTINUE;
+  }
+  int needed = snprintf(path, sizeof(path), srsMODEL_DECKS_DIRNAME "/%s", dir_path + decks_length + 1);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(path)))
+  {
+    return srsFILESYSTEM_VISIT_STOP;
+  }
+  srsMODEL_DECK *deck = srsModel_Resident_Add(find->model, path);
+  if (deck == NULL)
+  {
+    srsLOG_ERROR("Unable to keep deck %s in memory", path);
+    return srsFILESYSTEM_VISIT_STOP;
+  }
+  srsMutex_Lock(&deck->lock);
+  if (!srsModel_Deck_Open(find->model, deck))
+  {
+    srsLOG_ERROR("Unable to read deck %s - it will be read again when it is asked for", deck->path);
+  }
+  srsMutex_Unlock(&deck->lock);
+  return srsFILESYSTEM_VISIT_STOP;
+}
+
+static void *srsModel_Resident_Build(void *arg)
+{
+  srsMODEL_RESIDENT_LOAD *load = arg;
+  int32_t i = 0;
+  while ((i = srsAtomic_Add(&load->next, 1) - 1) < (int32_t)load->count)
+  {
+    srsMODEL_DECK *deck = load->decks[i];
+    srsMutex_Lock(&deck->lock);
+    if ((deck->snapshot != NULL) && !srsModel_Deck_Build(deck))
+    {
+      srsModel_Deck_Release(deck);
+    }
+    srsMutex_Unlock(&deck->lock);
+  }
+  return NULL;
+}
+
+/* Loads every deck of the root. Decks are found and their snapshots opened by a parallel walk of the decks directory, and then queued on as many threads as there are decks, up to the hardware's. */
+static void srsModel_Resident_Load(srsMODEL *model)
+{
+  srsMODEL_RESIDENT_LOAD load = {0};
+  srsTHREAD threads[srsMODEL_RESIDENT_THREADS_MAX];
+  size_t started = 0;
+  size_t cards = 0;
+  size_t i = 0;
+  size_t thread_count = srsThread_GetHardwareConcurrency();
+  thread_count = (thread_count < srsMODEL_RESIDENT_THREADS_MAX) ? thread_count : srsMODEL_RESIDENT_THREADS_MAX;
+  /* The walker opens its start the same way, so the paths it hands out begin with this one */
+  srsDIR *decks_dir = srsDir_OpenAt(model->root_dir, srsMODEL_DECKS_DIRNAME);
+  if (decks_dir != NULL)
+  {
+    srsMODEL_RESIDENT_FIND find = {.model = model, .decks_path = srsDir_GetPath(decks_dir)};
+    if (!srsFileSystem_IterateParallel(model->root_dir, srsMODEL_DECKS_DIRNAME, (uint32_t)thread_count, &find, srsModel_Resident_Visit))
+    {
+      srsLOG_ERROR("Unable to read every deck - the rest will be read when they are asked for");
+    }
+    srsDir_Close(decks_dir);
+  }
+
+  /* The walk is over, but decks may still be added by anyone asking for one, so build from a copy of the list */
+  srsSpinLock_Lock(&model->resident.lock);
+  load.count = model->resident.decks.count;
+  load.decks = (load.count == 0) ? NULL : malloc(load.count * sizeof(*load.decks));
+  if (load.decks != NULL)
+  {
+    memcpy(load.decks, model->resident.decks.data, load.count * sizeof(*load.decks));
+  }
+  srsSpinLock_Unlock(&model->resident.lock);
+  if ((load.count > 0) && (load.decks == NULL))
+  {
+    srsLOG_ERROR("Unable to allocate the list of %zu decks - they will be read when they are asked for", load.count);
+    return;
+  }
+  thread_count = (thread_count < load.count) ? thread_count : load.count;
+  for (i = 1; i < thread_count; i++)
+  {
+    if (srsThread_Create(&threads[started], srsModel_Resident_Build, &load))
+    {
+      started++;
+    }
+  }
+  srsModel_Resident_Build(&load);
+  for (i = 0; i < started; i++)
+  {
+    srsThread_Join(threads[i], NULL);
+  }
+  for (i = 0; i < load.count; i++)
+  {
+    srsMutex_Lock(&load.decks[i]->lock);
+    cards += srsSnapshot_GetCount(load.decks[i]->snapshot);
+    srsMutex_Unlock(&load.decks[i]->lock);
+  }
+  srsLOG_PRINT("Keeping %zu cards of %zu decks in memory", cards, load.count);
+  free(load.decks);
+}
+
+static void srsModel_Resident_Unload(srsMODEL *model)
+{
+  srsMODEL_DECK *deck = NULL;
+  srsSpinLock_Lock(&model->resident.lock);
+  while (srsModelDeckList_Pop(&model->resident.decks, &deck))
+  {
+    srsModel_Deck_Release(deck);
+    srsMutex_Destroy(&deck->lock);
+    free(deck);
+  }
+  srsModelDeckList_Free(&model->resident.decks);
+  /* Start over with a fresh map, since interned paths are only freed with it */
+  srsHashMap_Free(&model->resident.map);
+  if (model->resident.enabled && !srsHashMap_Init(&model->resident.map, 0))
+  {
+    srsLOG_ERROR("Unable to keep decks in memory - they will be read from disk");
+    model->resident.enabled = false;
+  }
+  srsSpinLock_Unlock(&model->resident.lock);
+}
+
+/* Runs on the watcher thread with a path relative to the root. A rescheduled card is moved within its deck, and cards coming or going make the deck reload when it is next asked for. */
+static void srsModel_Resident_OnChange(srsMODEL *model, srsWATCH_EVENT event, const char *path)
+{
+  static const char decks_dir[] = srsMODEL_DECKS_DIRNAME "/";
+  static const char cards_dir[] = "/" srsMODEL_CARDS_DIRNAME "/";
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  char card_id[srsMODEL_CARD_ID_MAX];
+  size_t i = 0;
+  /* Nothing is in memory unless resident, and checking that under the lock keeps it from racing with srsModel_SetResidentAt */
+  if (event == srsWATCH_RESCAN)
+  {
+    srsSpinLock_Lock(&model->resident.lock);
+    for (i = 0; i < model->resident.decks.count; i++)
+    {
+      srsAtomic_Add(&model->resident.decks.data[i]->changes, 1);
+    }
+    srsSpinLock_Unlock(&model->resident.lock);
+    return;
+  }
+  if ((strncmp(path, decks_dir, sizeof(decks_dir) - 1) != 0) || (strstr(path, "/" srsSNAPSHOT_DIRNAME) != NULL))
+  {
+    return;
+  }
+  const char *slash = strchr(path + sizeof(decks_dir) - 1, '/');
+  size_t length = (slash == NULL) ? strlen(path) : (size_t)(slash - path);
+  if (length >= sizeof(deck_key))
+  {
+    return;
+  }
+  memcpy(deck_key, path, length);
+  deck_key[length] = kiokuCHAR_NULL;
+  /* Decks not yet in memory are read when first asked for */
+  srsMODEL_DECK *deck = srsModel_Resident_Find(model, deck_key);
+  if (deck == NULL)
+  {
+    return;
+  }
+  const char *rest = path + length;
+  if (strncmp(rest, cards_dir, sizeof(cards_dir) - 1) == 0)
+  {
+    const char *card_path = rest + sizeof(cards_dir) - 1;
+    slash = strchr(card_path, '/');
+    length = (slash == NULL) ? 0 : (size_t)(slash - card_path);
+    if ((slash != NULL) && (strcmp(slash, "/scheduled.txt") == 0) && (length < sizeof(card_id)))
+    {
+      memcpy(card_id, card_path, length);
+      card_id[length] = kiokuCHAR_NULL;
+      srsModel_Resident_Reschedule(deck, card_id, srsModel_Card_ReadDue(model, deck_key, card_id, srsClock_Now()));
+      return;
+    }
+    /* Editing what is on a card does not change its schedule */
+    if ((slash != NULL) && (strcmp(slash, "/added.txt") != 0))
+    {
+      return;
+    }
+  }
+  srsAtomic_Add(&deck->changes, 1);
+}
+
+void srsModel_SetResidentAt(srsMODEL *model, bool resident)
+{
+  if (resident == model->resident.enabled)
+  {
+    return;
+  }
+  if (!resident)
+  {
+    srsSpinLock_Lock(&model->resident.lock);
+    model->resident.enabled = false;
+    srsSpinLock_Unlock(&model->resident.lock);
+    srsModel_Resident_Unload(model);
+    return;
+  }
+  /* The watcher thread may be looking decks up meanwhile */
+  srsSpinLock_Lock(&model->resident.lock);
+  model->resident.enabled = srsHashMap_Init(&model->resident.map, 0);
+  srsSpinLock_Unlock(&model->resident.lock);
+  if (!model->resident.enabled)
+  {
+    srsLOG_ERROR("Unable to keep decks in memory - they will be read from disk");
+    return;
+  }
+  if (model->root_dir != NULL)
+  {
+    srsModel_Resident_Load(model);
+  }
+}
+
+void srsModel_SetResident(bool resident)
+{
+  srsModel_SetResidentAt(&srsModel_DEFAULT, resident);
+}
+
+bool srsModel_IsResidentAt(srsMODEL *model)
+{
+  return model->resident.enabled;
+}
+
+bool srsModel_IsResident()
+{
+  return srsModel_IsResidentAt(&srsModel_DEFAULT);
+}
+
+bool srsModel_Deck_ForEachCardAt(srsMODEL *model, const char *deck_path, srsMODEL_CARD_FUNC func, void *userdata)
+{
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  char path[srsPATH_MAX + 1];
+  srsCARD card = {0};
+  bool result = true;
+  size_t i = 0;
+  if ((deck_path == NULL) || (func == NULL) || !srsModel_DueQueue_GetDeckKey(model, deck_path, deck_key, sizeof(deck_key)))
+  {
+    return false;
+  }
+  srsMODEL_DECK *deck = srsModel_Resident_Acquire(model, deck_key);
+  if (deck == NULL)
+  {
+    return false;
+  }
+  size_t count = srsSnapshot_GetCount(deck->snapshot);
+  const char *cards_path = srsSnapshot_GetCardsPath(deck->snapshot);
+  for (i = 0; result && (i < count); i++)
+  {
+    card.id = srsSnapshot_GetID(deck->snapshot, i);
+    int32_t needed = kioku_path_concat(path, sizeof(path), cards_path, card.id);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(path)))
+    {
+      srsLOG_ERROR("Card path for %s is too long", card.id);
+      continue;
+    }
+    card.path = path;
+    card.when_added = srsSnapshot_GetAdded(deck->snapshot, i);
+    card.when_next_scheduled = srsTime_Unpack(deck->due[i]);
+    result = func(&card, userdata);
+  }
+  srsMutex_Unlock(&deck->lock);
+  return result;
+}
+
+bool srsModel_Deck_ForEachCard(const char *deck_path, srsMODEL_CARD_FUNC func, void *userdata)
+{
+  return srsModel_Deck_ForEachCardAt(&srsModel_DEFAULT, deck_path, func, userdata);
+}
+
+/**
+ * Without an explicit schedule the next card is the one due soonest, which is the head of the deck's due queue.
+ * Every deck keeps its own queue between calls. While the model is watched only the cards the watcher saw rescheduled are re-read, and otherwise the queue is kept as long as the deck's snapshot is in the same state.
+ */
+static bool srsModel_Card_GetSoonestDue(srsMODEL *model, const char *deck_path, char *card_id_buf, size_t card_id_buf_size)
+{
+  bool result = false;
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  char pending_ids[srsMODEL_DUE_PENDING_MAX][srsMODEL_CARD_ID_MAX];
+  uint32_t pending[srsMODEL_DUE_PENDING_MAX];
+  srsTIME_PACKED pending_due[srsMODEL_DUE_PENDING_MAX];
+  size_t pending_count = 0;
+  uint32_t generation = 0;
+  srsSNAPSHOT *snapshot = NULL;
+  size_t i = 0;
+  if (!srsModel_DueQueue_GetDeckKey(model, deck_path, deck_key, sizeof(deck_key)))
+  {
+    srsLOG_ERROR("Deck path is too long: %s", deck_path);
+    return false;
+  }
+  bool watched = (model->watch != NULL);
+  if (!watched)
+  {
+    /* Nothing reports changes, so the snapshot is what tells whether the queue is still current */
+    snapshot = srsSnapshot_OpenAt(model, deck_key);
+    if (snapshot == NULL)
+    {
+      return false;
+    }
+  }
+
+  /* Take the rescheduled cards, if the queue can be kept */
+  srsSpinLock_Lock(&model->due_lock);
+  srsMODEL_DUE_QUEUE *due = srsModel_DueQueue_Find(model, deck_key);
+  bool reuse = (due != NULL) && due->valid && (watched || srsSnapshot_IsSameState(due->snapshot, snapshot));
+  if (reuse)
+  {
+    pending_count = due->pending_count;
+    for (i = 0; i < pending_count; i++)
+    {
+      pending[i] = due->pending[i];
+      snprintf(pending_ids[i], sizeof(pending_ids[i]), "%s", srsSnapshot_GetID(due->snapshot, pending[i]));
+    }
+    due->pending_count = 0;
+    generation = due->generation;
+  }
+  srsSpinLock_Unlock(&model->due_lock);
+
+  if (reuse)
+  {
+    srsTIME_PACKED now = srsClock_Now();
+    srsSnapshot_Close(snapshot);
+    for (i = 0; i < pending_count; i++)
+    {
+      pending_due[i] = srsModel_Card_ReadDue(model, deck_key, pending_ids[i], now);
+    }
+  }
+  else
+  {
+    /* Build a new queue outside the lock, keeping it only if no cards changed meanwhile */
+    int32_t changes = srsAtomic_Load(&model->card_changes);
+    if (snapshot == NULL)
+    {
+      snapshot = srsSnapshot_OpenAt(model, deck_key);
+    }
+    srsSCHEDULE_QUEUE *queue = (snapshot == NULL) ? NULL : srsScheduleQueue_Create(srsSnapshot_GetDueTimes(snapshot), srsSnapshot_GetCount(snapshot));
+    if (queue == NULL)
+    {
+      srsSnapshot_Close(snapshot);
+      return false;
+    }
+    srsSpinLock_Lock(&model->due_lock);
+    due = srsModel_DueQueue_Add(model, deck_key);
+    srsSNAPSHOT *old_snapshot = (due == NULL) ? snapshot : due->snapshot;
+    srsSCHEDULE_QUEUE *old_queue = (due == NULL) ? queue : due->queue;
+    if (due != NULL)
+    {
+      due->snapshot = snapshot;
+      due->queue = queue;
+      due->valid = (srsAtomic_Load(&model->card_changes) == changes);
+      due->pending_count = 0;
+      generation = due->generation = ++model->due_generation;
+    }
+    else
+    {
+      /* Answer from the queue just built, even though it could not be kept */
+      uint32_t card = 0;
+      result = srsScheduleQueue_Peek(queue, &card, NULL) && (snprintf(card_id_buf, card_id_buf_size, "%s", srsSnapshot_GetID(snapshot, card)) < (int)card_id_buf_size);
+    }
+    srsSpinLock_Unlock(&model->due_lock);
+    srsScheduleQueue_Free(old_queue);
+    srsSnapshot_Close(old_snapshot);
+    if (due == NULL)
+    {
+      return result;
+    }
+  }
+
+  /* Peek while holding the lock, since the watcher may invalidate the queue at any time */
+  srsSpinLock_Lock(&model->due_lock);
+  due = srsModel_DueQueue_Find(model, deck_key);
+  if ((due != NULL) && (due->generation == generation))
+  {
+    uint32_t card = 0;
+    for (i = 0; i < pending_count; i++)
+    {
+      srsScheduleQueue_Update(due->queue, pending[i], pending_due[i]);
+    }
+    if (srsScheduleQueue_Peek(due->queue, &card, NULL))
+    {
+      const char *card_id = srsSnapshot_GetID(due->snapshot, card);
+      size_t length = strlen(card_id);
+      result = (card_id_buf_size >= length + 1);
+      if (result)
+      {
+        memcpy(card_id_buf, card_id, length + 1);
+      }
+      else
+      {
+        srsLOG_ERROR("Insufficient string size: %zu < %zu", card_id_buf_size, length + 1);
+      }
+    }
+  }
+  srsSpinLock_Unlock(&model->due_lock);
+  return result;
+}
+
+bool srsModel_Card_GetNextIDAt(srsMODEL *model, const char *deck_path, char *card_id_buf, size_t card_id_buf_size)
+{
+  bool result = false;
+  char file_path[srsPATH_MAX] = {0};
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  if ((deck_path != NULL) && srsModel_DueQueue_GetDeckKey(model, deck_path, deck_key, sizeof(deck_key)) && srsModel_Resident_GetNextID(model, deck_key, card_id_buf, card_id_buf_size, &result))
+  {
+    return result;
+  }
+
+  /* Get path to the .at file */
+  int32_t atlen = kioku_path_concat(file_path, sizeof(file_path), deck_path, ".at");
+  result = ((atlen > 0) && (atlen < sizeof(file_path)));
+  if (!result)
+  {
+    return result;
+  }
+  if (!srsFile_ExistsAt(model->root_dir, file_path))
+  {
+    return srsModel_Card_GetSoonestDue(model, deck_path, card_id_buf, card_id_buf_size);
+  }
+
+  /* Get content from .at file */
+  char atindex_string[16] = {0};
+  result = srsFile_GetContentAt(model->root_dir, file_path, atindex_string, sizeof(atindex_string));
+  srsLOG_PRINT(".at = %s", atindex_string);
+  if (!result)
+  {
+    return result;
+  }
+
+  /* Convert .at content to integer */
+  int32_t atindex = 0;
+  result = srsString_ToU32(atindex_string, &atindex);
+  if (!result)
+  {
+    return result;
+  }
+  if (atindex < 1)
+  {
+    srsLOG_ERROR("Line number is out of range for line search (%d)", atindex);
+    return false;
+  }
+
+  int32_t schedlen = kioku_path_concat(file_path, sizeof(file_path), deck_path, ".schedule");
+  result = ((schedlen > 0) && (schedlen < sizeof(file_path)));
+  if (!result)
+  {
+    srsLOG_ERROR("Schedule file path name length out of range: %d", schedlen);
+    return result;
   }
   char linedata[srsMODEL_CARD_ID_MAX] = {0};
-  int32_t linelen = srsFile_ReadLineByNumber(file_path, (uint32_t)atindex, linedata, sizeof(linedata));
+  int32_t linelen = srsFile_ReadLineIndexedAt(model->root_dir, file_path, (uint32_t)atindex, linedata, sizeof(linedata));
   if (linelen < 0)
   {
     srsLOG_ERROR("%d line invalid", atindex);
@@ -322,3 +1667,244 @@ bool srsModel_Card_GetNextID(const char *deck_path, char *card_id_buf, size_t ca
   return result;
 }
 
+bool srsModel_Card_GetNextID(const char *deck_path, char *card_id_buf, size_t card_id_buf_size)
+{
+  return srsModel_Card_GetNextIDAt(&srsModel_DEFAULT, deck_path, card_id_buf, card_id_buf_size);
+}
+
+bool srsModel_Card_SetDueAt(srsMODEL *model, const char *deck_path, const char *card_id, srsTIME due)
+{
+  char deck_key[srsMODEL_DECK_ID_MAX];
+  char path[srsPATH_MAX + 1];
+  srsTIME_STRING content = {0};
+  size_t index = 0;
+  if ((deck_path == NULL) || (card_id == NULL) || (model->root_dir == NULL) || !srsModel_DueQueue_GetDeckKey(model, deck_path, deck_key, sizeof(deck_key)))
+  {
+    return false;
+  }
+  if (!srsTime_ToString(due, content))
+  {
+    srsLOG_ERROR("Invalid due time for card %s", card_id);
+    return false;
+  }
+  srsMODEL_DECK *deck = model->resident.enabled ? srsModel_Resident_Find(model, deck_key) : NULL;
+  int needed = snprintf(path, sizeof(path), "%s/" srsMODEL_CARDS_DIRNAME "/%s", deck_key, card_id);
+  if ((needed <= 0) || ((size_t)needed + sizeof("/scheduled.txt") > sizeof(path)) || !(((deck != NULL) && srsModel_Resident_HasCard(deck, card_id)) || srsDir_ExistsAt(model->root_dir, path)))
+  {
+    srsLOG_ERROR("No card %s in deck %s", card_id, deck_path);
+    return false;
+  }
+  strcat(path, "/scheduled.txt");
+  if (!srsFile_SetContentAt(model->root_dir, path, (const char *)content))
+  {
+    return false;
+  }
+  /* Move it within the queue straight away rather than waiting for the watcher */
+  srsSpinLock_Lock(&model->due_lock);
+  srsMODEL_DUE_QUEUE *queue = srsModel_DueQueue_Find(model, deck_key);
+  if ((queue != NULL) && queue->valid && srsSnapshot_Find(queue->snapshot, card_id, &index))
+  {
+    srsScheduleQueue_Update(queue->queue, (uint32_t)index, srsTime_Pack(due));
+  }
+  srsSpinLock_Unlock(&model->due_lock);
+  if (deck != NULL)
+  {
+    srsModel_Resident_Reschedule(deck, card_id, srsTime_Pack(due));
+  }
+  return true;
+}
+
+bool srsModel_Card_SetDue(const char *deck_path, const char *card_id, srsTIME due)
+{
+  return srsModel_Card_SetDueAt(&srsModel_DEFAULT, deck_path, card_id, due);
+}
+
+
+/* Cards counted by one thread at a time while forecasting */
+typedef struct _srsMODEL_FORECAST_RANGE_s
+{
+  const srsTIME_PACKED *due;
+  size_t count;
+} srsMODEL_FORECAST_RANGE;
+
+typedef struct _srsMODEL_FORECAST_s
+{
+  const srsMODEL_FORECAST_RANGE *ranges;
+  size_t range_count;
+  srsATOMIC32 next_range;
+  srsTIME_PACKED start;
+  uint32_t days;
+} srsMODEL_FORECAST;
+
+typedef struct _srsMODEL_FORECAST_WORKER_s
+{
+  srsMODEL_FORECAST *forecast;
+  uint32_t *counts;
+} srsMODEL_FORECAST_WORKER;
+
+/* Takes ranges until there are none left, so threads that get small decks simply take more of them */
+static void *srsModel_Forecast_Run(void *arg)
+{
+  srsMODEL_FORECAST_WORKER *worker = (srsMODEL_FORECAST_WORKER *)arg;
+  srsMODEL_FORECAST *forecast = worker->forecast;
+  int32_t range = 0;
+  while ((range = srsAtomic_Add(&forecast->next_range, 1) - 1) < (int32_t)forecast->range_count)
+  {
+    srsScheduler_CountDue(forecast->ranges[range].due, forecast->ranges[range].count, forecast->start, forecast->days, worker->counts);
+  }
+  return NULL;
+}
+
+/* Opens the snapshot of every deck. Directories without cards are not decks, but decks that cannot be read are failures. */
+static bool srsModel_Forecast_OpenDecks(srsMODEL *model, srsSNAPSHOT ***snapshots_out, size_t *count_out)
+{
+  bool result = true;
+  const char *name = NULL;
+  bool is_dir = false;
+  char path[srsMODEL_DECK_ID_MAX];
+  char cards_path[srsPATH_MAX + 1];
+  srsSNAPSHOT **snapshots = NULL;
+  size_t count = 0;
+  srsDIR_STREAM *stream = srsDirStream_Open(model->root_dir, srsMODEL_DECKS_DIRNAME);
+  if (stream == NULL)
+  {
+    return false;
+  }
+  while (srsDirStream_Next(stream, &name, &is_dir))
+  {
+    int needed = snprintf(path, sizeof(path), srsMODEL_DECKS_DIRNAME "/%s", name);
+    if (!is_dir || (name[0] == '.') || (needed <= 0) || ((size_t)needed >= sizeof(path)))
+    {
+      continue;
+    }
+    needed = snprintf(cards_path, sizeof(cards_path), "%s/" srsMODEL_CARDS_DIRNAME, path);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(cards_path)) || !srsDir_ExistsAt(model->root_dir, cards_path))
+    {
+      continue;
+    }
+    srsSNAPSHOT **grown = realloc(snapshots, (count + 1) * sizeof(*snapshots));
+    srsSNAPSHOT *snapshot = (grown == NULL) ? NULL : srsSnapshot_OpenAt(model, path);
+    snapshots = (grown == NULL) ? snapshots : grown;
+    if (snapshot == NULL)
+    {
+      srsLOG_ERROR("Unable to read deck %s for the forecast", path);
+      result = false;
+      continue;
+    }
+    snapshots[count++] = snapshot;
+  }
+  srsDirStream_Close(stream);
+  *snapshots_out = snapshots;
+  *count_out = count;
+  return result;
+}
+
+bool srsModel_GetForecastAt(srsMODEL *model, srsTIME from, uint32_t days, uint32_t *counts_out)
+{
+  srsSNAPSHOT **snapshots = NULL;
+  size_t snapshot_count = 0;
+  srsMODEL_FORECAST_RANGE *ranges = NULL;
+  size_t range_count = 0;
+  srsMODEL_FORECAST forecast = {0};
+  srsMODEL_FORECAST_WORKER workers[srsMODEL_FORECAST_THREADS_MAX];
+  srsTHREAD threads[srsMODEL_FORECAST_THREADS_MAX];
+  uint32_t *counts = NULL;
+  size_t i = 0;
+  size_t d = 0;
+  if ((counts_out == NULL) || (model->root_dir == NULL))
+  {
+    return false;
+  }
+  memset(counts_out, 0, days * sizeof(*counts_out));
+  if (days == 0)
+  {
+    return true;
+  }
+  /* Snapshots are opened on this thread before any worker starts, so that the workers only count */
+  bool result = srsModel_Forecast_OpenDecks(model, &snapshots, &snapshot_count);
+  for (i = 0; i < snapshot_count; i++)
+  {
+    range_count += (srsSnapshot_GetCount(snapshots[i]) + srsMODEL_FORECAST_CHUNK - 1) / srsMODEL_FORECAST_CHUNK;
+  }
+  ranges = (range_count == 0) ? NULL : malloc(range_count * sizeof(*ranges));
+  if ((range_count > 0) && (ranges == NULL))
+  {
+    srsLOG_ERROR("Unable to allocate %zu ranges of cards to forecast", range_count);
+    result = false;
+    goto done;
+  }
+  range_count = 0;
+  for (i = 0; i < snapshot_count; i++)
+  {
+    const srsTIME_PACKED *due = srsSnapshot_GetDueTimes(snapshots[i]);
+    size_t count = srsSnapshot_GetCount(snapshots[i]);
+    size_t start = 0;
+    for (start = 0; start < count; start += srsMODEL_FORECAST_CHUNK)
+    {
+      ranges[range_count].due = due + start;
+      ranges[range_count].count = ((count - start) < srsMODEL_FORECAST_CHUNK) ? (count - start) : srsMODEL_FORECAST_CHUNK;
+      range_count++;
+    }
+  }
+
+  size_t thread_count = srsThread_GetHardwareConcurrency();
+  thread_count = (thread_count < range_count) ? thread_count : range_count;
+  thread_count = (thread_count < srsMODEL_FORECAST_THREADS_MAX) ? thread_count : srsMODEL_FORECAST_THREADS_MAX;
+  thread_count = (thread_count < 1) ? 1 : thread_count;
+  /* Each thread gets its own counters, padded to whole cache lines so threads never write to the same one */
+  size_t stride = (days + 15) & ~(size_t)15;
+  counts = calloc(thread_count * stride, sizeof(*counts));
+  if (counts == NULL)
+  {
+    srsLOG_ERROR("Unable to allocate counters for %zu threads", thread_count);
+    result = false;
+    goto done;
+  }
+  from.hour = 0;
+  from.minute = 0;
+  forecast.ranges = ranges;
+  forecast.range_count = range_count;
+  forecast.start = srsTime_Pack(from);
+  forecast.days = days;
+  size_t started = 0;
+  for (i = 0; i < thread_count; i++)
+  {
+    workers[i].forecast = &forecast;
+    workers[i].counts = &counts[i * stride];
+  }
+  /* The calling thread is the first worker. Threads that fail to start just leave more ranges to the others. */
+  for (i = 1; i < thread_count; i++)
+  {
+    if (srsThread_Create(&threads[started], srsModel_Forecast_Run, &workers[i]))
+    {
+      started++;
+    }
+  }
+  srsModel_Forecast_Run(&workers[0]);
+  for (i = 0; i < started; i++)
+  {
+    srsThread_Join(threads[i], NULL);
+  }
+  for (i = 0; i < thread_count; i++)
+  {
+    for (d = 0; d < days; d++)
+    {
+      counts_out[d] += counts[i * stride + d];
+    }
+  }
+
+done:
+  for (i = 0; i < snapshot_count; i++)
+  {
+    srsSnapshot_Close(snapshots[i]);
+  }
+  free(snapshots);
+  free(ranges);
+  free(counts);
+  return result;
+}
+
+bool srsModel_GetForecast(srsTIME from, uint32_t days, uint32_t *counts_out)
+{
+  return srsModel_GetForecastAt(&srsModel_DEFAULT, from, days, counts_out);
+}
@@ -0,0 +1,586 @@
+#include "kioku/optimizer.h"
+#include "kioku/git.h"
+#include "kioku/model.h"
+#include "kioku/clock.h"
+#include "kioku/datastructure.h"
+#include "kioku/thread.h"
+#include "kioku/log.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define srsOPTIMIZER_MINUTES_PER_DAY 1440u
+/* Grades inferred from the history: an interval that grew by less than the first factor was Hard, and by at least the second was Easy */
+#define srsOPTIMIZER_HARD_FACTOR 1.5f
+#define srsOPTIMIZER_EASY_FACTOR 3.5f
+/* Predictions are kept this far from 0 so a confident miss costs a lot, but not infinitely much */
+#define srsOPTIMIZER_MIN_PROBABILITY 1e-4f
+/* Adam's decay rates and guard against dividing by zero */
+#define srsOPTIMIZER_BETA1 0.9f
+#define srsOPTIMIZER_BETA2 0.999f
+#define srsOPTIMIZER_EPSILON 1e-8f
+
+/* Ranges the FSRS weights are kept in while fitting, as in the reference optimizer */
+static const float srsOptimizer_WEIGHT_MIN[srsSCHEDULER_FSRS_WEIGHTS] = {
+  0.001f, 0.001f, 0.001f, 0.001f, 1.0f, 0.001f, 0.001f, 0.001f, 0.0f, 0.0f,
+  0.001f, 0.001f, 0.001f, 0.001f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f
+};
+static const float srsOptimizer_WEIGHT_MAX[srsSCHEDULER_FSRS_WEIGHTS] = {
+  100.0f, 100.0f, 100.0f, 100.0f, 10.0f, 4.0f, 4.0f, 0.75f, 4.5f, 0.8f,
+  3.5f, 5.0f, 0.25f, 0.9f, 4.0f, 1.0f, 6.0f, 2.0f, 2.0f
+};
+
+typedef struct _srsREVIEW_s
+{
+  uint32_t card;
+  srsTIME_PACKED time;
+  uint8_t grade;
+} srsREVIEW;
+
+struct _srsREVIEW_LOG_s
+{
+  srsREVIEW *reviews;
+  size_t count;
+  size_t capacity;
+};
+
+/**
+ * The reviews of up to @ref srsOPTIMIZER_SHARD_CARDS cards, laid out a step at a time: first every card's first review, then every card's second, and so on.
+ * Cards are sorted by how many reviews they have, most first, so the cards with a review at a given step are always the first ones.
+ */
+typedef struct _srsOPTIMIZER_SHARD_s
+{
+  size_t card_count;
+  size_t step_count;
+  size_t scored_count;      /* Reviews that are scored, which is all but each card's first */
+  size_t *active;           /* Number of cards with a review at each step */
+  size_t *offsets;          /* Where each step's reviews start */
+  uint8_t *grades;
+  srsTIME_PACKED *times;
+} srsOPTIMIZER_SHARD;
+
+typedef struct _srsOPTIMIZER_DATA_s
+{
+  srsOPTIMIZER_SHARD *shards;
+  size_t shard_count;
+  size_t scored_count;
+} srsOPTIMIZER_DATA;
+
+/* A card's reviews within the sorted log */
+typedef struct _srsOPTIMIZER_SEQUENCE_s
+{
+  size_t start;
+  size_t length;
+} srsOPTIMIZER_SEQUENCE;
+
+/* Scores candidate settings against a batch of shards. Work items are pairs of shard and candidate, taken in turn by every thread. */
+typedef struct _srsOPTIMIZER_JOB_s
+{
+  const srsSCHEDULER *candidates;
+  size_t candidate_count;
+  const srsOPTIMIZER_SHARD *shards;
+  size_t shard_count;
+  srsATOMIC32 next_item;
+} srsOPTIMIZER_JOB;
+
+typedef struct _srsOPTIMIZER_WORKER_s
+{
+  srsOPTIMIZER_JOB *job;
+  double losses[srsSCHEDULER_FSRS_WEIGHTS + 1];
+} srsOPTIMIZER_WORKER;
+
+/* A version of a card's schedule file found in the history */
+typedef struct _srsOPTIMIZER_VERSION_s
+{
+  const char *path;
+  srsTIME_PACKED time;
+  srsTIME_PACKED due;
+  size_t order;
+} srsOPTIMIZER_VERSION;
+
+typedef struct _srsOPTIMIZER_HISTORY_s
+{
+  srsARENA arena;
+  srsOPTIMIZER_VERSION *versions;
+  size_t count;
+  size_t capacity;
+  bool failed;
+} srsOPTIMIZER_HISTORY;
+
+srsREVIEW_LOG *srsReviewLog_Create()
+{
+  return calloc(1, sizeof(srsREVIEW_LOG));
+}
+
+void srsReviewLog_Free(srsREVIEW_LOG *log)
+{
+  if (log != NULL)
+  {
+    free(log->reviews);
+    free(log);
+  }
+}
+
+bool srsReviewLog_Add(srsREVIEW_LOG *log, uint32_t card, srsTIME_PACKED time, srsGRADE grade)
+{
+  if ((log == NULL) || (grade < srsGRADE_AGAIN) || (grade > srsGRADE_EASY) || (time == srsTIME_PACKED_NONE) || (time == srsTIME_PACKED_NEVER))
+  {
+    return false;
+  }
+  if (log->count == log->capacity)
+  {
+    size_t capacity = (log->capacity == 0) ? 1024 : log->capacity * 2;
+    srsREVIEW *grown = realloc(log->reviews, capacity * sizeof(*grown));
+    if (grown == NULL)
+    {
+      srsLOG_ERROR("Unable to grow the review log to %zu reviews", capacity);
+      return false;
+    }
+    log->reviews = grown;
+    log->capacity = capacity;
+  }
+  log->reviews[log->count].card = card;
+  log->reviews[log->count].time = time;
+  log->reviews[log->count].grade = (uint8_t)grade;
+  log->count++;
+  return true;
+}
+
+size_t srsReviewLog_GetCount(const srsREVIEW_LOG *log)
+{
+  return (log == NULL) ? 0 : log->count;
+}
+
+/* How a card was graded, judging by how its interval changed from the previous schedule to the new one */
+static srsGRADE srsOptimizer_InferGrade(srsTIME_PACKED previous, srsTIME_PACKED previous_due, srsTIME_PACKED time, srsTIME_PACKED due)
+{
+  float day = (float)srsOPTIMIZER_MINUTES_PER_DAY;
+  float old_interval = (previous_due > previous) ? (float)(previous_due - previous) : 0.0f;
+  float new_interval = (due > time) ? (float)(due - time) : 0.0f;
+  old_interval = (old_interval < day) ? day : old_interval;
+  if ((new_interval < old_interval) && (new_interval <= day))
+  {
+    return srsGRADE_AGAIN;
+  }
+  float factor = new_interval / old_interval;
+  return (factor < srsOPTIMIZER_HARD_FACTOR) ? srsGRADE_HARD : ((factor < srsOPTIMIZER_EASY_FACTOR) ? srsGRADE_GOOD : srsGRADE_EASY);
+}
+
+static bool srsOptimizer_OnVersion(const char *path, const char *content, size_t size, int64_t time, void *userdata)
+{
+  static const char suffix[] = "/scheduled.txt";
+  srsOPTIMIZER_HISTORY *history = (srsOPTIMIZER_HISTORY *)userdata;
+  srsTIME_STRING string = {0};
+  srsTIME due;
+  size_t length = strlen(path);
+  if ((length < sizeof(suffix) - 1) || (strcmp(&path[length - (sizeof(suffix) - 1)], suffix) != 0))
+  {
+    return true;
+  }
+  memcpy(string, content, (size < sizeof(string) - 1) ? size : sizeof(string) - 1);
+  if (!srsTime_FromString(string, &due))
+  {
+    srsLOG_PRINT("Skipping unreadable schedule of %s", path);
+    return true;
+  }
+  if (history->count == history->capacity)
+  {
+    size_t capacity = (history->capacity == 0) ? 1024 : history->capacity * 2;
+    srsOPTIMIZER_VERSION *grown = realloc(history->versions, capacity * sizeof(*grown));
+    if (grown == NULL)
+    {
+      history->failed = true;
+      return false;
+    }
+    history->versions = grown;
+    history->capacity = capacity;
+  }
+  srsOPTIMIZER_VERSION *version = &history->versions[history->count];
+  version->path = srsArena_StrDup(&history->arena, path);
+  /* The history already gives the time in the committer's time zone */
+  version->time = srsClock_Pack(time, 0);
+  version->due = srsTime_Pack(due);
+  version->order = history->count;
+  history->failed = (version->path == NULL);
+  history->count += !history->failed;
+  return !history->failed;
+}
+
+static int srsOptimizer_CompareVersions(const void *a, const void *b)
+{
+  const srsOPTIMIZER_VERSION *left = (const srsOPTIMIZER_VERSION *)a;
+  const srsOPTIMIZER_VERSION *right = (const srsOPTIMIZER_VERSION *)b;
+  int compared = strcmp(left->path, right->path);
+  return (compared != 0) ? compared : ((left->order > right->order) - (left->order < right->order));
+}
+
+bool srsReviewLog_LoadHistoryAt(srsMODEL *model, srsREVIEW_LOG *log)
+{
+  srsOPTIMIZER_HISTORY history = {0};
+  size_t i = 0;
+  uint32_t card = 0;
+  if ((log == NULL) || !srsArena_Init(&history.arena, 0))
+  {
+    return false;
+  }
+  bool result = srsGitRepo_WalkHistory(srsModel_GetRepoAt(model), "*/scheduled.txt", srsOptimizer_OnVersion, &history) && !history.failed;
+  /* Each card's versions in the order they were committed. The first is when the card was added, and every later one is a review. */
+  if (history.count > 0)
+  {
+    qsort(history.versions, history.count, sizeof(*history.versions), srsOptimizer_CompareVersions);
+  }
+  for (i = 1; result && (i < history.count); i++)
+  {
+    const srsOPTIMIZER_VERSION *previous = &history.versions[i - 1];
+    const srsOPTIMIZER_VERSION *version = &history.versions[i];
+    if (strcmp(previous->path, version->path) != 0)
+    {
+      card++;
+      continue;
+    }
+    if (version->due != previous->due)
+    {
+      result = srsReviewLog_Add(log, card, version->time, srsOptimizer_InferGrade(previous->time, previous->due, version->time, version->due));
+    }
+  }
+  srsLOG_PRINT("Found %zu reviews of %u cards in %zu schedule versions", log->count, (history.count > 0) ? card + 1 : 0, history.count);
+  free(history.versions);
+  srsArena_Free(&history.arena);
+  return result;
+}
+
+bool srsReviewLog_LoadHistory(srsREVIEW_LOG *log)
+{
+  return srsReviewLog_LoadHistoryAt(srsModel_GetDefault(), log);
+}
+
+static int srsOptimizer_CompareReviews(const void *a, const void *b)
+{
+  const srsREVIEW *left = (const srsREVIEW *)a;
+  const srsREVIEW *right = (const srsREVIEW *)b;
+  if (left->card != right->card)
+  {
+    return (left->card > right->card) ? 1 : -1;
+  }
+  return (left->time > right->time) - (left->time < right->time);
+}
+
+/* Most reviews first, then in log order so shards come out the same every time */
+static int srsOptimizer_CompareSequences(const void *a, const void *b)
+{
+  const srsOPTIMIZER_SEQUENCE *left = (const srsOPTIMIZER_SEQUENCE *)a;
+  const srsOPTIMIZER_SEQUENCE *right = (const srsOPTIMIZER_SEQUENCE *)b;
+  if (left->length != right->length)
+  {
+    return (left->length < right->length) ? 1 : -1;
+  }
+  return (left->start > right->start) - (left->start < right->start);
+}
+
+static void srsOptimizer_FreeData(srsOPTIMIZER_DATA *data)
+{
+  size_t i = 0;
+  for (i = 0; i < data->shard_count; i++)
+  {
+    free(data->shards[i].active);
+    free(data->shards[i].offsets);
+    free(data->shards[i].grades);
+    free(data->shards[i].times);
+  }
+  free(data->shards);
+  memset(data, 0, sizeof(*data));
+}
+
+/**
+ * Splits the log into shards. Cards are dealt out in turn, most reviews first, so every shard gets a similar mix of long and short histories.
+ * Card i goes to shard i % shard_count, at position i / shard_count.
+ */
+static bool srsOptimizer_PrepareData(const srsREVIEW_LOG *log, srsOPTIMIZER_DATA *data)
+{
+  bool result = false;
+  srsREVIEW *reviews = NULL;
+  srsOPTIMIZER_SEQUENCE *sequences = NULL;
+  size_t sequence_count = 0;
+  size_t *review_counts = NULL;
+  size_t i = 0;
+  size_t k = 0;
+  memset(data, 0, sizeof(*data));
+  if (log->count == 0)
+  {
+    return false;
+  }
+  reviews = malloc(log->count * sizeof(*reviews));
+  sequences = malloc(log->count * sizeof(*sequences));
+  if ((reviews == NULL) || (sequences == NULL))
+  {
+    goto done;
+  }
+  memcpy(reviews, log->reviews, log->count * sizeof(*reviews));
+  qsort(reviews, log->count, sizeof(*reviews), srsOptimizer_CompareReviews);
+  for (i = 0; i < log->count; i++)
+  {
+    if ((i == 0) || (reviews[i].card != reviews[i - 1].card))
+    {
+      sequences[sequence_count].start = i;
+      sequences[sequence_count].length = 0;
+      sequence_count++;
+    }
+    sequences[sequence_count - 1].length++;
+  }
+  qsort(sequences, sequence_count, sizeof(*sequences), srsOptimizer_CompareSequences);
+
+  data->shard_count = (sequence_count + srsOPTIMIZER_SHARD_CARDS - 1) / srsOPTIMIZER_SHARD_CARDS;
+  data->shards = calloc(data->shard_count, sizeof(*data->shards));
+  review_counts = calloc(data->shard_count, sizeof(*review_counts));
+  if ((data->shards == NULL) || (review_counts == NULL))
+  {
+    data->shard_count = 0;
+    goto done;
+  }
+  for (i = 0; i < sequence_count; i++)
+  {
+    srsOPTIMIZER_SHARD *shard = &data->shards[i % data->shard_count];
+    shard->card_count++;
+    shard->step_count = (shard->step_count > sequences[i].length) ? shard->step_count : sequences[i].length;
+    shard->scored_count += sequences[i].length - 1;
+    review_counts[i % data->shard_count] += sequences[i].length;
+  }
+  for (i = 0; i < data->shard_count; i++)
+  {
+    srsOPTIMIZER_SHARD *shard = &data->shards[i];
+    shard->active = calloc(shard->step_count, sizeof(*shard->active));
+    shard->offsets = calloc(shard->step_count, sizeof(*shard->offsets));
+    shard->grades = malloc(review_counts[i] * sizeof(*shard->grades));
+    shard->times = malloc(review_counts[i] * sizeof(*shard->times));
+    if ((shard->active == NULL) || (shard->offsets == NULL) || (shard->grades == NULL) || (shard->times == NULL))
+    {
+      goto done;
+    }
+    data->scored_count += shard->scored_count;
+  }
+  for (i = 0; i < sequence_count; i++)
+  {
+    srsOPTIMIZER_SHARD *shard = &data->shards[i % data->shard_count];
+    for (k = 0; k < sequences[i].length; k++)
+    {
+      shard->active[k]++;
+    }
+  }
+  for (i = 0; i < data->shard_count; i++)
+  {
+    srsOPTIMIZER_SHARD *shard = &data->shards[i];
+    for (k = 1; k < shard->step_count; k++)
+    {
+      shard->offsets[k] = shard->offsets[k - 1] + shard->active[k - 1];
+    }
+  }
+  for (i = 0; i < sequence_count; i++)
+  {
+    srsOPTIMIZER_SHARD *shard = &data->shards[i % data->shard_count];
+    size_t position = i / data->shard_count;
+    for (k = 0; k < sequences[i].length; k++)
+    {
+      shard->grades[shard->offsets[k] + position] = reviews[sequences[i].start + k].grade;
+      shard->times[shard->offsets[k] + position] = reviews[sequences[i].start + k].time;
+    }
+  }
+  result = true;
+done:
+  if (!result)
+  {
+    srsLOG_ERROR("Unable to allocate shards for %zu reviews", log->count);
+    srsOptimizer_FreeData(data);
+  }
+  free(review_counts);
+  free(sequences);
+  free(reviews);
+  return result;
+}
+
+/* Replays a shard's reviews a step at a time, adding up the log loss of every prediction but the first of each card */
+static double srsOptimizer_Replay(const srsSCHEDULER *scheduler, const srsOPTIMIZER_SHARD *shard)
+{
+  float stability[srsOPTIMIZER_SHARD_CARDS];
+  float difficulty[srsOPTIMIZER_SHARD_CARDS];
+  srsTIME_PACKED last_review[srsOPTIMIZER_SHARD_CARDS];
+  srsTIME_PACKED due[srsOPTIMIZER_SHARD_CARDS];
+  uint16_t reps[srsOPTIMIZER_SHARD_CARDS];
+  uint16_t lapses[srsOPTIMIZER_SHARD_CARDS];
+  float retrievability[srsOPTIMIZER_SHARD_CARDS];
+  srsCARD_STATES states = {stability, difficulty, last_review, due, reps, lapses};
+  double loss = 0.0;
+  size_t i = 0;
+  size_t k = 0;
+  memset(stability, 0, shard->card_count * sizeof(*stability));
+  memset(difficulty, 0, shard->card_count * sizeof(*difficulty));
+  memset(last_review, 0, shard->card_count * sizeof(*last_review));
+  memset(due, 0, shard->card_count * sizeof(*due));
+  memset(reps, 0, shard->card_count * sizeof(*reps));
+  memset(lapses, 0, shard->card_count * sizeof(*lapses));
+  for (k = 0; k < shard->step_count; k++)
+  {
+    size_t count = shard->active[k];
+    const uint8_t *grades = shard->grades + shard->offsets[k];
+    const srsTIME_PACKED *times = shard->times + shard->offsets[k];
+    if (k > 0)
+    {
+      float step_loss = 0.0f;
+      srsScheduler_GetRetrievabilityMany(scheduler, &states, times, count, retrievability);
+      for (i = 0; i < count; i++)
+      {
+        float p = (grades[i] == srsGRADE_AGAIN) ? 1.0f - retrievability[i] : retrievability[i];
+        step_loss -= logf((p < srsOPTIMIZER_MIN_PROBABILITY) ? srsOPTIMIZER_MIN_PROBABILITY : p);
+      }
+      loss += step_loss;
+    }
+    srsScheduler_GradeMany(scheduler, &states, grades, times, count);
+  }
+  return loss;
+}
+
+static void *srsOptimizer_Work(void *arg)
+{
+  srsOPTIMIZER_WORKER *worker = (srsOPTIMIZER_WORKER *)arg;
+  srsOPTIMIZER_JOB *job = worker->job;
+  int32_t item_count = (int32_t)(job->shard_count * job->candidate_count);
+  int32_t item = 0;
+  while ((item = srsAtomic_Add(&job->next_item, 1) - 1) < item_count)
+  {
+    size_t candidate = (size_t)item % job->candidate_count;
+    size_t shard = (size_t)item / job->candidate_count;
+    worker->losses[candidate] += srsOptimizer_Replay(&job->candidates[candidate], &job->shards[shard]);
+  }
+  return NULL;
+}
+
+/* Adds up the loss of each candidate over a batch of shards. The calling thread is the first worker, and threads that fail to start leave more work to the others. */
+static void srsOptimizer_Evaluate(const srsSCHEDULER *candidates, size_t candidate_count, const srsOPTIMIZER_SHARD *shards, size_t shard_count, uint32_t thread_count, double *losses_out)
+{
+  srsOPTIMIZER_WORKER workers[srsOPTIMIZER_THREADS_MAX];
+  srsTHREAD threads[srsOPTIMIZER_THREADS_MAX];
+  srsOPTIMIZER_JOB job = {candidates, candidate_count, shards, shard_count, 0};
+  size_t started = 0;
+  size_t i = 0;
+  size_t c = 0;
+  size_t item_count = shard_count * candidate_count;
+  thread_count = (thread_count > srsOPTIMIZER_THREADS_MAX) ? srsOPTIMIZER_THREADS_MAX : thread_count;
+  thread_count = (thread_count > item_count) ? (uint32_t)item_count : thread_count;
+  thread_count = (thread_count < 1) ? 1 : thread_count;
+  for (i = 0; i < thread_count; i++)
+  {
+    memset(&workers[i], 0, sizeof(workers[i]));
+    workers[i].job = &job;
+  }
+  for (i = 1; i < thread_count; i++)
+  {
+    if (srsThread_Create(&threads[started], srsOptimizer_Work, &workers[i]))
+    {
+      started++;
+    }
+  }
+  srsOptimizer_Work(&workers[0]);
+  for (i = 0; i < started; i++)
+  {
+    srsThread_Join(threads[i], NULL);
+  }
+  for (c = 0; c < candidate_count; c++)
+  {
+    losses_out[c] = 0.0;
+    for (i = 0; i < thread_count; i++)
+    {
+      losses_out[c] += workers[i].losses[c];
+    }
+  }
+}
+
+bool srsOptimizer_GetLoss(const srsSCHEDULER *scheduler, const srsREVIEW_LOG *log, double *loss_out)
+{
+  srsOPTIMIZER_DATA data;
+  double loss = 0.0;
+  if ((scheduler == NULL) || (log == NULL) || (loss_out == NULL) || (scheduler->algorithm != srsSCHEDULER_FSRS))
+  {
+    return false;
+  }
+  if (!srsOptimizer_PrepareData(log, &data))
+  {
+    return false;
+  }
+  bool result = (data.scored_count > 0);
+  if (result)
+  {
+    srsOptimizer_Evaluate(scheduler, 1, data.shards, data.shard_count, srsThread_GetHardwareConcurrency(), &loss);
+    *loss_out = loss / (double)data.scored_count;
+  }
+  srsOptimizer_FreeData(&data);
+  return result;
+}
+
+bool srsOptimizer_Fit(srsSCHEDULER *scheduler, const srsREVIEW_LOG *log, srsOPTIMIZER_OPTS opts)
+{
+  srsOPTIMIZER_DATA data;
+  srsSCHEDULER candidates[srsSCHEDULER_FSRS_WEIGHTS + 1];
+  double losses[srsSCHEDULER_FSRS_WEIGHTS + 1];
+  float nudges[srsSCHEDULER_FSRS_WEIGHTS];
+  float moment[srsSCHEDULER_FSRS_WEIGHTS] = {0};
+  float velocity[srsSCHEDULER_FSRS_WEIGHTS] = {0};
+  float beta1_power = 1.0f;
+  float beta2_power = 1.0f;
+  uint32_t epoch = 0;
+  size_t first = 0;
+  size_t last = 0;
+  size_t p = 0;
+  if ((scheduler == NULL) || (log == NULL) || (scheduler->algorithm != srsSCHEDULER_FSRS) || (opts.learning_rate <= 0.0f))
+  {
+    return false;
+  }
+  if (!srsOptimizer_PrepareData(log, &data))
+  {
+    return false;
+  }
+  bool result = (data.scored_count > 0);
+  uint32_t thread_count = (opts.thread_count == 0) ? srsThread_GetHardwareConcurrency() : opts.thread_count;
+  srsSCHEDULER fitted = *scheduler;
+  for (epoch = 0; result && (epoch < opts.epochs); epoch++)
+  {
+    for (first = 0; first < data.shard_count; first = last)
+    {
+      size_t scored = 0;
+      for (last = first; (last < data.shard_count) && ((last == first) || (scored < opts.batch_size)); last++)
+      {
+        scored += data.shards[last].scored_count;
+      }
+      if (scored == 0)
+      {
+        continue;
+      }
+      /* The gradient is estimated by nudging each weight in turn, away from the nearer end of its range */
+      candidates[0] = fitted;
+      for (p = 0; p < srsSCHEDULER_FSRS_WEIGHTS; p++)
+      {
+        float weight = fitted.weights[p];
+        nudges[p] = 1e-3f * (1.0f + fabsf(weight));
+        nudges[p] = (weight + nudges[p] > srsOptimizer_WEIGHT_MAX[p]) ? -nudges[p] : nudges[p];
+        candidates[p + 1] = fitted;
+        candidates[p + 1].weights[p] = weight + nudges[p];
+      }
+      srsOptimizer_Evaluate(candidates, srsSCHEDULER_FSRS_WEIGHTS + 1, &data.shards[first], last - first, thread_count, losses);
+      beta1_power *= srsOPTIMIZER_BETA1;
+      beta2_power *= srsOPTIMIZER_BETA2;
+      for (p = 0; p < srsSCHEDULER_FSRS_WEIGHTS; p++)
+      {
+        float gradient = (float)((losses[p + 1] - losses[0]) / (double)scored) / nudges[p];
+        moment[p] = srsOPTIMIZER_BETA1 * moment[p] + (1.0f - srsOPTIMIZER_BETA1) * gradient;
+        velocity[p] = srsOPTIMIZER_BETA2 * velocity[p] + (1.0f - srsOPTIMIZER_BETA2) * gradient * gradient;
+        float step = opts.learning_rate * (moment[p] / (1.0f - beta1_power)) / (sqrtf(velocity[p] / (1.0f - beta2_power)) + srsOPTIMIZER_EPSILON);
+        float weight = fitted.weights[p] - step;
+        fitted.weights[p] = (weight < srsOptimizer_WEIGHT_MIN[p]) ? srsOptimizer_WEIGHT_MIN[p] : ((weight > srsOptimizer_WEIGHT_MAX[p]) ? srsOptimizer_WEIGHT_MAX[p] : weight);
+      }
+    }
+  }
+  if (result)
+  {
+    memcpy(scheduler->weights, fitted.weights, sizeof(scheduler->weights));
+  }
+  srsOptimizer_FreeData(&data);
+  return result;
+}
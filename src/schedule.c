@@ -1,47 +1,171 @@
 #include "kioku/schedule.h"
+#include "kioku/clock.h"
 #include "kioku/log.h"
-#include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
 
-#define srsTIME_YEAR_OFFSET 1900
-#define srsTIME_MONTH_OFFSET 1
+/* Length of a time string in the layout of srsTIME_DATE_FORMAT: "YYYY-MM-DD HH:MM" */
+#define srsTIME_FIXED_LENGTH 16
+#define srsTIME_MINUTES_PER_DAY (24 * 60)
 
-bool srsTime_ToString(const srsTIME time, srsTIME_STRING string)
+static bool srsTime_IsLeapYear(unsigned int year)
 {
-  bool result = false;
-  /* Bounds checks */
-  if (string == NULL)
+  return ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+}
+
+/* Whether the fields of a time make up a real date, regardless of year */
+static bool srsTime_IsValid(unsigned int year, unsigned int month, unsigned int day, unsigned int hour, unsigned int minute)
+{
+  static const uint8_t month_days[12] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if ((month < 1) || (month > 12) || (day < 1) || (day > month_days[month - 1]) || (hour >= 24) || (minute >= 60))
   {
-    goto end;
+    return false;
+  }
+  return (month != 2) || (day < 29) || srsTime_IsLeapYear(year);
+}
+
+/* Days from the start of the packing epoch to a date, using the usual shift of the year to begin in March so leap days fall last */
+static uint32_t srsTime_DaysFromCivil(unsigned int year, unsigned int month, unsigned int day)
+{
+  uint32_t y = year - (month <= 2);
+  uint32_t era = y / 400;
+  uint32_t year_of_era = y - era * 400;
+  uint32_t day_of_year = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+  uint32_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+  /* 693901 is the number of days from 0000-03-01 to 1900-01-01 */
+  return era * 146097 + day_of_era - 693901;
+}
+
+/* The inverse of srsTime_DaysFromCivil */
+static void srsTime_CivilFromDays(uint32_t days, srsTIME *time)
+{
+  uint32_t z = days + 693901;
+  uint32_t era = z / 146097;
+  uint32_t day_of_era = z - era * 146097;
+  uint32_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  uint32_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  uint32_t shifted_month = (5 * day_of_year + 2) / 153;
+  time->day = (uint8_t)(day_of_year - (153 * shifted_month + 2) / 5 + 1);
+  time->month = (uint8_t)((shifted_month < 10) ? shifted_month + 3 : shifted_month - 9);
+  time->year = (uint16_t)(year_of_era + era * 400 + (time->month <= 2));
+}
+
+srsTIME_PACKED srsTime_Pack(const srsTIME time)
+{
+  if (time.year > srsTIME_PACKED_MAX_YEAR)
+  {
+    return srsTIME_PACKED_NEVER;
   }
-  if (time.month + srsTIME_MONTH_OFFSET > 12)
+  if ((time.year < srsTIME_PACKED_EPOCH_YEAR) || !srsTime_IsValid(time.year, time.month, time.day, time.hour, time.minute))
   {
-    goto end;
+    return srsTIME_PACKED_NONE;
   }
-  if (time.day < 1 || time.day > 31)
+  uint32_t days = srsTime_DaysFromCivil(time.year, time.month, time.day);
+  return days * srsTIME_MINUTES_PER_DAY + time.hour * 60u + time.minute + 1;
+}
+
+srsTIME srsTime_Unpack(srsTIME_PACKED packed)
+{
+  srsTIME time = srsTIME_NONE;
+  if (packed == srsTIME_PACKED_NEVER)
+  {
+    srsTIME never = srsTIME_NEVER;
+    return never;
+  }
+  if (packed == srsTIME_PACKED_NONE)
+  {
+    return time;
+  }
+  uint32_t minutes = packed - 1;
+  srsTime_CivilFromDays(minutes / srsTIME_MINUTES_PER_DAY, &time);
+  minutes %= srsTIME_MINUTES_PER_DAY;
+  time.hour = (uint8_t)(minutes / 60);
+  time.minute = (uint8_t)(minutes % 60);
+  return time;
+}
+
+/**
+ * Decodes a string in the exact layout written by srsTime_ToString.
+ * Every digit is read at a fixed offset and errors are accumulated rather than branched on, which keeps the common case of a well-formed file cheap and lets the compiler vectorize it.
+ */
+static bool srsTime_ParseFixed(const char *string, srsTIME *time)
+{
+  static const uint8_t digit_offsets[12] = {0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15};
+  unsigned int digits[12];
+  unsigned int bad = 0;
+  size_t i = 0;
+  /* Never read past the end of a short string */
+  for (i = 0; i < srsTIME_FIXED_LENGTH; i++)
+  {
+    if (string[i] == kiokuCHAR_NULL)
+    {
+      return false;
+    }
+  }
+  for (i = 0; i < 12; i++)
+  {
+    digits[i] = (unsigned int)((unsigned char)string[digit_offsets[i]] - '0');
+    bad |= (digits[i] > 9);
+  }
+  bad |= (string[4] != '-') | (string[7] != '-') | (string[10] != ' ') | (string[13] != ':');
+  if (bad)
+  {
+    return false;
+  }
+  time->year = (uint16_t)(digits[0] * 1000 + digits[1] * 100 + digits[2] * 10 + digits[3]);
+  time->month = (uint8_t)(digits[4] * 10 + digits[5]);
+  time->day = (uint8_t)(digits[6] * 10 + digits[7]);
+  time->hour = (uint8_t)(digits[8] * 10 + digits[9]);
+  time->minute = (uint8_t)(digits[10] * 10 + digits[11]);
+  return true;
+}
+
+/* Writes a valid time in the layout of srsTIME_DATE_FORMAT */
+static void srsTime_FormatFixed(const srsTIME *time, char *string)
+{
+  unsigned int year = time->year;
+  string[0] = (char)('0' + year / 1000);
+  string[1] = (char)('0' + year / 100 % 10);
+  string[2] = (char)('0' + year / 10 % 10);
+  string[3] = (char)('0' + year % 10);
+  string[4] = '-';
+  string[5] = (char)('0' + time->month / 10);
+  string[6] = (char)('0' + time->month % 10);
+  string[7] = '-';
+  string[8] = (char)('0' + time->day / 10);
+  string[9] = (char)('0' + time->day % 10);
+  string[10] = ' ';
+  string[11] = (char)('0' + time->hour / 10);
+  string[12] = (char)('0' + time->hour % 10);
+  string[13] = ':';
+  string[14] = (char)('0' + time->minute / 10);
+  string[15] = (char)('0' + time->minute % 10);
+  string[16] = kiokuCHAR_NULL;
+}
+
+bool srsTime_ToString(const srsTIME time, srsTIME_STRING string)
+{
+  bool result = false;
+  /* Bounds checks */
+  if (string == NULL)
   {
     goto end;
   }
-  if (time.hour >= 24)
+  if (time.year > srsTIME_PACKED_MAX_YEAR)
   {
     goto end;
   }
-  if (time.minute >= 60)
+  if (!srsTime_IsValid(time.year, time.month, time.day, time.hour, time.minute))
   {
     goto end;
   }
   /* Conversion */
-  struct tm stdtime = { .tm_year=time.year - srsTIME_YEAR_OFFSET,
-                        .tm_mon=time.month - srsTIME_MONTH_OFFSET,
-                        .tm_mday=time.day,
-                        .tm_hour=time.hour,
-                        .tm_min=time.minute,
-                        .tm_sec=0 /* NOTE: if we implement this, account for pre-C99 range defect (0-61 allowing for 2 leap seconds) */
-  };
-  size_t length = strftime(string, srsTIME_STRING_SIZE, srsTIME_DATE_FORMAT, &stdtime);
-  result = (length != 0);
+  srsTime_FormatFixed(&time, (char *)string);
+  result = true;
   /* Return result */
 end:
   return result;
@@ -58,98 +182,604 @@ bool srsTime_FromString(const srsTIME_STRING string, srsTIME *time)
   {
     goto end;
   }
-  unsigned int year = 0;
-  unsigned int month = 0;
-  unsigned int day = 0;
-  unsigned int hour = 0;
-  unsigned int minute = 0;
-  int found = sscanf(string, srsTIME_SCAN_FORMAT, &year, &month, &day, &hour, &minute);
-  result = (found == 5);
-  if (!result)
+  srsTIME parsed = srsTIME_NONE;
+  if (!srsTime_ParseFixed((const char *)string, &parsed))
   {
-    goto end;
+    /* Fall back to the more forgiving scan for anything that was written by hand */
+    unsigned int year = 0;
+    unsigned int month = 0;
+    unsigned int day = 0;
+    unsigned int hour = 0;
+    unsigned int minute = 0;
+    int found = sscanf((const char *)string, srsTIME_SCAN_FORMAT, &year, &month, &day, &hour, &minute);
+    result = (found == 5) && (year <= UINT16_MAX) && (month <= UINT8_MAX) && (day <= UINT8_MAX) && (hour <= UINT8_MAX) && (minute <= UINT8_MAX);
+    if (!result)
+    {
+      goto end;
+    }
+    parsed.year = year;
+    parsed.month = month;
+    parsed.day = day;
+    parsed.hour = hour;
+    parsed.minute = minute;
   }
-  result = (year >= 1900);
+  result = (parsed.year >= 1900);
   if (!result)
   {
     goto end;
   }
-  result = (month <= 12);
+  result = srsTime_IsValid(parsed.year, parsed.month, parsed.day, parsed.hour, parsed.minute);
   if (!result)
   {
     goto end;
   }
-  result = ((day >= 1) && (day <= 31));
-  if (!result)
+  *time = parsed;
+end:
+  return result;
+}
+
+size_t srsTime_ParseMany(const char *const *strings, size_t count, srsTIME_PACKED *times_out)
+{
+  size_t parsed = 0;
+  if ((strings == NULL) || (times_out == NULL))
   {
-    goto end;
+    return 0;
   }
-  result = ((hour >= 0) && (hour < 24));
-  if (!result)
+  for (size_t i = 0; i < count; i++)
   {
-    goto end;
+    srsTIME time = srsTIME_NONE;
+    times_out[i] = srsTIME_PACKED_NONE;
+    if ((strings[i] != NULL) && srsTime_FromString((const signed char *)strings[i], &time))
+    {
+      times_out[i] = srsTime_Pack(time);
+      parsed += (times_out[i] != srsTIME_PACKED_NONE);
+    }
   }
-  result = ((minute >= 0) && (hour < 60));
-  if (!result)
+  return parsed;
+}
+
+size_t srsTime_FormatMany(const srsTIME_PACKED *times, size_t count, srsTIME_STRING *strings_out)
+{
+  size_t formatted = 0;
+  if ((times == NULL) || (strings_out == NULL))
   {
-    goto end;
+    return 0;
   }
-  memset(time, 0, sizeof(*time));
-  time->year = year;
-  time->month = month;
-  time->day = day;
-  time->hour = hour;
-  time->minute = minute;
-end:
-  return result;
+  for (size_t i = 0; i < count; i++)
+  {
+    strings_out[i][0] = kiokuCHAR_NULL;
+    if ((times[i] != srsTIME_PACKED_NONE) && (times[i] != srsTIME_PACKED_NEVER))
+    {
+      srsTIME time = srsTime_Unpack(times[i]);
+      srsTime_FormatFixed(&time, (char *)strings_out[i]);
+      formatted++;
+    }
+  }
+  return formatted;
 }
 
-static srsTIME srsTime_FromTM(struct tm *timeinfo)
+srsTIME srsTime_Now()
 {
-  srsTIME kioku_time = {0};
-  kioku_time.year = timeinfo->tm_year + srsTIME_YEAR_OFFSET;
-  kioku_time.month = timeinfo->tm_mon + srsTIME_MONTH_OFFSET;
-  kioku_time.day = timeinfo->tm_mday;
-  kioku_time.hour = timeinfo->tm_hour;
-  kioku_time.minute = timeinfo->tm_min;
-  return kioku_time;
+  return srsTime_Unpack(srsClock_Now());
 }
 
-srsTIME srsTime_Now()
+/* Orders the fields of a time from most to least significant in a single integer */
+static uint64_t srsTime_Key(const srsTIME time)
 {
-  time_t now = time(0);
-  struct tm * timeinfo = localtime(&now);
-  return srsTime_FromTM(timeinfo);
+  return ((uint64_t)time.year << 32) | ((uint64_t)time.month << 24) | ((uint64_t)time.day << 16) | ((uint64_t)time.hour << 8) | time.minute;
 }
 
 int srsTime_Compare(const srsTIME left, const srsTIME right)
 {
-  int result = 0;
-  result = left.year - right.year;
-  if (result != 0)
+  uint64_t left_key = srsTime_Key(left);
+  uint64_t right_key = srsTime_Key(right);
+  return (left_key > right_key) - (left_key < right_key);
+}
+
+/* Marks a card that is not in the queue */
+#define srsSCHEDULE_QUEUE_ABSENT UINT32_MAX
+
+/**
+ * A binary min-heap of keys that hold the due time in the high half and the card index in the low half.
+ * Comparing keys therefore orders by due time and then by card, and every comparison is a single integer compare.
+ * positions maps each card to where its key is in the heap so it can be found again without searching.
+ */
+struct _srsSCHEDULE_QUEUE_s
+{
+  size_t capacity;
+  size_t count;
+  uint64_t *heap;
+  uint32_t *positions;
+};
+
+static uint64_t srsScheduleQueue_Key(uint32_t card, srsTIME_PACKED due)
+{
+  return ((uint64_t)due << 32) | card;
+}
+
+static void srsScheduleQueue_Place(srsSCHEDULE_QUEUE *queue, size_t position, uint64_t key)
+{
+  queue->heap[position] = key;
+  queue->positions[(uint32_t)key] = (uint32_t)position;
+}
+
+static void srsScheduleQueue_SiftUp(srsSCHEDULE_QUEUE *queue, size_t position)
+{
+  uint64_t key = queue->heap[position];
+  while (position > 0)
   {
-    goto done;
+    size_t parent = (position - 1) / 2;
+    if (queue->heap[parent] <= key)
+    {
+      break;
+    }
+    srsScheduleQueue_Place(queue, position, queue->heap[parent]);
+    position = parent;
   }
-  result = left.month - right.month;
-  if (result != 0)
+  srsScheduleQueue_Place(queue, position, key);
+}
+
+static void srsScheduleQueue_SiftDown(srsSCHEDULE_QUEUE *queue, size_t position)
+{
+  uint64_t key = queue->heap[position];
+  for (;;)
   {
-    goto done;
+    size_t child = position * 2 + 1;
+    if (child >= queue->count)
+    {
+      break;
+    }
+    if ((child + 1 < queue->count) && (queue->heap[child + 1] < queue->heap[child]))
+    {
+      child++;
+    }
+    if (key <= queue->heap[child])
+    {
+      break;
+    }
+    srsScheduleQueue_Place(queue, position, queue->heap[child]);
+    position = child;
   }
-  result = left.day - right.day;
-  if (result != 0)
+  srsScheduleQueue_Place(queue, position, key);
+}
+
+/* Takes the key at a position out of the heap, filling the hole with the last key */
+static void srsScheduleQueue_RemoveAt(srsSCHEDULE_QUEUE *queue, size_t position)
+{
+  uint64_t removed = queue->heap[position];
+  uint64_t last = queue->heap[--queue->count];
+  queue->positions[(uint32_t)removed] = srsSCHEDULE_QUEUE_ABSENT;
+  if (position == queue->count)
   {
-    goto done;
+    return;
   }
-  result = left.hour - right.hour;
-  if (result != 0)
+  queue->heap[position] = last;
+  if (last < removed)
   {
-    goto done;
+    srsScheduleQueue_SiftUp(queue, position);
   }
-  result = left.minute - right.minute;
-  if (result != 0)
+  else
   {
-    goto done;
+    srsScheduleQueue_SiftDown(queue, position);
   }
-done:
-  return result;
+}
+
+srsSCHEDULE_QUEUE *srsScheduleQueue_Create(const srsTIME_PACKED *due, size_t count)
+{
+  srsSCHEDULE_QUEUE *queue = NULL;
+  if (((due == NULL) && (count > 0)) || (count >= srsSCHEDULE_QUEUE_ABSENT))
+  {
+    return NULL;
+  }
+  queue = calloc(1, sizeof(*queue));
+  if (queue == NULL)
+  {
+    return NULL;
+  }
+  queue->capacity = count;
+  /* Always allocate something so an empty queue looks like any other */
+  queue->heap = malloc((count + 1) * sizeof(*queue->heap));
+  queue->positions = malloc((count + 1) * sizeof(*queue->positions));
+  if ((queue->heap == NULL) || (queue->positions == NULL))
+  {
+    srsScheduleQueue_Free(queue);
+    return NULL;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    srsScheduleQueue_Place(queue, i, srsScheduleQueue_Key((uint32_t)i, due[i]));
+  }
+  queue->count = count;
+  /* Heapify from the last parent down, which is linear rather than the n log n of pushing one at a time */
+  for (size_t i = count / 2; i > 0; i--)
+  {
+    srsScheduleQueue_SiftDown(queue, i - 1);
+  }
+  return queue;
+}
+
+void srsScheduleQueue_Free(srsSCHEDULE_QUEUE *queue)
+{
+  if (queue == NULL)
+  {
+    return;
+  }
+  free(queue->heap);
+  free(queue->positions);
+  free(queue);
+}
+
+size_t srsScheduleQueue_GetCount(const srsSCHEDULE_QUEUE *queue)
+{
+  return (queue == NULL) ? 0 : queue->count;
+}
+
+bool srsScheduleQueue_Peek(const srsSCHEDULE_QUEUE *queue, uint32_t *card_out, srsTIME_PACKED *due_out)
+{
+  if (srsScheduleQueue_GetCount(queue) == 0)
+  {
+    return false;
+  }
+  if (card_out != NULL)
+  {
+    *card_out = (uint32_t)queue->heap[0];
+  }
+  if (due_out != NULL)
+  {
+    *due_out = (srsTIME_PACKED)(queue->heap[0] >> 32);
+  }
+  return true;
+}
+
+size_t srsScheduleQueue_Pop(srsSCHEDULE_QUEUE *queue, size_t count, uint32_t *cards_out)
+{
+  size_t popped = 0;
+  if (cards_out == NULL)
+  {
+    return 0;
+  }
+  while ((popped < count) && (srsScheduleQueue_GetCount(queue) > 0))
+  {
+    cards_out[popped++] = (uint32_t)queue->heap[0];
+    srsScheduleQueue_RemoveAt(queue, 0);
+  }
+  return popped;
+}
+
+bool srsScheduleQueue_Update(srsSCHEDULE_QUEUE *queue, uint32_t card, srsTIME_PACKED due)
+{
+  if ((queue == NULL) || (card >= queue->capacity))
+  {
+    return false;
+  }
+  uint64_t key = srsScheduleQueue_Key(card, due);
+  uint32_t position = queue->positions[card];
+  if (position == srsSCHEDULE_QUEUE_ABSENT)
+  {
+    position = (uint32_t)queue->count++;
+    srsScheduleQueue_Place(queue, position, key);
+    srsScheduleQueue_SiftUp(queue, position);
+    return true;
+  }
+  uint64_t previous = queue->heap[position];
+  queue->heap[position] = key;
+  if (key < previous)
+  {
+    srsScheduleQueue_SiftUp(queue, position);
+  }
+  else
+  {
+    srsScheduleQueue_SiftDown(queue, position);
+  }
+  return true;
+}
+
+bool srsScheduleQueue_Remove(srsSCHEDULE_QUEUE *queue, uint32_t card)
+{
+  if ((queue == NULL) || (card >= queue->capacity) || (queue->positions[card] == srsSCHEDULE_QUEUE_ABSENT))
+  {
+    return false;
+  }
+  srsScheduleQueue_RemoveAt(queue, queue->positions[card]);
+  return true;
+}
+
+/* Bits of the packed time each level of the wheel indexes by, from the lowest level up. Together they cover all 32. */
+#define srsTIMER_WHEEL_LEVELS 5
+static const uint8_t srsTimerWheel_SHIFTS[srsTIMER_WHEEL_LEVELS] = {0, 6, 12, 18, 24};
+static const uint8_t srsTimerWheel_BITS[srsTIMER_WHEEL_LEVELS] = {6, 6, 6, 6, 8};
+static const uint16_t srsTimerWheel_OFFSETS[srsTIMER_WHEEL_LEVELS] = {0, 64, 128, 192, 256};
+#define srsTIMER_WHEEL_SLOTS 512
+/* Timers added for a minute the wheel has already passed wait here for the next advance */
+#define srsTIMER_WHEEL_EXPIRED srsTIMER_WHEEL_SLOTS
+
+/**
+ * Timers are kept in the slot of the lowest level whose span still separates their due time from now, i.e. the level of the highest bit in which the two differ.
+ * A slot on a higher level is emptied into the levels below it once now reaches it, so timers trickle down until they expire from the lowest level.
+ * occupied has a bit per slot, which lets the next occupied slot of a level be found without looking at empty ones.
+ */
+struct _srsTIMER_WHEEL_s
+{
+  srsTIME_PACKED now; /* The earliest minute that has not been expired yet */
+  size_t count;
+  srsTIMER_FUNC func;
+  void *userdata;
+  srsTIMER *slots[srsTIMER_WHEEL_SLOTS + 1];
+  uint64_t occupied[srsTIMER_WHEEL_SLOTS / 64];
+};
+
+static unsigned int srsTimerWheel_Index(srsTIME_PACKED time, unsigned int level)
+{
+  return (time >> srsTimerWheel_SHIFTS[level]) & ((1u << srsTimerWheel_BITS[level]) - 1);
+}
+
+static void srsTimerWheel_Link(srsTIMER_WHEEL *wheel, srsTIMER *timer, uint16_t slot)
+{
+  timer->slot = slot;
+  timer->prev = NULL;
+  timer->next = wheel->slots[slot];
+  if (timer->next != NULL)
+  {
+    timer->next->prev = timer;
+  }
+  wheel->slots[slot] = timer;
+  if (slot < srsTIMER_WHEEL_SLOTS)
+  {
+    wheel->occupied[slot / 64] |= (uint64_t)1 << (slot % 64);
+  }
+}
+
+static void srsTimerWheel_Unlink(srsTIMER_WHEEL *wheel, srsTIMER *timer)
+{
+  if (timer->prev != NULL)
+  {
+    timer->prev->next = timer->next;
+  }
+  else
+  {
+    wheel->slots[timer->slot] = timer->next;
+    if ((timer->next == NULL) && (timer->slot < srsTIMER_WHEEL_SLOTS))
+    {
+      wheel->occupied[timer->slot / 64] &= ~((uint64_t)1 << (timer->slot % 64));
+    }
+  }
+  if (timer->next != NULL)
+  {
+    timer->next->prev = timer->prev;
+  }
+  timer->next = NULL;
+  timer->prev = NULL;
+}
+
+/* Puts an active timer in the slot its due time belongs in relative to now */
+static void srsTimerWheel_Place(srsTIMER_WHEEL *wheel, srsTIMER *timer)
+{
+  if (timer->due < wheel->now)
+  {
+    srsTimerWheel_Link(wheel, timer, srsTIMER_WHEEL_EXPIRED);
+    return;
+  }
+  uint32_t differing = timer->due ^ wheel->now;
+  unsigned int level = 0;
+  while ((level + 1 < srsTIMER_WHEEL_LEVELS) && ((differing >> srsTimerWheel_SHIFTS[level + 1]) != 0))
+  {
+    level++;
+  }
+  srsTimerWheel_Link(wheel, timer, (uint16_t)(srsTimerWheel_OFFSETS[level] + srsTimerWheel_Index(timer->due, level)));
+}
+
+/* Index of the lowest set bit. bits must not be 0. */
+static unsigned int srsTimerWheel_CountTrailingZeros(uint64_t bits)
+{
+#if defined __GNUC__
+  return (unsigned int)__builtin_ctzll(bits);
+#elif defined _MSC_VER && defined kiokuARCH_64BIT
+  unsigned long index = 0;
+  _BitScanForward64(&index, bits);
+  return (unsigned int)index;
+#else
+  unsigned int index = 0;
+  while ((bits & 1) == 0)
+  {
+    bits >>= 1;
+    index++;
+  }
+  return index;
+#endif
+}
+
+/* Finds the first occupied slot of a level at or after an index */
+static bool srsTimerWheel_FindSlot(const srsTIMER_WHEEL *wheel, unsigned int level, unsigned int from, unsigned int *index_out)
+{
+  unsigned int size = 1u << srsTimerWheel_BITS[level];
+  while (from < size)
+  {
+    unsigned int slot = srsTimerWheel_OFFSETS[level] + from;
+    uint64_t bits = wheel->occupied[slot / 64] >> (slot % 64);
+    if (bits != 0)
+    {
+      unsigned int found = from + srsTimerWheel_CountTrailingZeros(bits);
+      if (found >= size)
+      {
+        return false;
+      }
+      *index_out = found;
+      return true;
+    }
+    from += 64 - (slot % 64);
+  }
+  return false;
+}
+
+/**
+ * Finds the earliest occupied slot. Slots hold timers with the same bits as now above their level, so a slot starts where now's bits from its level down are replaced by its index.
+ * The slot now is in on a higher level can only be occupied once now has moved into it, in which case it is due straight away.
+ */
+static bool srsTimerWheel_FindNext(const srsTIMER_WHEEL *wheel, srsTIME_PACKED *time_out, unsigned int *level_out, unsigned int *index_out)
+{
+  bool found = false;
+  for (unsigned int level = 0; level < srsTIMER_WHEEL_LEVELS; level++)
+  {
+    unsigned int index = 0;
+    if (!srsTimerWheel_FindSlot(wheel, level, srsTimerWheel_Index(wheel->now, level), &index))
+    {
+      continue;
+    }
+    unsigned int shift = srsTimerWheel_SHIFTS[level];
+    unsigned int span = shift + srsTimerWheel_BITS[level];
+    uint64_t above = (span >= 32) ? 0 : ((uint64_t)wheel->now >> span) << span;
+    uint64_t start = above | ((uint64_t)index << shift);
+    srsTIME_PACKED time = (start < wheel->now) ? wheel->now : (srsTIME_PACKED)start;
+    /* On a tie the higher level goes first, since emptying it may add to the lower slot */
+    if (!found || (time <= *time_out))
+    {
+      found = true;
+      *time_out = time;
+      *level_out = level;
+      *index_out = index;
+    }
+  }
+  return found;
+}
+
+srsTIMER_WHEEL *srsTimerWheel_Create(srsTIME_PACKED now, srsTIMER_FUNC func, void *userdata)
+{
+  if (func == NULL)
+  {
+    return NULL;
+  }
+  srsTIMER_WHEEL *wheel = calloc(1, sizeof(*wheel));
+  if (wheel == NULL)
+  {
+    return NULL;
+  }
+  wheel->now = now;
+  wheel->func = func;
+  wheel->userdata = userdata;
+  return wheel;
+}
+
+void srsTimerWheel_Free(srsTIMER_WHEEL *wheel)
+{
+  free(wheel);
+}
+
+bool srsTimerWheel_Add(srsTIMER_WHEEL *wheel, srsTIMER *timer, srsTIME_PACKED due)
+{
+  if ((wheel == NULL) || (timer == NULL) || (due == srsTIME_PACKED_NEVER))
+  {
+    return false;
+  }
+  if (timer->active)
+  {
+    srsTimerWheel_Unlink(wheel, timer);
+  }
+  else
+  {
+    timer->active = true;
+    wheel->count++;
+  }
+  timer->due = due;
+  srsTimerWheel_Place(wheel, timer);
+  return true;
+}
+
+bool srsTimerWheel_Remove(srsTIMER_WHEEL *wheel, srsTIMER *timer)
+{
+  if ((wheel == NULL) || (timer == NULL) || !timer->active)
+  {
+    return false;
+  }
+  srsTimerWheel_Unlink(wheel, timer);
+  timer->active = false;
+  wheel->count--;
+  return true;
+}
+
+/* Takes every timer off a slot and calls back for each */
+static size_t srsTimerWheel_Expire(srsTIMER_WHEEL *wheel, uint16_t slot)
+{
+  size_t expired = 0;
+  srsTIMER *timer = wheel->slots[slot];
+  wheel->slots[slot] = NULL;
+  if (slot < srsTIMER_WHEEL_SLOTS)
+  {
+    wheel->occupied[slot / 64] &= ~((uint64_t)1 << (slot % 64));
+  }
+  while (timer != NULL)
+  {
+    srsTIMER *next = timer->next;
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->active = false;
+    wheel->count--;
+    wheel->func(timer, wheel->userdata);
+    expired++;
+    timer = next;
+  }
+  return expired;
+}
+
+size_t srsTimerWheel_Advance(srsTIMER_WHEEL *wheel, srsTIME_PACKED now)
+{
+  size_t expired = 0;
+  srsTIME_PACKED time = 0;
+  unsigned int level = 0;
+  unsigned int index = 0;
+  if (wheel == NULL)
+  {
+    return 0;
+  }
+  /* Anything added for a minute already passed goes first, leaving whatever its callbacks add for the next advance */
+  if (wheel->slots[srsTIMER_WHEEL_EXPIRED] != NULL)
+  {
+    expired += srsTimerWheel_Expire(wheel, srsTIMER_WHEEL_EXPIRED);
+  }
+  while ((now >= wheel->now) && srsTimerWheel_FindNext(wheel, &time, &level, &index) && (time <= now))
+  {
+    wheel->now = time;
+    if (level > 0)
+    {
+      /* Move the slot's timers down now that it has been reached */
+      srsTIMER *timer = wheel->slots[srsTimerWheel_OFFSETS[level] + index];
+      wheel->slots[srsTimerWheel_OFFSETS[level] + index] = NULL;
+      wheel->occupied[(srsTimerWheel_OFFSETS[level] + index) / 64] &= ~((uint64_t)1 << ((srsTimerWheel_OFFSETS[level] + index) % 64));
+      while (timer != NULL)
+      {
+        srsTIMER *next = timer->next;
+        srsTimerWheel_Place(wheel, timer);
+        timer = next;
+      }
+      continue;
+    }
+    /* Step past the minute before calling back, so anything added for it waits for the next advance instead of expiring forever. Nothing is ever due at the last minute, which is srsTIME_PACKED_NEVER. */
+    wheel->now = time + 1;
+    expired += srsTimerWheel_Expire(wheel, (uint16_t)index);
+  }
+  if ((now >= wheel->now) && (now != UINT32_MAX))
+  {
+    wheel->now = now + 1;
+  }
+  return expired;
+}
+
+bool srsTimerWheel_GetNextExpiry(const srsTIMER_WHEEL *wheel, srsTIME_PACKED *due_out)
+{
+  unsigned int level = 0;
+  unsigned int index = 0;
+  if ((wheel == NULL) || (due_out == NULL) || (wheel->count == 0))
+  {
+    return false;
+  }
+  if (wheel->slots[srsTIMER_WHEEL_EXPIRED] != NULL)
+  {
+    *due_out = wheel->slots[srsTIMER_WHEEL_EXPIRED]->due;
+    return true;
+  }
+  return srsTimerWheel_FindNext(wheel, due_out, &level, &index);
+}
+
+size_t srsTimerWheel_GetCount(const srsTIMER_WHEEL *wheel)
+{
+  return (wheel == NULL) ? 0 : wheel->count;
 }
@@ -0,0 +1,347 @@
+#include "kioku/scheduler.h"
+#include "kioku/log.h"
+#include "parson.h"
+#include <math.h>
+#include <string.h>
+
+/* Shape of the FSRS forgetting curve: recall falls as (1 + FACTOR * t / S) ^ DECAY, which is 90% when t == S */
+#define srsFSRS_DECAY (-0.5f)
+#define srsFSRS_FACTOR (19.0f / 81.0f)
+#define srsFSRS_MIN_STABILITY 0.01f
+#define srsFSRS_MIN_DIFFICULTY 1.0f
+#define srsFSRS_MAX_DIFFICULTY 10.0f
+
+#define srsSM2_DEFAULT_EASE 2.5f
+#define srsSM2_MIN_EASE 1.3f
+
+#define srsSCHEDULER_MINUTES_PER_DAY 1440.0f
+/* Cards are graded in chunks of this many so each step of the update can be a separate loop over small scratch arrays */
+#define srsSCHEDULER_CHUNK 256
+
+/* Default weights of FSRS 5 */
+static const float srsScheduler_FSRS_WEIGHTS[srsSCHEDULER_FSRS_WEIGHTS] = {
+  0.40255f, 1.18385f, 3.173f, 15.69105f, 7.1949f, 0.5345f, 1.4604f, 0.0046f, 1.54575f, 0.1192f,
+  1.01925f, 1.9395f, 0.11f, 0.29605f, 2.2698f, 0.2315f, 2.9898f, 0.51655f, 0.6621f
+};
+
+bool srsScheduler_Init(srsSCHEDULER *scheduler, srsSCHEDULER_ALGORITHM algorithm)
+{
+  if ((scheduler == NULL) || ((algorithm != srsSCHEDULER_SM2) && (algorithm != srsSCHEDULER_FSRS)))
+  {
+    return false;
+  }
+  memset(scheduler, 0, sizeof(*scheduler));
+  scheduler->algorithm = algorithm;
+  scheduler->desired_retention = 0.9f;
+  scheduler->maximum_interval = 36500.0f;
+  memcpy(scheduler->weights, srsScheduler_FSRS_WEIGHTS, sizeof(scheduler->weights));
+  return true;
+}
+
+bool srsScheduler_Load(srsSCHEDULER *scheduler, const char *path)
+{
+  bool result = false;
+  srsSCHEDULER loaded;
+  size_t i = 0;
+  JSON_Value *root_value = (path == NULL) ? NULL : json_parse_file(path);
+  JSON_Object *root_object = json_value_get_object(root_value);
+  if ((scheduler == NULL) || (root_object == NULL))
+  {
+    srsLOG_ERROR("Unable to read scheduler options from %s", (path == NULL) ? "NULL" : path);
+    goto done;
+  }
+  const char *algorithm = json_object_get_string(root_object, "algorithm");
+  if ((algorithm == NULL) || (strcmp(algorithm, "fsrs") == 0))
+  {
+    srsScheduler_Init(&loaded, srsSCHEDULER_FSRS);
+  }
+  else if (strcmp(algorithm, "sm2") == 0)
+  {
+    srsScheduler_Init(&loaded, srsSCHEDULER_SM2);
+  }
+  else
+  {
+    srsLOG_ERROR("Unknown scheduler algorithm %s in %s", algorithm, path);
+    goto done;
+  }
+  if (json_object_has_value_of_type(root_object, "desired_retention", JSONNumber))
+  {
+    loaded.desired_retention = (float)json_object_get_number(root_object, "desired_retention");
+  }
+  if (json_object_has_value_of_type(root_object, "maximum_interval", JSONNumber))
+  {
+    loaded.maximum_interval = (float)json_object_get_number(root_object, "maximum_interval");
+  }
+  JSON_Array *weights = json_object_get_array(root_object, "weights");
+  if ((weights != NULL) && (json_array_get_count(weights) != srsSCHEDULER_FSRS_WEIGHTS))
+  {
+    srsLOG_ERROR("Expected %d weights in %s, not %zu", srsSCHEDULER_FSRS_WEIGHTS, path, json_array_get_count(weights));
+    goto done;
+  }
+  for (i = 0; (weights != NULL) && (i < srsSCHEDULER_FSRS_WEIGHTS); i++)
+  {
+    loaded.weights[i] = (float)json_array_get_number(weights, i);
+  }
+  result = (loaded.desired_retention > 0.0f) && (loaded.desired_retention < 1.0f) && (loaded.maximum_interval >= 1.0f);
+  if (!result)
+  {
+    srsLOG_ERROR("Scheduler options in %s are out of range", path);
+    goto done;
+  }
+  *scheduler = loaded;
+done:
+  json_value_free(root_value);
+  return result;
+}
+
+bool srsScheduler_Save(const srsSCHEDULER *scheduler, const char *path)
+{
+  size_t i = 0;
+  if ((scheduler == NULL) || (path == NULL))
+  {
+    return false;
+  }
+  JSON_Value *root_value = json_value_init_object();
+  JSON_Object *root_object = json_value_get_object(root_value);
+  JSON_Value *weights_value = json_value_init_array();
+  JSON_Array *weights = json_value_get_array(weights_value);
+  json_object_set_string(root_object, "algorithm", (scheduler->algorithm == srsSCHEDULER_SM2) ? "sm2" : "fsrs");
+  json_object_set_number(root_object, "desired_retention", scheduler->desired_retention);
+  json_object_set_number(root_object, "maximum_interval", scheduler->maximum_interval);
+  for (i = 0; i < srsSCHEDULER_FSRS_WEIGHTS; i++)
+  {
+    json_array_append_number(weights, scheduler->weights[i]);
+  }
+  json_object_set_value(root_object, "weights", weights_value);
+  bool result = (json_serialize_to_file_pretty(root_value, path) == JSONSuccess);
+  if (!result)
+  {
+    srsLOG_ERROR("Unable to write scheduler options to %s", path);
+  }
+  json_value_free(root_value);
+  return result;
+}
+
+static float srsScheduler_Clamp(float value, float low, float high)
+{
+  return (value < low) ? low : ((value > high) ? high : value);
+}
+
+/* Days between two packed times, never negative */
+static void srsScheduler_GetElapsedDays(const srsTIME_PACKED *srsRESTRICT last_review, const srsTIME_PACKED *srsRESTRICT times, float *srsRESTRICT elapsed, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    uint32_t minutes = (times[i] > last_review[i]) ? times[i] - last_review[i] : 0;
+    elapsed[i] = (float)minutes / srsSCHEDULER_MINUTES_PER_DAY;
+  }
+}
+
+/* Turns intervals in days into due times, rounded to whole days and kept between a day and the maximum */
+static void srsScheduler_SetDue(const srsSCHEDULER *scheduler, const float *srsRESTRICT intervals, const srsTIME_PACKED *srsRESTRICT times, srsTIME_PACKED *srsRESTRICT due, size_t count)
+{
+  float maximum = (scheduler->maximum_interval < 1.0f) ? 1.0f : scheduler->maximum_interval;
+  for (size_t i = 0; i < count; i++)
+  {
+    float days = srsScheduler_Clamp(floorf(intervals[i] + 0.5f), 1.0f, maximum);
+    uint32_t minutes = (uint32_t)(days * srsSCHEDULER_MINUTES_PER_DAY);
+    due[i] = (times[i] < srsTIME_PACKED_NEVER - minutes) ? times[i] + minutes : srsTIME_PACKED_NEVER - 1;
+  }
+}
+
+/**
+ * Grades a chunk of cards with FSRS.
+ * Every loop is over plain arrays with no early exits, and every branch of the model is computed for every card and then selected, so each loop can be vectorized.
+ */
+static void srsScheduler_GradeFSRS(const srsSCHEDULER *scheduler, float *srsRESTRICT stability, float *srsRESTRICT difficulty, srsTIME_PACKED *srsRESTRICT last_review, srsTIME_PACKED *srsRESTRICT due, uint16_t *srsRESTRICT reps, uint16_t *srsRESTRICT lapses, const uint8_t *srsRESTRICT grades, const srsTIME_PACKED *srsRESTRICT times, size_t count)
+{
+  float elapsed[srsSCHEDULER_CHUNK];
+  float retrievability[srsSCHEDULER_CHUNK];
+  float intervals[srsSCHEDULER_CHUNK];
+  srsTIME_PACKED new_due[srsSCHEDULER_CHUNK];
+  const float *w = scheduler->weights;
+  /* Terms that are the same for every card */
+  float initial_easy_difficulty = w[4] - expf(w[5] * 3.0f) + 1.0f;
+  float recall_scale = expf(w[8]);
+  float retention = srsScheduler_Clamp(scheduler->desired_retention, 0.01f, 0.99f);
+  float interval_scale = (powf(retention, 1.0f / srsFSRS_DECAY) - 1.0f) / srsFSRS_FACTOR;
+  size_t i = 0;
+
+  srsScheduler_GetElapsedDays(last_review, times, elapsed, count);
+  for (i = 0; i < count; i++)
+  {
+    float s = (stability[i] < srsFSRS_MIN_STABILITY) ? srsFSRS_MIN_STABILITY : stability[i];
+    retrievability[i] = powf(1.0f + srsFSRS_FACTOR * elapsed[i] / s, srsFSRS_DECAY);
+  }
+  for (i = 0; i < count; i++)
+  {
+    float grade = (float)grades[i];
+    bool valid = (grades[i] >= srsGRADE_AGAIN) && (grades[i] <= srsGRADE_EASY);
+    bool is_new = (stability[i] <= 0.0f);
+    bool again = (grades[i] == srsGRADE_AGAIN);
+    float s = (stability[i] < srsFSRS_MIN_STABILITY) ? srsFSRS_MIN_STABILITY : stability[i];
+    float d = srsScheduler_Clamp(difficulty[i], srsFSRS_MIN_DIFFICULTY, srsFSRS_MAX_DIFFICULTY);
+    float r = retrievability[i];
+    /* A card seen for the first time starts from weights chosen per grade */
+    float initial_stability = again ? w[0] : ((grades[i] == srsGRADE_HARD) ? w[1] : ((grades[i] == srsGRADE_GOOD) ? w[2] : w[3]));
+    float initial_difficulty = srsScheduler_Clamp(w[4] - expf(w[5] * (grade - 1.0f)) + 1.0f, srsFSRS_MIN_DIFFICULTY, srsFSRS_MAX_DIFFICULTY);
+    /* Difficulty moves with the grade, less so the closer it is to the top, then reverts a little towards that of an easy first grade */
+    float damped = d - w[6] * (grade - 3.0f) * (srsFSRS_MAX_DIFFICULTY - d) / 9.0f;
+    float next_difficulty = srsScheduler_Clamp(w[7] * initial_easy_difficulty + (1.0f - w[7]) * damped, srsFSRS_MIN_DIFFICULTY, srsFSRS_MAX_DIFFICULTY);
+    /* Stability after a successful recall, after forgetting, and after a review on the same day */
+    float bonus = (grades[i] == srsGRADE_HARD) ? w[15] : ((grades[i] == srsGRADE_EASY) ? w[16] : 1.0f);
+    float recalled = s * (recall_scale * (11.0f - d) * powf(s, -w[9]) * (expf(w[10] * (1.0f - r)) - 1.0f) * bonus + 1.0f);
+    float forgotten = w[11] * powf(d, -w[12]) * (powf(s + 1.0f, w[13]) - 1.0f) * expf(w[14] * (1.0f - r));
+    forgotten = (forgotten < s) ? forgotten : s;
+    float short_term = s * expf(w[17] * (grade - 3.0f + w[18]));
+    float reviewed = (elapsed[i] < 1.0f) ? short_term : (again ? forgotten : recalled);
+    float next_stability = is_new ? initial_stability : reviewed;
+    next_stability = (next_stability < srsFSRS_MIN_STABILITY) ? srsFSRS_MIN_STABILITY : next_stability;
+
+    stability[i] = valid ? next_stability : stability[i];
+    difficulty[i] = valid ? (is_new ? initial_difficulty : next_difficulty) : difficulty[i];
+    intervals[i] = stability[i] * interval_scale;
+    reps[i] = valid ? (again ? 0 : (uint16_t)(reps[i] + (reps[i] < UINT16_MAX))) : reps[i];
+    lapses[i] = (uint16_t)(lapses[i] + (valid && again && !is_new && (lapses[i] < UINT16_MAX)));
+  }
+  srsScheduler_SetDue(scheduler, intervals, times, new_due, count);
+  for (i = 0; i < count; i++)
+  {
+    bool valid = (grades[i] >= srsGRADE_AGAIN) && (grades[i] <= srsGRADE_EASY);
+    due[i] = valid ? new_due[i] : due[i];
+    last_review[i] = valid ? times[i] : last_review[i];
+  }
+}
+
+/* Grades a chunk of cards with SM-2. Grades map to SM-2's quality of response as Again 2, Hard 3, Good 4 and Easy 5. */
+static void srsScheduler_GradeSM2(const srsSCHEDULER *scheduler, float *srsRESTRICT stability, float *srsRESTRICT difficulty, srsTIME_PACKED *srsRESTRICT last_review, srsTIME_PACKED *srsRESTRICT due, uint16_t *srsRESTRICT reps, uint16_t *srsRESTRICT lapses, const uint8_t *srsRESTRICT grades, const srsTIME_PACKED *srsRESTRICT times, size_t count)
+{
+  float intervals[srsSCHEDULER_CHUNK];
+  srsTIME_PACKED new_due[srsSCHEDULER_CHUNK];
+  size_t i = 0;
+  for (i = 0; i < count; i++)
+  {
+    bool valid = (grades[i] >= srsGRADE_AGAIN) && (grades[i] <= srsGRADE_EASY);
+    bool again = (grades[i] == srsGRADE_AGAIN);
+    bool is_new = (difficulty[i] <= 0.0f);
+    float ease = is_new ? srsSM2_DEFAULT_EASE : difficulty[i];
+    float shortfall = 4.0f - (float)grades[i];
+    float next_ease = ease + 0.1f - shortfall * (0.08f + shortfall * 0.02f);
+    next_ease = (next_ease < srsSM2_MIN_EASE) ? srsSM2_MIN_EASE : next_ease;
+    /* One day, then six, then the last interval times the ease. Forgetting starts over. */
+    float interval = (reps[i] == 0) ? 1.0f : ((reps[i] == 1) ? 6.0f : stability[i] * ease);
+    interval = again ? 1.0f : interval;
+
+    intervals[i] = valid ? interval : stability[i];
+    stability[i] = valid ? floorf(srsScheduler_Clamp(interval, 1.0f, scheduler->maximum_interval) + 0.5f) : stability[i];
+    difficulty[i] = valid ? next_ease : difficulty[i];
+    reps[i] = valid ? (again ? 0 : (uint16_t)(reps[i] + (reps[i] < UINT16_MAX))) : reps[i];
+    lapses[i] = (uint16_t)(lapses[i] + (valid && again && !is_new && (lapses[i] < UINT16_MAX)));
+  }
+  srsScheduler_SetDue(scheduler, intervals, times, new_due, count);
+  for (i = 0; i < count; i++)
+  {
+    bool valid = (grades[i] >= srsGRADE_AGAIN) && (grades[i] <= srsGRADE_EASY);
+    due[i] = valid ? new_due[i] : due[i];
+    last_review[i] = valid ? times[i] : last_review[i];
+  }
+}
+
+bool srsScheduler_GradeMany(const srsSCHEDULER *scheduler, srsCARD_STATES *states, const uint8_t *grades, const srsTIME_PACKED *times, size_t count)
+{
+  if ((scheduler == NULL) || (states == NULL) || (grades == NULL) || (times == NULL))
+  {
+    return false;
+  }
+  if ((states->stability == NULL) || (states->difficulty == NULL) || (states->last_review == NULL) || (states->due == NULL) || (states->reps == NULL) || (states->lapses == NULL))
+  {
+    return false;
+  }
+  if ((scheduler->algorithm != srsSCHEDULER_SM2) && (scheduler->algorithm != srsSCHEDULER_FSRS))
+  {
+    return false;
+  }
+  for (size_t start = 0; start < count; start += srsSCHEDULER_CHUNK)
+  {
+    size_t chunk = ((count - start) < srsSCHEDULER_CHUNK) ? (count - start) : srsSCHEDULER_CHUNK;
+    if (scheduler->algorithm == srsSCHEDULER_FSRS)
+    {
+      srsScheduler_GradeFSRS(scheduler, states->stability + start, states->difficulty + start, states->last_review + start, states->due + start, states->reps + start, states->lapses + start, grades + start, times + start, chunk);
+    }
+    else
+    {
+      srsScheduler_GradeSM2(scheduler, states->stability + start, states->difficulty + start, states->last_review + start, states->due + start, states->reps + start, states->lapses + start, grades + start, times + start, chunk);
+    }
+  }
+  return true;
+}
+
+bool srsScheduler_Grade(const srsSCHEDULER *scheduler, const srsCARD_STATE *state, srsGRADE grade, srsTIME_PACKED now, srsCARD_STATE *state_out)
+{
+  if ((state == NULL) || (state_out == NULL) || (grade < srsGRADE_AGAIN) || (grade > srsGRADE_EASY))
+  {
+    return false;
+  }
+  /* A batch of one, so single cards are graded exactly like many */
+  srsCARD_STATE card = *state;
+  uint8_t grades[1] = {(uint8_t)grade};
+  srsTIME_PACKED times[1] = {now};
+  srsCARD_STATES states = {&card.stability, &card.difficulty, &card.last_review, &card.due, &card.reps, &card.lapses};
+  if (!srsScheduler_GradeMany(scheduler, &states, grades, times, 1))
+  {
+    return false;
+  }
+  *state_out = card;
+  return true;
+}
+
+float srsScheduler_GetRetrievability(const srsSCHEDULER *scheduler, const srsCARD_STATE *state, srsTIME_PACKED now)
+{
+  float elapsed = 0.0f;
+  if ((scheduler == NULL) || (state == NULL) || (state->stability <= 0.0f))
+  {
+    return 0.0f;
+  }
+  srsScheduler_GetElapsedDays(&state->last_review, &now, &elapsed, 1);
+  return powf(1.0f + srsFSRS_FACTOR * elapsed / state->stability, srsFSRS_DECAY);
+}
+
+bool srsScheduler_GetRetrievabilityMany(const srsSCHEDULER *scheduler, const srsCARD_STATES *states, const srsTIME_PACKED *times, size_t count, float *retrievability_out)
+{
+  float elapsed[srsSCHEDULER_CHUNK];
+  if ((scheduler == NULL) || (states == NULL) || (states->stability == NULL) || (states->last_review == NULL) || (times == NULL) || (retrievability_out == NULL))
+  {
+    return false;
+  }
+  for (size_t start = 0; start < count; start += srsSCHEDULER_CHUNK)
+  {
+    size_t chunk = ((count - start) < srsSCHEDULER_CHUNK) ? (count - start) : srsSCHEDULER_CHUNK;
+    const float *srsRESTRICT stability = states->stability + start;
+    float *srsRESTRICT retrievability = retrievability_out + start;
+    srsScheduler_GetElapsedDays(states->last_review + start, times + start, elapsed, chunk);
+    for (size_t i = 0; i < chunk; i++)
+    {
+      float s = (stability[i] < srsFSRS_MIN_STABILITY) ? srsFSRS_MIN_STABILITY : stability[i];
+      float r = powf(1.0f + srsFSRS_FACTOR * elapsed[i] / s, srsFSRS_DECAY);
+      retrievability[i] = (stability[i] <= 0.0f) ? 0.0f : r;
+    }
+  }
+  return true;
+}
+
+void srsScheduler_CountDue(const srsTIME_PACKED *due, size_t count, srsTIME_PACKED start, uint32_t days, uint32_t *counts)
+{
+  size_t i = 0;
+  if ((due == NULL) || (counts == NULL))
+  {
+    return;
+  }
+  for (i = 0; i < count; i++)
+  {
+    uint32_t day = (due[i] > start) ? (due[i] - start) / (uint32_t)srsSCHEDULER_MINUTES_PER_DAY : 0;
+    if (day < days)
+    {
+      counts[day]++;
+    }
+  }
+}
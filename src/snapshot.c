@@ -0,0 +1,744 @@
+#include "kioku/snapshot.h"
+#include "kioku/card.h"
+#include "kioku/model.h"
+#include "kioku/git.h"
+#include "kioku/io.h"
+#include "kioku/filesystem.h"
+#include "kioku/datastructure.h"
+#include "kioku/thread.h"
+#include "kioku/log.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+/* Snapshot layout, in native byte order: header, ID offsets, packed added times, packed due times, file modification times, then the pool of NUL-terminated IDs */
+#define srsSNAPSHOT_MAGIC 0x504E534B /* "KSNP" */
+#define srsSNAPSHOT_VERSION 2
+
+/* Cards whose files are stat'd together while refreshing */
+#define srsSNAPSHOT_STAT_BATCH 256
+/* Changed cards whose times are read together while refreshing */
+#define srsSNAPSHOT_LOAD_BATCH 4096
+/* Recently opened decks remembered for deciding whether the watcher reported changes to them */
+#define srsSNAPSHOT_MEMO_MAX 16
+/* States of a snapshot's ID index */
+#define srsSNAPSHOT_INDEX_NONE 0
+#define srsSNAPSHOT_INDEX_BUILDING 1
+#define srsSNAPSHOT_INDEX_READY 2
+#define srsSNAPSHOT_INDEX_FAILED 3
+
+typedef struct _srsSNAPSHOT_HEADER_s
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+  uint32_t pool_size;
+  int64_t cards_mtime_sec;
+  int64_t cards_mtime_nsec;
+  char head[48];
+} srsSNAPSHOT_HEADER;
+
+typedef struct _srsSNAPSHOT_LAYOUT_s
+{
+  uint64_t ids;
+  uint64_t added;
+  uint64_t due;
+  uint64_t mtimes;
+  uint64_t pool;
+  uint64_t size;
+} srsSNAPSHOT_LAYOUT;
+
+struct _srsSNAPSHOT_s
+{
+  srsFILE_VIEW view; /* Backing memory when loaded from disk */
+  char *buffer;      /* Backing memory when freshly built */
+  char *cards_path;
+  srsSNAPSHOT_HEADER header;
+  const uint32_t *ids;
+  const srsTIME_PACKED *added;
+  const srsTIME_PACKED *due;
+  const int64_t *mtimes;
+  const char *pool;
+  /* Hash index of the IDs, built by the first lookup. Its state is one of srsSNAPSHOT_INDEX_*. */
+  srsATOMIC32 index_state;
+  srsHASHMAP index;
+};
+
+/* A card while a snapshot is being built */
+typedef struct _srsSNAPSHOT_ENTRY_s
+{
+  const char *id;
+  srsTIME_PACKED added;
+  srsTIME_PACKED due;
+  int64_t mtime;
+} srsSNAPSHOT_ENTRY;
+
+typedef struct _srsSNAPSHOT_MEMO_s
+{
+  const srsMODEL *model;
+  uint64_t key;
+  int32_t changes;
+} srsSNAPSHOT_MEMO;
+
+static srsSPINLOCK srsSnapshot_LOCK = srsSPINLOCK_INIT;
+static srsSNAPSHOT_MEMO srsSnapshot_MEMO[srsSNAPSHOT_MEMO_MAX];
+static size_t srsSnapshot_MEMO_NEXT = 0;
+
+static uint64_t srsSnapshot_HashPath(const char *path)
+{
+  uint64_t hash = 14695981039346656037ULL;
+  for (; *path != kiokuCHAR_NULL; path++)
+  {
+    hash = (hash ^ (uint8_t)*path) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+/* Whether the watcher may have reported changes to a deck since it was last opened by this process */
+static bool srsSnapshot_HasChanged(const srsMODEL *model, uint64_t key, int32_t changes)
+{
+  bool changed = (changes != 0);
+  srsSpinLock_Lock(&srsSnapshot_LOCK);
+  for (size_t i = 0; i < srsSNAPSHOT_MEMO_MAX; i++)
+  {
+    if ((srsSnapshot_MEMO[i].model == model) && (srsSnapshot_MEMO[i].key == key))
+    {
+      changed = (srsSnapshot_MEMO[i].changes != changes);
+      break;
+    }
+  }
+  srsSpinLock_Unlock(&srsSnapshot_LOCK);
+  return changed;
+}
+
+static void srsSnapshot_Remember(const srsMODEL *model, uint64_t key, int32_t changes)
+{
+  size_t i = 0;
+  srsSpinLock_Lock(&srsSnapshot_LOCK);
+  for (i = 0; (i < srsSNAPSHOT_MEMO_MAX) && ((srsSnapshot_MEMO[i].model != model) || (srsSnapshot_MEMO[i].key != key)); i++);
+  if (i == srsSNAPSHOT_MEMO_MAX)
+  {
+    i = srsSnapshot_MEMO_NEXT;
+    srsSnapshot_MEMO_NEXT = (srsSnapshot_MEMO_NEXT + 1) % srsSNAPSHOT_MEMO_MAX;
+  }
+  srsSnapshot_MEMO[i].model = model;
+  srsSnapshot_MEMO[i].key = key;
+  srsSnapshot_MEMO[i].changes = changes;
+  srsSpinLock_Unlock(&srsSnapshot_LOCK);
+}
+
+static srsSNAPSHOT_LAYOUT srsSnapshot_GetLayout(uint32_t count, uint32_t pool_size)
+{
+  srsSNAPSHOT_LAYOUT layout;
+  layout.ids = sizeof(srsSNAPSHOT_HEADER);
+  layout.added = layout.ids + (uint64_t)count * sizeof(uint32_t);
+  layout.due = layout.added + (uint64_t)count * sizeof(srsTIME_PACKED);
+  layout.mtimes = (layout.due + (uint64_t)count * sizeof(srsTIME_PACKED) + 7) & ~(uint64_t)7;
+  layout.pool = layout.mtimes + (uint64_t)count * sizeof(int64_t);
+  layout.size = layout.pool + pool_size;
+  return layout;
+}
+
+/* Points the columns of a snapshot into its backing memory, after making sure every ID lies inside the pool */
+static bool srsSnapshot_Attach(srsSNAPSHOT *snapshot, const char *data, size_t size)
+{
+  srsSNAPSHOT_HEADER header;
+  if (size < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  if ((header.magic != srsSNAPSHOT_MAGIC) || (header.version != srsSNAPSHOT_VERSION) || (header.head[sizeof(header.head) - 1] != kiokuCHAR_NULL))
+  {
+    return false;
+  }
+  srsSNAPSHOT_LAYOUT layout = srsSnapshot_GetLayout(header.count, header.pool_size);
+  if (layout.size != size)
+  {
+    return false;
+  }
+  const uint32_t *ids = (const uint32_t *)(data + layout.ids);
+  const char *pool = data + layout.pool;
+  if ((header.count > 0) && ((header.pool_size == 0) || (pool[header.pool_size - 1] != kiokuCHAR_NULL)))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < header.count; i++)
+  {
+    if (ids[i] >= header.pool_size)
+    {
+      return false;
+    }
+  }
+  snapshot->header = header;
+  snapshot->ids = ids;
+  snapshot->added = (const srsTIME_PACKED *)(data + layout.added);
+  snapshot->due = (const srsTIME_PACKED *)(data + layout.due);
+  snapshot->mtimes = (const int64_t *)(data + layout.mtimes);
+  snapshot->pool = pool;
+  return true;
+}
+
+/* Stamps the current state of a deck: the commit HEAD points to and when cards were last added or removed */
+static bool srsSnapshot_GetStamp(srsMODEL *model, srsIO_ENGINE *engine, srsDIR *deck_dir, srsSNAPSHOT_HEADER *stamp)
+{
+  srsIO_REQUEST request = {0};
+  memset(stamp->head, 0, sizeof(stamp->head));
+  /* A model without commits yet is stamped with an empty HEAD */
+  srsGitRepo_GetHead(srsModel_GetRepoAt(model), stamp->head, sizeof(stamp->head));
+  request.op = srsIO_STAT;
+  request.dir = deck_dir;
+  request.path = "cards";
+  if (!srsIO_Submit(engine, &request, 1) || (request.result != 0) || !request.is_dir)
+  {
+    return false;
+  }
+  stamp->cards_mtime_sec = request.mtime_sec;
+  stamp->cards_mtime_nsec = request.mtime_nsec;
+  return true;
+}
+
+static bool srsSnapshot_StampEquals(const srsSNAPSHOT_HEADER *a, const srsSNAPSHOT_HEADER *b)
+{
+  return (a->cards_mtime_sec == b->cards_mtime_sec) && (a->cards_mtime_nsec == b->cards_mtime_nsec) && (strcmp(a->head, b->head) == 0);
+}
+
+/* Snapshots are opened and closed for nearly every request, so they are kept for reuse */
+srsPOOL_DEFINE(srsSNAPSHOT_POOL, srsSnapshotPool, srsSNAPSHOT)
+static srsSNAPSHOT_POOL srsSnapshot_POOL = srsPOOL_DEFINE_INIT(srsSNAPSHOT);
+
+static srsSNAPSHOT *srsSnapshot_Create(srsDIR *cards_dir)
+{
+  srsSNAPSHOT *snapshot = srsSnapshotPool_Alloc(&srsSnapshot_POOL);
+  if (snapshot == NULL)
+  {
+    return NULL;
+  }
+  memset(snapshot, 0, sizeof(*snapshot));
+  snapshot->cards_path = strdup(srsDir_GetPath(cards_dir));
+  if (snapshot->cards_path == NULL)
+  {
+    srsSnapshotPool_Release(&srsSnapshot_POOL, snapshot);
+    return NULL;
+  }
+  return snapshot;
+}
+
+static srsSNAPSHOT *srsSnapshot_Load(srsDIR *deck_dir, srsDIR *cards_dir)
+{
+  srsSNAPSHOT *snapshot = srsSnapshot_Create(cards_dir);
+  if (snapshot == NULL)
+  {
+    return NULL;
+  }
+  if (!srsFile_MapAt(deck_dir, srsSNAPSHOT_DIRNAME "/" srsSNAPSHOT_FILENAME, &snapshot->view) || !srsSnapshot_Attach(snapshot, snapshot->view.data, snapshot->view.size))
+  {
+    srsSnapshot_Close(snapshot);
+    return NULL;
+  }
+  return snapshot;
+}
+
+/* Writes a snapshot under a temporary name first so readers never map a partial one */
+static void srsSnapshot_Save(srsDIR *deck_dir, const char *data, size_t size)
+{
+  char cache_path[srsPATH_MAX + 1];
+  char path[srsPATH_MAX + 1];
+  char temp[srsPATH_MAX + 1];
+  int32_t needed = kioku_path_concat(cache_path, sizeof(cache_path), srsDir_GetPath(deck_dir), srsSNAPSHOT_DIRNAME);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(cache_path)))
+  {
+    return;
+  }
+  if (!srsDir_Exists(cache_path))
+  {
+    if (!srsDir_Create(cache_path))
+    {
+      srsLOG_ERROR("Unable to create %s - the snapshot will be rebuilt every time", cache_path);
+      return;
+    }
+    /* Keep derived data out of the repository without touching the user's own ignore rules */
+    needed = kioku_path_concat(path, sizeof(path), cache_path, ".gitignore");
+    if ((needed > 0) && ((size_t)needed < sizeof(path)) && srsFile_Create(path))
+    {
+      srsFile_SetContent(path, "*" kiokuSTRING_LF);
+    }
+  }
+  needed = snprintf(path, sizeof(path), "%s/%s", cache_path, srsSNAPSHOT_FILENAME);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(path)))
+  {
+    return;
+  }
+  /* Another thread or process may be rebuilding the same deck, so each writes its own temporary file */
+  if (!srsFile_GetTempPath(path, temp, sizeof(temp)))
+  {
+    return;
+  }
+  FILE *fp = fopen(temp, "wb");
+  if (fp == NULL)
+  {
+    return;
+  }
+  bool ok = (fwrite(data, 1, size, fp) == size);
+  ok = (fclose(fp) == 0) && ok;
+#ifdef kiokuOS_WINDOWS
+  /* rename refuses to replace an existing file on Windows */
+  remove(path);
+#endif
+  if (!ok || !srsPath_Move(temp, path))
+  {
+    remove(temp);
+  }
+}
+
+static int srsSnapshot_CompareEntries(const void *a, const void *b)
+{
+  return strcmp(((const srsSNAPSHOT_ENTRY *)a)->id, ((const srsSNAPSHOT_ENTRY *)b)->id);
+}
+
+/* Packs sorted entries into the on-disk layout */
+static srsSNAPSHOT *srsSnapshot_Pack(srsDIR *cards_dir, const srsSNAPSHOT_HEADER *stamp, const srsSNAPSHOT_ENTRY *entries, size_t count)
+{
+  uint64_t pool_size = 0;
+  size_t i = 0;
+  for (i = 0; i < count; i++)
+  {
+    pool_size += strlen(entries[i].id) + 1;
+  }
+  if ((count > UINT32_MAX) || (pool_size > UINT32_MAX))
+  {
+    return NULL;
+  }
+  srsSNAPSHOT_LAYOUT layout = srsSnapshot_GetLayout((uint32_t)count, (uint32_t)pool_size);
+  if (layout.size > SIZE_MAX)
+  {
+    return NULL;
+  }
+  srsSNAPSHOT *snapshot = srsSnapshot_Create(cards_dir);
+  if (snapshot == NULL)
+  {
+    return NULL;
+  }
+  snapshot->buffer = calloc(1, (size_t)layout.size);
+  if (snapshot->buffer == NULL)
+  {
+    srsSnapshot_Close(snapshot);
+    return NULL;
+  }
+  srsSNAPSHOT_HEADER header = *stamp;
+  header.magic = srsSNAPSHOT_MAGIC;
+  header.version = srsSNAPSHOT_VERSION;
+  header.count = (uint32_t)count;
+  header.pool_size = (uint32_t)pool_size;
+  memcpy(snapshot->buffer, &header, sizeof(header));
+  uint32_t *ids = (uint32_t *)(snapshot->buffer + layout.ids);
+  srsTIME_PACKED *added = (srsTIME_PACKED *)(snapshot->buffer + layout.added);
+  srsTIME_PACKED *due = (srsTIME_PACKED *)(snapshot->buffer + layout.due);
+  int64_t *mtimes = (int64_t *)(snapshot->buffer + layout.mtimes);
+  char *pool = snapshot->buffer + layout.pool;
+  uint32_t offset = 0;
+  for (i = 0; i < count; i++)
+  {
+    size_t length = strlen(entries[i].id) + 1;
+    memcpy(pool + offset, entries[i].id, length);
+    ids[i] = offset;
+    offset += (uint32_t)length;
+    added[i] = entries[i].added;
+    due[i] = entries[i].due;
+    mtimes[i] = entries[i].mtime;
+  }
+  srsSnapshot_Attach(snapshot, snapshot->buffer, (size_t)layout.size);
+  return snapshot;
+}
+
+/* Reads the times of the cards that changed, in batches */
+static bool srsSnapshot_LoadChanged(srsDIR *cards_dir, srsSNAPSHOT_ENTRY *entries, const size_t *changed, size_t changed_count, srsCARD *cards)
+{
+  for (size_t start = 0; start < changed_count; start += srsSNAPSHOT_LOAD_BATCH)
+  {
+    size_t count = changed_count - start;
+    size_t i = 0;
+    count = (count < srsSNAPSHOT_LOAD_BATCH) ? count : srsSNAPSHOT_LOAD_BATCH;
+    for (i = 0; i < count; i++)
+    {
+      memset(&cards[i], 0, sizeof(cards[i]));
+      cards[i].id = entries[changed[start + i]].id;
+    }
+    if (!srsCard_LoadTimes(cards_dir, cards, count))
+    {
+      return false;
+    }
+    for (i = 0; i < count; i++)
+    {
+      entries[changed[start + i]].added = srsTime_Pack(cards[i].when_added);
+      entries[changed[start + i]].due = srsTime_Pack(cards[i].when_next_scheduled);
+    }
+  }
+  return true;
+}
+
+/**
+ * Builds a snapshot of the cards directory as it is now.
+ * The files of every card are stat'd in batches. Cards found in the previous snapshot whose files are unchanged keep their times, and only the rest are read.
+ */
+static srsSNAPSHOT *srsSnapshot_Build(srsDIR *cards_dir, const srsSNAPSHOT_HEADER *stamp, const srsSNAPSHOT *previous)
+{
+  static const char *files[2] = {"added.txt", "scheduled.txt"};
+  srsSNAPSHOT *snapshot = NULL;
+  srsDIR_STREAM *stream = NULL;
+  srsIO_ENGINE *engine = NULL;
+  srsARENA arena;
+  srsSNAPSHOT_ENTRY *entries = NULL;
+  size_t count = 0;
+  size_t capacity = 0;
+  size_t *changed = NULL;
+  size_t changed_count = 0;
+  srsCARD *cards = NULL;
+  srsIO_REQUEST *requests = NULL;
+  char (*paths)[srsMODEL_CARD_ID_MAX + sizeof("/scheduled.txt")] = NULL;
+  const char *name = NULL;
+  bool is_dir = false;
+  bool more = true;
+  size_t i = 0;
+  size_t j = 0;
+  /* Files modified in the last moment might be modified again without their mtime changing, so those are never trusted later */
+  int64_t racy_after = (int64_t)time(NULL) - 1;
+
+  srsArena_Init(&arena, 0);
+  stream = srsDirStream_Open(cards_dir, ".");
+  engine = srsIO_Create(srsIO_DEFAULT_DEPTH, 0);
+  requests = malloc(srsSNAPSHOT_STAT_BATCH * 2 * sizeof(*requests));
+  paths = malloc(srsSNAPSHOT_STAT_BATCH * 2 * sizeof(*paths));
+  if ((stream == NULL) || (engine == NULL) || (requests == NULL) || (paths == NULL))
+  {
+    goto done;
+  }
+  while (more)
+  {
+    size_t batch_start = count;
+    /* Gather a batch of cards */
+    while ((count - batch_start < srsSNAPSHOT_STAT_BATCH) && (more = srsDirStream_Next(stream, &name, &is_dir)))
+    {
+      /* Anything that isn't a directory can't be a card */
+      if (!is_dir || (strlen(name) > srsMODEL_CARD_ID_MAX))
+      {
+        continue;
+      }
+      if (count == capacity)
+      {
+        size_t grown_capacity = (capacity == 0) ? 1024 : capacity * 2;
+        srsSNAPSHOT_ENTRY *grown = realloc(entries, grown_capacity * sizeof(*entries));
+        size_t *grown_changed = realloc(changed, grown_capacity * sizeof(*changed));
+        entries = (grown != NULL) ? grown : entries;
+        changed = (grown_changed != NULL) ? grown_changed : changed;
+        if ((grown == NULL) || (grown_changed == NULL))
+        {
+          goto done;
+        }
+        capacity = grown_capacity;
+      }
+      memset(&entries[count], 0, sizeof(entries[count]));
+      entries[count].id = srsArena_StrDup(&arena, name);
+      if (entries[count].id == NULL)
+      {
+        goto done;
+      }
+      count++;
+    }
+    size_t batch_count = count - batch_start;
+    if (batch_count == 0)
+    {
+      break;
+    }
+    /* Stat both time files of every card in the batch */
+    memset(requests, 0, batch_count * 2 * sizeof(*requests));
+    for (i = 0; i < batch_count; i++)
+    {
+      for (j = 0; j < 2; j++)
+      {
+        srsIO_REQUEST *request = &requests[i * 2 + j];
+        snprintf(paths[i * 2 + j], sizeof(paths[i * 2 + j]), "%s/%s", entries[batch_start + i].id, files[j]);
+        request->op = srsIO_STAT;
+        request->dir = cards_dir;
+        request->path = paths[i * 2 + j];
+      }
+    }
+    if (!srsIO_Submit(engine, requests, batch_count * 2))
+    {
+      goto done;
+    }
+    for (i = 0; i < batch_count; i++)
+    {
+      srsSNAPSHOT_ENTRY *entry = &entries[batch_start + i];
+      size_t found = 0;
+      for (j = 0; j < 2; j++)
+      {
+        const srsIO_REQUEST *request = &requests[i * 2 + j];
+        int64_t mtime = (request->result == 0) ? (request->mtime_sec * 1000000000LL + request->mtime_nsec) : 0;
+        if ((request->result == 0) && (request->mtime_sec >= racy_after))
+        {
+          entry->mtime = -1;
+          break;
+        }
+        entry->mtime = (mtime > entry->mtime) ? mtime : entry->mtime;
+      }
+      if ((entry->mtime != -1) && srsSnapshot_Find(previous, entry->id, &found) && (previous->mtimes[found] == entry->mtime))
+      {
+        entry->added = previous->added[found];
+        entry->due = previous->due[found];
+      }
+      else
+      {
+        changed[changed_count++] = batch_start + i;
+      }
+    }
+  }
+  srsLOG_PRINT("Snapshot of %s: %zu cards, %zu read from disk", srsDir_GetPath(cards_dir), count, changed_count);
+  cards = malloc(srsSNAPSHOT_LOAD_BATCH * sizeof(*cards));
+  if ((cards == NULL) || !srsSnapshot_LoadChanged(cards_dir, entries, changed, changed_count, cards))
+  {
+    goto done;
+  }
+  if (count > 0)
+  {
+    qsort(entries, count, sizeof(*entries), srsSnapshot_CompareEntries);
+  }
+  snapshot = srsSnapshot_Pack(cards_dir, stamp, entries, count);
+done:
+  free(cards);
+  free(paths);
+  free(requests);
+  free(changed);
+  free(entries);
+  srsIO_Destroy(engine);
+  srsDirStream_Close(stream);
+  srsArena_Free(&arena);
+  return snapshot;
+}
+
+static srsSNAPSHOT *srsSnapshot_OpenInternal(srsMODEL *model, const char *deck_path, bool refresh)
+{
+  srsSNAPSHOT *snapshot = NULL;
+  srsSNAPSHOT *previous = NULL;
+  srsDIR *deck_dir = NULL;
+  srsDIR *cards_dir = NULL;
+  srsIO_ENGINE *engine = NULL;
+  srsSNAPSHOT_HEADER stamp = {0};
+  if ((deck_path == NULL) || (srsModel_GetRootAt(model) == NULL))
+  {
+    return NULL;
+  }
+  /* Read before anything else so changes reported while building are caught by the next open */
+  int32_t changes = srsModel_GetCardChangesAt(model);
+  deck_dir = srsDir_OpenAt(srsModel_GetRootDirAt(model), deck_path);
+  cards_dir = (deck_dir == NULL) ? NULL : srsDir_OpenAt(deck_dir, "cards");
+  engine = srsIO_Create(1, srsIO_FLAG_BLOCKING);
+  if ((cards_dir == NULL) || (engine == NULL) || !srsSnapshot_GetStamp(model, engine, deck_dir, &stamp))
+  {
+    goto done;
+  }
+  uint64_t key = srsSnapshot_HashPath(srsDir_GetPath(deck_dir));
+  previous = srsSnapshot_Load(deck_dir, cards_dir);
+  if ((previous != NULL) && !refresh && srsSnapshot_StampEquals(&stamp, &previous->header) && !srsSnapshot_HasChanged(model, key, changes))
+  {
+    snapshot = previous;
+    previous = NULL;
+  }
+  else
+  {
+    if (stamp.cards_mtime_sec >= (int64_t)time(NULL) - 1)
+    {
+      /* Cards may still be arriving within the same timestamp, so make sure the stamp will not match next time */
+      stamp.cards_mtime_sec = -1;
+    }
+    snapshot = srsSnapshot_Build(cards_dir, &stamp, previous);
+    if (snapshot != NULL)
+    {
+      srsSnapshot_Save(deck_dir, snapshot->buffer, (size_t)srsSnapshot_GetLayout(snapshot->header.count, snapshot->header.pool_size).size);
+    }
+  }
+  if (snapshot != NULL)
+  {
+    srsSnapshot_Remember(model, key, changes);
+  }
+done:
+  srsSnapshot_Close(previous);
+  srsIO_Destroy(engine);
+  srsDir_Close(cards_dir);
+  srsDir_Close(deck_dir);
+  return snapshot;
+}
+
+srsSNAPSHOT *srsSnapshot_OpenAt(srsMODEL *model, const char *deck_path)
+{
+  return srsSnapshot_OpenInternal(model, deck_path, false);
+}
+
+srsSNAPSHOT *srsSnapshot_Open(const char *deck_path)
+{
+  return srsSnapshot_OpenAt(srsModel_GetDefault(), deck_path);
+}
+
+srsSNAPSHOT *srsSnapshot_RefreshAt(srsMODEL *model, const char *deck_path)
+{
+  return srsSnapshot_OpenInternal(model, deck_path, true);
+}
+
+srsSNAPSHOT *srsSnapshot_Refresh(const char *deck_path)
+{
+  return srsSnapshot_RefreshAt(srsModel_GetDefault(), deck_path);
+}
+
+void srsSnapshot_Forget(const srsMODEL *model)
+{
+  srsSpinLock_Lock(&srsSnapshot_LOCK);
+  for (size_t i = 0; i < srsSNAPSHOT_MEMO_MAX; i++)
+  {
+    if (srsSnapshot_MEMO[i].model == model)
+    {
+      memset(&srsSnapshot_MEMO[i], 0, sizeof(srsSnapshot_MEMO[i]));
+    }
+  }
+  srsSpinLock_Unlock(&srsSnapshot_LOCK);
+}
+
+void srsSnapshot_Close(srsSNAPSHOT *snapshot)
+{
+  if (snapshot == NULL)
+  {
+    return;
+  }
+  if (snapshot->view.data != NULL)
+  {
+    srsFile_Unmap(&snapshot->view);
+  }
+  if (srsAtomic_Load(&snapshot->index_state) == srsSNAPSHOT_INDEX_READY)
+  {
+    srsHashMap_Free(&snapshot->index);
+  }
+  free(snapshot->buffer);
+  free(snapshot->cards_path);
+  srsSnapshotPool_Release(&srsSnapshot_POOL, snapshot);
+}
+
+const char *srsSnapshot_GetCardsPath(const srsSNAPSHOT *snapshot)
+{
+  return (snapshot == NULL) ? NULL : snapshot->cards_path;
+}
+
+size_t srsSnapshot_GetCount(const srsSNAPSHOT *snapshot)
+{
+  return (snapshot == NULL) ? 0 : snapshot->header.count;
+}
+
+const char *srsSnapshot_GetID(const srsSNAPSHOT *snapshot, size_t index)
+{
+  return (index < srsSnapshot_GetCount(snapshot)) ? snapshot->pool + snapshot->ids[index] : NULL;
+}
+
+srsTIME srsSnapshot_GetAdded(const srsSNAPSHOT *snapshot, size_t index)
+{
+  return srsTime_Unpack((index < srsSnapshot_GetCount(snapshot)) ? snapshot->added[index] : srsTIME_PACKED_NONE);
+}
+
+srsTIME srsSnapshot_GetDue(const srsSNAPSHOT *snapshot, size_t index)
+{
+  return srsTime_Unpack((index < srsSnapshot_GetCount(snapshot)) ? snapshot->due[index] : srsTIME_PACKED_NONE);
+}
+
+const srsTIME_PACKED *srsSnapshot_GetAddedTimes(const srsSNAPSHOT *snapshot)
+{
+  return (srsSnapshot_GetCount(snapshot) == 0) ? NULL : snapshot->added;
+}
+
+const srsTIME_PACKED *srsSnapshot_GetDueTimes(const srsSNAPSHOT *snapshot)
+{
+  return (srsSnapshot_GetCount(snapshot) == 0) ? NULL : snapshot->due;
+}
+
+/**
+ * Builds the hash index of a snapshot's IDs the first time it is needed, so that only snapshots that are searched pay for it.
+ * Snapshots are otherwise read-only and may be shared, so whichever thread gets here first builds it while the others wait.
+ */
+static bool srsSnapshot_GetIndex(srsSNAPSHOT *snapshot)
+{
+  int32_t state = srsSNAPSHOT_INDEX_NONE;
+  while ((state = srsAtomic_Load(&snapshot->index_state)) != srsSNAPSHOT_INDEX_READY)
+  {
+    if (state == srsSNAPSHOT_INDEX_FAILED)
+    {
+      return false;
+    }
+    if (!srsAtomic_CompareExchange(&snapshot->index_state, srsSNAPSHOT_INDEX_NONE, srsSNAPSHOT_INDEX_BUILDING))
+    {
+      srsThread_Yield();
+      continue;
+    }
+    size_t count = srsSnapshot_GetCount(snapshot);
+    bool ok = srsHashMap_Init(&snapshot->index, count);
+    for (size_t i = 0; ok && (i < count); i++)
+    {
+      ok = srsHashMap_Set(&snapshot->index, snapshot->pool + snapshot->ids[i], (void *)(uintptr_t)i);
+    }
+    if (!ok)
+    {
+      srsHashMap_Free(&snapshot->index);
+    }
+    srsAtomic_Store(&snapshot->index_state, ok ? srsSNAPSHOT_INDEX_READY : srsSNAPSHOT_INDEX_FAILED);
+  }
+  return true;
+}
+
+bool srsSnapshot_IsSameState(const srsSNAPSHOT *a, const srsSNAPSHOT *b)
+{
+  /* A stamp that was made not to match the one on disk does not say anything either */
+  return (a != NULL) && (b != NULL) && (a->header.cards_mtime_sec >= 0) && (a->header.count == b->header.count) && srsSnapshot_StampEquals(&a->header, &b->header) && (strcmp(a->cards_path, b->cards_path) == 0);
+}
+
+bool srsSnapshot_Find(const srsSNAPSHOT *snapshot, const char *card_id, size_t *index_out)
+{
+  size_t low = 0;
+  size_t high = srsSnapshot_GetCount(snapshot);
+  void *index = NULL;
+  if ((card_id == NULL) || (high == 0))
+  {
+    return false;
+  }
+  /* The index is a cache, which is all that changes */
+  if (srsSnapshot_GetIndex((srsSNAPSHOT *)snapshot))
+  {
+    if (!srsHashMap_Get(&snapshot->index, card_id, &index))
+    {
+      return false;
+    }
+    if (index_out != NULL)
+    {
+      *index_out = (size_t)(uintptr_t)index;
+    }
+    return true;
+  }
+  /* Without an index the IDs are still sorted */
+  while (low < high)
+  {
+    size_t middle = low + (high - low) / 2;
+    int comparison = strcmp(snapshot->pool + snapshot->ids[middle], card_id);
+    if (comparison == 0)
+    {
+      if (index_out != NULL)
+      {
+        *index_out = middle;
+      }
+      return true;
+    }
+    if (comparison < 0)
+    {
+      low = middle + 1;
+    }
+    else
+    {
+      high = middle;
+    }
+  }
+  return false;
+}
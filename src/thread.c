@@ -0,0 +1,188 @@
+#include "kioku/thread.h"
+#include "kioku/log.h"
+
+#include <stdlib.h>
+
+#ifndef kiokuOS_WINDOWS
+#include <unistd.h>
+#include <sched.h>
+#endif
+
+bool srsMutex_Init(srsMUTEX *mutex)
+{
+  if (mutex == NULL)
+  {
+    return false;
+  }
+#ifdef kiokuOS_WINDOWS
+  InitializeCriticalSection(mutex);
+  return true;
+#else
+  return pthread_mutex_init(mutex, NULL) == 0;
+#endif
+}
+
+void srsMutex_Destroy(srsMUTEX *mutex)
+{
+#ifdef kiokuOS_WINDOWS
+  DeleteCriticalSection(mutex);
+#else
+  pthread_mutex_destroy(mutex);
+#endif
+}
+
+void srsMutex_Lock(srsMUTEX *mutex)
+{
+#ifdef kiokuOS_WINDOWS
+  EnterCriticalSection(mutex);
+#else
+  pthread_mutex_lock(mutex);
+#endif
+}
+
+void srsMutex_Unlock(srsMUTEX *mutex)
+{
+#ifdef kiokuOS_WINDOWS
+  LeaveCriticalSection(mutex);
+#else
+  pthread_mutex_unlock(mutex);
+#endif
+}
+
+bool srsCond_Init(srsCOND *cond)
+{
+  if (cond == NULL)
+  {
+    return false;
+  }
+#ifdef kiokuOS_WINDOWS
+  InitializeConditionVariable(cond);
+  return true;
+#else
+  return pthread_cond_init(cond, NULL) == 0;
+#endif
+}
+
+void srsCond_Destroy(srsCOND *cond)
+{
+#ifdef kiokuOS_WINDOWS
+  /* Windows condition variables hold no resources */
+  (void)cond;
+#else
+  pthread_cond_destroy(cond);
+#endif
+}
+
+void srsCond_Wait(srsCOND *cond, srsMUTEX *mutex)
+{
+#ifdef kiokuOS_WINDOWS
+  SleepConditionVariableCS(cond, mutex, INFINITE);
+#else
+  pthread_cond_wait(cond, mutex);
+#endif
+}
+
+void srsCond_Signal(srsCOND *cond)
+{
+#ifdef kiokuOS_WINDOWS
+  WakeConditionVariable(cond);
+#else
+  pthread_cond_signal(cond);
+#endif
+}
+
+void srsCond_Broadcast(srsCOND *cond)
+{
+#ifdef kiokuOS_WINDOWS
+  WakeAllConditionVariable(cond);
+#else
+  pthread_cond_broadcast(cond);
+#endif
+}
+
+#ifdef kiokuOS_WINDOWS
+/* CreateThread wants a different entry point signature, so trampoline through a heap-allocated start record */
+typedef struct _srsTHREAD_START_s
+{
+  srsTHREAD_FUNC func;
+  void *arg;
+} srsTHREAD_START;
+
+static DWORD WINAPI srsThread_Trampoline(LPVOID param)
+{
+  srsTHREAD_START start = *(srsTHREAD_START *)param;
+  free(param);
+  start.func(start.arg);
+  return 0;
+}
+#endif
+
+bool srsThread_Create(srsTHREAD *thread, srsTHREAD_FUNC func, void *arg)
+{
+  if ((thread == NULL) || (func == NULL))
+  {
+    return false;
+  }
+#ifdef kiokuOS_WINDOWS
+  srsTHREAD_START *start = malloc(sizeof(*start));
+  if (start == NULL)
+  {
+    return false;
+  }
+  start->func = func;
+  start->arg = arg;
+  *thread = CreateThread(NULL, 0, srsThread_Trampoline, start, 0, NULL);
+  if (*thread == NULL)
+  {
+    free(start);
+    return false;
+  }
+  return true;
+#else
+  int err = pthread_create(thread, NULL, func, arg);
+  if (err != 0)
+  {
+    srsLOG_ERROR("Failed to create thread (error %d)", err);
+    return false;
+  }
+  return true;
+#endif
+}
+
+bool srsThread_Join(srsTHREAD thread, void **result_out)
+{
+#ifdef kiokuOS_WINDOWS
+  /* A DWORD exit code cannot carry a pointer, so the thread function's result is not available on Windows */
+  bool result = (WaitForSingleObject(thread, INFINITE) == WAIT_OBJECT_0);
+  CloseHandle(thread);
+  if (result_out != NULL)
+  {
+    *result_out = NULL;
+  }
+  return result;
+#else
+  void *ignored = NULL;
+  return pthread_join(thread, (result_out != NULL) ? result_out : &ignored) == 0;
+#endif
+}
+
+uint32_t srsThread_GetHardwareConcurrency()
+{
+#ifdef kiokuOS_WINDOWS
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (info.dwNumberOfProcessors > 0) ? (uint32_t)info.dwNumberOfProcessors : 1;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return (count > 0) ? (uint32_t)count : 1;
+#endif
+}
+
+void srsThread_Yield()
+{
+#ifdef kiokuOS_WINDOWS
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
@@ -0,0 +1,596 @@
+#include "kioku/watch.h"
+#include "kioku/thread.h"
+#include "kioku/filesystem.h"
+#include "kioku/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined kiokuOS_LINUX
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#define srsWATCH_INOTIFY
+#endif
+
+#ifdef srsWATCH_INOTIFY
+/* Changes to entries of a watched directory. Moves are reported as a deletion and a creation, and directory self-events are left to the parent. */
+#define srsWATCH_INOTIFY_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+/* A directory watched on behalf of a watcher. Watchers whose trees overlap share the inotify watch descriptor of a directory, so it has one of these for each. */
+typedef struct _srsWATCH_DIR_s
+{
+  int wd;
+  srsWATCH *watch;
+  char *path; /* Relative to the watch root, "" for the root itself */
+} srsWATCH_DIR;
+
+/* The thread reading events for every watcher, along with the inotify instance it reads */
+typedef struct _srsWATCH_THREAD_s
+{
+  int fd;
+  int wake[2]; /* Pipe written to when the last watcher closes to stop the thread */
+  srsTHREAD thread;
+} srsWATCH_THREAD;
+#endif
+
+struct _srsWATCH_s
+{
+  char *path;
+  srsWATCH_FUNC func;
+  void *userdata;
+#ifdef srsWATCH_INOTIFY
+  bool cached; /* Whether the filesystem module caches state beneath path on our word */
+  size_t dir_count;
+  srsWATCH *next;
+#endif
+};
+
+#ifdef srsWATCH_INOTIFY
+/*
+ * Every watcher shares one inotify instance and one thread, since both are limited per user and a process may watch many roots.
+ * The lock guards everything below and is held while callbacks run, which keeps a watcher from being closed in the middle of one.
+ */
+static srsATOMIC32 srsWatch_STATE = 0; /* 0 until the lock is initialized, 1 while initializing, 2 once ready */
+static srsMUTEX srsWatch_LOCK;
+static srsWATCH_THREAD *srsWatch_THREAD = NULL;
+static srsWATCH *srsWatch_LIST = NULL;
+/* Sorted by wd and then watcher so events can be resolved with a binary search */
+static srsWATCH_DIR *srsWatch_DIRS = NULL;
+static size_t srsWatch_DIR_COUNT = 0;
+static size_t srsWatch_DIR_CAPACITY = 0;
+
+static bool srsWatch_Init()
+{
+  while (srsAtomic_Load(&srsWatch_STATE) != 2)
+  {
+    if (!srsAtomic_CompareExchange(&srsWatch_STATE, 0, 1))
+    {
+      srsThread_Yield();
+      continue;
+    }
+    if (!srsMutex_Init(&srsWatch_LOCK))
+    {
+      srsAtomic_Store(&srsWatch_STATE, 0);
+      return false;
+    }
+    srsAtomic_Store(&srsWatch_STATE, 2);
+  }
+  return true;
+}
+
+/* Joins the watch root, a relative directory and optionally a name */
+static bool srsWatch_JoinPath(char *out, size_t out_size, const char *base, const char *rel, const char *name)
+{
+  int needed;
+  if (rel[0] == kiokuCHAR_NULL)
+  {
+    needed = (name == NULL) ? snprintf(out, out_size, "%s", base) : snprintf(out, out_size, "%s/%s", base, name);
+  }
+  else
+  {
+    needed = (name == NULL) ? snprintf(out, out_size, "%s/%s", base, rel) : snprintf(out, out_size, "%s/%s/%s", base, rel, name);
+  }
+  return (needed > 0) && ((size_t)needed < out_size);
+}
+
+/* Drops cached state for a changed path before anyone is told about it, so they cannot read it back stale */
+static void srsWatch_Report(srsWATCH *watch, srsWATCH_EVENT event, const char *rel, bool is_dir)
+{
+  char fullpath[srsPATH_MAX + 1];
+  if (srsWatch_JoinPath(fullpath, sizeof(fullpath), watch->path, rel, NULL))
+  {
+    srsFileSystem_Invalidate(fullpath);
+  }
+  watch->func(event, rel, is_dir, watch->userdata);
+}
+
+/* Index of the first directory not ordered before the given wd and watcher */
+static size_t srsWatch_LowerBound(int wd, const srsWATCH *watch)
+{
+  size_t lo = 0;
+  size_t hi = srsWatch_DIR_COUNT;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    const srsWATCH_DIR *dir = &srsWatch_DIRS[mid];
+    if ((dir->wd < wd) || ((dir->wd == wd) && ((uintptr_t)dir->watch < (uintptr_t)watch)))
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/* Index of the first directory with a wd, for a watcher ordered after the given one, or the count if there is none */
+static size_t srsWatch_FindNext(int wd, const srsWATCH *after)
+{
+  size_t i = srsWatch_LowerBound(wd, after);
+  if ((after != NULL) && (i < srsWatch_DIR_COUNT) && (srsWatch_DIRS[i].wd == wd) && (srsWatch_DIRS[i].watch == after))
+  {
+    i++;
+  }
+  return ((i < srsWatch_DIR_COUNT) && (srsWatch_DIRS[i].wd == wd)) ? i : srsWatch_DIR_COUNT;
+}
+
+/* Forgets a directory, and stops watching it unless another watcher still needs it or it is already gone */
+static void srsWatch_RemoveDirAt(size_t i, bool unwatch)
+{
+  int wd = srsWatch_DIRS[i].wd;
+  srsWatch_DIRS[i].watch->dir_count--;
+  free(srsWatch_DIRS[i].path);
+  memmove(&srsWatch_DIRS[i], &srsWatch_DIRS[i + 1], (srsWatch_DIR_COUNT - i - 1) * sizeof(*srsWatch_DIRS));
+  srsWatch_DIR_COUNT--;
+  if (unwatch && (srsWatch_FindNext(wd, NULL) == srsWatch_DIR_COUNT))
+  {
+    inotify_rm_watch(srsWatch_THREAD->fd, wd);
+  }
+}
+
+/* Records a watch descriptor. Adding a directory that is already watched returns its existing descriptor, so the path is just replaced. */
+static bool srsWatch_TrackDir(srsWATCH *watch, int wd, const char *rel)
+{
+  char *path = strdup(rel);
+  if (path == NULL)
+  {
+    return false;
+  }
+  size_t i = srsWatch_LowerBound(wd, watch);
+  if ((i < srsWatch_DIR_COUNT) && (srsWatch_DIRS[i].wd == wd) && (srsWatch_DIRS[i].watch == watch))
+  {
+    free(srsWatch_DIRS[i].path);
+    srsWatch_DIRS[i].path = path;
+    return true;
+  }
+  if (srsWatch_DIR_COUNT == srsWatch_DIR_CAPACITY)
+  {
+    size_t capacity = (srsWatch_DIR_CAPACITY == 0) ? 64 : srsWatch_DIR_CAPACITY * 2;
+    srsWATCH_DIR *dirs = realloc(srsWatch_DIRS, capacity * sizeof(*dirs));
+    if (dirs == NULL)
+    {
+      free(path);
+      return false;
+    }
+    srsWatch_DIRS = dirs;
+    srsWatch_DIR_CAPACITY = capacity;
+  }
+  memmove(&srsWatch_DIRS[i + 1], &srsWatch_DIRS[i], (srsWatch_DIR_COUNT - i) * sizeof(*srsWatch_DIRS));
+  srsWatch_DIRS[i].wd = wd;
+  srsWatch_DIRS[i].watch = watch;
+  srsWatch_DIRS[i].path = path;
+  srsWatch_DIR_COUNT++;
+  watch->dir_count++;
+  return true;
+}
+
+/* Watches a directory and everything beneath it, optionally reporting what it already contains */
+static bool srsWatch_AddDir(srsWATCH *watch, const char *rel, bool report)
+{
+  char fullpath[srsPATH_MAX + 1];
+  if (!srsWatch_JoinPath(fullpath, sizeof(fullpath), watch->path, rel, NULL))
+  {
+    srsLOG_ERROR("Path is too long to watch [%s/%s]", watch->path, rel);
+    return false;
+  }
+  int wd = inotify_add_watch(srsWatch_THREAD->fd, fullpath, srsWATCH_INOTIFY_MASK);
+  if (wd < 0)
+  {
+    /* The directory may already be gone again, in which case its deletion has been queued too */
+    if (errno != ENOENT && errno != ENOTDIR)
+    {
+      srsLOG_ERROR("Failed to watch [%s] (%s)", fullpath, strerror(errno));
+    }
+    return false;
+  }
+  if (!srsWatch_TrackDir(watch, wd, rel))
+  {
+    if (srsWatch_FindNext(wd, NULL) == srsWatch_DIR_COUNT)
+    {
+      inotify_rm_watch(srsWatch_THREAD->fd, wd);
+    }
+    return false;
+  }
+  DIR *dir = opendir(fullpath);
+  if (dir == NULL)
+  {
+    return true;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0))
+    {
+      continue;
+    }
+    char childrel[srsPATH_MAX + 1];
+    int needed = (rel[0] == kiokuCHAR_NULL) ? snprintf(childrel, sizeof(childrel), "%s", entry->d_name) : snprintf(childrel, sizeof(childrel), "%s/%s", rel, entry->d_name);
+    if ((needed <= 0) || ((size_t)needed >= sizeof(childrel)))
+    {
+      continue;
+    }
+    bool is_dir = (entry->d_type == DT_DIR);
+    if (entry->d_type == DT_UNKNOWN)
+    {
+      struct stat st;
+      is_dir = (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0) && S_ISDIR(st.st_mode);
+    }
+    if (report)
+    {
+      srsWatch_Report(watch, srsWATCH_CREATED, childrel, is_dir);
+    }
+    if (is_dir)
+    {
+      srsWatch_AddDir(watch, childrel, report);
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+/* Stops watching a directory that moved out of or within a watcher's tree, along with everything beneath it. Passing NULL drops the whole tree. */
+static void srsWatch_RemoveDirs(srsWATCH *watch, const char *rel)
+{
+  size_t len = (rel == NULL) ? 0 : strlen(rel);
+  size_t i = 0;
+  while ((i < srsWatch_DIR_COUNT) && (watch->dir_count > 0))
+  {
+    const char *path = srsWatch_DIRS[i].path;
+    if ((srsWatch_DIRS[i].watch == watch) && ((rel == NULL) || ((strncmp(path, rel, len) == 0) && ((path[len] == kiokuCHAR_NULL) || (path[len] == '/')))))
+    {
+      srsWatch_RemoveDirAt(i, true);
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+/* Passes an event on to one of the watchers of the directory it happened in */
+static void srsWatch_DispatchTo(srsWATCH *watch, const char *dirpath, const struct inotify_event *event)
+{
+  bool is_dir = (event->mask & IN_ISDIR) != 0;
+  char rel[srsPATH_MAX + 1];
+  int needed = (dirpath[0] == kiokuCHAR_NULL) ? snprintf(rel, sizeof(rel), "%s", event->name) : snprintf(rel, sizeof(rel), "%s/%s", dirpath, event->name);
+  if ((needed <= 0) || ((size_t)needed >= sizeof(rel)))
+  {
+    return;
+  }
+  if (event->mask & (IN_CREATE | IN_MOVED_TO))
+  {
+    srsWatch_Report(watch, srsWATCH_CREATED, rel, is_dir);
+    if (is_dir)
+    {
+      srsWatch_AddDir(watch, rel, true);
+    }
+  }
+  else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+  {
+    if (is_dir)
+    {
+      srsWatch_RemoveDirs(watch, rel);
+    }
+    srsWatch_Report(watch, srsWATCH_DELETED, rel, is_dir);
+  }
+  else if (event->mask & (IN_MODIFY | IN_CLOSE_WRITE))
+  {
+    srsWatch_Report(watch, srsWATCH_MODIFIED, rel, is_dir);
+  }
+}
+
+/* The caller holds the lock */
+static void srsWatch_Dispatch(const char *buffer, size_t size)
+{
+  /* Each write to a file raises its own modification event, so skip repeats of the one just reported */
+  int last_wd = -1;
+  const char *last_name = NULL;
+  for (size_t offset = 0; offset + sizeof(struct inotify_event) <= size; )
+  {
+    const struct inotify_event *event = (const struct inotify_event *)(buffer + offset);
+    offset += sizeof(struct inotify_event) + event->len;
+    if (event->mask & IN_Q_OVERFLOW)
+    {
+      last_wd = -1;
+      for (srsWATCH *watch = srsWatch_LIST; watch != NULL; watch = watch->next)
+      {
+        srsWatch_Report(watch, srsWATCH_RESCAN, "", true);
+      }
+      continue;
+    }
+    size_t i = srsWatch_FindNext(event->wd, NULL);
+    if (i == srsWatch_DIR_COUNT)
+    {
+      continue;
+    }
+    if (event->mask & IN_IGNORED)
+    {
+      /* The directory was deleted, or removed from every watch above */
+      while ((i = srsWatch_FindNext(event->wd, NULL)) != srsWatch_DIR_COUNT)
+      {
+        srsWatch_RemoveDirAt(i, false);
+      }
+      last_wd = -1;
+      continue;
+    }
+    if ((event->len == 0) || (event->name[0] == kiokuCHAR_NULL))
+    {
+      continue;
+    }
+    if (event->mask & (IN_MODIFY | IN_CLOSE_WRITE))
+    {
+      if ((last_wd == event->wd) && (strcmp(last_name, event->name) == 0))
+      {
+        continue;
+      }
+      last_wd = event->wd;
+      last_name = event->name;
+    }
+    else
+    {
+      last_wd = -1;
+    }
+    /* Reporting may add or remove directories, so find the next watcher afresh each time */
+    char dirpath[srsPATH_MAX + 1];
+    for (srsWATCH *watch = NULL; (i = srsWatch_FindNext(event->wd, watch)) != srsWatch_DIR_COUNT;)
+    {
+      watch = srsWatch_DIRS[i].watch;
+      snprintf(dirpath, sizeof(dirpath), "%s", srsWatch_DIRS[i].path);
+      srsWatch_DispatchTo(watch, dirpath, event);
+    }
+  }
+}
+
+static void *srsWatch_Run(void *arg)
+{
+  srsWATCH_THREAD *thread = arg;
+  /* Large enough for many events per read, aligned for struct inotify_event */
+  union
+  {
+    struct inotify_event event;
+    char bytes[16 * 1024];
+  } buffer;
+  struct pollfd fds[2];
+  fds[0].fd = thread->fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = thread->wake[0];
+  fds[1].events = POLLIN;
+  for (;;)
+  {
+    fds[0].revents = 0;
+    fds[1].revents = 0;
+    if (poll(fds, 2, -1) < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      srsLOG_ERROR("Failed to wait for changes (%s)", strerror(errno));
+      break;
+    }
+    if (fds[1].revents != 0)
+    {
+      break;
+    }
+    if (fds[0].revents & POLLIN)
+    {
+      ssize_t got = read(thread->fd, buffer.bytes, sizeof(buffer.bytes));
+      if (got < 0)
+      {
+        if ((errno == EAGAIN) || (errno == EINTR))
+        {
+          continue;
+        }
+        srsLOG_ERROR("Failed to read changes (%s)", strerror(errno));
+        break;
+      }
+      srsMutex_Lock(&srsWatch_LOCK);
+      /* Once the last watcher has closed, the table may already belong to the instance of a newer thread */
+      if (srsWatch_THREAD == thread)
+      {
+        srsWatch_Dispatch(buffer.bytes, (size_t)got);
+      }
+      srsMutex_Unlock(&srsWatch_LOCK);
+    }
+  }
+  return NULL;
+}
+
+static void srsWatch_FreeThread(srsWATCH_THREAD *thread)
+{
+  if (thread->fd >= 0)
+  {
+    close(thread->fd);
+  }
+  if (thread->wake[0] >= 0)
+  {
+    close(thread->wake[0]);
+    close(thread->wake[1]);
+  }
+  free(thread);
+}
+
+/* Starts the shared thread for the first watcher. The caller holds the lock. */
+static bool srsWatch_Start()
+{
+  srsWATCH_THREAD *thread = calloc(1, sizeof(*thread));
+  if (thread == NULL)
+  {
+    return false;
+  }
+  thread->wake[0] = -1;
+  thread->wake[1] = -1;
+  thread->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (thread->fd < 0)
+  {
+    srsLOG_ERROR("Failed to initialize inotify (%s)", strerror(errno));
+    goto fail;
+  }
+  if (pipe(thread->wake) != 0)
+  {
+    thread->wake[0] = -1;
+    thread->wake[1] = -1;
+    goto fail;
+  }
+  if (!srsThread_Create(&thread->thread, srsWatch_Run, thread))
+  {
+    goto fail;
+  }
+  srsWatch_THREAD = thread;
+  return true;
+fail:
+  srsWatch_FreeThread(thread);
+  return false;
+}
+
+/* Detaches the shared thread once no watcher is left, returning it to be stopped after the lock is released. The caller holds the lock. */
+static srsWATCH_THREAD *srsWatch_Detach()
+{
+  srsWATCH_THREAD *thread = NULL;
+  if ((srsWatch_LIST == NULL) && (srsWatch_THREAD != NULL))
+  {
+    thread = srsWatch_THREAD;
+    srsWatch_THREAD = NULL;
+    free(srsWatch_DIRS);
+    srsWatch_DIRS = NULL;
+    srsWatch_DIR_COUNT = 0;
+    srsWatch_DIR_CAPACITY = 0;
+  }
+  return thread;
+}
+
+/* Stops a detached thread. It may be waiting for the lock, so this must not be called with it held. */
+static void srsWatch_Stop(srsWATCH_THREAD *thread)
+{
+  if (thread == NULL)
+  {
+    return;
+  }
+  char stop = 0;
+  while ((write(thread->wake[1], &stop, 1) < 0) && (errno == EINTR))
+  {
+  }
+  srsThread_Join(thread->thread, NULL);
+  srsWatch_FreeThread(thread);
+}
+#endif
+
+srsWATCH *srsWatch_Open(const char *path, srsWATCH_FUNC func, void *userdata)
+{
+  if ((path == NULL) || (func == NULL))
+  {
+    return NULL;
+  }
+#ifdef srsWATCH_INOTIFY
+  if (!srsWatch_Init())
+  {
+    return NULL;
+  }
+  srsWATCH *watch = calloc(1, sizeof(*watch));
+  if (watch == NULL)
+  {
+    return NULL;
+  }
+  watch->func = func;
+  watch->userdata = userdata;
+  watch->path = strdup(path);
+  if (watch->path == NULL)
+  {
+    free(watch);
+    return NULL;
+  }
+  srsMutex_Lock(&srsWatch_LOCK);
+  /* Existing entries are not reported - the caller reads the tree as it is now */
+  bool ok = ((srsWatch_THREAD != NULL) || srsWatch_Start()) && srsWatch_AddDir(watch, "", false);
+  srsWATCH_THREAD *stopped = NULL;
+  if (ok)
+  {
+    watch->next = srsWatch_LIST;
+    srsWatch_LIST = watch;
+  }
+  else
+  {
+    if (srsWatch_THREAD != NULL)
+    {
+      srsWatch_RemoveDirs(watch, NULL);
+    }
+    stopped = srsWatch_Detach();
+  }
+  srsMutex_Unlock(&srsWatch_LOCK);
+  if (!ok)
+  {
+    srsWatch_Stop(stopped);
+    free(watch->path);
+    free(watch);
+    return NULL;
+  }
+  /* Let the filesystem module trust what it caches about the tree, now that every change will be reported */
+  watch->cached = srsFileSystem_SetWatched(watch->path, true);
+  srsLOG_PRINT("Watching [%s] (%zu directories)", watch->path, watch->dir_count);
+  return watch;
+#else
+  srsLOG_PRINT("Watching [%s] is not supported on this platform", path);
+  return NULL;
+#endif
+}
+
+void srsWatch_Close(srsWATCH *watch)
+{
+  if (watch == NULL)
+  {
+    return;
+  }
+#ifdef srsWATCH_INOTIFY
+  if (watch->cached)
+  {
+    srsFileSystem_SetWatched(watch->path, false);
+  }
+  srsMutex_Lock(&srsWatch_LOCK);
+  for (srsWATCH **link = &srsWatch_LIST; *link != NULL; link = &(*link)->next)
+  {
+    if (*link == watch)
+    {
+      *link = watch->next;
+      break;
+    }
+  }
+  srsWatch_RemoveDirs(watch, NULL);
+  srsWATCH_THREAD *stopped = srsWatch_Detach();
+  srsMutex_Unlock(&srsWatch_LOCK);
+  srsWatch_Stop(stopped);
+#endif
+  free(watch->path);
+  free(watch);
+}
+
+const char *srsWatch_GetPath(const srsWATCH *watch)
+{
+  return (watch == NULL) ? NULL : watch->path;
+}
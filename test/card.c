@@ -1,6 +1,8 @@
 #include "greatest.h"
 #include "kioku/model/card.h"
 #include "kioku/filesystem.h"
+#include "kioku/snapshot.h"
+#include "kioku/model.h"
 #include "kioku/log.h"
 #include "kioku/error.h"
 #include <stdlib.h>
@@ -168,9 +170,151 @@ TEST test_card(void)
 
   PASS();
 }
+/* Runs after test_card, reusing its root and cards */
+TEST test_card_cursor(void)
+{
+  srsCARD_FILTER filter = {0};
+  srsCARD card = {0};
+  srsCARD_CURSOR *cursor = NULL;
+  size_t count = 0;
+  srsTIME now = srsTime_Now();
+
+  /* Bad input */
+  ASSERT_EQ(NULL, srsCardCursor_Open(NULL, NULL));
+  ASSERT_EQ(NULL, srsCardCursor_Open("..", NULL));
+  ASSERT_EQ(NULL, srsCardCursor_Open("missing-deck-path", NULL));
+  ASSERT_FALSE(srsCardCursor_Next(NULL, &card));
+  ASSERT_FALSE(srsCardCursor_HasFailed(NULL));
+  srsCardCursor_Close(NULL);
+
+  /* No filter yields every card exactly once */
+  cursor = srsCardCursor_Open(".", NULL);
+  ASSERT(cursor != NULL);
+  char seen[4] = {0};
+  while (srsCardCursor_Next(cursor, &card))
+  {
+    ASSERT(strncmp(card.id, "id_", 3) == 0);
+    ASSERT(strstr(card.path, card.id) != NULL);
+    ASSERT_EQ(0, seen[card.id[3] - '0']++);
+    count++;
+  }
+  ASSERT_FALSE(srsCardCursor_HasFailed(cursor));
+  srsCardCursor_Close(cursor);
+  ASSERT_EQ(4, count);
+
+  /* Limits */
+  filter.limit = 3;
+  count = 0;
+  cursor = srsCardCursor_Open(".", &filter);
+  ASSERT(cursor != NULL);
+  while (srsCardCursor_Next(cursor, &card))
+  {
+    count++;
+  }
+  srsCardCursor_Close(cursor);
+  ASSERT_EQ(3, count);
+
+  /* Every card was added and scheduled before now */
+  filter.limit = 0;
+  filter.added_after = now;
+  cursor = srsCardCursor_Open(".", &filter);
+  ASSERT(cursor != NULL);
+  ASSERT_FALSE(srsCardCursor_Next(cursor, &card));
+  srsCardCursor_Close(cursor);
+
+  memset(&filter, 0, sizeof(filter));
+  filter.due_before = now;
+  filter.due_before.year += 1;
+  count = 0;
+  cursor = srsCardCursor_Open(".", &filter);
+  ASSERT(cursor != NULL);
+  while (srsCardCursor_Next(cursor, &card))
+  {
+    count++;
+  }
+  srsCardCursor_Close(cursor);
+  ASSERT_EQ(4, count);
+
+  filter.due_before.year -= 2;
+  cursor = srsCardCursor_Open(".", &filter);
+  ASSERT(cursor != NULL);
+  ASSERT_FALSE(srsCardCursor_Next(cursor, &card));
+  srsCardCursor_Close(cursor);
+
+  PASS();
+}
+
+/* Runs after test_card, reusing its root and cards */
+TEST test_card_snapshot(void)
+{
+  size_t index = 0;
+  srsTIME none = {0};
+  ASSERT_EQ(NULL, srsSnapshot_Open(NULL));
+  ASSERT_EQ(NULL, srsSnapshot_Open("missing-deck-path"));
+  ASSERT_EQ(0, srsSnapshot_GetCount(NULL));
+  ASSERT_EQ(NULL, srsSnapshot_GetID(NULL, 0));
+  srsSnapshot_Close(NULL);
+
+  /* Built on first use, then loaded from disk */
+  for (int pass = 0; pass < 2; pass++)
+  {
+    srsSNAPSHOT *snapshot = srsSnapshot_Open(".");
+    ASSERT(snapshot != NULL);
+    ASSERT(srsDir_ExistsAt(srsModel_GetRootDir(), srsSNAPSHOT_DIRNAME));
+    ASSERT_EQ(4, srsSnapshot_GetCount(snapshot));
+    ASSERT_STR_EQ("id_0", srsSnapshot_GetID(snapshot, 0));
+    ASSERT_STR_EQ("id_3", srsSnapshot_GetID(snapshot, 3));
+    ASSERT_EQ(NULL, srsSnapshot_GetID(snapshot, 4));
+    ASSERT(srsSnapshot_Find(snapshot, "id_2", &index));
+    ASSERT_EQ(2, index);
+    ASSERT_FALSE(srsSnapshot_Find(snapshot, "id_9", &index));
+    srsTIME added = srsSnapshot_GetAdded(snapshot, 1);
+    srsTIME due = srsSnapshot_GetDue(snapshot, 1);
+    ASSERT(srsTime_Compare(added, none) > 0);
+    ASSERT(srsTime_Compare(due, none) > 0);
+    ASSERT(strstr(srsSnapshot_GetCardsPath(snapshot), "cards") != NULL);
+    srsSnapshot_Close(snapshot);
+  }
+
+  /* A changed card is picked up by a refresh */
+  srsTIME later = srsTime_Now();
+  srsTIME_STRING later_string = {0};
+  later.year += 10;
+  ASSERT(srsTime_ToString(later, later_string));
+  srsDIR *cards_dir = srsDir_OpenAt(srsModel_GetRootDir(), "cards");
+  ASSERT(cards_dir != NULL);
+  ASSERT(srsFile_SetContentAt(cards_dir, "id_1/scheduled.txt", (const char *)later_string));
+  srsDir_Close(cards_dir);
+  srsSNAPSHOT *snapshot = srsSnapshot_Refresh(".");
+  ASSERT(snapshot != NULL);
+  ASSERT(srsSnapshot_Find(snapshot, "id_1", &index));
+  ASSERT_EQ(0, srsTime_Compare(later, srsSnapshot_GetDue(snapshot, index)));
+  ASSERT_EQ(srsTime_Pack(later), srsSnapshot_GetDueTimes(snapshot)[index]);
+  ASSERT(srsSnapshot_GetAddedTimes(snapshot)[index] < srsSnapshot_GetDueTimes(snapshot)[index]);
+  srsSnapshot_Close(snapshot);
+
+  /* Without an explicit schedule the next card is the one due soonest, which is no longer id_1 */
+  char card_id[srsMODEL_CARD_ID_MAX] = {0};
+  ASSERT(srsModel_Card_GetNextID(srsModel_GetRoot(), card_id, sizeof(card_id)));
+  ASSERT(strcmp("id_1", card_id) != 0);
+
+  /* Rescheduling a card moves it within the due queue */
+  srsTIME earliest = {.year=2000, .month=1, .day=1, .hour=0, .minute=0};
+  ASSERT(srsModel_Card_SetDue(".", "id_1", earliest));
+  ASSERT(srsModel_Card_GetNextID(".", card_id, sizeof(card_id)));
+  ASSERT_STR_EQ("id_1", card_id);
+  ASSERT(srsModel_Card_SetDue(".", "id_1", later));
+  ASSERT(srsModel_Card_GetNextID(".", card_id, sizeof(card_id)));
+  ASSERT(strcmp("id_1", card_id) != 0);
+  ASSERT_FALSE(srsModel_Card_SetDue(".", "id_9", earliest));
+  PASS();
+}
+
 /* Suites can group multiple tests with common setup. */
 SUITE(the_suite) {
   RUN_TEST(test_card);
+  RUN_TEST(test_card_cursor);
+  RUN_TEST(test_card_snapshot);
 }
 
 /* Add definitions that need to be in the test runner's main file. */
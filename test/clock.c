@@ -0,0 +1,92 @@
+#include "greatest.h"
+#include "kioku/clock.h"
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+static void set_time_zone(const char *zone)
+{
+#ifdef _WIN32
+  _putenv_s("TZ", zone);
+#else
+  setenv("TZ", zone, 1);
+#endif
+  srsClock_Refresh();
+}
+
+TEST PackingMatchesCalendar(void)
+{
+  srsTIME epoch = {.year=1970, .month=1, .day=1, .hour=0, .minute=0};
+  srsTIME later = {.year=2018, .month=3, .day=25, .hour=1, .minute=30};
+  srsTIME last = {.year=9999, .month=12, .day=31, .hour=23, .minute=59};
+  ASSERT_EQ(srsTime_Pack(epoch), srsClock_Pack(0, 0));
+  ASSERT_EQ(srsTime_Pack(epoch), srsClock_Pack(59, 0));
+  ASSERT_EQ(srsTime_Pack(epoch) - 1, srsClock_Pack(-1, 0));
+  /* 2018-03-25 01:30 UTC, seen from an hour and from five and three quarter hours ahead */
+  ASSERT_EQ(srsTime_Pack(later), srsClock_Pack(1521941400, 0));
+  later.hour = 2;
+  ASSERT_EQ(srsTime_Pack(later), srsClock_Pack(1521941400, 60));
+  later.hour = 7;
+  later.minute = 15;
+  ASSERT_EQ(srsTime_Pack(later), srsClock_Pack(1521941400, 345));
+  /* The last packable minute, and the ones past either end */
+  ASSERT_EQ(srsTime_Pack(last), srsClock_Pack(253402300740, 0));
+  ASSERT_EQ(srsTIME_PACKED_NONE, srsClock_Pack(253402300800, 0));
+  ASSERT_EQ(srsTIME_PACKED_NONE, srsClock_Pack(-2208988801, 0));
+  PASS();
+}
+
+TEST OffsetFollowsTimeZone(void)
+{
+  srsCLOCK_SNAPSHOT snapshot;
+  set_time_zone("UTC0");
+  ASSERT_EQ(0, srsClock_GetUTCOffset());
+  /* POSIX time zones count west of UTC as positive */
+  set_time_zone("XYZ-5:45");
+  ASSERT_EQ(345, srsClock_GetUTCOffset());
+  set_time_zone("XYZ+3:30");
+  ASSERT_EQ(-210, srsClock_GetUTCOffset());
+
+  /* Every form of a snapshot tells the same time */
+  snapshot = srsClock_Capture();
+  ASSERT_EQ(-210, snapshot.utc_offset);
+  ASSERT_EQ(srsClock_Pack(snapshot.utc, -210), snapshot.packed);
+  ASSERT_EQ(snapshot.packed, srsTime_Pack(snapshot.time));
+  ASSERT((srsClock_Now() - snapshot.packed) <= 1);
+  ASSERT((srsTime_Pack(srsTime_Now()) - snapshot.packed) <= 1);
+  set_time_zone("UTC0");
+  PASS();
+}
+
+TEST NowMatchesLocalTime(void)
+{
+  srsTIME expected;
+  struct tm *local = NULL;
+  time_t now = time(NULL);
+  srsClock_Refresh();
+  local = localtime(&now);
+  ASSERT(local != NULL);
+  expected.year = (uint16_t)(local->tm_year + 1900);
+  expected.month = (uint8_t)(local->tm_mon + 1);
+  expected.day = (uint8_t)local->tm_mday;
+  expected.hour = (uint8_t)local->tm_hour;
+  expected.minute = (uint8_t)local->tm_min;
+  /* Allow for the minute turning over between the two */
+  ASSERT((srsClock_Now() - srsTime_Pack(expected)) <= 1);
+  PASS();
+}
+
+SUITE(test_clock) {
+  RUN_TEST(PackingMatchesCalendar);
+  RUN_TEST(OffsetFollowsTimeZone);
+  RUN_TEST(NowMatchesLocalTime);
+}
+
+/* Add definitions that need to be in the test runner's main file. */
+GREATEST_MAIN_DEFS();
+int main(int argc, char **argv)
+{
+  GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
+  RUN_SUITE(test_clock);
+  GREATEST_MAIN_END();        /* display results */
+}
@@ -1,6 +1,9 @@
 #include "greatest.h"
 #include "kioku/log.h"
 #include "kioku/datastructure.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* A test runs various assertions, then calls PASS(), FAIL(), or SKIP(). */
 TEST TestMemStack_InitAndFree(void)
@@ -207,12 +210,552 @@ TEST TestMemStack_Push4Pop4WorksAndIncreasesCapacity(void)
   PASS();
 }
 
+TEST TestArena_AllocAndReset(void)
+{
+  srsARENA arena = {0};
+  size_t i = 0;
+  /* Test bad input */
+  ASSERT_FALSE(srsArena_Init(NULL, 0));
+  ASSERT_EQ(NULL, srsArena_Alloc(NULL, 1));
+  ASSERT_EQ(NULL, srsArena_Alloc(&arena, 1));
+  ASSERT_EQ(NULL, srsArena_StrDup(&arena, NULL));
+  ASSERT_FALSE(srsArena_Owns(NULL, &arena));
+  srsArena_Free(NULL);
+
+  /* Nothing is allocated up front */
+  ASSERT(srsArena_Init(&arena, 64));
+  ASSERT_EQ(NULL, arena.chunk);
+  srsARENA_MARK empty = srsArena_GetMark(&arena);
+
+  /* Allocations are aligned, distinct and owned */
+  char *first = srsArena_Alloc(&arena, 3);
+  char *second = srsArena_Alloc(&arena, 0);
+  ASSERT(first != NULL);
+  ASSERT(second != NULL);
+  ASSERT(first != second);
+  ASSERT_EQ(0, ((uintptr_t)first) % srsARENA_ALIGNMENT);
+  ASSERT_EQ(0, ((uintptr_t)second) % srsARENA_ALIGNMENT);
+  ASSERT(srsArena_Owns(&arena, first));
+  ASSERT_FALSE(srsArena_Owns(&arena, &arena));
+  char *copy = srsArena_StrDup(&arena, "kioku");
+  ASSERT_STR_EQ("kioku", copy);
+  uint32_t *zeroed = srsArena_Calloc(&arena, 4, sizeof(*zeroed));
+  ASSERT(zeroed != NULL);
+  for (i = 0; i < 4; i++)
+  {
+    ASSERT_EQ(0, zeroed[i]);
+  }
+  ASSERT_EQ(NULL, srsArena_Calloc(&arena, SIZE_MAX, 2));
+
+  /* Growing the last allocation happens in place while it fits, and moves with its contents once it does not */
+  srsARENA_MARK before_grow = srsArena_GetMark(&arena);
+  char *grown = srsArena_Alloc(&arena, 4);
+  memcpy(grown, "abc", 4);
+  ASSERT_EQ(grown, srsArena_Realloc(&arena, grown, 4, 8));
+  char *moved = srsArena_Realloc(&arena, grown, 8, 4096);
+  ASSERT(moved != NULL);
+  ASSERT_STR_EQ("abc", moved);
+  ASSERT(srsArena_Owns(&arena, moved));
+
+  /* Oversized allocations still work, in chunks of their own */
+  uint8_t *big = srsArena_Alloc(&arena, 100000);
+  ASSERT(big != NULL);
+  memset(big, 0xAB, 100000);
+
+  /* Resetting to a mark releases what came after it but keeps what came before */
+  srsArena_Reset(&arena, before_grow);
+  ASSERT_FALSE(srsArena_Owns(&arena, big));
+  ASSERT(srsArena_Owns(&arena, copy));
+  ASSERT_STR_EQ("kioku", copy);
+
+  /* Resetting to empty keeps a chunk to reuse */
+  srsArena_Reset(&arena, empty);
+  ASSERT_EQ(NULL, arena.chunk);
+  ASSERT(arena.spare != NULL);
+  ASSERT_FALSE(srsArena_Owns(&arena, first));
+  srsARENA_CHUNK *spare = arena.spare;
+  ASSERT(srsArena_Alloc(&arena, 16) != NULL);
+  ASSERT_EQ(spare, arena.chunk);
+
+  srsArena_Free(&arena);
+  srsARENA zeroed_arena = {0};
+  ASSERT_EQ(0, memcmp(&arena, &zeroed_arena, sizeof(zeroed_arena)));
+  PASS();
+}
+
+TEST TestArena_ManySmallAllocations(void)
+{
+  srsARENA arena = {0};
+  size_t i = 0;
+  char *strings[1000] = {0};
+  char expected[16] = {0};
+  ASSERT(srsArena_Init(&arena, 256));
+  for (i = 0; i < 1000; i++)
+  {
+    snprintf(expected, sizeof(expected), "card-%zu", i);
+    strings[i] = srsArena_StrDup(&arena, expected);
+    ASSERT(strings[i] != NULL);
+  }
+  for (i = 0; i < 1000; i++)
+  {
+    snprintf(expected, sizeof(expected), "card-%zu", i);
+    ASSERT_STR_EQ(expected, strings[i]);
+  }
+  ASSERT(srsArena_Owns(&arena, strings[0]));
+  ASSERT(srsArena_Owns(&arena, strings[999]));
+  srsArena_Free(&arena);
+  ASSERT_FALSE(srsArena_Owns(&arena, strings[0]));
+  PASS();
+}
+
 /* Suites can group multiple tests with common setup. */
+srsVECTOR_DEFINE(TEST_INT_STACK, TestIntStack, int32_t, 4)
+srsVECTOR_DEFINE(TEST_INT_LIST, TestIntList, int32_t, 0)
+
+TEST TestVector_GrowsOutOfInlineStorageAndBack(void)
+{
+  TEST_INT_STACK stack = {0};
+  int32_t value = 0;
+  int32_t i;
+  ASSERT_EQ(NULL, TestIntStack_Top(&stack));
+  ASSERT_FALSE(TestIntStack_Pop(&stack, &value));
+
+  /* The first elements stay inline */
+  for (i = 0; i < 4; i++)
+  {
+    ASSERT(TestIntStack_Push(&stack, i));
+  }
+  ASSERT_EQ(stack.inline_data, stack.data);
+  ASSERT_EQ_FMT((size_t)4, stack.capacity, "%zu");
+  ASSERT(TestIntStack_Push(&stack, 4));
+  ASSERT(stack.data != stack.inline_data);
+  ASSERT_EQ_FMT((size_t)srsVECTOR_MINIMUM_CAPACITY, stack.capacity, "%zu");
+  for (i = 5; i < 1000; i++)
+  {
+    ASSERT(TestIntStack_Push(&stack, i));
+  }
+  ASSERT_EQ(999, *TestIntStack_Top(&stack));
+  size_t grown = stack.capacity;
+
+  /* Popping back and forth across a power of two does not shrink it */
+  for (i = 0; i < 100; i++)
+  {
+    ASSERT(TestIntStack_Pop(&stack, NULL));
+    ASSERT(TestIntStack_Push(&stack, 999));
+  }
+  ASSERT_EQ_FMT(grown, stack.capacity, "%zu");
+
+  /* Popping most of it does, keeping the elements left */
+  for (i = 999; i >= 2; i--)
+  {
+    ASSERT(TestIntStack_Pop(&stack, &value));
+    ASSERT_EQ(i, value);
+  }
+  ASSERT(stack.capacity < grown);
+  ASSERT_EQ(1, *TestIntStack_Top(&stack));
+  ASSERT_EQ(0, stack.data[0]);
+  TestIntStack_Free(&stack);
+  ASSERT_EQ_FMT((size_t)0, stack.count, "%zu");
+  ASSERT_EQ(NULL, stack.data);
+  PASS();
+}
+
+TEST TestVector_ReserveAndBulkPush(void)
+{
+  TEST_INT_LIST list = {0};
+  int32_t values[6] = {5, 4, 3, 2, 1, 0};
+  int32_t *extended = NULL;
+  size_t count = 0;
+  ASSERT(TestIntList_Reserve(&list, 100));
+  ASSERT_EQ_FMT((size_t)100, list.capacity, "%zu");
+  int32_t *reserved = list.data;
+  ASSERT(TestIntList_PushN(&list, values, 6));
+  ASSERT(TestIntList_PushN(&list, values, 0));
+  extended = TestIntList_Extend(&list, 94);
+  ASSERT(extended != NULL);
+  ASSERT_EQ(list.data + 6, extended);
+  extended[93] = 42;
+  /* Nothing so far needed more room than was reserved */
+  ASSERT_EQ(reserved, list.data);
+  ASSERT_EQ_FMT((size_t)100, list.count, "%zu");
+  ASSERT_EQ(42, *TestIntList_Top(&list));
+  ASSERT_MEM_EQ(values, list.data, sizeof(values));
+
+  TestIntList_Clear(&list);
+  ASSERT_EQ_FMT((size_t)0, list.count, "%zu");
+  ASSERT_EQ_FMT((size_t)100, list.capacity, "%zu");
+  ASSERT_EQ(NULL, TestIntList_Detach(&list, &count));
+  ASSERT_EQ_FMT((size_t)0, count, "%zu");
+
+  /* Detaching hands over the elements and leaves it empty */
+  ASSERT(TestIntList_PushN(&list, values, 6));
+  int32_t *detached = TestIntList_Detach(&list, &count);
+  ASSERT_EQ_FMT((size_t)6, count, "%zu");
+  ASSERT_MEM_EQ(values, detached, sizeof(values));
+  ASSERT_EQ_FMT((size_t)0, list.capacity, "%zu");
+  free(detached);
+  PASS();
+}
+
+TEST TestHashMap_SetGetRemove(void)
+{
+  srsHASHMAP map;
+  void *value = NULL;
+  char key[16];
+  ASSERT_FALSE(srsHashMap_Init(NULL, 0));
+  ASSERT(srsHashMap_Init(&map, 0));
+  ASSERT_FALSE(srsHashMap_Set(&map, NULL, NULL));
+  ASSERT_FALSE(srsHashMap_Get(&map, "a", &value));
+  ASSERT_FALSE(srsHashMap_Remove(&map, "a"));
+
+  ASSERT(srsHashMap_Set(&map, "a", &map));
+  ASSERT(srsHashMap_Set(&map, "b", NULL));
+  ASSERT(srsHashMap_Get(&map, "a", &value));
+  ASSERT_EQ(&map, value);
+  ASSERT(srsHashMap_Get(&map, "b", &value));
+  ASSERT_EQ(NULL, value);
+  ASSERT(srsHashMap_Set(&map, "a", NULL));
+  ASSERT(srsHashMap_Get(&map, "a", &value));
+  ASSERT_EQ(NULL, value);
+  ASSERT_EQ_FMT((size_t)2, srsHashMap_GetCount(&map), "%zu");
+
+  /* Interned keys are shared by equal strings and outlive their entry */
+  strcpy(key, "a");
+  const char *interned = srsHashMap_Intern(&map, key);
+  ASSERT(interned != key);
+  ASSERT_EQ(interned, srsHashMap_Intern(&map, "a"));
+  ASSERT(srsHashMap_Remove(&map, "a"));
+  ASSERT_FALSE(srsHashMap_Remove(&map, "a"));
+  ASSERT_FALSE(srsHashMap_Get(&map, "a", NULL));
+  ASSERT_STR_EQ("a", interned);
+  ASSERT_EQ_FMT((size_t)1, srsHashMap_GetCount(&map), "%zu");
+  srsHashMap_Free(&map);
+  ASSERT_EQ_FMT((size_t)0, srsHashMap_GetCount(&map), "%zu");
+  PASS();
+}
+
+TEST TestHashMap_GrowsWhileChanging(void)
+{
+  srsHASHMAP map;
+  char key[16];
+  void *value = NULL;
+  size_t i;
+  ASSERT(srsHashMap_Init(&map, 0));
+  /* Enough to grow many times over, removing every third key along the way, including while the old table is being moved out of */
+  for (i = 0; i < 20000; i++)
+  {
+    snprintf(key, sizeof(key), "card-%zu", i);
+    ASSERT(srsHashMap_Set(&map, key, (void *)(uintptr_t)(i + 1)));
+    if ((i % 3) == 0)
+    {
+      snprintf(key, sizeof(key), "card-%zu", i / 2);
+      srsHashMap_Remove(&map, key);
+    }
+  }
+  for (i = 0; i < 20000; i++)
+  {
+    /* Key i was removed after adding key 2i or 2i + 1, whichever is a multiple of three */
+    bool removed = (((i * 2) % 3 == 0) && (i * 2 < 20000)) || (((i * 2 + 1) % 3 == 0) && (i * 2 + 1 < 20000));
+    snprintf(key, sizeof(key), "card-%zu", i);
+    ASSERT_EQ(!removed, srsHashMap_Get(&map, key, &value));
+    if (!removed)
+    {
+      ASSERT_EQ((void *)(uintptr_t)(i + 1), value);
+    }
+  }
+  srsHashMap_Free(&map);
+  PASS();
+}
+
+TEST TestMPMCQueue_FillsAndEmptiesInOrder(void)
+{
+  srsMPMC_QUEUE queue;
+  void *value = NULL;
+  uintptr_t i;
+  ASSERT_FALSE(srsMPMCQueue_Init(&queue, 1));
+  ASSERT(srsMPMCQueue_Init(&queue, 5));
+  ASSERT_EQ_FMT((uint32_t)8, srsMPMCQueue_GetCapacity(&queue), "%u");
+  ASSERT_FALSE(srsMPMCQueue_Pop(&queue, &value));
+  /* Several laps, so that every cell is reused */
+  for (i = 0; i < 40; i += 8)
+  {
+    uintptr_t j;
+    for (j = 0; j < 8; j++)
+    {
+      ASSERT(srsMPMCQueue_Push(&queue, (void *)(i + j)));
+    }
+    ASSERT_FALSE(srsMPMCQueue_Push(&queue, NULL));
+    for (j = 0; j < 8; j++)
+    {
+      ASSERT(srsMPMCQueue_Pop(&queue, &value));
+      ASSERT_EQ((void *)(i + j), value);
+    }
+    ASSERT_FALSE(srsMPMCQueue_Pop(&queue, &value));
+  }
+  srsMPMCQueue_Free(&queue);
+  ASSERT_EQ_FMT((uint32_t)0, srsMPMCQueue_GetCapacity(&queue), "%u");
+  PASS();
+}
+
+#define MPMC_THREADS 4
+#define MPMC_VALUES_PER_THREAD 50000
+
+typedef struct _MPMC_TEST_s
+{
+  srsMPMC_QUEUE queue;
+  srsATOMIC32 next_producer;
+  srsATOMIC32 popped;
+  uint8_t seen[MPMC_THREADS * MPMC_VALUES_PER_THREAD];
+} MPMC_TEST;
+
+static void *mpmc_producer(void *arg)
+{
+  MPMC_TEST *test = arg;
+  uintptr_t first = (uintptr_t)(srsAtomic_Add(&test->next_producer, 1) - 1) * MPMC_VALUES_PER_THREAD;
+  uintptr_t i;
+  for (i = 0; i < MPMC_VALUES_PER_THREAD; i++)
+  {
+    while (!srsMPMCQueue_Push(&test->queue, (void *)(first + i)))
+    {
+      srsThread_Yield();
+    }
+  }
+  return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+  MPMC_TEST *test = arg;
+  void *value = NULL;
+  while (srsAtomic_Load(&test->popped) < MPMC_THREADS * MPMC_VALUES_PER_THREAD)
+  {
+    if (srsMPMCQueue_Pop(&test->queue, &value))
+    {
+      test->seen[(uintptr_t)value]++;
+      srsAtomic_Add(&test->popped, 1);
+    }
+    else
+    {
+      srsThread_Yield();
+    }
+  }
+  return NULL;
+}
+
+TEST TestMPMCQueue_ManyProducersAndConsumers(void)
+{
+  MPMC_TEST *test = calloc(1, sizeof(*test));
+  srsTHREAD threads[MPMC_THREADS * 2];
+  size_t i;
+  ASSERT(test != NULL);
+  /* Small enough that producers keep finding it full */
+  ASSERT(srsMPMCQueue_Init(&test->queue, 64));
+  for (i = 0; i < MPMC_THREADS; i++)
+  {
+    ASSERT(srsThread_Create(&threads[i], mpmc_producer, test));
+    ASSERT(srsThread_Create(&threads[MPMC_THREADS + i], mpmc_consumer, test));
+  }
+  for (i = 0; i < MPMC_THREADS * 2; i++)
+  {
+    ASSERT(srsThread_Join(threads[i], NULL));
+  }
+  /* Every value came out exactly once */
+  for (i = 0; i < MPMC_THREADS * MPMC_VALUES_PER_THREAD; i++)
+  {
+    ASSERT_EQ_FMT(1, (int)test->seen[i], "%d");
+  }
+  srsMPMCQueue_Free(&test->queue);
+  free(test);
+  PASS();
+}
+
+TEST TestPool_ReusesReleasedObjects(void)
+{
+  srsPOOL pool = srsPOOL_INIT(24);
+  void *objects[200];
+  void *again = NULL;
+  size_t i, j;
+  for (i = 0; i < 200; i++)
+  {
+    objects[i] = srsPool_Alloc(&pool);
+    ASSERT(objects[i] != NULL);
+    ASSERT_EQ_FMT((uintptr_t)0, (uintptr_t)objects[i] % srsARENA_ALIGNMENT, "%zu");
+    memset(objects[i], (int)i, 24);
+  }
+  for (i = 0; i < 200; i++)
+  {
+    ASSERT_EQ_FMT((int)(uint8_t)i, (int)((uint8_t *)objects[i])[23], "%d");
+  }
+  for (i = 0; i < 200; i++)
+  {
+    srsPool_Release(&pool, objects[i]);
+  }
+  /* The object released last is the first handed out again */
+  again = srsPool_Alloc(&pool);
+  ASSERT_EQ(objects[199], again);
+  srsPool_Release(&pool, again);
+  /* No object is handed out twice */
+  for (i = 0; i < 200; i++)
+  {
+    objects[i] = srsPool_Alloc(&pool);
+    ASSERT(objects[i] != NULL);
+    for (j = 0; j < i; j++)
+    {
+      ASSERT(objects[j] != objects[i]);
+    }
+  }
+  srsPool_Free(&pool);
+  /* The pool can be used again after being freed */
+  again = srsPool_Alloc(&pool);
+  ASSERT(again != NULL);
+  srsPool_Release(&pool, again);
+  srsPool_Free(&pool);
+  PASS();
+}
+
+#define POOL_THREADS 4
+#define POOL_OBJECTS_PER_THREAD 20000
+
+typedef struct _POOL_TEST_s
+{
+  srsPOOL pool;
+  srsMPMC_QUEUE queue;
+  srsATOMIC32 released;
+  srsATOMIC32 corrupt;
+} POOL_TEST;
+
+/* Allocates objects and hands them to other threads to release */
+static void *pool_allocator(void *arg)
+{
+  POOL_TEST *test = arg;
+  uint32_t i;
+  for (i = 0; i < POOL_OBJECTS_PER_THREAD; i++)
+  {
+    uint32_t *object = srsPool_Alloc(&test->pool);
+    if (object == NULL)
+    {
+      srsAtomic_Add(&test->corrupt, 1);
+      continue;
+    }
+    object[0] = i;
+    object[1] = ~i;
+    while (!srsMPMCQueue_Push(&test->queue, object))
+    {
+      srsThread_Yield();
+    }
+  }
+  return NULL;
+}
+
+static void *pool_releaser(void *arg)
+{
+  POOL_TEST *test = arg;
+  void *value = NULL;
+  while (srsAtomic_Load(&test->released) < POOL_THREADS * POOL_OBJECTS_PER_THREAD)
+  {
+    if (!srsMPMCQueue_Pop(&test->queue, &value))
+    {
+      srsThread_Yield();
+      continue;
+    }
+    uint32_t *object = value;
+    if (object[1] != ~object[0])
+    {
+      srsAtomic_Add(&test->corrupt, 1);
+    }
+    srsPool_Release(&test->pool, object);
+    srsAtomic_Add(&test->released, 1);
+  }
+  return NULL;
+}
+
+TEST TestPool_ReleasesOnOtherThreads(void)
+{
+  POOL_TEST test;
+  srsTHREAD threads[POOL_THREADS * 2];
+  size_t i;
+  memset(&test, 0, sizeof(test));
+  srsPool_Init(&test.pool, 2 * sizeof(uint32_t));
+  ASSERT(srsMPMCQueue_Init(&test.queue, 256));
+  for (i = 0; i < POOL_THREADS; i++)
+  {
+    ASSERT(srsThread_Create(&threads[i], pool_allocator, &test));
+    ASSERT(srsThread_Create(&threads[POOL_THREADS + i], pool_releaser, &test));
+  }
+  for (i = 0; i < POOL_THREADS * 2; i++)
+  {
+    ASSERT(srsThread_Join(threads[i], NULL));
+  }
+  ASSERT_EQ_FMT(0, (int)srsAtomic_Load(&test.corrupt), "%d");
+  srsMPMCQueue_Free(&test.queue);
+  srsPool_Free(&test.pool);
+  PASS();
+}
+
+#define POOL_SLAB_OBJECTS 4
+
+typedef struct
+{
+  srsPOOL pool;
+  void *objects[POOL_SLAB_OBJECTS];
+} POOL_EXIT_TEST;
+
+static void *pool_cacher(void *arg)
+{
+  POOL_EXIT_TEST *test = arg;
+  size_t i;
+  for (i = 0; i < POOL_SLAB_OBJECTS; i++)
+  {
+    test->objects[i] = srsPool_Alloc(&test->pool);
+  }
+  for (i = 0; i < POOL_SLAB_OBJECTS; i++)
+  {
+    srsPool_Release(&test->pool, test->objects[i]);
+  }
+  return NULL;
+}
+
+TEST TestPool_ReturnsCachesOfExitedThreads(void)
+{
+  POOL_EXIT_TEST test;
+  srsTHREAD thread;
+  size_t i, j;
+  memset(&test, 0, sizeof(test));
+  /* One slab holds every object, so the thread's cache keeps them all when it exits */
+  srsPool_Init(&test.pool, srsPOOL_SLAB_SIZE / POOL_SLAB_OBJECTS);
+  ASSERT(srsThread_Create(&thread, pool_cacher, &test));
+  ASSERT(srsThread_Join(thread, NULL));
+  for (i = 0; i < POOL_SLAB_OBJECTS; i++)
+  {
+    ASSERT(test.objects[i] != NULL);
+    void *object = srsPool_Alloc(&test.pool);
+    bool reused = false;
+    for (j = 0; j < POOL_SLAB_OBJECTS; j++)
+    {
+      reused = reused || (object == test.objects[j]);
+    }
+    ASSERT(reused);
+  }
+  srsPool_Free(&test.pool);
+  PASS();
+}
+
 SUITE(the_suite) {
   RUN_TEST(TestMemStack_InitAndFree);
   RUN_TEST(TestMemStack_Push1Pop1);
   RUN_TEST(TestMemStack_PopFromEmptyFailsWithNoOutput);
   RUN_TEST(TestMemStack_Push4Pop4WorksAndIncreasesCapacity);
+  RUN_TEST(TestArena_AllocAndReset);
+  RUN_TEST(TestArena_ManySmallAllocations);
+  RUN_TEST(TestVector_GrowsOutOfInlineStorageAndBack);
+  RUN_TEST(TestVector_ReserveAndBulkPush);
+  RUN_TEST(TestHashMap_SetGetRemove);
+  RUN_TEST(TestHashMap_GrowsWhileChanging);
+  RUN_TEST(TestMPMCQueue_FillsAndEmptiesInOrder);
+  RUN_TEST(TestMPMCQueue_ManyProducersAndConsumers);
+  RUN_TEST(TestPool_ReusesReleasedObjects);
+  RUN_TEST(TestPool_ReleasesOnOtherThreads);
+  RUN_TEST(TestPool_ReturnsCachesOfExitedThreads);
 }
 
 /* Add definitions that need to be in the test runner's main file. */
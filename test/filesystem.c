@@ -1,7 +1,13 @@
 #include "greatest.h"
 
 #include "kioku/filesystem.h"
+#include "kioku/thread.h"
 #include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifndef kiokuOS_WINDOWS
+#include <utime.h>
+#endif
 
 TEST test_up_path(void)
 {
@@ -920,6 +926,458 @@ TEST TestIteration(void)
   PASS();
 }
 
+srsFILESYSTEM_VISIT_ACTION filesystem_counter_iterator_at(srsDIR *dir, const char *name, bool is_dir, void *userdata)
+{
+  struct filesystem_counter *counter = ((struct filesystem_counter *)userdata);
+  if (is_dir)
+  {
+    counter->numdirs++;
+    return srsFILESYSTEM_VISIT_RECURSE;
+  }
+  counter->numfiles++;
+  return srsFILESYSTEM_VISIT_CONTINUE;
+}
+
+TEST TestDirHandles(void)
+{
+  char cwd[srsPATH_MAX + 1] = {0};
+  char buffer[64] = {0};
+  strncpy(cwd, srsDir_GetCWD(), srsPATH_MAX);
+
+  /* Test bad input */
+  ASSERT_EQ(NULL, srsDir_Open(NULL));
+  ASSERT_EQ(NULL, srsDir_Open("not-a-directory-lol"));
+  ASSERT_EQ(NULL, srsDir_GetPath(NULL));
+  srsDir_Close(NULL);
+
+  ASSERT(srsDir_Exists("handles/sub") || srsDir_Create("handles/sub"));
+  ASSERT(srsFile_Exists("handles/sub/file.txt") || srsFile_Create("handles/sub/file.txt"));
+  ASSERT(srsFile_Exists("handles/other.txt") || srsFile_Create("handles/other.txt"));
+
+  srsDIR *dir = srsDir_Open("handles");
+  ASSERT(dir != NULL);
+  /* Handle paths are absolute */
+  ASSERT(srsPath_IsAbsolute(srsDir_GetPath(dir)));
+  ASSERT(strstr(srsDir_GetPath(dir), "handles") != NULL);
+
+  /* Lookups resolve against the handle, not the CWD */
+  ASSERT(srsDir_ExistsAt(dir, "sub"));
+  ASSERT_FALSE(srsFile_ExistsAt(dir, "sub"));
+  ASSERT(srsFile_ExistsAt(dir, "sub/file.txt"));
+  ASSERT_FALSE(srsDir_ExistsAt(dir, "sub/file.txt"));
+  ASSERT(srsPath_ExistsAt(dir, "other.txt"));
+  ASSERT_FALSE(srsPath_ExistsAt(dir, "missing.txt"));
+  ASSERT_FALSE(srsFile_ExistsAt(NULL, "other.txt"));
+
+  /* Content functions behave like their path-based counterparts */
+  ASSERT_FALSE(srsFile_SetContentAt(dir, "missing.txt", "text"));
+  ASSERT_FALSE(srsFile_SetContentAt(dir, "sub", "text"));
+  ASSERT(srsFile_SetContentAt(dir, "sub/file.txt", "first line\nsecond line"));
+  ASSERT_EQ(strlen("first line\nsecond line"), srsFile_GetLengthAt(dir, "sub/file.txt"));
+  ASSERT_EQ(-1, srsFile_GetLengthAt(dir, "sub"));
+  ASSERT(srsFile_GetContentAt(dir, "sub/file.txt", buffer, sizeof(buffer)));
+  ASSERT_STR_EQ("first line\n", buffer);
+  ASSERT_FALSE(srsFile_GetContentAt(dir, "sub", buffer, sizeof(buffer)));
+  ASSERT_FALSE(srsFile_GetContentAt(dir, "other.txt", buffer, sizeof(buffer)));
+
+  /* Nested handles */
+  srsDIR *sub = srsDir_OpenAt(dir, "sub");
+  ASSERT(sub != NULL);
+  FILE *fp = srsFile_OpenAt(sub, "file.txt", "r");
+  ASSERT(fp != NULL);
+  ASSERT(fgets(buffer, sizeof(buffer), fp) == buffer);
+  ASSERT_STR_EQ("first line\n", buffer);
+  fclose(fp);
+  srsDir_Close(sub);
+
+  /* Iteration */
+  struct filesystem_counter counter = {0};
+  ASSERT_FALSE(srsFileSystem_IterateAt(dir, "missing", &counter, filesystem_counter_iterator_at));
+  ASSERT_FALSE(srsFileSystem_IterateAt(dir, ".", &counter, NULL));
+  ASSERT(srsFileSystem_IterateAt(dir, ".", &counter, filesystem_counter_iterator_at));
+  ASSERT_EQ_FMT((size_t)1, counter.numdirs, "%zu");
+  ASSERT_EQ_FMT((size_t)2, counter.numfiles, "%zu");
+
+  /* Streaming only reads the top level, one entry at a time */
+  ASSERT_EQ(NULL, srsDirStream_Open(dir, "missing"));
+  ASSERT_EQ(NULL, srsDirStream_Open(dir, NULL));
+  ASSERT_EQ(NULL, srsDirStream_GetDir(NULL));
+  srsDirStream_Close(NULL);
+  srsDIR_STREAM *stream = srsDirStream_Open(dir, ".");
+  ASSERT(stream != NULL);
+  ASSERT(strstr(srsDir_GetPath(srsDirStream_GetDir(stream)), "handles") != NULL);
+  const char *name = NULL;
+  bool is_dir = false;
+  size_t streamed_dirs = 0;
+  size_t streamed_files = 0;
+  while (srsDirStream_Next(stream, &name, &is_dir))
+  {
+    ASSERT(strcmp(name, ".") != 0);
+    ASSERT(strcmp(name, "..") != 0);
+    ASSERT_EQ(is_dir, srsDir_ExistsAt(dir, name));
+    is_dir ? streamed_dirs++ : streamed_files++;
+  }
+  ASSERT_FALSE(srsDirStream_Next(stream, &name, NULL));
+  srsDirStream_Close(stream);
+  ASSERT_EQ_FMT((size_t)1, streamed_dirs, "%zu");
+  ASSERT_EQ_FMT((size_t)1, streamed_files, "%zu");
+  srsDir_Close(dir);
+
+  /* None of this touched the CWD */
+  ASSERT_STR_EQ(cwd, srsDir_GetCWD());
+  PASS();
+}
+
+struct filesystem_parallel_counter
+{
+  srsATOMIC32 numdirs;
+  srsATOMIC32 numfiles;
+  srsFILESYSTEM_VISIT_ACTION action;
+};
+srsFILESYSTEM_VISIT_ACTION filesystem_parallel_counter_iterator(srsDIR *dir, const char *name, bool is_dir, void *userdata)
+{
+  struct filesystem_parallel_counter *counter = ((struct filesystem_parallel_counter *)userdata);
+  /* The handle must be usable from whichever thread runs the visitor */
+  if (is_dir != srsDir_ExistsAt(dir, name))
+  {
+    return srsFILESYSTEM_VISIT_EXIT;
+  }
+  srsAtomic_Add(is_dir ? &counter->numdirs : &counter->numfiles, 1);
+  return counter->action;
+}
+
+TEST TestParallelIteration(void)
+{
+  const size_t numtop = 8;
+  const size_t numsub = 20;
+  const size_t numleaf = 2;
+  char path[64];
+  size_t i, j, k;
+  for (i = 0; i < numtop; i++)
+  {
+    for (j = 0; j < numsub; j++)
+    {
+      snprintf(path, sizeof(path), "walk/%zu/%zu", i, j);
+      ASSERT(srsDir_Exists(path) || srsDir_Create(path));
+      for (k = 0; k < numleaf; k++)
+      {
+        snprintf(path, sizeof(path), "walk/%zu/%zu/%zu.txt", i, j, k);
+        ASSERT(srsFile_Exists(path) || srsFile_Create(path));
+      }
+    }
+  }
+
+  /* Test bad input */
+  struct filesystem_parallel_counter counter = {0};
+  ASSERT_FALSE(srsFileSystem_IterateParallel(NULL, NULL, 4, &counter, filesystem_parallel_counter_iterator));
+  ASSERT_FALSE(srsFileSystem_IterateParallel(NULL, "walk", 4, &counter, NULL));
+  ASSERT_FALSE(srsFileSystem_IterateParallel(NULL, "not-a-directory-lol", 4, &counter, filesystem_parallel_counter_iterator));
+
+  /* Every entry is visited exactly once regardless of how many threads share the work */
+  const uint32_t thread_counts[] = {1, 2, 4, 0};
+  for (i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++)
+  {
+    struct filesystem_parallel_counter counter = {0, 0, srsFILESYSTEM_VISIT_RECURSE};
+    ASSERT(srsFileSystem_IterateParallel(NULL, "walk", thread_counts[i], &counter, filesystem_parallel_counter_iterator));
+    ASSERT_EQ_FMT((int32_t)(numtop + numtop * numsub), srsAtomic_Load(&counter.numdirs), "%d");
+    ASSERT_EQ_FMT((int32_t)(numtop * numsub * numleaf), srsAtomic_Load(&counter.numfiles), "%d");
+  }
+
+  /* Resolving against a handle */
+  srsDIR *dir = srsDir_Open("walk");
+  ASSERT(dir != NULL);
+  struct filesystem_parallel_counter at_counter = {0, 0, srsFILESYSTEM_VISIT_RECURSE};
+  ASSERT(srsFileSystem_IterateParallel(dir, "0", 4, &at_counter, filesystem_parallel_counter_iterator));
+  ASSERT_EQ_FMT((int32_t)numsub, srsAtomic_Load(&at_counter.numdirs), "%d");
+  ASSERT_EQ_FMT((int32_t)(numsub * numleaf), srsAtomic_Load(&at_counter.numfiles), "%d");
+  srsDir_Close(dir);
+
+  /* CONTINUE does not descend */
+  struct filesystem_parallel_counter continue_counter = {0, 0, srsFILESYSTEM_VISIT_CONTINUE};
+  ASSERT(srsFileSystem_IterateParallel(NULL, "walk", 4, &continue_counter, filesystem_parallel_counter_iterator));
+  ASSERT_EQ_FMT((int32_t)numtop, srsAtomic_Load(&continue_counter.numdirs), "%d");
+
+  /* STOP and EXIT end the walk after the first entry since only the starting directory has been queued */
+  struct filesystem_parallel_counter stop_counter = {0, 0, srsFILESYSTEM_VISIT_STOP};
+  ASSERT(srsFileSystem_IterateParallel(NULL, "walk", 4, &stop_counter, filesystem_parallel_counter_iterator));
+  ASSERT_EQ_FMT(1, srsAtomic_Load(&stop_counter.numdirs), "%d");
+  struct filesystem_parallel_counter exit_counter = {0, 0, srsFILESYSTEM_VISIT_EXIT};
+  ASSERT(srsFileSystem_IterateParallel(NULL, "walk", 4, &exit_counter, filesystem_parallel_counter_iterator));
+  ASSERT_EQ_FMT(1, srsAtomic_Load(&exit_counter.numdirs), "%d");
+  PASS();
+}
+
+TEST TestFileMap(void)
+{
+  srsFILE_VIEW view = {0};
+  srsFILE_VIEW views[12];
+  size_t i;
+
+  /* Test bad input */
+  ASSERT_FALSE(srsFile_Map(NULL, &view));
+  ASSERT_FALSE(srsFile_Map("map-small.txt", NULL));
+  ASSERT_FALSE(srsFile_Map("not-a-file-lol", &view));
+  ASSERT(srsDir_Exists("map-dir") || srsDir_Create("map-dir"));
+  ASSERT_FALSE(srsFile_Map("map-dir", &view));
+  srsFile_Unmap(NULL);
+
+  /* Empty files map to an empty view */
+  ASSERT(srsFile_Exists("map-empty.txt") || srsFile_Create("map-empty.txt"));
+  ASSERT(srsFile_Map("map-empty.txt", &view));
+  ASSERT_EQ_FMT((size_t)0, view.size, "%zu");
+  srsFile_Unmap(&view);
+  ASSERT_EQ(NULL, view.data);
+
+  /* Small files come back whole, newlines included */
+  ASSERT(srsFile_Exists("map-small.txt") || srsFile_Create("map-small.txt"));
+  ASSERT(srsFile_SetContent("map-small.txt", "first line\nsecond line\n"));
+  ASSERT(srsFile_Map("map-small.txt", &view));
+  ASSERT_EQ_FMT(strlen("first line\nsecond line\n"), view.size, "%zu");
+  ASSERT_EQ(0, memcmp("first line\nsecond line\n", view.data, view.size));
+  srsFile_Unmap(&view);
+
+  /* More small views than the pool holds can be alive at once */
+  for (i = 0; i < sizeof(views) / sizeof(views[0]); i++)
+  {
+    ASSERT(srsFile_Map("map-small.txt", &views[i]));
+    ASSERT_EQ(0, memcmp("first line\nsecond line\n", views[i].data, views[i].size));
+  }
+  for (i = 0; i < sizeof(views) / sizeof(views[0]); i++)
+  {
+    srsFile_Unmap(&views[i]);
+  }
+
+  /* Large files are mapped */
+  size_t large_size = srsFILE_MAP_THRESHOLD * 3 + 7;
+  char *large = malloc(large_size + 1);
+  ASSERT(large != NULL);
+  for (i = 0; i < large_size; i++)
+  {
+    large[i] = (i % 64 == 63) ? '\n' : (char)('a' + (i % 26));
+  }
+  large[large_size] = '\0';
+  ASSERT(srsFile_Exists("map-large.txt") || srsFile_Create("map-large.txt"));
+  ASSERT(srsFile_SetContent("map-large.txt", large));
+  srsDIR *dir = srsDir_Open(".");
+  ASSERT(dir != NULL);
+  ASSERT(srsFile_MapAt(dir, "map-large.txt", &view));
+  srsDir_Close(dir);
+  ASSERT_EQ_FMT(large_size, view.size, "%zu");
+  ASSERT_EQ(0, memcmp(large, view.data, view.size));
+  srsFile_Unmap(&view);
+  free(large);
+  PASS();
+}
+
+static bool filesystem_lines_match(srsLINE_INDEX *index, const char *path, uint32_t maxline)
+{
+  const size_t sizes[] = {1, 2, 3, 4, 64};
+  char expected[64];
+  char actual[64];
+  char cached[64];
+  for (uint32_t linenum = 0; linenum <= maxline; linenum++)
+  {
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+      int32_t expected_len = srsFile_ReadLineByNumber(path, linenum, expected, sizes[i]);
+      int32_t actual_len = srsLineIndex_ReadLine(index, linenum, actual, sizes[i]);
+      int32_t cached_len = srsFile_ReadLineIndexed(path, linenum, cached, sizes[i]);
+      if ((expected_len != actual_len) || (expected_len != cached_len) || (strcmp(expected, actual) != 0) || (strcmp(expected, cached) != 0))
+      {
+        srsLOG_ERROR("Line %u (buffer %zu) mismatch: [%s] %d vs [%s] %d vs [%s] %d", linenum, sizes[i], expected, expected_len, actual, actual_len, cached, cached_len);
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+TEST TestLineIndex(void)
+{
+  char linebuf[64];
+  const char *path = "lines.txt";
+  char sidecar[64];
+  snprintf(sidecar, sizeof(sidecar), "%s/%s%s", srsLINE_INDEX_DIRNAME, path, srsLINE_INDEX_SUFFIX);
+
+  /* Test bad input */
+  ASSERT_EQ(NULL, srsLineIndex_Open(NULL, false));
+  ASSERT_EQ(NULL, srsLineIndex_Open("not-a-file-lol", false));
+  ASSERT_EQ(-1, srsLineIndex_GetCount(NULL));
+  ASSERT_EQ(-1, srsLineIndex_ReadLine(NULL, 1, linebuf, sizeof(linebuf)));
+  srsLineIndex_Close(NULL);
+
+  /* Lines follow srsFile_ReadLineByNumber exactly, including carriage returns, empty lines and trailing newlines */
+  ASSERT(srsFile_Exists(path) || srsFile_Create(path));
+  ASSERT(srsFile_SetContent(path, "ab\r\nabcd\n\nabcdef\na\n"));
+  srsLINE_INDEX *index = srsLineIndex_Open(path, false);
+  ASSERT(index != NULL);
+  ASSERT_EQ(5, srsLineIndex_GetCount(index));
+  ASSERT(filesystem_lines_match(index, path, 7));
+  ASSERT_FALSE(srsPath_Exists(sidecar));
+
+  /* Changes to the file are picked up */
+  ASSERT(srsFile_SetContent(path, "x\ny"));
+  ASSERT_EQ(2, srsLineIndex_GetCount(index));
+  ASSERT(filesystem_lines_match(index, path, 3));
+  ASSERT(srsFile_SetContent(path, ""));
+  ASSERT_EQ(0, srsLineIndex_GetCount(index));
+  ASSERT(filesystem_lines_match(index, path, 2));
+  srsLineIndex_Close(index);
+
+  /* Large files */
+  const uint32_t numlines = 100000;
+  char *content = malloc(numlines * 16);
+  ASSERT(content != NULL);
+  size_t length = 0;
+  for (uint32_t i = 1; i <= numlines; i++)
+  {
+    length += (size_t)sprintf(content + length, "card%u\n", i);
+  }
+  ASSERT(srsFile_SetContent(path, content));
+  free(content);
+  index = srsLineIndex_Open(path, true);
+  ASSERT(index != NULL);
+  ASSERT_EQ((int32_t)numlines, srsLineIndex_GetCount(index));
+  ASSERT_EQ(5, srsLineIndex_ReadLine(index, 1, linebuf, sizeof(linebuf)));
+  ASSERT_STR_EQ("card1", linebuf);
+  ASSERT_EQ(9, srsLineIndex_ReadLine(index, 50000, linebuf, sizeof(linebuf)));
+  ASSERT_STR_EQ("card50000", linebuf);
+  ASSERT_EQ(10, srsLineIndex_ReadLine(index, numlines, linebuf, sizeof(linebuf)));
+  ASSERT_STR_EQ("card100000", linebuf);
+  ASSERT_EQ(-1, srsLineIndex_ReadLine(index, numlines + 1, linebuf, sizeof(linebuf)));
+  srsLineIndex_Close(index);
+#ifndef kiokuOS_WINDOWS
+  /* A file that has settled gets a sidecar which later opens reuse. Backdate it rather than sleeping. */
+  struct utimbuf times = {time(NULL) - 60, time(NULL) - 60};
+  ASSERT_EQ(0, utime(path, &times));
+  index = srsLineIndex_Open(path, true);
+  ASSERT(index != NULL);
+  srsLineIndex_Close(index);
+  ASSERT(srsFile_Exists(sidecar));
+  ASSERT(srsFile_Exists(srsLINE_INDEX_DIRNAME "/.gitignore"));
+  index = srsLineIndex_Open(path, true);
+  ASSERT(index != NULL);
+  ASSERT_EQ((int32_t)numlines, srsLineIndex_GetCount(index));
+  ASSERT_EQ(9, srsLineIndex_ReadLine(index, 12345, linebuf, sizeof(linebuf)));
+  ASSERT_STR_EQ("card12345", linebuf);
+  srsLineIndex_Close(index);
+
+  /* A sidecar that does not describe the file is ignored */
+  ASSERT(srsFile_SetContent(sidecar, "garbage"));
+  ASSERT(srsFile_SetContent(path, "one\ntwo\n"));
+  ASSERT_EQ(0, utime(path, &times));
+  index = srsLineIndex_Open(path, true);
+  ASSERT(index != NULL);
+  ASSERT(filesystem_lines_match(index, path, 3));
+  srsLineIndex_Close(index);
+#endif
+  PASS();
+}
+
+#define DURABLE_WRITERS 8
+#define DURABLE_FILES 4
+#define DURABLE_ROUNDS 8
+
+struct filesystem_durable_writer
+{
+  srsDIR *dir;
+  size_t index;
+  srsATOMIC32 *failures;
+};
+static void *filesystem_durable_write(void *arg)
+{
+  struct filesystem_durable_writer *writer = arg;
+  char path[32];
+  char content[32];
+  for (size_t round = 0; round < DURABLE_ROUNDS; round++)
+  {
+    for (size_t i = 0; i < DURABLE_FILES; i++)
+    {
+      snprintf(path, sizeof(path), "%zu-%zu.txt", writer->index, i);
+      snprintf(content, sizeof(content), "round %zu of %zu-%zu\n", round, writer->index, i);
+      if (!srsFile_SetContentAt(writer->dir, path, content))
+      {
+        srsAtomic_Add(writer->failures, 1);
+      }
+    }
+  }
+  return NULL;
+}
+
+srsFILESYSTEM_VISIT_ACTION filesystem_durable_counter(srsDIR *dir, const char *name, bool is_dir, void *userdata)
+{
+  srsAtomic_Add((srsATOMIC32 *)userdata, 1);
+  return srsFILESYSTEM_VISIT_CONTINUE;
+}
+
+TEST TestDurableWrite(void)
+{
+  char path[32];
+  char content[32];
+  char expected[32];
+  size_t i, j;
+  ASSERT_FALSE(srsFileSystem_IsDurable());
+  ASSERT(srsDir_Exists("durable") || srsDir_Create("durable"));
+  for (i = 0; i < DURABLE_WRITERS; i++)
+  {
+    for (j = 0; j < DURABLE_FILES; j++)
+    {
+      snprintf(path, sizeof(path), "durable/%zu-%zu.txt", i, j);
+      ASSERT(srsFile_Exists(path) || srsFile_Create(path));
+    }
+  }
+  srsFileSystem_SetDurable(true);
+  ASSERT(srsFileSystem_IsDurable());
+
+  /* Same rules as regular writes */
+  ASSERT_FALSE(srsFile_SetContent(NULL, "content"));
+  ASSERT_FALSE(srsFile_SetContent("durable/0-0.txt", NULL));
+  ASSERT_FALSE(srsFile_SetContent("durable/not-a-file-lol", "content"));
+  ASSERT_FALSE(srsFile_SetContent("durable", "content"));
+  ASSERT_FALSE(srsFile_Exists("durable/not-a-file-lol"));
+
+  ASSERT(srsFile_SetContent("durable/0-0.txt", "replaced\n"));
+  ASSERT(srsFile_GetContent("durable/0-0.txt", content, sizeof(content)));
+  ASSERT_STR_EQ("replaced\n", content);
+
+  /* Concurrent writers share group commits */
+  srsATOMIC32 failures = 0;
+  srsDIR *dir = srsDir_Open("durable");
+  ASSERT(dir != NULL);
+  srsTHREAD threads[DURABLE_WRITERS];
+  struct filesystem_durable_writer writers[DURABLE_WRITERS];
+  for (i = 0; i < DURABLE_WRITERS; i++)
+  {
+    writers[i].dir = dir;
+    writers[i].index = i;
+    writers[i].failures = &failures;
+    ASSERT(srsThread_Create(&threads[i], filesystem_durable_write, &writers[i]));
+  }
+  for (i = 0; i < DURABLE_WRITERS; i++)
+  {
+    ASSERT(srsThread_Join(threads[i], NULL));
+  }
+  srsFileSystem_SetDurable(false);
+  ASSERT_EQ_FMT(0, srsAtomic_Load(&failures), "%d");
+  for (i = 0; i < DURABLE_WRITERS; i++)
+  {
+    for (j = 0; j < DURABLE_FILES; j++)
+    {
+      snprintf(path, sizeof(path), "%zu-%zu.txt", i, j);
+      snprintf(expected, sizeof(expected), "round %d of %zu-%zu\n", DURABLE_ROUNDS - 1, i, j);
+      ASSERT(srsFile_GetContentAt(dir, path, content, sizeof(content)));
+      ASSERT_STR_EQ(expected, content);
+    }
+  }
+
+  /* No temporary files are left behind */
+  srsATOMIC32 entries = 0;
+  ASSERT(srsFileSystem_IterateAt(dir, ".", &entries, filesystem_durable_counter));
+  ASSERT_EQ_FMT(DURABLE_WRITERS * DURABLE_FILES, srsAtomic_Load(&entries), "%d");
+  srsDir_Close(dir);
+  PASS();
+}
+
 SUITE(test_filesystem) {
   RUN_TEST(test_file_readlinenumber);
   printf(kiokuSTRING_LF);
@@ -943,6 +1401,21 @@ SUITE(test_filesystem) {
   printf(kiokuSTRING_LF);
   srsDir_SetCWD(TESTDIR);
   RUN_TEST(TestIteration);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestDirHandles);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestParallelIteration);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestFileMap);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestLineIndex);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestDurableWrite);
 }
 /* Add definitions that need to be in the test runner's main file. */
 GREATEST_MAIN_DEFS();
@@ -0,0 +1,158 @@
+#include "greatest.h"
+#include "kioku/io.h"
+#include "kioku/filesystem.h"
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#define IO_FILE_COUNT 20
+
+TEST TestIOEngine(uint32_t flags)
+{
+  char paths[IO_FILE_COUNT][32];
+  char contents[IO_FILE_COUNT][32];
+  char buffers[IO_FILE_COUNT][32];
+  srsIO_REQUEST requests[IO_FILE_COUNT * 2];
+  size_t i;
+
+  /* A depth smaller than the batch forces it to be split */
+  srsIO_ENGINE *engine = srsIO_Create(4, flags);
+  ASSERT(engine != NULL);
+  if (flags & srsIO_FLAG_BLOCKING)
+  {
+    ASSERT_FALSE(srsIO_IsAsync(engine));
+  }
+  ASSERT(srsDir_Exists("io") || srsDir_Create("io"));
+  srsDIR *dir = srsDir_Open("io");
+  ASSERT(dir != NULL);
+
+  /* Test bad input */
+  ASSERT_FALSE(srsIO_Submit(NULL, requests, 1));
+  ASSERT_FALSE(srsIO_Submit(engine, NULL, 1));
+  ASSERT(srsIO_Submit(engine, requests, 0));
+  memset(requests, 0, sizeof(requests));
+  ASSERT_FALSE(srsIO_Submit(engine, requests, 1));
+
+  /* Creating writes */
+  memset(requests, 0, sizeof(requests));
+  for (i = 0; i < IO_FILE_COUNT; i++)
+  {
+    snprintf(paths[i], sizeof(paths[i]), "file%zu.txt", i);
+    snprintf(contents[i], sizeof(contents[i]), "content %zu\n", i * 7);
+    srsPath_Remove(paths[i]);
+    requests[i].op = srsIO_WRITE;
+    requests[i].dir = dir;
+    requests[i].path = paths[i];
+    requests[i].buffer = contents[i];
+    requests[i].size = strlen(contents[i]);
+    requests[i].flags = srsIO_FLAG_CREATE;
+  }
+  ASSERT(srsIO_Submit(engine, requests, IO_FILE_COUNT));
+  for (i = 0; i < IO_FILE_COUNT; i++)
+  {
+    ASSERT_EQ_FMT((int64_t)strlen(contents[i]), requests[i].result, "%lld");
+  }
+
+  /* Reads and stats mixed in one batch */
+  memset(requests, 0, sizeof(requests));
+  memset(buffers, 0, sizeof(buffers));
+  for (i = 0; i < IO_FILE_COUNT; i++)
+  {
+    requests[i * 2].op = srsIO_READ;
+    requests[i * 2].dir = dir;
+    requests[i * 2].path = paths[i];
+    requests[i * 2].buffer = buffers[i];
+    requests[i * 2].size = sizeof(buffers[i]) - 1;
+    requests[i * 2 + 1].op = srsIO_STAT;
+    requests[i * 2 + 1].dir = dir;
+    requests[i * 2 + 1].path = paths[i];
+  }
+  ASSERT(srsIO_Submit(engine, requests, IO_FILE_COUNT * 2));
+  for (i = 0; i < IO_FILE_COUNT; i++)
+  {
+    ASSERT_EQ_FMT((int64_t)strlen(contents[i]), requests[i * 2].result, "%lld");
+    ASSERT_STR_EQ(contents[i], buffers[i]);
+    ASSERT_EQ_FMT((int64_t)0, requests[i * 2 + 1].result, "%lld");
+    ASSERT_EQ_FMT((uint64_t)strlen(contents[i]), requests[i * 2 + 1].file_size, "%llu");
+    ASSERT_FALSE(requests[i * 2 + 1].is_dir);
+    ASSERT(requests[i * 2 + 1].mtime_sec > 0);
+  }
+
+  /* Reads stop at the buffer size */
+  memset(requests, 0, sizeof(requests));
+  memset(buffers[0], 0, sizeof(buffers[0]));
+  requests[0].op = srsIO_READ;
+  requests[0].dir = dir;
+  requests[0].path = paths[0];
+  requests[0].buffer = buffers[0];
+  requests[0].size = 4;
+  ASSERT(srsIO_Submit(engine, requests, 1));
+  ASSERT_EQ_FMT((int64_t)4, requests[0].result, "%lld");
+  ASSERT_STR_EQ("cont", buffers[0]);
+
+  /* Failures are reported per request without affecting the rest of the batch */
+  memset(requests, 0, sizeof(requests));
+  requests[0].op = srsIO_READ;
+  requests[0].dir = dir;
+  requests[0].path = "missing.txt";
+  requests[0].buffer = buffers[0];
+  requests[0].size = sizeof(buffers[0]);
+  requests[1].op = srsIO_WRITE;
+  requests[1].dir = dir;
+  requests[1].path = "missing.txt";
+  requests[1].buffer = contents[0];
+  requests[1].size = strlen(contents[0]);
+  requests[2].op = srsIO_STAT;
+  requests[2].dir = NULL;
+  requests[2].path = "io";
+  requests[3].op = srsIO_READ;
+  requests[3].dir = NULL;
+  requests[3].path = "io";
+  requests[3].buffer = buffers[0];
+  requests[3].size = sizeof(buffers[0]);
+  requests[4].op = srsIO_STAT;
+  requests[4].dir = dir;
+  requests[4].path = paths[1];
+  ASSERT(srsIO_Submit(engine, requests, 5));
+  ASSERT_EQ_FMT((int64_t)-ENOENT, requests[0].result, "%lld");
+  ASSERT_EQ_FMT((int64_t)-ENOENT, requests[1].result, "%lld");
+  ASSERT_FALSE(srsFile_Exists("io/missing.txt"));
+  ASSERT_EQ_FMT((int64_t)0, requests[2].result, "%lld");
+  ASSERT(requests[2].is_dir);
+  ASSERT(requests[3].result < 0);
+  ASSERT_EQ_FMT((int64_t)0, requests[4].result, "%lld");
+
+  /* Writes without the create flag replace existing content */
+  memset(requests, 0, sizeof(requests));
+  requests[0].op = srsIO_WRITE;
+  requests[0].dir = dir;
+  requests[0].path = paths[2];
+  requests[0].buffer = "short";
+  requests[0].size = 5;
+  ASSERT(srsIO_Submit(engine, requests, 1));
+  ASSERT_EQ_FMT((int64_t)5, requests[0].result, "%lld");
+  ASSERT_EQ(5, srsFile_GetLengthAt(dir, paths[2]));
+
+  srsDir_Close(dir);
+  srsIO_Destroy(engine);
+  PASS();
+}
+
+SUITE(test_io) {
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST1(TestIOEngine, srsIO_FLAG_BLOCKING);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  /* Uses io_uring where the kernel allows it */
+  RUN_TEST1(TestIOEngine, 0);
+  srsIO_Destroy(NULL);
+}
+
+/* Add definitions that need to be in the test runner's main file. */
+GREATEST_MAIN_DEFS();
+int main(int argc, char **argv)
+{
+  GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
+  RUN_SUITE(test_io);
+  GREATEST_MAIN_END();        /* display results */
+}
@@ -3,6 +3,12 @@
 #include "kioku/model.h"
 #include "kioku/error.h"
 #include "kioku/filesystem.h"
+#include "kioku/thread.h"
+#include "kioku/snapshot.h"
+#include <time.h>
+#ifndef kiokuOS_WINDOWS
+#include <unistd.h>
+#endif
 
 static bool createdeck()
 {
@@ -214,12 +220,297 @@ TEST TestExistsInRoot(void)
   PASS();
 }
 
+static void countchange(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata)
+{
+  srsAtomic_Add((srsATOMIC32 *)userdata, 1);
+}
+
+/* Waits a few seconds at most for the watcher to report another change */
+static bool waitforchange(srsATOMIC32 *changes, int32_t seen)
+{
+  time_t deadline = time(NULL) + 5;
+  while ((srsAtomic_Load(changes) == seen) && (time(NULL) <= deadline))
+  {
+    srsThread_Yield();
+  }
+  return srsAtomic_Load(changes) != seen;
+}
+
+TEST TestExistsInRootEscapes(void)
+{
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(srsOK, srsModel_CreateAndSetRoot(TESTDIR"/path/to/contain"));
+  ASSERT(srsFile_Create(TESTDIR"/path/to/contain/decks/secret.txt"));
+  ASSERT(srsFile_Create(TESTDIR"/path/to/containx/decks/secret.txt"));
+  ASSERT(srsFile_Create(TESTDIR"/path/to/outside/deep/secret.txt"));
+  ASSERT(srsFile_Create(TESTDIR"/path/to/outside/secret.txt"));
+
+  /* The root itself is not inside it, however it is spelled */
+  ASSERT_EQ(false, srsModel_ExistsInRoot(TESTDIR"/path/to/contain"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/.."));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/secret.txt/../.."));
+  /* Neither is a sibling whose name starts with the root's */
+  ASSERT_EQ(false, srsModel_ExistsInRoot(TESTDIR"/path/to/containx/decks/secret.txt"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("../containx/decks/secret.txt"));
+  /* ".." may wander, as long as it ends up inside */
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/../../outside/secret.txt"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/../../.."));
+  ASSERT_EQ(true, srsModel_ExistsInRoot("decks/../decks/secret.txt"));
+  ASSERT_EQ(true, srsModel_ExistsInRoot("decks/secret.txt/../secret.txt"));
+
+#ifndef kiokuOS_WINDOWS
+  srsATOMIC32 changes = 0;
+  unlink(TESTDIR"/path/to/contain/decks/link");
+  unlink(TESTDIR"/path/to/contain/decks/swap");
+  rmdir(TESTDIR"/path/to/contain/decks/swap");
+  /* A symlink out of the root is followed before the ".." after it, so reading the path the way it looks does not let it back in */
+  ASSERT_EQ(0, symlink(TESTDIR"/path/to/outside/deep", TESTDIR"/path/to/contain/decks/link"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/link/secret.txt"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/link/../secret.txt"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot(TESTDIR"/path/to/contain/decks/link/../secret.txt"));
+
+  /* A path found inside is remembered until the watcher sees it go, even if a symlink out of the root takes its place */
+  ASSERT(srsModel_AddListener(countchange, &changes));
+  ASSERT(srsDir_Create(TESTDIR"/path/to/contain/decks/swap"));
+  ASSERT_EQ(true, srsModel_ExistsInRoot("decks/swap"));
+  ASSERT_EQ(true, srsModel_ExistsInRoot("decks/swap"));
+  int32_t seen = srsAtomic_Load(&changes);
+  ASSERT_EQ(0, rmdir(TESTDIR"/path/to/contain/decks/swap"));
+  ASSERT_EQ(0, symlink(TESTDIR"/path/to/outside/deep", TESTDIR"/path/to/contain/decks/swap"));
+  ASSERT(waitforchange(&changes, seen));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/swap"));
+  ASSERT_EQ(false, srsModel_ExistsInRoot("decks/swap/secret.txt"));
+  srsModel_RemoveListener(countchange, &changes);
+  ASSERT_EQ(0, unlink(TESTDIR"/path/to/contain/decks/swap"));
+  ASSERT_EQ(0, unlink(TESTDIR"/path/to/contain/decks/link"));
+#endif
+  PASS();
+}
+
+static bool createcardat(const char *root, const char *id, const char *due)
+{
+  char path[srsPATH_MAX + 1];
+  bool ok = true;
+  snprintf(path, sizeof(path), "%s/decks/Japanese/cards/%s/added.txt", root, id);
+  ok = ok && srsFile_Create(path) && srsFile_SetContent(path, "2000-01-01 00:00");
+  snprintf(path, sizeof(path), "%s/decks/Japanese/cards/%s/scheduled.txt", root, id);
+  ok = ok && srsFile_Create(path) && srsFile_SetContent(path, due);
+  return ok;
+}
+
+static bool createcard(const char *id, const char *due)
+{
+  return createcardat(TESTDIR"/path/to/resident", id, due);
+}
+
+static bool countcard(const srsCARD *card, void *userdata)
+{
+  (*(size_t *)userdata)++;
+  return true;
+}
+
+TEST TestResident(void)
+{
+  char id[srsMODEL_CARD_ID_MAX] = {0};
+  srsTIME due = {2001, 1, 4, 0, 0};
+  size_t count = 0;
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(false, srsModel_IsResident());
+  ASSERT_EQ(srsOK, srsModel_CreateAndSetRoot(TESTDIR"/path/to/resident"));
+  ASSERT(createcard("0001", "2001-01-03 00:00"));
+  ASSERT(createcard("0002", "2001-01-01 00:00"));
+  ASSERT(createcard("0003", "2001-01-02 00:00"));
+
+  /* Not resident, so there is nothing in memory to go through */
+  ASSERT_EQ(false, srsModel_Deck_ForEachCard("decks/Japanese", countcard, &count));
+
+  srsModel_SetResident(true);
+  ASSERT_EQ(true, srsModel_IsResident());
+  ASSERT(srsModel_Deck_ForEachCard("decks/Japanese", countcard, &count));
+  ASSERT_EQ(3, count);
+  ASSERT(srsModel_Card_GetNextID("decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+
+  /* Rescheduling goes to disk and memory alike */
+  ASSERT(srsModel_Card_SetDue("decks/Japanese", "0002", due));
+  ASSERT(srsModel_Card_GetNextID("decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0003", id);
+  ASSERT_EQ(false, srsModel_Card_SetDue("decks/Japanese", "0004", due));
+
+  /* Setting the root again loads it from disk, where the reschedule was written */
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(srsOK, srsModel_SetRoot(TESTDIR"/path/to/resident"));
+  ASSERT(srsModel_Card_GetNextID("decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0003", id);
+
+  srsModel_SetResident(false);
+  ASSERT_EQ(false, srsModel_Deck_ForEachCard("decks/Japanese", countcard, &count));
+  ASSERT(srsModel_Card_GetNextID("decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0003", id);
+  PASS();
+}
+
+static bool createcardin(const char *deck, const char *id)
+{
+  char path[srsPATH_MAX + 1];
+  bool ok = true;
+  snprintf(path, sizeof(path), "%s/cards/%s/added.txt", deck, id);
+  ok = ok && srsFile_Create(path) && srsFile_SetContent(path, "2000-01-01 00:00");
+  snprintf(path, sizeof(path), "%s/cards/%s/scheduled.txt", deck, id);
+  ok = ok && srsFile_Create(path) && srsFile_SetContent(path, "2000-01-02 00:00");
+  return ok;
+}
+
+TEST TestCardsStayInRoot(void)
+{
+  size_t count = 1;
+  srsARENA arena;
+  srsArena_Init(&arena, 0);
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(srsOK, srsModel_CreateAndSetRoot(TESTDIR"/path/to/cardroot/root"));
+  ASSERT(createcardin(TESTDIR"/path/to/cardroot/root/inside", "0001"));
+  ASSERT(createcardin(TESTDIR"/path/to/cardroot/x", "0001"));
+  /* The root's parent looks like a deck too */
+  ASSERT(createcardin(TESTDIR"/path/to/cardroot", "0001"));
+
+  srsCARD *cards = srsCard_GetAll("inside", &count);
+  ASSERT(cards != NULL);
+  ASSERT_EQ(1, count);
+  srsCard_FreeArray(cards, count);
+
+  /* Decks outside the root are neither read nor given a snapshot, whichever way cards are listed */
+  for (int resident = 0; resident < 2; resident++)
+  {
+    srsModel_SetResident(resident == 1);
+    ASSERT_EQ(NULL, srsCard_GetAll("../x", &count));
+    ASSERT_EQ(0, count);
+    ASSERT_EQ(NULL, srsCard_GetAll("..", &count));
+    ASSERT_EQ(0, count);
+    ASSERT_EQ(NULL, srsCard_GetAllInArena("..", &arena, &count));
+    ASSERT_EQ(0, count);
+  }
+  srsModel_SetResident(false);
+  ASSERT_EQ(false, srsDir_Exists(TESTDIR"/path/to/cardroot/" srsSNAPSHOT_DIRNAME));
+#ifndef kiokuOS_WINDOWS
+  unlink(TESTDIR"/path/to/cardroot/root/link");
+  ASSERT_EQ(0, symlink(TESTDIR"/path/to/cardroot/x", TESTDIR"/path/to/cardroot/root/link"));
+  ASSERT_EQ(NULL, srsCard_GetAll("link", &count));
+  ASSERT_EQ(NULL, srsCard_GetAllInArena("link", &arena, &count));
+  ASSERT_EQ(0, unlink(TESTDIR"/path/to/cardroot/root/link"));
+#endif
+  ASSERT_EQ(false, srsDir_Exists(TESTDIR"/path/to/cardroot/x/" srsSNAPSHOT_DIRNAME));
+  srsArena_Free(&arena);
+  PASS();
+}
+
+TEST TestDeckSpellings(void)
+{
+  static const char *spellings[] = {"decks/Japanese", "./decks/./Japanese/", "decks//Japanese", TESTDIR"/path/to/spellings/decks/Japanese"};
+  static const char *added[] = {"0003", "0004"};
+  static const char *due[] = {"2000-06-02 00:00", "2000-06-01 00:00"};
+  char id[srsMODEL_CARD_ID_MAX] = {0};
+  srsATOMIC32 changes = 0;
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(srsOK, srsModel_CreateAndSetRoot(TESTDIR"/path/to/spellings"));
+  ASSERT(createcardat(TESTDIR"/path/to/spellings", "0001", "2001-01-02 00:00"));
+  ASSERT(createcardat(TESTDIR"/path/to/spellings", "0002", "2001-01-03 00:00"));
+  for (size_t i = 0; i < sizeof(spellings) / sizeof(*spellings); i++)
+  {
+    ASSERT(srsModel_Card_GetNextID(spellings[i], id, sizeof(id)));
+    ASSERT_STR_EQ("0001", id);
+  }
+  /* However a deck is spelled, the watcher's reports about it reach what is kept of it, whether that is its due queue or the resident deck */
+  ASSERT(srsModel_AddListener(countchange, &changes));
+  for (size_t pass = 0; pass < 2; pass++)
+  {
+    srsModel_SetResident(pass == 1);
+    for (size_t i = 0; i < sizeof(spellings) / sizeof(*spellings); i++)
+    {
+      ASSERT(srsModel_Card_GetNextID(spellings[i], id, sizeof(id)));
+    }
+    int32_t seen = srsAtomic_Load(&changes);
+    ASSERT(createcardat(TESTDIR"/path/to/spellings", added[pass], due[pass]));
+    ASSERT(waitforchange(&changes, seen));
+    for (size_t i = 0; i < sizeof(spellings) / sizeof(*spellings); i++)
+    {
+      ASSERT(srsModel_Card_GetNextID(spellings[i], id, sizeof(id)));
+      ASSERT_STR_EQ(added[pass], id);
+    }
+  }
+  srsModel_SetResident(false);
+  srsModel_RemoveListener(countchange, &changes);
+  PASS();
+}
+
 /* Suites can group multiple tests with common setup. */
+TEST TestContexts(void)
+{
+  char id[srsMODEL_CARD_ID_MAX] = {0};
+  srsTIME due = {2001, 1, 4, 0, 0};
+  srsModel_SetRoot(NULL);
+  ASSERT_EQ(NULL, srsModel_Open(TESTDIR"/path/to/contexts/none"));
+  ASSERT_EQ(srsOK, srsModel_CreateRoot(TESTDIR"/path/to/contexts/a"));
+  ASSERT_EQ(srsOK, srsModel_CreateRoot(TESTDIR"/path/to/contexts/b"));
+  ASSERT(createcardat(TESTDIR"/path/to/contexts/a", "0001", "2001-01-01 00:00"));
+  ASSERT(createcardat(TESTDIR"/path/to/contexts/a", "0002", "2001-01-02 00:00"));
+  ASSERT(createcardat(TESTDIR"/path/to/contexts/b", "0001", "2001-01-02 00:00"));
+  ASSERT(createcardat(TESTDIR"/path/to/contexts/b", "0002", "2001-01-01 00:00"));
+
+  srsMODEL *a = srsModel_Open(TESTDIR"/path/to/contexts/a");
+  srsMODEL *b = srsModel_Open(TESTDIR"/path/to/contexts/b");
+  ASSERT(a != NULL);
+  ASSERT(b != NULL);
+  ASSERT(a != srsModel_GetDefault());
+  ASSERT(strcmp(srsModel_GetRootAt(a), srsModel_GetRootAt(b)) != 0);
+  /* Opening contexts leaves the default one alone */
+  ASSERT_EQ(NULL, srsModel_GetRoot());
+
+  /* Each context reads its own decks, and paths are checked against its own root */
+  ASSERT(srsModel_Card_GetNextIDAt(a, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0001", id);
+  ASSERT(srsModel_Card_GetNextIDAt(b, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+  ASSERT_EQ(true, srsModel_ExistsInRootAt(a, TESTDIR"/path/to/contexts/a/decks"));
+  ASSERT_EQ(false, srsModel_ExistsInRootAt(a, TESTDIR"/path/to/contexts/b/decks"));
+
+  /* Rescheduling in one context is not seen by the other */
+  ASSERT(srsModel_Card_SetDueAt(a, "decks/Japanese", "0001", due));
+  ASSERT(srsModel_Card_GetNextIDAt(a, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+  ASSERT(srsModel_Card_GetNextIDAt(b, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+
+  /* A schedule file is read from the root of its context, wherever the CWD is */
+  ASSERT(srsFile_Create(TESTDIR"/path/to/contexts/b/decks/Japanese/.at"));
+  ASSERT(srsFile_SetContent(TESTDIR"/path/to/contexts/b/decks/Japanese/.at", "2"));
+  ASSERT(srsFile_Create(TESTDIR"/path/to/contexts/b/decks/Japanese/.schedule"));
+  ASSERT(srsFile_SetContent(TESTDIR"/path/to/contexts/b/decks/Japanese/.schedule", "0002\n0001\n"));
+  ASSERT(srsDir_PushCWD(TESTDIR"/path/to/contexts/a") != NULL);
+  ASSERT(srsModel_Card_GetNextIDAt(b, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0001", id);
+  ASSERT(srsModel_Card_GetNextIDAt(a, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+  ASSERT(srsDir_PopCWD(NULL));
+  ASSERT(srsPath_Remove(TESTDIR"/path/to/contexts/b/decks/Japanese/.at"));
+
+  /* Closing one context leaves the other usable */
+  srsModel_Close(a);
+  ASSERT(srsModel_Card_GetNextIDAt(b, "decks/Japanese", id, sizeof(id)));
+  ASSERT_STR_EQ("0002", id);
+  srsModel_Close(b);
+  PASS();
+}
+
 SUITE(the_suite) {
   RUN_TEST(test_card_getpath);
   RUN_TEST(test_card_getnextid);
   RUN_TEST(test_get_set_root);
   RUN_TEST(TestExistsInRoot);
+  RUN_TEST(TestExistsInRootEscapes);
+  RUN_TEST(TestCardsStayInRoot);
+  RUN_TEST(TestDeckSpellings);
+  RUN_TEST(TestContexts);
+  RUN_TEST(TestResident);
 }
 
 /* Add definitions that need to be in the test runner's main file. */
@@ -0,0 +1,107 @@
+#include "greatest.h"
+#include "kioku/optimizer.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+/* Deterministic so that a fit always sees the same history */
+static uint32_t random_state = 12345;
+static float random_unit(void)
+{
+  random_state = random_state * 1664525u + 1013904223u;
+  return (float)(random_state >> 8) / 16777216.0f;
+}
+
+/* Reviews cards with the weights of scheduler, recalling each with the probability they predict */
+static void simulate_reviews(const srsSCHEDULER *scheduler, srsREVIEW_LOG *log, uint32_t card_count)
+{
+  srsTIME_PACKED start = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=12, .minute=0});
+  uint32_t card;
+  for (card = 0; card < card_count; card++)
+  {
+    srsCARD_STATE state = {0};
+    srsTIME_PACKED now = start + (srsTIME_PACKED)(random_unit() * 365 * 1440);
+    int review_count = 2 + (int)(random_unit() * 15);
+    int review;
+    for (review = 0; review < review_count; review++)
+    {
+      float recall = (review == 0) ? 1.0f : srsScheduler_GetRetrievability(scheduler, &state, now);
+      srsGRADE grade = (random_unit() < recall) ? ((random_unit() < 0.8f) ? srsGRADE_GOOD : srsGRADE_EASY) : srsGRADE_AGAIN;
+      srsReviewLog_Add(log, card, now, grade);
+      srsScheduler_Grade(scheduler, &state, grade, now, &state);
+      now = state.due + (srsTIME_PACKED)(random_unit() * 2 * 1440);
+    }
+  }
+}
+
+TEST AddingReviewsChecksInput(void)
+{
+  srsREVIEW_LOG *log = srsReviewLog_Create();
+  srsTIME_PACKED now = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=12, .minute=0});
+  srsSCHEDULER scheduler;
+  double loss = 0.0;
+  ASSERT(log != NULL);
+  ASSERT_EQ(0, srsReviewLog_GetCount(NULL));
+  ASSERT_FALSE(srsReviewLog_Add(NULL, 0, now, srsGRADE_GOOD));
+  ASSERT_FALSE(srsReviewLog_Add(log, 0, now, (srsGRADE)0));
+  ASSERT_FALSE(srsReviewLog_Add(log, 0, now, (srsGRADE)5));
+  ASSERT(srsReviewLog_Add(log, 0, now, srsGRADE_GOOD));
+  ASSERT_EQ(1, srsReviewLog_GetCount(log));
+
+  /* A card's first review is not scored, so there is nothing to score yet */
+  ASSERT(srsScheduler_Init(&scheduler, srsSCHEDULER_FSRS));
+  ASSERT_FALSE(srsOptimizer_GetLoss(&scheduler, log, &loss));
+  ASSERT(srsReviewLog_Add(log, 0, now + 3 * 1440, srsGRADE_GOOD));
+  ASSERT(srsOptimizer_GetLoss(&scheduler, log, &loss));
+  ASSERT(loss > 0.0);
+
+  /* Only FSRS has weights to fit */
+  ASSERT(srsScheduler_Init(&scheduler, srsSCHEDULER_SM2));
+  ASSERT_FALSE(srsOptimizer_GetLoss(&scheduler, log, &loss));
+  ASSERT_FALSE(srsOptimizer_Fit(&scheduler, log, srsOPTIMIZER_OPTS_INIT));
+  srsReviewLog_Free(log);
+  PASS();
+}
+
+TEST FittingLowersTheLoss(void)
+{
+  srsSCHEDULER truth;
+  srsSCHEDULER scheduler;
+  srsOPTIMIZER_OPTS opts = srsOPTIMIZER_OPTS_INIT;
+  srsREVIEW_LOG *log = srsReviewLog_Create();
+  double start_loss = 0.0;
+  double fitted_loss = 0.0;
+  ASSERT(log != NULL);
+  ASSERT(srsScheduler_Init(&truth, srsSCHEDULER_FSRS));
+  simulate_reviews(&truth, log, 2000);
+
+  /* Start from weights that remember everything too well */
+  ASSERT(srsScheduler_Init(&scheduler, srsSCHEDULER_FSRS));
+  scheduler.weights[2] = 10.0f;
+  scheduler.weights[3] = 40.0f;
+  scheduler.weights[8] = 2.0f;
+  ASSERT(srsOptimizer_GetLoss(&scheduler, log, &start_loss));
+  opts.batch_size = 2048;
+  opts.thread_count = 2;
+  ASSERT(srsOptimizer_Fit(&scheduler, log, opts));
+  ASSERT(srsOptimizer_GetLoss(&scheduler, log, &fitted_loss));
+  ASSERT(fitted_loss < start_loss);
+  ASSERT(scheduler.weights[2] < 10.0f);
+  ASSERT_EQ(srsSCHEDULER_FSRS, scheduler.algorithm);
+  srsReviewLog_Free(log);
+  PASS();
+}
+
+SUITE(test_optimizer) {
+  RUN_TEST(AddingReviewsChecksInput);
+  RUN_TEST(FittingLowersTheLoss);
+}
+
+/* Add definitions that need to be in the test runner's main file. */
+GREATEST_MAIN_DEFS();
+int main(int argc, char **argv)
+{
+  GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
+  RUN_SUITE(test_optimizer);
+  GREATEST_MAIN_END();        /* display results */
+}
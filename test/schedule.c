@@ -1,6 +1,7 @@
 
 #include "greatest.h"
 #include "kioku/schedule.h"
+#include <string.h>
 
 /* A test runs various assertions, then calls PASS(), FAIL(), or SKIP(). */
 TEST TimeConvertsToAndFromString(void)
@@ -81,10 +82,180 @@ TEST TimeComparison(void)
   PASS();
 }
 
+TEST TimePacksAndParsesInBulk(void)
+{
+  srsTIME time = {.year=2017, .month=10, .day=31, .hour=23, .minute=59};
+  srsTIME later = time;
+  srsTIME none = srsTIME_NONE;
+  srsTIME never = srsTIME_NEVER;
+
+  /* Packing round trips and keeps the order of times */
+  ASSERT_EQ(0, srsTime_Compare(time, srsTime_Unpack(srsTime_Pack(time))));
+  later.minute = 0;
+  later.hour = 0;
+  later.day = 1;
+  later.month = 11;
+  ASSERT_EQ(srsTime_Pack(time) + 1, srsTime_Pack(later));
+  later.year = 2016;
+  later.month = 2;
+  later.day = 29;
+  ASSERT_EQ(0, srsTime_Compare(later, srsTime_Unpack(srsTime_Pack(later))));
+  ASSERT(srsTime_Pack(later) < srsTime_Pack(time));
+  ASSERT_EQ(srsTIME_PACKED_NONE, srsTime_Pack(none));
+  ASSERT_EQ(srsTIME_PACKED_NEVER, srsTime_Pack(never));
+  ASSERT_EQ(0, srsTime_Compare(never, srsTime_Unpack(srsTIME_PACKED_NEVER)));
+  later.year = 2017;
+  ASSERT_EQ(srsTIME_PACKED_NONE, srsTime_Pack(later));
+
+  /* Bulk parsing takes the fast path and the forgiving one alike */
+  const char *strings[5] = {"2017-10-31 23:59", "2017-1-2 3:04", "2017-02-29 00:00", NULL, "garbage"};
+  srsTIME_PACKED packed[5];
+  ASSERT_EQ(2, srsTime_ParseMany(strings, 5, packed));
+  ASSERT_EQ(srsTime_Pack(time), packed[0]);
+  ASSERT_EQ(0, srsTime_Compare((srsTIME){.year=2017, .month=1, .day=2, .hour=3, .minute=4}, srsTime_Unpack(packed[1])));
+  ASSERT_EQ(srsTIME_PACKED_NONE, packed[2]);
+  ASSERT_EQ(srsTIME_PACKED_NONE, packed[3]);
+  ASSERT_EQ(srsTIME_PACKED_NONE, packed[4]);
+
+  /* Bulk formatting writes what srsTime_ToString would */
+  srsTIME_STRING formatted[3];
+  srsTIME_PACKED times[3] = {packed[0], srsTIME_PACKED_NONE, srsTIME_PACKED_NEVER};
+  ASSERT_EQ(1, srsTime_FormatMany(times, 3, formatted));
+  ASSERT_STR_EQ("2017-10-31 23:59", formatted[0]);
+  ASSERT_STR_EQ("", formatted[1]);
+  ASSERT_STR_EQ("", formatted[2]);
+  PASS();
+}
+
+TEST ScheduleQueueOrdersByDue(void)
+{
+  enum { CARDS = 1000 };
+  srsTIME_PACKED due[CARDS];
+  uint32_t popped[CARDS];
+  uint32_t card = 0;
+  srsTIME_PACKED next_due = 0;
+  size_t i = 0;
+
+  ASSERT_EQ(NULL, srsScheduleQueue_Create(NULL, 1));
+  srsSCHEDULE_QUEUE *queue = srsScheduleQueue_Create(NULL, 0);
+  ASSERT(queue != NULL);
+  ASSERT_FALSE(srsScheduleQueue_Peek(queue, &card, NULL));
+  ASSERT_EQ(0, srsScheduleQueue_Pop(queue, 1, popped));
+  srsScheduleQueue_Free(queue);
+
+  /* Scatter due times, with plenty of ties */
+  for (i = 0; i < CARDS; i++)
+  {
+    due[i] = (srsTIME_PACKED)((i * 7919) % 101 + 1);
+  }
+  queue = srsScheduleQueue_Create(due, CARDS);
+  ASSERT(queue != NULL);
+  ASSERT_EQ(CARDS, srsScheduleQueue_GetCount(queue));
+
+  /* Move a few cards around and take one out */
+  ASSERT(srsScheduleQueue_Update(queue, 500, 0));
+  due[500] = 0;
+  ASSERT(srsScheduleQueue_Update(queue, 3, srsTIME_PACKED_NEVER));
+  due[3] = srsTIME_PACKED_NEVER;
+  ASSERT(srsScheduleQueue_Remove(queue, 42));
+  ASSERT_FALSE(srsScheduleQueue_Remove(queue, 42));
+  ASSERT_FALSE(srsScheduleQueue_Update(queue, CARDS, 0));
+  ASSERT(srsScheduleQueue_Peek(queue, &card, &next_due));
+  ASSERT_EQ(500, card);
+  ASSERT_EQ(0, next_due);
+
+  /* Everything comes out by due time, then by card */
+  ASSERT_EQ(CARDS - 1, srsScheduleQueue_Pop(queue, CARDS, popped));
+  ASSERT_EQ(0, srsScheduleQueue_GetCount(queue));
+  ASSERT_EQ(3, popped[CARDS - 2]);
+  for (i = 1; i < CARDS - 1; i++)
+  {
+    ASSERT(popped[i] != 42);
+    ASSERT((due[popped[i - 1]] < due[popped[i]]) || ((due[popped[i - 1]] == due[popped[i]]) && (popped[i - 1] < popped[i])));
+  }
+
+  /* Popped cards can be queued again */
+  ASSERT(srsScheduleQueue_Update(queue, 42, 7));
+  ASSERT_EQ(1, srsScheduleQueue_Pop(queue, 5, popped));
+  ASSERT_EQ(42, popped[0]);
+  srsScheduleQueue_Free(queue);
+  PASS();
+}
+
+static srsTIME_PACKED last_expired_due = 0;
+static bool expired_in_order = true;
+
+static void RecordExpiry(srsTIMER *timer, void *userdata)
+{
+  expired_in_order = expired_in_order && (timer->due >= last_expired_due);
+  last_expired_due = timer->due;
+  (*(size_t *)timer->data)++;
+}
+
+TEST TimerWheelExpiresInOrder(void)
+{
+  enum { TIMERS = 4096 };
+  static srsTIMER timers[TIMERS];
+  static size_t expiries[TIMERS];
+  srsTIME_PACKED start = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=0, .minute=0});
+  srsTIME_PACKED next = 0;
+  size_t i = 0;
+
+  ASSERT_EQ(NULL, srsTimerWheel_Create(start, NULL, NULL));
+  srsTIMER_WHEEL *wheel = srsTimerWheel_Create(start, RecordExpiry, NULL);
+  ASSERT(wheel != NULL);
+  ASSERT_FALSE(srsTimerWheel_GetNextExpiry(wheel, &next));
+  ASSERT_EQ(0, srsTimerWheel_Advance(wheel, start + 1000000));
+  srsTimerWheel_Free(wheel);
+
+  /* Timers from a minute to years away, so every level is used */
+  wheel = srsTimerWheel_Create(start, RecordExpiry, NULL);
+  ASSERT(wheel != NULL);
+  memset(timers, 0, sizeof(timers));
+  memset(expiries, 0, sizeof(expiries));
+  for (i = 0; i < TIMERS; i++)
+  {
+    timers[i].data = &expiries[i];
+    ASSERT(srsTimerWheel_Add(wheel, &timers[i], start + (srsTIME_PACKED)((i * i * 2654435761u) % (60u << (i % 24)))));
+  }
+  ASSERT_FALSE(srsTimerWheel_Add(wheel, &timers[0], srsTIME_PACKED_NEVER));
+  ASSERT_EQ(TIMERS, srsTimerWheel_GetCount(wheel));
+  /* Moving and removing timers */
+  ASSERT(srsTimerWheel_Add(wheel, &timers[1], start - 10));
+  ASSERT(srsTimerWheel_Remove(wheel, &timers[2]));
+  ASSERT_FALSE(srsTimerWheel_Remove(wheel, &timers[2]));
+  ASSERT_EQ(TIMERS - 1, srsTimerWheel_GetCount(wheel));
+  ASSERT(srsTimerWheel_GetNextExpiry(wheel, &next));
+  ASSERT(next <= start);
+
+  /* Step from one expiry to the next, never expiring anything early */
+  srsTIME_PACKED now = start;
+  size_t expired = 0;
+  while (srsTimerWheel_GetNextExpiry(wheel, &next))
+  {
+    now = (next > now) ? next : now;
+    last_expired_due = 0;
+    expired += srsTimerWheel_Advance(wheel, now);
+    ASSERT(expired_in_order);
+    ASSERT_EQ(0, srsTimerWheel_Advance(wheel, now));
+  }
+  ASSERT_EQ(TIMERS - 1, expired);
+  for (i = 0; i < TIMERS; i++)
+  {
+    ASSERT_EQ((i == 2) ? 0 : 1, expiries[i]);
+    ASSERT(timers[i].due <= now);
+  }
+  srsTimerWheel_Free(wheel);
+  PASS();
+}
+
 /* Suites can group multiple tests with common setup. */
 SUITE(the_suite) {
   RUN_TEST(TimeConvertsToAndFromString);
   RUN_TEST(TimeComparison);
+  RUN_TEST(TimePacksAndParsesInBulk);
+  RUN_TEST(ScheduleQueueOrdersByDue);
+  RUN_TEST(TimerWheelExpiresInOrder);
 }
 
 /* Add definitions that need to be in the test runner's main file. */
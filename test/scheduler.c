@@ -0,0 +1,217 @@
+#include "greatest.h"
+#include "kioku/scheduler.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define DAY 1440
+
+TEST SM2SchedulesIncreasingIntervals(void)
+{
+  srsSCHEDULER scheduler;
+  srsCARD_STATE state = {0};
+  srsTIME_PACKED now = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=12, .minute=0});
+  ASSERT(srsScheduler_Init(&scheduler, srsSCHEDULER_SM2));
+  ASSERT_FALSE(srsScheduler_Grade(&scheduler, &state, (srsGRADE)0, now, &state));
+  ASSERT_FALSE(srsScheduler_Grade(&scheduler, &state, (srsGRADE)5, now, &state));
+
+  /* One day, six days, then the interval times the ease */
+  ASSERT(srsScheduler_Grade(&scheduler, &state, srsGRADE_GOOD, now, &state));
+  ASSERT_EQ(now + DAY, state.due);
+  ASSERT_EQ(1, state.reps);
+  now = state.due;
+  ASSERT(srsScheduler_Grade(&scheduler, &state, srsGRADE_GOOD, now, &state));
+  ASSERT_EQ(now + 6 * DAY, state.due);
+  now = state.due;
+  ASSERT(srsScheduler_Grade(&scheduler, &state, srsGRADE_GOOD, now, &state));
+  ASSERT_EQ(now + 15 * DAY, state.due);
+  ASSERT_EQ(now, state.last_review);
+
+  /* Easy grades raise the ease, and forgetting starts over */
+  ASSERT(srsScheduler_Grade(&scheduler, &state, srsGRADE_EASY, state.due, &state));
+  ASSERT(state.difficulty > 2.5f);
+  ASSERT(srsScheduler_Grade(&scheduler, &state, srsGRADE_AGAIN, state.due, &state));
+  ASSERT_EQ(state.last_review + DAY, state.due);
+  ASSERT_EQ(0, state.reps);
+  ASSERT_EQ(1, state.lapses);
+  PASS();
+}
+
+TEST FSRSSchedulesAtDesiredRetention(void)
+{
+  srsSCHEDULER scheduler;
+  srsCARD_STATE good = {0};
+  srsCARD_STATE again = {0};
+  srsCARD_STATE easy = {0};
+  srsTIME_PACKED now = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=12, .minute=0});
+  ASSERT(srsScheduler_Init(&scheduler, srsSCHEDULER_FSRS));
+
+  /* First grades start from the weights for each grade */
+  ASSERT(srsScheduler_Grade(&scheduler, &good, srsGRADE_GOOD, now, &good));
+  ASSERT(srsScheduler_Grade(&scheduler, &again, srsGRADE_AGAIN, now, &again));
+  ASSERT(srsScheduler_Grade(&scheduler, &easy, srsGRADE_EASY, now, &easy));
+  ASSERT(fabsf(scheduler.weights[2] - good.stability) < 0.0001f);
+  ASSERT_EQ(now + 3 * DAY, good.due);
+  ASSERT_EQ(now + DAY, again.due);
+  ASSERT_EQ(now + 16 * DAY, easy.due);
+  ASSERT(again.difficulty > good.difficulty);
+  ASSERT(good.difficulty > easy.difficulty);
+
+  /* Recall is at the desired retention when the card is due, and recalling it then makes it more stable */
+  ASSERT(fabsf(0.9f - srsScheduler_GetRetrievability(&scheduler, &good, good.due)) < 0.01f);
+  float stability = good.stability;
+  ASSERT(srsScheduler_Grade(&scheduler, &good, srsGRADE_GOOD, good.due, &good));
+  ASSERT(good.stability > stability * 2.0f);
+  ASSERT_EQ(2, good.reps);
+
+  /* Forgetting it makes it less stable */
+  stability = good.stability;
+  ASSERT(srsScheduler_Grade(&scheduler, &good, srsGRADE_AGAIN, good.due, &good));
+  ASSERT(good.stability < stability);
+  ASSERT_EQ(1, good.lapses);
+  ASSERT_EQ(0, good.reps);
+
+  /* A higher desired retention schedules sooner */
+  srsCARD_STATE strict = {0};
+  scheduler.desired_retention = 0.95f;
+  ASSERT(srsScheduler_Grade(&scheduler, &strict, srsGRADE_EASY, now, &strict));
+  ASSERT(strict.due < easy.due);
+  PASS();
+}
+
+TEST GradingManyMatchesGradingEach(void)
+{
+  enum { CARDS = 1000 };
+  static float stability[CARDS];
+  static float difficulty[CARDS];
+  static srsTIME_PACKED last_review[CARDS];
+  static srsTIME_PACKED due[CARDS];
+  static uint16_t reps[CARDS];
+  static uint16_t lapses[CARDS];
+  static uint8_t grades[CARDS];
+  static srsTIME_PACKED times[CARDS];
+  static srsCARD_STATE expected[CARDS];
+  srsCARD_STATES states = {stability, difficulty, last_review, due, reps, lapses};
+  srsSCHEDULER_ALGORITHM algorithms[2] = {srsSCHEDULER_SM2, srsSCHEDULER_FSRS};
+  srsTIME_PACKED start = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=12, .minute=0});
+  srsSCHEDULER scheduler;
+  size_t i = 0;
+
+  ASSERT_FALSE(srsScheduler_GradeMany(NULL, &states, grades, times, CARDS));
+  srand(5);
+  for (size_t a = 0; a < 2; a++)
+  {
+    ASSERT(srsScheduler_Init(&scheduler, algorithms[a]));
+    memset(stability, 0, sizeof(stability));
+    memset(difficulty, 0, sizeof(difficulty));
+    memset(last_review, 0, sizeof(last_review));
+    memset(due, 0, sizeof(due));
+    memset(reps, 0, sizeof(reps));
+    memset(lapses, 0, sizeof(lapses));
+    memset(expected, 0, sizeof(expected));
+    /* A few rounds of reviews, some of them out of range, early, late, or on the same day */
+    for (size_t round = 0; round < 5; round++)
+    {
+      for (i = 0; i < CARDS; i++)
+      {
+        grades[i] = (uint8_t)(rand() % 6);
+        times[i] = ((due[i] == 0) ? start : due[i]) + (srsTIME_PACKED)(rand() % (3 * DAY)) - ((round == 3) ? DAY : 0);
+        srsCARD_STATE state = expected[i];
+        if (!srsScheduler_Grade(&scheduler, &state, (srsGRADE)grades[i], times[i], &expected[i]))
+        {
+          expected[i] = state;
+        }
+      }
+      ASSERT(srsScheduler_GradeMany(&scheduler, &states, grades, times, CARDS));
+      for (i = 0; i < CARDS; i++)
+      {
+        ASSERT_EQ(expected[i].due, due[i]);
+        ASSERT_EQ(expected[i].last_review, last_review[i]);
+        ASSERT_EQ(expected[i].reps, reps[i]);
+        ASSERT_EQ(expected[i].lapses, lapses[i]);
+        /* Vectorized math may differ from scalar math in the last bits */
+        ASSERT(fabsf(expected[i].stability - stability[i]) <= 1e-5f * expected[i].stability);
+        ASSERT(fabsf(expected[i].difficulty - difficulty[i]) <= 1e-5f * expected[i].difficulty);
+        ASSERT(isfinite(stability[i]) && (stability[i] >= 0.0f));
+      }
+    }
+  }
+  PASS();
+}
+
+TEST CountingDueSplitsCardsByDay(void)
+{
+  uint32_t counts[3] = {0};
+  srsTIME_PACKED start = srsTime_Pack((srsTIME){.year=2018, .month=1, .day=1, .hour=0, .minute=0});
+  srsTIME_PACKED due[] = {srsTIME_PACKED_NONE, start - 1, start, start + DAY - 1, start + DAY, start + 2 * DAY + 5, start + 3 * DAY, srsTIME_PACKED_NEVER};
+  srsScheduler_CountDue(NULL, 8, start, 3, counts);
+  srsScheduler_CountDue(due, 0, start, 3, counts);
+  ASSERT_EQ(0, counts[0] + counts[1] + counts[2]);
+
+  /* Overdue cards count towards today, and cards beyond the last day are left out */
+  srsScheduler_CountDue(due, sizeof(due) / sizeof(due[0]), start, 3, counts);
+  ASSERT_EQ(4, counts[0]);
+  ASSERT_EQ(1, counts[1]);
+  ASSERT_EQ(1, counts[2]);
+
+  /* Counts are added to, so decks can be counted one after another */
+  srsScheduler_CountDue(due, sizeof(due) / sizeof(due[0]), start, 3, counts);
+  ASSERT_EQ(8, counts[0]);
+  ASSERT_EQ(2, counts[2]);
+  PASS();
+}
+
+TEST OptionsFileRoundTrips(void)
+{
+  srsSCHEDULER saved;
+  srsSCHEDULER loaded;
+  const char *path = TESTDIR "/scheduler.json";
+  FILE *file = NULL;
+  size_t i;
+  ASSERT(srsScheduler_Init(&saved, srsSCHEDULER_FSRS));
+  saved.desired_retention = 0.85f;
+  saved.maximum_interval = 365.0f;
+  for (i = 0; i < srsSCHEDULER_FSRS_WEIGHTS; i++)
+  {
+    saved.weights[i] *= 1.25f;
+  }
+  ASSERT(srsScheduler_Save(&saved, path));
+  ASSERT(srsScheduler_Init(&loaded, srsSCHEDULER_SM2));
+  ASSERT(srsScheduler_Load(&loaded, path));
+  ASSERT_EQ(srsSCHEDULER_FSRS, loaded.algorithm);
+  ASSERT(fabsf(0.85f - loaded.desired_retention) < 0.0001f);
+  ASSERT(fabsf(365.0f - loaded.maximum_interval) < 0.0001f);
+  for (i = 0; i < srsSCHEDULER_FSRS_WEIGHTS; i++)
+  {
+    ASSERT(fabsf(saved.weights[i] - loaded.weights[i]) < 0.0001f);
+  }
+
+  /* Anything invalid leaves the settings as they were */
+  file = fopen(path, "w");
+  ASSERT(file != NULL);
+  fputs("{\"algorithm\": \"fsrs\", \"desired_retention\": 1.5}", file);
+  fclose(file);
+  ASSERT_FALSE(srsScheduler_Load(&loaded, path));
+  ASSERT(fabsf(0.85f - loaded.desired_retention) < 0.0001f);
+  ASSERT_FALSE(srsScheduler_Load(&loaded, TESTDIR "/missing.json"));
+  remove(path);
+  PASS();
+}
+
+SUITE(test_scheduler) {
+  RUN_TEST(SM2SchedulesIncreasingIntervals);
+  RUN_TEST(FSRSSchedulesAtDesiredRetention);
+  RUN_TEST(GradingManyMatchesGradingEach);
+  RUN_TEST(CountingDueSplitsCardsByDay);
+  RUN_TEST(OptionsFileRoundTrips);
+}
+
+/* Add definitions that need to be in the test runner's main file. */
+GREATEST_MAIN_DEFS();
+int main(int argc, char **argv)
+{
+  GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
+  RUN_SUITE(test_scheduler);
+  GREATEST_MAIN_END();        /* display results */
+}
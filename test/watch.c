@@ -0,0 +1,276 @@
+#include "greatest.h"
+#include "kioku/watch.h"
+#include "kioku/filesystem.h"
+#include "kioku/thread.h"
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#define WATCH_LOG_MAX 256
+
+typedef struct
+{
+  srsWATCH_EVENT event;
+  char path[64];
+  bool is_dir;
+} WATCH_RECORD;
+
+static srsMUTEX watch_log_lock;
+static WATCH_RECORD watch_log[WATCH_LOG_MAX];
+static size_t watch_log_count = 0;
+
+static void RecordChange(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata)
+{
+  srsMutex_Lock(&watch_log_lock);
+  if (watch_log_count < WATCH_LOG_MAX)
+  {
+    watch_log[watch_log_count].event = event;
+    snprintf(watch_log[watch_log_count].path, sizeof(watch_log[watch_log_count].path), "%s", path);
+    watch_log[watch_log_count].is_dir = is_dir;
+    watch_log_count++;
+  }
+  srsMutex_Unlock(&watch_log_lock);
+  srsAtomic_Add((srsATOMIC32 *)userdata, 1);
+}
+
+static void ClearChanges()
+{
+  srsMutex_Lock(&watch_log_lock);
+  watch_log_count = 0;
+  srsMutex_Unlock(&watch_log_lock);
+}
+
+/* Waits a few seconds at most for a change to be reported */
+static bool WaitForChange(srsWATCH_EVENT event, const char *path, bool is_dir)
+{
+  time_t deadline = time(NULL) + 5;
+  do
+  {
+    srsMutex_Lock(&watch_log_lock);
+    for (size_t i = 0; i < watch_log_count; i++)
+    {
+      if ((watch_log[i].event == event) && (strcmp(watch_log[i].path, path) == 0) && (watch_log[i].is_dir == is_dir))
+      {
+        srsMutex_Unlock(&watch_log_lock);
+        return true;
+      }
+    }
+    srsMutex_Unlock(&watch_log_lock);
+    srsThread_Yield();
+  } while (time(NULL) <= deadline);
+  return false;
+}
+
+TEST TestWatch()
+{
+  srsATOMIC32 calls = 0;
+  char root[srsPATH_MAX + 1];
+  ASSERT(srsDir_Exists("watch") || srsDir_Create("watch"));
+  srsPath_Remove("watch/renamed.txt");
+  srsPath_Remove("watch/sub/inner.txt");
+  srsPath_Remove("watch/sub");
+  ASSERT(srsFile_Exists("watch/existing.txt") || srsFile_Create("watch/existing.txt"));
+  ASSERT(kioku_path_concat(root, sizeof(root), TESTDIR, "watch") > 0);
+
+  /* Test bad input */
+  ASSERT_EQ(NULL, srsWatch_Open(NULL, RecordChange, &calls));
+  ASSERT_EQ(NULL, srsWatch_Open(root, NULL, &calls));
+  ASSERT_EQ(NULL, srsWatch_Open("does-not-exist", RecordChange, &calls));
+  srsWatch_Close(NULL);
+  ASSERT_EQ(NULL, srsWatch_GetPath(NULL));
+
+  ASSERT(srsMutex_Init(&watch_log_lock));
+  srsWATCH *watch = srsWatch_Open(root, RecordChange, &calls);
+  if (watch == NULL)
+  {
+    srsMutex_Destroy(&watch_log_lock);
+    SKIPm("Watching is not supported on this platform");
+  }
+  ASSERT_STR_EQ(root, srsWatch_GetPath(watch));
+
+  /* Modifying a file */
+  ASSERT(srsFile_SetContent("watch/existing.txt", "new"));
+  ASSERT(WaitForChange(srsWATCH_MODIFIED, "existing.txt", false));
+
+  /* Creating a file */
+  ASSERT(srsFile_Create("watch/created.txt"));
+  ASSERT(WaitForChange(srsWATCH_CREATED, "created.txt", false));
+
+  /* Renaming shows up as a deletion and a creation */
+  ASSERT(srsPath_Move("watch/created.txt", "watch/renamed.txt"));
+  ASSERT(WaitForChange(srsWATCH_DELETED, "created.txt", false));
+  ASSERT(WaitForChange(srsWATCH_CREATED, "renamed.txt", false));
+
+  /* New directories are watched too */
+  ASSERT(srsDir_Create("watch/sub"));
+  ASSERT(WaitForChange(srsWATCH_CREATED, "sub", true));
+  ClearChanges();
+  ASSERT(srsFile_Create("watch/sub/inner.txt"));
+  /* Depending on timing it is reported either by the new watch or by the scan that follows it */
+  ASSERT(WaitForChange(srsWATCH_CREATED, "sub/inner.txt", false));
+  ASSERT(srsFile_SetContent("watch/sub/inner.txt", "changed"));
+  ASSERT(WaitForChange(srsWATCH_MODIFIED, "sub/inner.txt", false));
+
+  /* Deleting */
+  ASSERT(srsPath_Remove("watch/sub/inner.txt"));
+  ASSERT(WaitForChange(srsWATCH_DELETED, "sub/inner.txt", false));
+  ASSERT(srsPath_Remove("watch/sub"));
+  ASSERT(WaitForChange(srsWATCH_DELETED, "sub", true));
+
+  /* Nothing is reported once it has been closed */
+  srsWatch_Close(watch);
+  int32_t closed_calls = srsAtomic_Load(&calls);
+  ASSERT(srsPath_Remove("watch/renamed.txt"));
+  srsThread_Yield();
+  ASSERT_EQ(closed_calls, srsAtomic_Load(&calls));
+
+  srsMutex_Destroy(&watch_log_lock);
+  PASS();
+}
+
+static void IgnoreChange(srsWATCH_EVENT event, const char *path, bool is_dir, void *userdata)
+{
+  srsAtomic_Add((srsATOMIC32 *)userdata, 1);
+}
+
+TEST TestWatchedExistence()
+{
+  srsATOMIC32 calls = 0;
+  char root[srsPATH_MAX + 1];
+  ASSERT(srsDir_Exists("watch") || srsDir_Create("watch"));
+  srsPath_Remove("watch/cached.txt");
+  srsPath_Remove("watch/outside.txt");
+  ASSERT(kioku_path_concat(root, sizeof(root), TESTDIR, "watch") > 0);
+
+  srsWATCH *watch = srsWatch_Open(root, IgnoreChange, &calls);
+  if (watch == NULL)
+  {
+    SKIPm("Watching is not supported on this platform");
+  }
+  /* Changes made through the filesystem module are seen straight away, including when the answer was cached as missing */
+  ASSERT_FALSE(srsFile_Exists("watch/cached.txt"));
+  ASSERT_FALSE(srsFile_Exists("watch//./cached.txt"));
+  ASSERT(srsFile_Create("watch/cached.txt"));
+  ASSERT(srsFile_Exists("watch/cached.txt"));
+  ASSERT(srsFile_Exists("watch//./cached.txt"));
+  ASSERT(srsPath_Exists("watch/cached.txt"));
+  ASSERT_FALSE(srsDir_Exists("watch/cached.txt"));
+  srsDIR *dir = srsDir_Open("watch");
+  ASSERT(dir != NULL);
+  ASSERT(srsFile_ExistsAt(dir, "cached.txt"));
+  ASSERT(srsPath_Move("watch/cached.txt", "watch/moved.txt"));
+  ASSERT_FALSE(srsFile_ExistsAt(dir, "cached.txt"));
+  ASSERT(srsFile_ExistsAt(dir, "moved.txt"));
+  ASSERT(srsPath_Remove("watch/moved.txt"));
+  ASSERT_FALSE(srsPath_ExistsAt(dir, "moved.txt"));
+  ASSERT(srsDir_Create("watch/cached-dir"));
+  ASSERT(srsDir_ExistsAt(dir, "cached-dir"));
+  ASSERT(srsPath_Remove("watch/cached-dir"));
+  ASSERT_FALSE(srsDir_Exists("watch/cached-dir"));
+
+  /* Changes made behind its back are seen once the watcher reports them */
+  ASSERT_FALSE(srsFile_Exists("watch/outside.txt"));
+  FILE *fp = fopen("watch/outside.txt", "w");
+  ASSERT(fp != NULL);
+  fclose(fp);
+  time_t deadline = time(NULL) + 5;
+  while (!srsFile_Exists("watch/outside.txt") && (time(NULL) <= deadline))
+  {
+    srsThread_Yield();
+  }
+  ASSERT(srsFile_Exists("watch/outside.txt"));
+  remove("watch/outside.txt");
+
+  /* Without a watcher nothing is cached */
+  srsWatch_Close(watch);
+  ASSERT_FALSE(srsFile_ExistsAt(dir, "outside.txt"));
+  fp = fopen("watch/outside.txt", "w");
+  ASSERT(fp != NULL);
+  fclose(fp);
+  ASSERT(srsFile_ExistsAt(dir, "outside.txt"));
+  srsDir_Close(dir);
+  PASS();
+}
+
+TEST TestWatchMany()
+{
+  srsATOMIC32 calls[12] = {0};
+  srsWATCH *watches[12] = {0};
+  char root[srsPATH_MAX + 1];
+  char path[srsPATH_MAX + 1];
+  ASSERT(srsMutex_Init(&watch_log_lock));
+  /* More trees than the stat cache used to track, two of them the same */
+  for (size_t i = 0; i < 12; i++)
+  {
+    snprintf(path, sizeof(path), "watch-many/%zu", (i == 11) ? (size_t)0 : i);
+    ASSERT(srsDir_Exists(path) || srsDir_Create(path));
+    ASSERT(kioku_path_concat(root, sizeof(root), TESTDIR, path) > 0);
+    watches[i] = srsWatch_Open(root, RecordChange, &calls[i]);
+    if (watches[i] == NULL)
+    {
+      for (size_t j = 0; j < i; j++)
+      {
+        srsWatch_Close(watches[j]);
+      }
+      srsMutex_Destroy(&watch_log_lock);
+      SKIPm("Watching is not supported on this platform");
+    }
+  }
+
+  /* Each watcher only hears about its own tree, and both watchers of the same tree hear about it */
+  srsPath_Remove("watch-many/10/created.txt");
+  ASSERT(srsFile_Create("watch-many/10/created.txt"));
+  ASSERT(WaitForChange(srsWATCH_CREATED, "created.txt", false));
+  ASSERT(srsAtomic_Load(&calls[10]) > 0);
+  ASSERT_EQ(0, srsAtomic_Load(&calls[9]));
+  ClearChanges();
+  srsPath_Remove("watch-many/0/created.txt");
+  ASSERT(srsFile_Create("watch-many/0/created.txt"));
+  time_t deadline = time(NULL) + 5;
+  while (((srsAtomic_Load(&calls[0]) == 0) || (srsAtomic_Load(&calls[11]) == 0)) && (time(NULL) <= deadline))
+  {
+    srsThread_Yield();
+  }
+  ASSERT(srsAtomic_Load(&calls[0]) > 0);
+  ASSERT(srsAtomic_Load(&calls[11]) > 0);
+
+  /* The filesystem module trusts its cache beneath the last tree like beneath the first */
+  ASSERT(srsFileSystem_SetWatched(srsWatch_GetPath(watches[10]), false));
+  ASSERT(srsFileSystem_SetWatched(srsWatch_GetPath(watches[10]), true));
+
+  /* Closing one of the watchers of a tree leaves the other one watching it */
+  srsWatch_Close(watches[0]);
+  int32_t closed_calls = srsAtomic_Load(&calls[0]);
+  int32_t open_calls = srsAtomic_Load(&calls[11]);
+  ClearChanges();
+  ASSERT(srsPath_Remove("watch-many/0/created.txt"));
+  ASSERT(WaitForChange(srsWATCH_DELETED, "created.txt", false));
+  ASSERT_EQ(closed_calls, srsAtomic_Load(&calls[0]));
+  ASSERT(srsAtomic_Load(&calls[11]) > open_calls);
+  for (size_t i = 1; i < 12; i++)
+  {
+    srsWatch_Close(watches[i]);
+  }
+  srsMutex_Destroy(&watch_log_lock);
+  PASS();
+}
+
+SUITE(test_watch) {
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestWatch);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestWatchedExistence);
+  printf(kiokuSTRING_LF);
+  srsDir_SetCWD(TESTDIR);
+  RUN_TEST(TestWatchMany);
+}
+
+/* Add definitions that need to be in the test runner's main file. */
+GREATEST_MAIN_DEFS();
+int main(int argc, char **argv)
+{
+  GREATEST_MAIN_BEGIN();      /* command-line options, initialization. */
+  RUN_SUITE(test_watch);
+  GREATEST_MAIN_END();        /* display results */
+}